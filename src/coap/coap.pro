@@ -5,13 +5,17 @@ QT_FOR_PRIVATE = network
 
 PUBLIC_HEADERS += \
     qcoapclient.h \
+    qcoapclientstatistics.h \
     qcoapconnection.h \
     qcoapmessage.h \
     qcoapoption.h \
     qcoapreply.h \
     qcoaprequest.h \
     qcoapresource.h \
+    qcoapresourcedirectory.h \
+    qcoapresourceset.h \
     qcoapprotocol.h \
+    qcoapserver.h \
     qcoapinternalmessage.h \
     qcoapglobal.h \
     qcoapdiscoveryreply.h \
@@ -19,13 +23,23 @@ PUBLIC_HEADERS += \
 
 PRIVATE_HEADERS += \
     qcoapmessage_p.h \
+    qcoapoption_p.h \
     qcoapreply_p.h \
     qcoaprequest_p.h \
-    qcoapoption_p.h \
     qcoapconnection_p.h \
     qcoapclient_p.h \
+    qcoapclientstatistics_p.h \
+    qcoapcapture_p.h \
+    qcoapattributepool_p.h \
+    qcoapobjectpool_p.h \
+    qcoapratelimiter_p.h \
     qcoapresource_p.h \
+    qcoapresourcedirectory_p.h \
+    qcoapresourceset_p.h \
+    qcoapresourcetree_p.h \
+    qcoaplinkformatparser_p.h \
     qcoapprotocol_p.h \
+    qcoapserver_p.h \
     qcoapinternalmessage_p.h \
     qcoapinternalrequest_p.h \
     qcoapinternalreply_p.h \
@@ -33,13 +47,22 @@ PRIVATE_HEADERS += \
 
 SOURCES += \
     qcoapclient.cpp \
+    qcoapclientstatistics.cpp \
+    qcoapcapture.cpp \
     qcoapconnection.cpp \
     qcoapmessage.cpp \
     qcoapoption.cpp \
     qcoapreply.cpp \
     qcoaprequest.cpp \
+    qcoapattributepool.cpp \
+    qcoapratelimiter.cpp \
     qcoapresource.cpp \
+    qcoapresourcedirectory.cpp \
+    qcoapresourceset.cpp \
+    qcoapresourcetree.cpp \
+    qcoaplinkformatparser.cpp \
     qcoapprotocol.cpp \
+    qcoapserver.cpp \
     qcoapinternalmessage.cpp \
     qcoapinternalreply.cpp \
     qcoapinternalrequest.cpp \
@@ -47,4 +70,7 @@ SOURCES += \
 
 HEADERS += $$PUBLIC_HEADERS $$PRIVATE_HEADERS
 
+TRACEPOINT_PROVIDER = $$PWD/qtcoap.tracepoints
+CONFIG += qt_tracepoints
+
 load(qt_module)
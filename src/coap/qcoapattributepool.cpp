@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapattributepool_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapAttributePool
+    \brief The QCoapAttributePool class shares the storage of link
+    attribute values.
+
+    The 'rt' and 'if' attributes of discovered resources come from a small
+    vocabulary, repeated by every resource of a catalogue. The pool keeps
+    one QString for each distinct value, and returns implicitly shared
+    copies of it, so that repeated values cost neither an allocation nor
+    memory.
+
+    Each QCoapLinkFormatParser owns a pool, which is released with it, so
+    that values are only shared within the documents it parses. Once the
+    pool holds MaximumSize values, new values are returned as they are,
+    without being pooled.
+*/
+
+/*!
+    \internal
+
+    Returns the pooled string equal to \a value, adding \a value to the pool
+    if it is not there yet.
+*/
+QString QCoapAttributePool::intern(const QString &value)
+{
+    if (value.isEmpty())
+        return value;
+
+    const auto it = strings.constFind(value);
+    if (it != strings.cend())
+        return *it;
+
+    if (strings.size() < MaximumSize)
+        strings.insert(value);
+    return value;
+}
+
+/*!
+    \internal
+
+    Returns the pooled string for the \a size bytes of UTF-8 at \a utf8.
+    Nothing is allocated when the value is already pooled.
+*/
+QString QCoapAttributePool::intern(const char *utf8, int size)
+{
+    if (size <= 0)
+        return QString();
+
+    const uint hash = qHashBits(utf8, static_cast<size_t>(size));
+    for (auto it = utf8Strings.constFind(hash);
+         it != utf8Strings.cend() && it.key() == hash; ++it) {
+        const QByteArray &candidate = it.value().utf8;
+        if (candidate.size() == size
+                && memcmp(candidate.constData(), utf8, static_cast<size_t>(size)) == 0) {
+            return it.value().value;
+        }
+    }
+
+    QString value = QString::fromUtf8(utf8, size);
+    const auto it = strings.constFind(value);
+    if (it != strings.cend())
+        value = *it;
+    else if (strings.size() < MaximumSize)
+        strings.insert(value);
+    else
+        return value;
+
+    if (utf8Strings.size() < MaximumSize)
+        utf8Strings.insert(hash, { QByteArray(utf8, size), value });
+    return value;
+}
+
+/*!
+    \fn int QCoapAttributePool::size() const
+    \internal
+
+    Returns the number of distinct values in the pool.
+*/
+
+QT_END_NAMESPACE
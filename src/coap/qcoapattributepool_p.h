@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPATTRIBUTEPOOL_P_H
+#define QCOAPATTRIBUTEPOOL_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qset.h>
+#include <QtCore/qstring.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapAttributePool
+{
+public:
+    enum { MaximumSize = 4096 };
+
+    QString intern(const QString &value);
+    QString intern(const char *utf8, int size);
+    int size() const { return strings.size(); }
+
+private:
+    struct Utf8Entry
+    {
+        QByteArray utf8;
+        QString value;
+    };
+
+    QSet<QString> strings;
+    // Keyed by the hash of the UTF-8 form, so that raw link-format bytes
+    // can be looked up without building a QByteArray or a QString first.
+    QMultiHash<uint, Utf8Entry> utf8Strings;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPATTRIBUTEPOOL_P_H
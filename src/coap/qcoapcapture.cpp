@@ -0,0 +1,359 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapcapture_p.h"
+#include "qcoapprotocol_p.h"
+#include "qcoapinternalrequest_p.h"
+#include "qcoapinternalmessage_p.h"
+#include <QtCore/qendian.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qtimer.h>
+#include <QtNetwork/qnetworkdatagram.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+const char captureMagic[] = "QCOAPCAP";
+const int captureMagicSize = sizeof(captureMagic) - 1;
+const quint8 captureVersion = 1;
+
+enum RecordFlag : quint8 {
+    ReceivedFlag = 0x01,
+    IPv6Flag = 0x02
+};
+
+template <typename T>
+void appendBigEndian(QByteArray *buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToBigEndian(value, bytes);
+    buffer->append(bytes, int(sizeof(T)));
+}
+
+} // namespace
+
+/*!
+    \internal
+
+    \class QCoapCaptureWriter
+    \brief The QCoapCaptureWriter class records CoAP datagrams in a binary
+    capture log.
+
+    The log starts with the \c QCOAPCAP magic and a version byte. Each
+    record then holds, in network byte order:
+
+    \list
+        \li a flags byte: bit 0 is set for received datagrams, bit 1 for
+            IPv6 addresses
+        \li the timestamp of the record, as a 64-bit count of nanoseconds
+            on a monotonic clock started with the capture
+        \li the 4 or 16 bytes of the destination or sender address
+        \li the 16-bit port
+        \li the 16-bit length of the datagram, followed by the datagram
+    \endlist
+
+    \sa QCoapCaptureReplayer, QCoapConnection::setCaptureDevice()
+*/
+
+/*!
+    \internal
+
+    Constructs a writer recording to \a device, which must be open for
+    writing. The header of the log is written immediately.
+*/
+QCoapCaptureWriter::QCoapCaptureWriter(QIODevice *device) :
+    device(device)
+{
+    clock.start();
+    buffer.reserve(64);
+    if (isValid()) {
+        buffer.append(captureMagic, captureMagicSize);
+        buffer.append(char(captureVersion));
+        device->write(buffer);
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if the device of the writer still exists and is open
+    for writing.
+*/
+bool QCoapCaptureWriter::isValid() const
+{
+    return device && device->isWritable();
+}
+
+/*!
+    \internal
+
+    Records the \a frame sent to, or received from, \a address and \a port,
+    depending on \a direction. The current time of the capture clock is
+    used as timestamp.
+*/
+void QCoapCaptureWriter::write(QCoapCaptureRecord::Direction direction, const QByteArray &frame,
+                               const QHostAddress &address, quint16 port)
+{
+    QCoapCaptureRecord record;
+    record.direction = direction;
+    record.timestamp = clock.nsecsElapsed();
+    record.address = address;
+    record.port = port;
+    record.frame = frame;
+    write(record);
+}
+
+/*!
+    \internal
+
+    Writes \a record as it is, including its timestamp.
+*/
+void QCoapCaptureWriter::write(const QCoapCaptureRecord &record)
+{
+    if (!isValid())
+        return;
+
+    const bool isIPv6 = record.address.protocol() == QAbstractSocket::IPv6Protocol;
+    quint8 flags = isIPv6 ? IPv6Flag : 0;
+    if (record.direction == QCoapCaptureRecord::Received)
+        flags |= ReceivedFlag;
+
+    buffer.resize(0);
+    buffer.append(char(flags));
+    appendBigEndian(&buffer, quint64(record.timestamp));
+    if (isIPv6) {
+        const Q_IPV6ADDR address = record.address.toIPv6Address();
+        buffer.append(reinterpret_cast<const char *>(address.c), 16);
+    } else {
+        appendBigEndian(&buffer, record.address.toIPv4Address());
+    }
+    appendBigEndian(&buffer, record.port);
+    const int size = qMin(record.frame.size(), 0xFFFF);
+    appendBigEndian(&buffer, quint16(size));
+    buffer.append(record.frame.constData(), size);
+
+    device->write(buffer);
+}
+
+/*!
+    \internal
+
+    Reads the records of the capture log available on \a device. If \a ok
+    is not \c nullptr, it is set to \c false when the log is invalid or
+    truncated; the records read until then are returned.
+*/
+QVector<QCoapCaptureRecord> QCoapCaptureWriter::readAll(QIODevice *device, bool *ok)
+{
+    QVector<QCoapCaptureRecord> records;
+    const QByteArray data = device->readAll();
+    const char *p = data.constData();
+    const char *end = p + data.size();
+
+    if (ok)
+        *ok = false;
+    if (data.size() < captureMagicSize + 1 || memcmp(p, captureMagic, captureMagicSize) != 0
+            || quint8(p[captureMagicSize]) != captureVersion) {
+        return records;
+    }
+    p += captureMagicSize + 1;
+
+    while (p != end) {
+        const quint8 flags = quint8(*p);
+        const int addressSize = (flags & IPv6Flag) ? 16 : 4;
+        if (end - p < 1 + 8 + addressSize + 2 + 2)
+            return records;
+
+        QCoapCaptureRecord record;
+        record.direction = (flags & ReceivedFlag) ? QCoapCaptureRecord::Received
+                                                  : QCoapCaptureRecord::Sent;
+        record.timestamp = qint64(qFromBigEndian<quint64>(p + 1));
+        p += 9;
+        if (flags & IPv6Flag)
+            record.address.setAddress(reinterpret_cast<const quint8 *>(p));
+        else
+            record.address.setAddress(qFromBigEndian<quint32>(p));
+        p += addressSize;
+        record.port = qFromBigEndian<quint16>(p);
+        const int size = qFromBigEndian<quint16>(p + 2);
+        p += 4;
+        if (end - p < size)
+            return records;
+
+        record.frame = QByteArray(p, size);
+        p += size;
+        records.append(record);
+    }
+
+    if (ok)
+        *ok = true;
+    return records;
+}
+
+/*!
+    \internal
+
+    \class QCoapCaptureReplayer
+    \brief The QCoapCaptureReplayer class replays a capture log through a
+    QCoapProtocol.
+
+    Received frames are fed to the protocol as if they came from the
+    network. Sent requests are not sent again: their exchange is
+    registered with the recorded token and message ID, so that the
+    received frames find it. Requests without a token cannot be told
+    apart, and are skipped. Frames sent by the protocol in answer to the
+    replayed frames, like acknowledgments, go through \a connection.
+
+    The protocol must live in the thread of the replayer.
+*/
+
+/*!
+    \internal
+
+    Constructs a replayer feeding \a protocol, and sending its answers
+    through \a connection, with the given \a parent.
+*/
+QCoapCaptureReplayer::QCoapCaptureReplayer(QCoapProtocol *protocol, QCoapConnection *connection,
+                                           QObject *parent) :
+    QObject(parent),
+    protocol(protocol),
+    connection(connection),
+    timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &QCoapCaptureReplayer::replayDue);
+}
+
+/*!
+    \internal
+
+    Sets the \a records to replay, and rewinds the replay.
+*/
+void QCoapCaptureReplayer::setRecords(const QVector<QCoapCaptureRecord> &records)
+{
+    timer->stop();
+    this->records = records;
+    position = 0;
+}
+
+/*!
+    \internal
+
+    Starts the replay. The records are replayed with the delays they were
+    recorded with, divided by \a speed. If \a speed is 0 or less, all the
+    records are replayed immediately, as fast as the protocol handles
+    them, before this method returns.
+
+    The finished() signal is emitted once all the records are replayed.
+*/
+void QCoapCaptureReplayer::start(double speed)
+{
+    this->speed = speed;
+    if (speed <= 0) {
+        while (position < records.size())
+            replay(records.at(position++));
+        emit finished();
+        return;
+    }
+
+    clock.start();
+    replayDue();
+}
+
+/*!
+    \internal
+
+    Replays the records whose time has come, and schedules the next one.
+*/
+void QCoapCaptureReplayer::replayDue()
+{
+    if (position == records.size())
+        return;
+
+    const qint64 start = records.first().timestamp;
+    const qint64 elapsed = clock.nsecsElapsed();
+    while (position < records.size()) {
+        const qint64 due = qint64((records.at(position).timestamp - start) / speed);
+        if (due > elapsed) {
+            timer->start(int((due - elapsed + 999999) / 1000000));
+            return;
+        }
+        replay(records.at(position++));
+    }
+
+    emit finished();
+}
+
+/*!
+    \internal
+
+    Replays a single \a record.
+*/
+void QCoapCaptureReplayer::replay(const QCoapCaptureRecord &record)
+{
+    auto d = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+
+    if (record.direction == QCoapCaptureRecord::Received) {
+        QNetworkDatagram datagram(record.frame);
+        datagram.setSender(record.address, record.port);
+        d->onFrameReceived(datagram);
+        return;
+    }
+
+    // Only requests open an exchange, acknowledgments and resets do not
+    const QByteArray &frame = record.frame;
+    if (frame.size() < 4)
+        return;
+    const auto type = QCoapMessage::MessageType((quint8(frame.at(0)) >> 4) & 0x03);
+    const quint8 code = quint8(frame.at(1));
+    if (type == QCoapMessage::Acknowledgment || type == QCoapMessage::Reset
+            || code == 0 || code > 31) {
+        return;
+    }
+
+    const QCoapToken token = QCoapInternalMessagePrivate::frameToken(frame);
+    if (d->isTokenRegistered(token))
+        return;
+
+    QUrl targetUri;
+    targetUri.setScheme(QStringLiteral("coap"));
+    targetUri.setHost(record.address.toString());
+    targetUri.setPort(record.port);
+
+    QCoapInternalRequest *request = d->requestPool.create();
+    request->setTargetUri(targetUri);
+    request->setMethod(QtCoap::Method(code));
+    request->setConnection(connection);
+    request->message()->setType(type);
+    request->setToken(token);
+    request->setMessageId(quint16(QCoapInternalMessagePrivate::frameMessageId(frame)));
+    d->registerExchange(token, nullptr, request);
+}
+
+QT_END_NAMESPACE
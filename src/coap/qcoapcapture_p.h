@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPCAPTURE_P_H
+#define QCOAPCAPTURE_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qvector.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QIODevice;
+class QTimer;
+class QCoapConnection;
+class QCoapProtocol;
+
+struct QCoapCaptureRecord
+{
+    enum Direction : quint8 {
+        Sent,
+        Received
+    };
+
+    Direction direction = Sent;
+    qint64 timestamp = 0;   // nanoseconds since the start of the capture
+    QHostAddress address;   // destination of sent frames, sender of received ones
+    quint16 port = 0;
+    QByteArray frame;
+};
+
+class Q_AUTOTEST_EXPORT QCoapCaptureWriter
+{
+public:
+    explicit QCoapCaptureWriter(QIODevice *device);
+
+    bool isValid() const;
+    void write(QCoapCaptureRecord::Direction direction, const QByteArray &frame,
+               const QHostAddress &address, quint16 port);
+    void write(const QCoapCaptureRecord &record);
+
+    static QVector<QCoapCaptureRecord> readAll(QIODevice *device, bool *ok = nullptr);
+
+private:
+    QPointer<QIODevice> device;
+    QElapsedTimer clock;
+    QByteArray buffer;  // reused for each record
+};
+
+class Q_AUTOTEST_EXPORT QCoapCaptureReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    QCoapCaptureReplayer(QCoapProtocol *protocol, QCoapConnection *connection,
+                         QObject *parent = nullptr);
+
+    void setRecords(const QVector<QCoapCaptureRecord> &records);
+    void start(double speed = 1.0);
+    int replayedCount() const { return position; }
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    void replay(const QCoapCaptureRecord &record);
+    void replayDue();
+
+    QCoapProtocol *protocol = nullptr;
+    QCoapConnection *connection = nullptr;
+    QVector<QCoapCaptureRecord> records;
+    QTimer *timer = nullptr;
+    QElapsedTimer clock;
+    double speed = 1.0;
+    int position = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPCAPTURE_P_H
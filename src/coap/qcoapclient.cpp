@@ -31,18 +31,32 @@
 #include "qcoapreply.h"
 #include "qcoapdiscoveryreply.h"
 #include "qcoapnamespace.h"
+#include "qcoapprotocol_p.h"
+#include "qcoapconnection_p.h"
 #include <QtCore/qurl.h>
+#include <QtCore/qurlquery.h>
 #include <QtNetwork/qudpsocket.h>
 
+#include <type_traits>
+
 QT_BEGIN_NAMESPACE
 
+Q_STATIC_ASSERT((std::is_same<QCoapClient::ResponseCallback, CoapResponseCallback>::value));
+
 QRandomGenerator QtCoap::randomGenerator = QRandomGenerator::securelySeeded();
 
 QCoapClientPrivate::QCoapClientPrivate(QCoapProtocol *protocol, QCoapConnection *connection) :
     protocol(protocol),
     connection(connection),
-    workerThread(new QThread)
+    workerThread(new QThread),
+    callbackReceiver(new QObject)
 {
+    // Queue times are counted by the connection with the statistics of the
+    // protocol, both in the worker thread
+    auto protocolPrivate = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+    auto connectionPrivate = static_cast<QCoapConnectionPrivate *>(QObjectPrivate::get(connection));
+    connectionPrivate->statistics = &protocolPrivate->statistics;
+
     protocol->moveToThread(workerThread);
     connection->moveToThread(workerThread);
     workerThread->start();
@@ -50,11 +64,18 @@ QCoapClientPrivate::QCoapClientPrivate(QCoapProtocol *protocol, QCoapConnection
 
 QCoapClientPrivate::~QCoapClientPrivate()
 {
+    // Let the protocol start the asynchronous requests still queued, so
+    // that their futures are canceled when it is deleted.
+    QMetaObject::invokeMethod(protocol, [] {}, Qt::BlockingQueuedConnection);
+
     workerThread->quit();
     workerThread->wait();
     delete workerThread;
     delete protocol;
     delete connection;
+
+    // Deleted last, dropping the callbacks the protocol still queued
+    delete callbackReceiver;
 }
 
 /*!
@@ -477,6 +498,212 @@ QCoapReply *QCoapClient::deleteResource(const QUrl &url)
     return deleteResource(QCoapRequest(url));
 }
 
+/*!
+    Sends the \a request using the GET method and returns a future for its
+    response, without creating a QCoapReply.
+
+    The future is finished with the response message once it is
+    received. For a multicast request, the future has one result for each
+    server that answers, and is finished at the end of the
+    \l{QCoapProtocol::leisure()}{Leisure}. If the request cannot be sent, if
+    the exchange fails, or if the server answers with an error response code,
+    the future is canceled, as the response code is not part of the message.
+
+    Canceling the future stops the retransmissions of the request. Observe
+    requests are not supported by the asynchronous methods: the future is
+    finished with the first notification.
+
+    \sa get(), putAsync(), postAsync(), deleteResourceAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::getAsync(const QCoapRequest &request)
+{
+    Q_D(QCoapClient);
+
+    if (request.method() != QtCoap::Invalid
+            && request.method() != QtCoap::Get) {
+        qWarning("QCoapClient::getAsync: Overriding method specified on request:"
+                 "using 'Get' instead.");
+    }
+
+    QCoapRequest copyRequest(request, QtCoap::Get);
+
+    return d->sendRequestAsync(copyRequest);
+}
+
+/*!
+    \overload
+
+    Sends a GET request to \a url and returns a future for its response.
+
+    \sa get(), putAsync(), postAsync(), deleteResourceAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::getAsync(const QUrl &url)
+{
+    return getAsync(QCoapRequest(url));
+}
+
+/*!
+    Sends the \a request using the PUT method and returns a future for its
+    response. Uses \a data as the payload for this request.
+
+    \sa put(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::putAsync(const QCoapRequest &request, const QByteArray &data)
+{
+    Q_D(QCoapClient);
+
+    if (request.method() != QtCoap::Invalid
+            && request.method() != QtCoap::Put) {
+        qWarning("QCoapClient::putAsync: Overriding method specified on request:"
+                 "using 'Put' instead.");
+    }
+
+    QCoapRequest copyRequest(request, QtCoap::Put);
+    copyRequest.setPayload(data);
+
+    return d->sendRequestAsync(copyRequest);
+}
+
+/*!
+    \overload
+
+    Sends a PUT request to \a url and returns a future for its response.
+    Uses \a data as the payload for this request.
+
+    \sa put(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::putAsync(const QUrl &url, const QByteArray &data)
+{
+    return putAsync(QCoapRequest(url), data);
+}
+
+/*!
+    Sends the \a request using the POST method and returns a future for its
+    response. Uses \a data as the payload for this request.
+
+    \sa post(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::postAsync(const QCoapRequest &request, const QByteArray &data)
+{
+    Q_D(QCoapClient);
+
+    if (request.method() != QtCoap::Invalid
+            && request.method() != QtCoap::Post) {
+        qWarning("QCoapClient::postAsync: Overriding method specified on request:"
+                 "using 'Post' instead.");
+    }
+
+    QCoapRequest copyRequest(request, QtCoap::Post);
+    copyRequest.setPayload(data);
+
+    return d->sendRequestAsync(copyRequest);
+}
+
+/*!
+    \overload
+
+    Sends a POST request to \a url and returns a future for its response.
+    Uses \a data as the payload for this request.
+
+    \sa post(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::postAsync(const QUrl &url, const QByteArray &data)
+{
+    return postAsync(QCoapRequest(url), data);
+}
+
+/*!
+    Sends the \a request using the DELETE method and returns a future for its
+    response.
+
+    \sa deleteResource(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::deleteResourceAsync(const QCoapRequest &request)
+{
+    Q_D(QCoapClient);
+
+    if (request.method() != QtCoap::Invalid
+            && request.method() != QtCoap::Delete) {
+        qWarning("QCoapClient::deleteResourceAsync: Overriding method specified on request:"
+                 "using 'Delete' instead.");
+    }
+
+    QCoapRequest copyRequest(request, QtCoap::Delete);
+
+    return d->sendRequestAsync(copyRequest);
+}
+
+/*!
+    \overload
+
+    Sends a DELETE request to the target \a url and returns a future for its
+    response.
+
+    \sa deleteResource(), getAsync()
+*/
+QFuture<QCoapMessage> QCoapClient::deleteResourceAsync(const QUrl &url)
+{
+    return deleteResourceAsync(QCoapRequest(url));
+}
+
+/*!
+    \typedef QCoapClient::ResponseCallback
+
+    Synonym for \c{std::function<void(QtCoap::ResponseCode, const QCoapMessage &)>}.
+    The callback gets the response code, and the response message with its
+    options and payload.
+*/
+
+/*!
+    Sends the \a request, using its method or GET if it has none, and
+    invokes \a callback once with the response, in the thread of the
+    \a context object. No QCoapReply is created for the request, which makes
+    it the cheapest way to send many requests.
+
+    If the exchange fails without a response, for instance on timeout, the
+    callback gets QtCoap::InvalidCode and an empty message. For a multicast
+    request, the callback gets the first response. The callback is not
+    invoked if \a context or the client is destroyed first.
+
+    The \a context must live in the thread of the client, where it is
+    checked before the callback is invoked.
+
+    Returns \c false, without invoking the callback, if the request cannot
+    be sent.
+
+    \sa get(), getAsync()
+*/
+bool QCoapClient::sendRequest(const QCoapRequest &request, const QObject *context,
+                              ResponseCallback callback)
+{
+    Q_D(QCoapClient);
+
+    if (!context || !callback) {
+        qWarning("QCoapClient: Failed to send request without a callback and its context.");
+        return false;
+    }
+
+    if (context->thread() != d->callbackReceiver->thread()) {
+        qWarning("QCoapClient: Failed to send request with a context in another thread.");
+        return false;
+    }
+
+    if (!QCoapRequest::isUrlValid(request.url())) {
+        qWarning("QCoapClient: Failed to send request for an invalid URL.");
+        return false;
+    }
+
+    QCoapRequest copyRequest(request, request.method() == QtCoap::Invalid
+                                      ? QtCoap::Get : request.method());
+
+    CoapExchangeData exchange;
+    exchange.callbackReceiver = d->callbackReceiver;
+    exchange.callbackContext = const_cast<QObject *>(context);
+    exchange.callback = std::move(callback);
+    d->startExchange(copyRequest, exchange);
+    return true;
+}
+
 /*!
     Discovers the resources available at the given \a url and returns
     a new QCoapDiscoveryReply object which emits the
@@ -487,14 +714,36 @@ QCoapReply *QCoapClient::deleteResource(const QUrl &url)
     by passing a different path to \a discoveryPath. Discovery is described in
     \l{https://tools.ietf.org/html/rfc6690#section-1.2.1}{RFC 6690}.
 
+    A filter like \c rt=temperature, in the query of \a url or after the
+    path in \a discoveryPath, is sent to the server so that it only lists
+    the matching resources. Filters given in both must all match. As filtering is optional for servers, the
+    filter is also applied to the resources received. See section
+    \l{https://tools.ietf.org/html/rfc6690#section-4.1}{'Query Filtering'}
+    of RFC 6690.
+
+    If the host of \a url is a multicast address, each server that answers
+    is reported by its own \l{QCoapDiscoveryReply::discovered()}{discovered()}
+    signal, and the reply is finished at the end of the
+    \l{QCoapProtocol::leisure()}{Leisure}.
+
     \sa get(), post(), put(), deleteResource(), observe()
 */
 QCoapDiscoveryReply *QCoapClient::discover(const QUrl &url, const QString &discoveryPath)
 {
     Q_D(QCoapClient);
 
+    const int queryStart = discoveryPath.indexOf(QLatin1Char('?'));
+
     QUrl discoveryUrl(url);
-    discoveryUrl.setPath(url.path() + discoveryPath);
+    discoveryUrl.setPath(url.path() + discoveryPath.left(queryStart));
+    if (queryStart >= 0) {
+        // Keep the filters of the URL along those of the discovery path
+        QUrlQuery query(url);
+        const QUrlQuery pathQuery(discoveryPath.mid(queryStart + 1));
+        for (const auto &item : pathQuery.queryItems())
+            query.addQueryItem(item.first, item.second);
+        discoveryUrl.setQuery(query);
+    }
 
     QCoapRequest request(discoveryUrl);
     request.setMethod(QtCoap::Get);
@@ -502,6 +751,46 @@ QCoapDiscoveryReply *QCoapClient::discover(const QUrl &url, const QString &disco
     return d->sendDiscovery(request);
 }
 
+/*!
+    \overload
+
+    Discovers the resources of the CoAP nodes listening on \a port and
+    joined to the "All CoAP Nodes" multicast \a group, with a single
+    request. See section
+    \l{https://tools.ietf.org/html/rfc7252#section-8}{'Multicast CoAP'}
+    of RFC 7252.
+
+    The returned QCoapDiscoveryReply emits the
+    \l{QCoapDiscoveryReply::discovered()}{discovered()} signal once for each
+    server that answers, with the resources not reported yet, and is
+    finished at the end of the \l{QCoapProtocol::leisure()}{Leisure}.
+
+    As only the servers with matching resources answer a filtered
+    discovery, like with the \a discoveryPath
+    "/.well-known/core?rt=temperature", filters are best used with
+    multicast.
+*/
+QCoapDiscoveryReply *QCoapClient::discover(QtCoap::MulticastGroup group, int port,
+                                           const QString &discoveryPath)
+{
+    QUrl url;
+    url.setScheme(QStringLiteral("coap"));
+    switch (group) {
+    case QtCoap::AllCoapNodesIPv4:
+        url.setHost(QStringLiteral("224.0.1.187"));
+        break;
+    case QtCoap::AllCoapNodesIPv6LinkLocal:
+        url.setHost(QStringLiteral("ff02::fd"));
+        break;
+    case QtCoap::AllCoapNodesIPv6SiteLocal:
+        url.setHost(QStringLiteral("ff05::fd"));
+        break;
+    }
+    url.setPort(port);
+
+    return discover(url, discoveryPath);
+}
+
 /*!
     Sends a request to observe the target \a request and returns
     a new QCoapReply object which emits the
@@ -555,6 +844,49 @@ void QCoapClient::cancelObserve(QCoapReply *notifiedReply)
                               Q_ARG(QPointer<QCoapReply>, QPointer<QCoapReply>(notifiedReply)));
 }
 
+/*!
+    \internal
+
+    Sends the CoAP \a request to its own URL and returns a future for its
+    response. The future is reported by the protocol directly, from the
+    worker thread.
+*/
+QFuture<QCoapMessage> QCoapClientPrivate::sendRequestAsync(QCoapRequest &request)
+{
+    auto future = QSharedPointer<QFutureInterface<QCoapMessage> >::create();
+    future->reportStarted();
+
+    if (!QCoapRequest::isUrlValid(request.url())) {
+        qWarning("QCoapClient: Failed to send request for an invalid URL.");
+        future->reportCanceled();
+        future->reportFinished();
+        return future->future();
+    }
+
+    CoapExchangeData exchange;
+    exchange.future = future;
+    startExchange(request, exchange);
+
+    return future->future();
+}
+
+/*!
+    \internal
+
+    Queues the start of an exchange for \a request to the protocol, whose
+    result is delivered to the future or the callback of \a exchange.
+*/
+void QCoapClientPrivate::startExchange(const QCoapRequest &request,
+                                       const CoapExchangeData &exchange)
+{
+    QCoapProtocol *protocol = this->protocol;
+    QCoapConnection *connection = this->connection;
+    QMetaObject::invokeMethod(protocol, [protocol, connection, request, exchange] {
+        auto d = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+        d->startExchange(request, exchange, connection);
+    }, Qt::QueuedConnection);
+}
+
 /*!
     \internal
 
@@ -635,6 +967,72 @@ void QCoapClient::setBlockSize(quint16 blockSize)
                               Q_ARG(quint16, blockSize));
 }
 
+/*!
+    Sets the rate limit of the endpoints without a limit of their own to
+    \a bytesPerSecond and \a messagesPerSecond. A rate of 0 means no
+    limit, which is the default.
+
+    \sa QCoapProtocol::setRateLimit()
+*/
+void QCoapClient::setRateLimit(double bytesPerSecond, double messagesPerSecond)
+{
+    Q_D(QCoapClient);
+
+    QMetaObject::invokeMethod(d->protocol, "setRateLimit", Qt::QueuedConnection,
+                              Q_ARG(double, bytesPerSecond),
+                              Q_ARG(double, messagesPerSecond));
+}
+
+/*!
+    \overload
+
+    Sets the rate limit of the endpoint at \a host and \a port to
+    \a bytesPerSecond and \a messagesPerSecond.
+
+    \sa QCoapProtocol::setRateLimit()
+*/
+void QCoapClient::setRateLimit(const QHostAddress &host, quint16 port, double bytesPerSecond,
+                               double messagesPerSecond)
+{
+    Q_D(QCoapClient);
+
+    QCoapProtocol *protocol = d->protocol;
+    QMetaObject::invokeMethod(protocol, [=] {
+        protocol->setRateLimit(host, port, bytesPerSecond, messagesPerSecond);
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    Sets the PROBING_RATE, limiting the non-confirmable requests sent to an
+    endpoint that has not answered yet, to \a bytesPerSecond.
+
+    \sa QCoapProtocol::setProbingRate()
+*/
+void QCoapClient::setProbingRate(double bytesPerSecond)
+{
+    Q_D(QCoapClient);
+
+    QMetaObject::invokeMethod(d->protocol, "setProbingRate", Qt::QueuedConnection,
+                              Q_ARG(double, bytesPerSecond));
+}
+
+/*!
+    Returns a snapshot of the statistics of the client: the messages sent
+    and received since its creation, the exchanges running, and the
+    round-trip times measured with each endpoint.
+
+    The counters are updated by the worker thread of the client without
+    locking, and taking a snapshot does not wait for it. Counters updated
+    while the snapshot is taken may not be consistent with each other.
+*/
+QCoapClientStatistics QCoapClient::statistics() const
+{
+    Q_D(const QCoapClient);
+
+    auto protocol = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(d->protocol));
+    return protocol->statistics.snapshot();
+}
+
 /*!
     Sets the QUdpSocket socket \a option to \a value.
 */
@@ -647,6 +1045,28 @@ void QCoapClient::setSocketOption(QAbstractSocket::SocketOption option, const QV
                               Q_ARG(QVariant, value));
 }
 
+/*!
+    Records every datagram sent and received by the client in \a device,
+    which must be open for writing. Setting a \c nullptr \a device stops
+    the capture.
+
+    The device is written from the worker thread of the client, and must
+    not be used until the capture is stopped. Stopping the capture waits
+    for the worker thread, so that the device can be used as soon as this
+    method returns.
+
+    \sa QCoapConnection::setCaptureDevice()
+*/
+void QCoapClient::setCaptureDevice(QIODevice *device)
+{
+    Q_D(QCoapClient);
+
+    qRegisterMetaType<QIODevice *>();
+    QMetaObject::invokeMethod(d->connection, "setCaptureDevice",
+                              device ? Qt::QueuedConnection : Qt::BlockingQueuedConnection,
+                              Q_ARG(QIODevice *, device));
+}
+
 #if 0
 //! Disabled until fully supported
 /*!
@@ -33,9 +33,15 @@
 #include <QtCore/qglobal.h>
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapnamespace.h>
+#include <QtCoap/qcoapclientstatistics.h>
+#include <QtCoap/qcoapmessage.h>
+#include <QtCore/qfuture.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qiodevice.h>
 #include <QtNetwork/qabstractsocket.h>
+#include <QtNetwork/qhostaddress.h>
+
+#include <functional>
 
 QT_BEGIN_NAMESPACE
 
@@ -50,6 +56,8 @@ class Q_COAP_EXPORT QCoapClient : public QObject
 {
     Q_OBJECT
 public:
+    typedef std::function<void(QtCoap::ResponseCode, const QCoapMessage &)> ResponseCallback;
+
     explicit QCoapClient(QObject *parent = nullptr);
     ~QCoapClient();
 
@@ -63,19 +71,37 @@ public:
     QCoapReply *post(const QUrl &url, const QByteArray &data = QByteArray());
     QCoapReply *deleteResource(const QCoapRequest &request);
     QCoapReply *deleteResource(const QUrl &url);
+    QFuture<QCoapMessage> getAsync(const QCoapRequest &request);
+    QFuture<QCoapMessage> getAsync(const QUrl &url);
+    QFuture<QCoapMessage> putAsync(const QCoapRequest &request,
+                                   const QByteArray &data = QByteArray());
+    QFuture<QCoapMessage> putAsync(const QUrl &url, const QByteArray &data = QByteArray());
+    QFuture<QCoapMessage> postAsync(const QCoapRequest &request,
+                                    const QByteArray &data = QByteArray());
+    QFuture<QCoapMessage> postAsync(const QUrl &url, const QByteArray &data = QByteArray());
+    QFuture<QCoapMessage> deleteResourceAsync(const QCoapRequest &request);
+    QFuture<QCoapMessage> deleteResourceAsync(const QUrl &url);
+    bool sendRequest(const QCoapRequest &request, const QObject *context,
+                     ResponseCallback callback);
     QCoapReply *observe(const QCoapRequest &request);
     QCoapReply *observe(const QUrl &request);
     void cancelObserve(QCoapReply *notifiedReply);
 
-#if 0
-    //! TODO Add Multicast discovery in a later submission.
-    QCoapDiscoveryReply *discover(const QString &discoveryPath = QLatin1String("/.well-known/core"));
-#endif
+    QCoapDiscoveryReply *discover(QtCoap::MulticastGroup group = QtCoap::AllCoapNodesIPv4,
+                                  int port = QtCoap::DefaultPort,
+                                  const QString &discoveryPath = QLatin1String("/.well-known/core"));
     QCoapDiscoveryReply *discover(const QUrl &baseUrl,
                                   const QString &discoveryPath = QLatin1String("/.well-known/core"));
 
     void setBlockSize(quint16 blockSize);
+    void setRateLimit(double bytesPerSecond, double messagesPerSecond);
+    void setRateLimit(const QHostAddress &host, quint16 port, double bytesPerSecond,
+                      double messagesPerSecond);
+    void setProbingRate(double bytesPerSecond);
     void setSocketOption(QAbstractSocket::SocketOption option, const QVariant &value);
+    void setCaptureDevice(QIODevice *device);
+
+    QCoapClientStatistics statistics() const;
 
 #if 0
     void setProtocol(QCoapProtocol *protocol);
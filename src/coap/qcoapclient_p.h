@@ -50,6 +50,8 @@
 
 QT_BEGIN_NAMESPACE
 
+struct CoapExchangeData;
+
 class Q_AUTOTEST_EXPORT QCoapClientPrivate : public QObjectPrivate
 {
 public:
@@ -59,8 +61,11 @@ public:
     QCoapProtocol *protocol = nullptr;
     QCoapConnection *connection = nullptr;
     QThread *workerThread = nullptr;
+    QObject *callbackReceiver = nullptr; // in the thread of the client
 
     QCoapReply *sendRequest(QCoapRequest &request);
+    QFuture<QCoapMessage> sendRequestAsync(QCoapRequest &request);
+    void startExchange(const QCoapRequest &request, const CoapExchangeData &exchange);
     QCoapDiscoveryReply *sendDiscovery(QCoapRequest &request);
     bool send(QCoapReply *reply);
 
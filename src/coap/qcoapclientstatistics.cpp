@@ -0,0 +1,370 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapclientstatistics_p.h"
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// The first bucket holds the round-trip times below 128 microseconds, and
+// each following bucket doubles the bound of the previous one.
+const int firstBucketBits = 7;
+
+} // namespace
+
+/*!
+    \class QCoapClientStatistics
+    \brief The QCoapClientStatistics class is a snapshot of the activity
+    of a QCoapClient.
+
+    \reentrant
+
+    A snapshot is taken with QCoapClient::statistics(). It counts the
+    messages sent and received by the client since its creation, and
+    holds a histogram of the round-trip times measured for each endpoint.
+
+    Round-trip times are measured between the first transmission of a
+    message and its acknowledgment or response. Following Karn's
+    algorithm, exchanges with retransmissions are not measured, as the
+    transmission answered is unknown. The histograms have RttBucketCount
+    buckets of logarithmic width, whose bounds are returned by
+    rttBucketUpperBound().
+
+    \sa QCoapClient::statistics()
+*/
+
+/*!
+    \variable QCoapClientStatistics::RttBucketCount
+
+    The number of buckets of the round-trip time histograms.
+*/
+
+/*!
+    Constructs an empty QCoapClientStatistics.
+*/
+QCoapClientStatistics::QCoapClientStatistics() :
+    d(new QCoapClientStatisticsPrivate)
+{
+}
+
+/*!
+    Copy constructs a new QCoapClientStatistics.
+*/
+QCoapClientStatistics::QCoapClientStatistics(const QCoapClientStatistics &other) :
+    d(other.d)
+{
+}
+
+/*!
+    Destroys the QCoapClientStatistics.
+*/
+QCoapClientStatistics::~QCoapClientStatistics()
+{
+}
+
+/*!
+    Assignment operator.
+*/
+QCoapClientStatistics &QCoapClientStatistics::operator =(const QCoapClientStatistics &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Swap function for Q_DECLARE_SHARED
+*/
+void QCoapClientStatistics::swap(QCoapClientStatistics &other) Q_DECL_NOTHROW
+{
+    d.swap(other.d);
+}
+
+/*!
+    Returns the number of requests sent, not counting retransmissions.
+    Each block of a blockwise transfer is a request.
+*/
+quint64 QCoapClientStatistics::requestsSent() const
+{
+    return d->requestsSent;
+}
+
+/*!
+    Returns the number of retransmissions of confirmable requests.
+*/
+quint64 QCoapClientStatistics::retransmissions() const
+{
+    return d->retransmissions;
+}
+
+/*!
+    Returns the number of requests that failed with a timeout.
+*/
+quint64 QCoapClientStatistics::timeouts() const
+{
+    return d->timeouts;
+}
+
+/*!
+    Returns the number of duplicate replies received and dropped.
+*/
+quint64 QCoapClientStatistics::duplicates() const
+{
+    return d->duplicates;
+}
+
+/*!
+    Returns the number of bytes sent, including retransmissions,
+    acknowledgments and resets.
+*/
+quint64 QCoapClientStatistics::bytesSent() const
+{
+    return d->bytesSent;
+}
+
+/*!
+    Returns the number of bytes received, including the frames dropped.
+*/
+quint64 QCoapClientStatistics::bytesReceived() const
+{
+    return d->bytesReceived;
+}
+
+/*!
+    Returns the number of frames of requests held back by the rate limits
+    of the protocol before being sent.
+
+    \sa throttledTime(), QCoapProtocol::setRateLimit()
+*/
+quint64 QCoapClientStatistics::throttledRequests() const
+{
+    return d->throttledRequests;
+}
+
+/*!
+    Returns the total time, in microseconds, that the frames of requests
+    were held back by the rate limits of the protocol.
+
+    \sa throttledRequests(), QCoapProtocol::setRateLimit()
+*/
+quint64 QCoapClientStatistics::throttledTime() const
+{
+    return d->throttledTime;
+}
+
+/*!
+    Returns the number of exchanges that were running when the snapshot
+    was taken.
+*/
+int QCoapClientStatistics::exchangesInFlight() const
+{
+    return d->exchangesInFlight;
+}
+
+/*!
+    Returns the endpoints for which round-trip times were measured, as
+    \c host:port strings.
+
+    \sa rttHistogram()
+*/
+QStringList QCoapClientStatistics::endpoints() const
+{
+    return d->endpoints;
+}
+
+/*!
+    Returns the histogram of the round-trip times measured for all the
+    endpoints. It has RttBucketCount buckets.
+*/
+QVector<quint64> QCoapClientStatistics::rttHistogram() const
+{
+    return d->rtt;
+}
+
+/*!
+    Returns the histogram of the round-trip times measured for
+    \a endpoint, or an empty vector if no time was measured for it.
+
+    \sa endpoints()
+*/
+QVector<quint64> QCoapClientStatistics::rttHistogram(const QString &endpoint) const
+{
+    const int index = d->endpoints.indexOf(endpoint);
+    return index < 0 ? QVector<quint64>() : d->endpointRtt.at(index);
+}
+
+/*!
+    Returns the histogram of the times the requests sent with \a priority
+    waited in the queue of the connection before being written to the
+    socket. It has the same RttBucketCount buckets as the round-trip time
+    histograms. Retransmissions are counted, acknowledgments and resets are
+    not.
+
+    \sa QCoapRequest::setPriority()
+*/
+QVector<quint64> QCoapClientStatistics::queueTimeHistogram(QCoapRequest::Priority priority) const
+{
+    if (priority < 0 || priority >= QCoapClientStatisticsPrivate::PriorityCount)
+        return QVector<quint64>();
+    return d->queueTime.at(priority);
+}
+
+/*!
+    Returns the exclusive upper bound of the round-trip times counted in
+    \a bucket, in microseconds, or -1 for the last bucket, which has no
+    bound.
+*/
+qint64 QCoapClientStatistics::rttBucketUpperBound(int bucket)
+{
+    if (bucket < 0 || bucket >= RttBucketCount - 1)
+        return -1;
+    return qint64(1) << (firstBucketBits + bucket);
+}
+
+/*!
+    \internal
+
+    \class QCoapStatisticsCounters
+    \brief The QCoapStatisticsCounters class holds the statistics counters
+    of a QCoapProtocol.
+
+    The counters are updated by the protocol in its thread, and a snapshot
+    of them can be taken from any thread.
+*/
+
+/*!
+    \internal
+
+    Constructs zeroed counters.
+*/
+QCoapStatisticsCounters::QCoapStatisticsCounters() :
+    requestsSent(0), retransmissions(0), timeouts(0), duplicates(0),
+    bytesSent(0), bytesReceived(0), throttledRequests(0), throttledTime(0),
+    exchangesInFlight(0),
+    endpoints(new Endpoint[MaximumEndpoints]), endpointCount(0)
+{
+    for (auto &bucket : rtt)
+        bucket.store(0, std::memory_order_relaxed);
+    for (auto &histogram : queueTime) {
+        for (auto &bucket : histogram)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < MaximumEndpoints; ++i) {
+        for (auto &bucket : endpoints[i].rtt)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*!
+    \internal
+
+    Counts a round-trip time of \a microseconds with the endpoint at
+    \a host and \a port. Only the first MaximumEndpoints endpoints have
+    their own histogram; all times are counted in the global one.
+*/
+void QCoapStatisticsCounters::addRttSample(const QString &host, int port, qint64 microseconds)
+{
+    const int bucket = rttBucket(microseconds);
+    add(&rtt[bucket], 1);
+
+    const auto key = qMakePair(host, port);
+    auto it = endpointIndex.constFind(key);
+    if (it == endpointIndex.cend()) {
+        const int count = endpointCount.load(std::memory_order_relaxed);
+        if (count == MaximumEndpoints)
+            return;
+
+        endpoints[count].name = host.contains(QLatin1Char(':'))
+                ? QLatin1Char('[') + host + QLatin1String("]:") + QString::number(port)
+                : host + QLatin1Char(':') + QString::number(port);
+        it = endpointIndex.insert(key, count);
+        endpointCount.store(count + 1, std::memory_order_release);
+    }
+
+    add(&endpoints[it.value()].rtt[bucket], 1);
+}
+
+/*!
+    \internal
+
+    Returns a snapshot of the counters. Counters updated while the
+    snapshot is taken may be seen before or after their update.
+*/
+QCoapClientStatistics QCoapStatisticsCounters::snapshot() const
+{
+    QCoapClientStatistics statistics;
+    QCoapClientStatisticsPrivate *d = statistics.d.data();
+
+    d->requestsSent = requestsSent.load(std::memory_order_relaxed);
+    d->retransmissions = retransmissions.load(std::memory_order_relaxed);
+    d->timeouts = timeouts.load(std::memory_order_relaxed);
+    d->duplicates = duplicates.load(std::memory_order_relaxed);
+    d->bytesSent = bytesSent.load(std::memory_order_relaxed);
+    d->bytesReceived = bytesReceived.load(std::memory_order_relaxed);
+    d->throttledRequests = throttledRequests.load(std::memory_order_relaxed);
+    d->throttledTime = throttledTime.load(std::memory_order_relaxed);
+    d->exchangesInFlight = exchangesInFlight.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < QCoapClientStatistics::RttBucketCount; ++i)
+        d->rtt[i] = rtt[i].load(std::memory_order_relaxed);
+    for (int i = 0; i < QCoapClientStatisticsPrivate::PriorityCount; ++i) {
+        for (int j = 0; j < QCoapClientStatistics::RttBucketCount; ++j)
+            d->queueTime[i][j] = queueTime[i][j].load(std::memory_order_relaxed);
+    }
+
+    const int count = endpointCount.load(std::memory_order_acquire);
+    d->endpoints.reserve(count);
+    d->endpointRtt.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QVector<quint64> histogram(QCoapClientStatistics::RttBucketCount);
+        for (int j = 0; j < QCoapClientStatistics::RttBucketCount; ++j)
+            histogram[j] = endpoints[i].rtt[j].load(std::memory_order_relaxed);
+        d->endpoints.append(endpoints[i].name);
+        d->endpointRtt.append(histogram);
+    }
+
+    return statistics;
+}
+
+/*!
+    \internal
+
+    Returns the histogram bucket of a round-trip time of \a microseconds.
+*/
+int QCoapStatisticsCounters::rttBucket(qint64 microseconds)
+{
+    if (microseconds < (qint64(1) << firstBucketBits))
+        return 0;
+
+    const int bits = 64 - qCountLeadingZeroBits(quint64(microseconds));
+    return qMin(bits - firstBucketBits, int(QCoapClientStatistics::RttBucketCount) - 1);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPCLIENTSTATISTICS_H
+#define QCOAPCLIENTSTATISTICS_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapClientStatisticsPrivate;
+
+class Q_COAP_EXPORT QCoapClientStatistics
+{
+public:
+    enum { RttBucketCount = 20 };
+
+    QCoapClientStatistics();
+    QCoapClientStatistics(const QCoapClientStatistics &other);
+    ~QCoapClientStatistics();
+    QCoapClientStatistics &operator =(const QCoapClientStatistics &other);
+
+    void swap(QCoapClientStatistics &other) Q_DECL_NOTHROW;
+
+    quint64 requestsSent() const;
+    quint64 retransmissions() const;
+    quint64 timeouts() const;
+    quint64 duplicates() const;
+    quint64 bytesSent() const;
+    quint64 bytesReceived() const;
+    quint64 throttledRequests() const;
+    quint64 throttledTime() const;
+    int exchangesInFlight() const;
+
+    QStringList endpoints() const;
+    QVector<quint64> rttHistogram() const;
+    QVector<quint64> rttHistogram(const QString &endpoint) const;
+    QVector<quint64> queueTimeHistogram(QCoapRequest::Priority priority) const;
+
+    static qint64 rttBucketUpperBound(int bucket);
+
+private:
+    friend class QCoapStatisticsCounters;
+    QSharedDataPointer<QCoapClientStatisticsPrivate> d;
+};
+
+Q_DECLARE_SHARED(QCoapClientStatistics)
+Q_DECLARE_METATYPE(QCoapClientStatistics)
+
+QT_END_NAMESPACE
+
+#endif // QCOAPCLIENTSTATISTICS_H
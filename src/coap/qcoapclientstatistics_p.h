@@ -0,0 +1,153 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPCLIENTSTATISTICS_P_H
+#define QCOAPCLIENTSTATISTICS_P_H
+
+#include <QtCoap/qcoapclientstatistics.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qshareddata.h>
+
+#include <atomic>
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapClientStatisticsPrivate : public QSharedData
+{
+public:
+    QCoapClientStatisticsPrivate() :
+        rtt(QCoapClientStatistics::RttBucketCount, 0),
+        queueTime(PriorityCount, QVector<quint64>(QCoapClientStatistics::RttBucketCount, 0))
+    {}
+
+    enum { PriorityCount = QCoapRequest::BulkPriority + 1 };
+
+    quint64 requestsSent = 0;
+    quint64 retransmissions = 0;
+    quint64 timeouts = 0;
+    quint64 duplicates = 0;
+    quint64 bytesSent = 0;
+    quint64 bytesReceived = 0;
+    quint64 throttledRequests = 0;
+    quint64 throttledTime = 0;
+    int exchangesInFlight = 0;
+
+    QVector<quint64> rtt;
+    QStringList endpoints;
+    QVector<QVector<quint64>> endpointRtt;  // in the order of endpoints
+    QVector<QVector<quint64>> queueTime;    // by request priority
+};
+
+// Counters updated by the protocol in the worker thread, and read from
+// any thread. They are only updated with relaxed atomic operations, so
+// that counting costs nothing more than an increment, and a snapshot
+// never waits for the worker thread.
+class Q_AUTOTEST_EXPORT QCoapStatisticsCounters
+{
+public:
+    enum { MaximumEndpoints = 64 };
+
+    QCoapStatisticsCounters();
+
+    void addRequestSent(quint64 bytes) { add(&requestsSent, 1); add(&bytesSent, bytes); }
+    void addRetransmission(quint64 bytes) { add(&retransmissions, 1); add(&bytesSent, bytes); }
+    void addControlSent(quint64 bytes) { add(&bytesSent, bytes); }
+    void addReceived(quint64 bytes) { add(&bytesReceived, bytes); }
+    void addTimeout() { add(&timeouts, 1); }
+    void addDuplicate() { add(&duplicates, 1); }
+    void addThrottled(qint64 microseconds)
+    {
+        add(&throttledRequests, 1);
+        add(&throttledTime, quint64(microseconds));
+    }
+    void setExchangesInFlight(int count)
+    {
+        exchangesInFlight.store(count, std::memory_order_relaxed);
+    }
+
+    void addRttSample(const QString &host, int port, qint64 microseconds);
+    void addQueueTime(QCoapRequest::Priority priority, qint64 microseconds)
+    {
+        add(&queueTime[priority][rttBucket(microseconds)], 1);
+    }
+
+    QCoapClientStatistics snapshot() const;
+
+    static int rttBucket(qint64 microseconds);
+
+private:
+    struct Endpoint
+    {
+        QString name;
+        std::atomic<quint64> rtt[QCoapClientStatistics::RttBucketCount];
+    };
+
+    // Only the worker thread writes, so that a load and a store are enough
+    static void add(std::atomic<quint64> *counter, quint64 value)
+    {
+        counter->store(counter->load(std::memory_order_relaxed) + value,
+                       std::memory_order_relaxed);
+    }
+
+    std::atomic<quint64> requestsSent;
+    std::atomic<quint64> retransmissions;
+    std::atomic<quint64> timeouts;
+    std::atomic<quint64> duplicates;
+    std::atomic<quint64> bytesSent;
+    std::atomic<quint64> bytesReceived;
+    std::atomic<quint64> throttledRequests;
+    std::atomic<quint64> throttledTime;
+    std::atomic<int> exchangesInFlight;
+    std::atomic<quint64> rtt[QCoapClientStatistics::RttBucketCount];
+    std::atomic<quint64> queueTime[QCoapClientStatisticsPrivate::PriorityCount]
+                                  [QCoapClientStatistics::RttBucketCount];
+
+    // Endpoints are never removed. The name of an endpoint is written
+    // before endpointCount is released, and never changes afterwards.
+    std::unique_ptr<Endpoint[]> endpoints;
+    std::atomic<int> endpointCount;
+    QHash<QPair<QString, int>, int> endpointIndex;  // worker thread only
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPCLIENTSTATISTICS_P_H
@@ -28,7 +28,9 @@
 ****************************************************************************/
 
 #include "qcoapconnection_p.h"
+#include "qcoapinternalmessage_p.h"
 #include <QtNetwork/qnetworkdatagram.h>
+#include <qtcoap_tracepoints_p.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -89,11 +91,12 @@ void QCoapConnection::createSocket()
 /*!
     \internal
 
-    Binds the socket to a random port and returns \c true if it succeeds.
+    Binds the socket to the bind address and port, a random port on any
+    address by default, and returns \c true if it succeeds.
 */
 bool QCoapConnectionPrivate::bind()
 {
-    return socket()->bind(QHostAddress::Any, 0, QAbstractSocket::ShareAddress);
+    return socket()->bind(bindAddress, bindPort, bindMode);
 }
 
 /*!
@@ -109,8 +112,9 @@ void QCoapConnectionPrivate::bindSocket()
         socket()->disconnectFromHost();
 
     q->connect(udpSocket, SIGNAL(error(QAbstractSocket::SocketError)),
-               q, SLOT(_q_socketError(QAbstractSocket::SocketError)));
-    q->connect(udpSocket, SIGNAL(readyRead()), q, SLOT(_q_socketReadyRead()));
+               q, SLOT(_q_socketError(QAbstractSocket::SocketError)), Qt::UniqueConnection);
+    q->connect(udpSocket, SIGNAL(readyRead()), q, SLOT(_q_socketReadyRead()),
+               Qt::UniqueConnection);
 
     if (bind())
         _q_socketBound();
@@ -119,13 +123,19 @@ void QCoapConnectionPrivate::bindSocket()
 /*!
     Binds the socket if it is not already done and sends the given
     \a request frame to the given \a host and \a port.
+
+    Frames waiting to be written are sent by order of \a priority.
+    Acknowledgments and resets are always sent first, whatever their
+    \a priority.
 */
-void QCoapConnection::sendRequest(const QByteArray &request, const QString &host, quint16 port)
+void QCoapConnection::sendRequest(const QByteArray &request, const QString &host, quint16 port,
+                                  QCoapRequest::Priority priority)
 {
     Q_D(QCoapConnection);
 
     CoapFrame frame(request, host, port);
-    d->framesToSend.enqueue(frame);
+    frame.queuedAt = d->queueClock.nsecsElapsed();
+    d->framesToSend[QCoapConnectionPrivate::frameQueue(request, priority)].enqueue(frame);
 
     if (d->state == Bound) {
         QMetaObject::invokeMethod(this, "_q_startToSendRequest", Qt::QueuedConnection);
@@ -144,12 +154,59 @@ void QCoapConnection::setSocketOption(QAbstractSocket::SocketOption option, cons
     d->socket()->setSocketOption(option, value);
 }
 
+/*!
+    Records every datagram sent and received by the connection in
+    \a device, which must be open for writing, until another device is
+    set. Setting a \c nullptr \a device stops the capture.
+
+    The capture is a compact binary log, where each datagram is stored with
+    its address and a monotonic timestamp. The device is used from the
+    thread of the connection.
+*/
+void QCoapConnection::setCaptureDevice(QIODevice *device)
+{
+    Q_D(QCoapConnection);
+    d->capture.reset(device ? new QCoapCaptureWriter(device) : nullptr);
+}
+
 /*!
     \internal
 
     Writes the given \a data frame to the socket to the stored \a host and \a port.
 */
 void QCoapConnectionPrivate::writeToSocket(const CoapFrame &frame)
+{
+    QHostAddress host(frame.host);
+    if (host.isNull()) {
+        qWarning() << "QtCoap: Invalid host IP address" << frame.host
+                   << "- only IPv4/IPv6 destination addresses are supported.";
+        return;
+    }
+
+    writeToSocket(frame.currentPdu, host, frame.port);
+}
+
+/*!
+    \internal
+
+    Writes the given \a frame to the socket, to the \a host address and
+    \a port, without going through the queue of frames to send.
+*/
+void QCoapConnectionPrivate::writeToSocket(const QByteArray &frame, const QHostAddress &host,
+                                           quint16 port)
+{
+    writeToSocket(frame.constData(), frame.size(), host, port);
+}
+
+/*!
+    \internal
+
+    Writes the \a size bytes of \a frame to the socket, to the \a host
+    address and \a port. The frame is not copied, unless the connection is
+    captured or traced.
+*/
+void QCoapConnectionPrivate::writeToSocket(const char *frame, int size, const QHostAddress &host,
+                                           quint16 port)
 {
     if (!socket()->isWritable()) {
         bool opened = socket()->open(socket()->openMode() | QIODevice::WriteOnly);
@@ -159,17 +216,15 @@ void QCoapConnectionPrivate::writeToSocket(const CoapFrame &frame)
         }
     }
 
-    QHostAddress host(frame.host);
-    if (host.isNull()) {
-        qWarning() << "QtCoap: Invalid host IP address" << frame.host
-                   << "- only IPv4/IPv6 destination addresses are supported.";
-        return;
-    }
-
-    qint64 bytesWritten = socket()->writeDatagram(frame.currentPdu,
-                                                  QHostAddress(frame.host), frame.port);
+    qint64 bytesWritten = socket()->writeDatagram(frame, size, host, port);
+    Q_TRACE(QCoapConnection_writeDatagram,
+            QCoapInternalMessagePrivate::frameToken(QByteArray::fromRawData(frame, size)),
+            QCoapInternalMessagePrivate::frameMessageId(QByteArray::fromRawData(frame, size)),
+            size);
     if (bytesWritten < 0)
         qWarning() << "QtCoap: Failed to write datagram:" << socket()->errorString();
+    else if (capture)
+        capture->write(QCoapCaptureRecord::Sent, QByteArray::fromRawData(frame, size), host, port);
 }
 
 /*!
@@ -192,12 +247,48 @@ void QCoapConnectionPrivate::_q_socketBound()
 /*!
     \internal
 
-    This slot writes the current stored frame to the socket.
+    Returns the queue of the given CoAP \a frame, sent with \a priority.
+*/
+QCoapConnectionPrivate::FrameQueue QCoapConnectionPrivate::frameQueue(
+        const QByteArray &frame, QCoapRequest::Priority priority)
+{
+    // The type is in bits 4 and 5 of the first byte of the header
+    const int type = frame.isEmpty() ? 0 : (quint8(frame.at(0)) >> 4) & 0x03;
+    if (type == QCoapMessage::Acknowledgment || type == QCoapMessage::Reset)
+        return ControlQueue;
+
+    switch (priority) {
+    case QCoapRequest::CriticalPriority:
+        return CriticalQueue;
+    case QCoapRequest::BulkPriority:
+        return BulkQueue;
+    case QCoapRequest::NormalPriority:
+        break;
+    }
+    return NormalQueue;
+}
+
+/*!
+    \internal
+
+    This slot writes the stored frame with the highest priority to the
+    socket, and counts the time it waited in its queue.
 */
 void QCoapConnectionPrivate::_q_startToSendRequest()
 {
-    const CoapFrame frame = framesToSend.dequeue();
-    writeToSocket(frame);
+    for (int queue = ControlQueue; queue < QueueCount; ++queue) {
+        if (framesToSend[queue].isEmpty())
+            continue;
+
+        const CoapFrame frame = framesToSend[queue].dequeue();
+        if (statistics && queue != ControlQueue) {
+            const auto priority = static_cast<QCoapRequest::Priority>(queue - CriticalQueue);
+            statistics->addQueueTime(priority,
+                                     (queueClock.nsecsElapsed() - frame.queuedAt) / 1000);
+        }
+        writeToSocket(frame);
+        return;
+    }
 }
 
 /*!
@@ -220,7 +311,16 @@ void QCoapConnectionPrivate::_q_socketReadyRead()
     }
 
     while (socket()->hasPendingDatagrams()) {
-        emit q->readyRead(socket()->receiveDatagram());
+        const QNetworkDatagram datagram = socket()->receiveDatagram();
+        if (capture) {
+            capture->write(QCoapCaptureRecord::Received, datagram.data(),
+                           datagram.senderAddress(), static_cast<quint16>(datagram.senderPort()));
+        }
+        Q_TRACE(QCoapConnection_receiveDatagram,
+                QCoapInternalMessagePrivate::frameToken(datagram.data()),
+                QCoapInternalMessagePrivate::frameMessageId(datagram.data()),
+                datagram.data().size());
+        emit q->readyRead(datagram);
     }
 }
 
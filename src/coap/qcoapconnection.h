@@ -32,6 +32,7 @@
 
 #include <QtCore/qglobal.h>
 #include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoaprequest.h>
 #include <QtCore/qstring.h>
 #include <QtNetwork/qudpsocket.h>
 
@@ -50,7 +51,8 @@ public:
 
     explicit QCoapConnection(QObject *parent = nullptr);
 
-    void sendRequest(const QByteArray &request, const QString &host, quint16 port);
+    void sendRequest(const QByteArray &request, const QString &host, quint16 port,
+                     QCoapRequest::Priority priority = QCoapRequest::NormalPriority);
 
     QUdpSocket *socket() const;
     ConnectionState state() const;
@@ -62,6 +64,7 @@ Q_SIGNALS:
 
 public Q_SLOTS:
     void setSocketOption(QAbstractSocket::SocketOption, const QVariant &value);
+    void setCaptureDevice(QIODevice *device);
 
 protected:
     explicit QCoapConnection(QCoapConnectionPrivate &dd, QObject *parent = nullptr);
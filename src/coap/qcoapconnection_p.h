@@ -33,6 +33,10 @@
 #include <QtCoap/qcoapconnection.h>
 #include <QtNetwork/qudpsocket.h>
 #include <QtCore/qqueue.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qscopedpointer.h>
+#include <private/qcoapcapture_p.h>
+#include <private/qcoapclientstatistics_p.h>
 #include <private/qobject_p.h>
 
 //
@@ -52,6 +56,7 @@ struct CoapFrame {
     QByteArray currentPdu;
     QString host;
     quint16 port = 0;
+    qint64 queuedAt = 0; // in nanoseconds of the queue clock
 
     CoapFrame(const QByteArray &pdu, const QString &hostName, quint16 portNumber)
     : currentPdu(pdu), host(hostName), port(portNumber) {}
@@ -60,15 +65,36 @@ struct CoapFrame {
 class Q_AUTOTEST_EXPORT QCoapConnectionPrivate : public QObjectPrivate
 {
 public:
-    QCoapConnectionPrivate() {}
+    QCoapConnectionPrivate() { queueClock.start(); }
+
+    // Acknowledgments and resets are queued before the requests of any
+    // priority, and each queue is emptied before the next one is used.
+    enum FrameQueue {
+        ControlQueue,
+        CriticalQueue,
+        NormalQueue,
+        BulkQueue,
+        QueueCount
+    };
 
     QCoapConnection::ConnectionState state = QCoapConnection::Unconnected;
-    QQueue<CoapFrame> framesToSend;
+    QQueue<CoapFrame> framesToSend[QueueCount];
+    QElapsedTimer queueClock;
+    QCoapStatisticsCounters *statistics = nullptr;
+
+    QHostAddress bindAddress = QHostAddress::Any;
+    quint16 bindPort = 0;
+    QAbstractSocket::BindMode bindMode = QAbstractSocket::ShareAddress;
+
+    QScopedPointer<QCoapCaptureWriter> capture;
 
     virtual bool bind();
 
     void bindSocket();
+    static FrameQueue frameQueue(const QByteArray &frame, QCoapRequest::Priority priority);
     void writeToSocket(const CoapFrame &frame);
+    void writeToSocket(const QByteArray &frame, const QHostAddress &host, quint16 port);
+    void writeToSocket(const char *frame, int size, const QHostAddress &host, quint16 port);
     QUdpSocket* socket() { return udpSocket; }
     void setSocket(QUdpSocket *socket);
     void setState(QCoapConnection::ConnectionState newState);
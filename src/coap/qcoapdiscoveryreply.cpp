@@ -30,10 +30,13 @@
 #include "qcoapdiscoveryreply_p.h"
 #include "qcoapinternalreply_p.h"
 
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 QCoapDiscoveryReplyPrivate::QCoapDiscoveryReplyPrivate(const QCoapRequest &request) :
-    QCoapReplyPrivate(request)
+    QCoapReplyPrivate(request),
+    filter(request.url().query(QUrl::FullyDecoded))
 {
 }
 
@@ -41,7 +44,9 @@ QCoapDiscoveryReplyPrivate::QCoapDiscoveryReplyPrivate(const QCoapRequest &reque
     \internal
 
     Updates the QCoapDiscoveryReply object, its message and list of resources
-    with data of the internal reply \a internalReply.
+    with the message \a msg received from \a sender, and its response
+    \a code. Only the part of the payload that was not already parsed block
+    by block is parsed.
 */
 void QCoapDiscoveryReplyPrivate::_q_setContent(const QHostAddress &sender, const QCoapMessage &msg,
                                                QtCoap::ResponseCode code)
@@ -54,13 +59,80 @@ void QCoapDiscoveryReplyPrivate::_q_setContent(const QHostAddress &sender, const
     message = msg;
     responseCode = code;
 
+    const int offset = parsedSize;
+    parsedSize = 0;
+
     if (QtCoap::isError(responseCode)) {
+        parser.finish();
         _q_setError(responseCode);
-    } else {
-        auto res = QCoapProtocol::resourcesFromCoreLinkList(sender, message.payload());
-        resources.append(res);
-        emit q->discovered(q, res);
+        return;
     }
+
+    const QByteArray payload = message.payload();
+    if (offset == 0)
+        parser = QCoapLinkFormatParser(sender);
+
+    QVector<QCoapResource> res = parser.feed(offset > 0 ? payload.mid(offset) : payload);
+    res.append(parser.finish());
+    addResources(res, true);
+}
+
+/*!
+    \internal
+
+    Parses the block of the discovery response received from \a sender,
+    with \a payload starting at \a offset, and reports the resources of
+    the links it completes. Blocks not received in order are left to
+    _q_setContent().
+*/
+void QCoapDiscoveryReplyPrivate::_q_setBlockReceived(const QHostAddress &sender,
+                                                     const QByteArray &payload, int offset)
+{
+    Q_Q(QCoapDiscoveryReply);
+
+    if (q->isFinished() || offset != parsedSize)
+        return;
+
+    if (offset == 0)
+        parser = QCoapLinkFormatParser(sender);
+
+    parsedSize += payload.size();
+    addResources(parser.feed(payload), false);
+}
+
+/*!
+    \internal
+
+    Appends the resources of \a newResources that were not reported yet,
+    by the same host and with the same path, and emits discovered() with
+    them. Unless \a emitEmpty is \c true, nothing is emitted if they were
+    all reported already. Resources not matching the filter of the request
+    are skipped, for servers that do not filter them.
+*/
+void QCoapDiscoveryReplyPrivate::addResources(QVector<QCoapResource> newResources,
+                                              bool emitEmpty)
+{
+    Q_Q(QCoapDiscoveryReply);
+
+    newResources.erase(std::remove_if(newResources.begin(), newResources.end(),
+                                      [this](const QCoapResource &resource) {
+        if (!filter.isEmpty()
+                && !QCoapLinkFormatParser::matchesQuery(resource.path(), resource, filter)) {
+            return true;
+        }
+
+        const auto key = qMakePair(resource.host(), resource.path());
+        if (knownResources.contains(key))
+            return true;
+        knownResources.insert(key);
+        return false;
+    }), newResources.end());
+
+    if (newResources.isEmpty() && !emitEmpty)
+        return;
+
+    resources.append(newResources);
+    emit q->discovered(q, newResources);
 }
 
 /*!
@@ -73,7 +145,18 @@ void QCoapDiscoveryReplyPrivate::_q_setContent(const QHostAddress &sender, const
     This class is used for discovery requests, and emits the discovered()
     signal if and when resources are discovered. When using a multicast
     address for discovery, the discovered() signal will be emitted once
-    for each response received.
+    for each server that answers, with the resources it reported, and the
+    reply is finished at the end of the
+    \l{QCoapProtocol::leisure()}{Leisure}.
+
+    When the response is transferred in several blocks, the discovered()
+    signal is emitted as the blocks arrive, with the resources whose link
+    was completed by each block. The first resources can then be used
+    before the whole list is received.
+
+    The resources discovered are also kept in a QCoapResourceSet, returned
+    by resourceSet(), to be queried by resource type, interface, content
+    format, host or observability without going through all of them.
 
     \sa QCoapClient, QCoapRequest, QCoapReply, QCoapResource
 */
@@ -88,8 +171,21 @@ QCoapDiscoveryReply::QCoapDiscoveryReply(const QCoapRequest &request, QObject *p
 
 /*!
     Returns the list of resources.
+
+    \sa resourceSet()
 */
 QVector<QCoapResource> QCoapDiscoveryReply::resources() const
+{
+    Q_D(const QCoapDiscoveryReply);
+    return d->resources.resources();
+}
+
+/*!
+    Returns the resources discovered, indexed by their attributes.
+
+    \sa resources()
+*/
+QCoapResourceSet QCoapDiscoveryReply::resourceSet() const
 {
     Q_D(const QCoapDiscoveryReply);
     return d->resources;
@@ -32,6 +32,7 @@
 
 #include <QtCoap/qcoapreply.h>
 #include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapresourceset.h>
 #include <QtCoap/qcoapprotocol.h>
 #include <QtCore/qlist.h>
 
@@ -46,6 +47,7 @@ public:
     explicit QCoapDiscoveryReply(const QCoapRequest &request, QObject *parent = nullptr);
 
     QVector<QCoapResource> resources() const;
+    QCoapResourceSet resourceSet() const;
 
 Q_SIGNALS:
     void discovered(QCoapDiscoveryReply *reply, QVector<QCoapResource> resources);
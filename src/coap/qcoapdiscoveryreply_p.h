@@ -31,8 +31,11 @@
 #define QCOAPDISCOVERYREPLY_P_H
 
 #include <QtCore/qlist.h>
+#include <QtCore/qset.h>
 #include <QtCoap/qcoapdiscoveryreply.h>
 #include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapresourceset.h>
+#include <private/qcoaplinkformatparser_p.h>
 #include <private/qcoapreply_p.h>
 
 //
@@ -54,8 +57,16 @@ public:
     QCoapDiscoveryReplyPrivate(const QCoapRequest &request);
 
     void _q_setContent(const QHostAddress &sender, const QCoapMessage &, QtCoap::ResponseCode) Q_DECL_OVERRIDE;
+    void _q_setBlockReceived(const QHostAddress &sender, const QByteArray &payload,
+                             int offset) Q_DECL_OVERRIDE;
 
-    QVector<QCoapResource> resources;
+    void addResources(QVector<QCoapResource> newResources, bool emitEmpty);
+
+    QCoapResourceSet resources;
+    QSet<QPair<QHostAddress, QString> > knownResources;
+    QString filter;         // query of the request, applied to the results
+    QCoapLinkFormatParser parser;
+    int parsedSize = 0;     // of the response being received
 
     Q_DECLARE_PUBLIC(QCoapDiscoveryReply)
 };
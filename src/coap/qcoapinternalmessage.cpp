@@ -28,10 +28,82 @@
 ****************************************************************************/
 
 #include "qcoapinternalmessage_p.h"
+#include "qcoapoption_p.h"
 #include <QtCoap/qcoaprequest.h>
+#include <algorithm>
 
 QT_BEGIN_NAMESPACE
 
+namespace {
+
+// Number of extended bytes following an option delta or length nibble,
+// indexed by the nibble value. 15 is reserved for the payload marker.
+const quint8 extendedBytesForNibble[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 0
+};
+
+// Offset subtracted from a delta or length before writing its extended
+// bytes, indexed by the nibble value.
+const quint16 extendedOffsetForNibble[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 269, 0
+};
+
+inline quint8 optionNibble(quint32 value)
+{
+    return value < 13 ? static_cast<quint8>(value) : (value < 269 ? 13 : 14);
+}
+
+inline char *writeExtendedBytes(char *out, quint8 nibble, quint32 value)
+{
+    const quint32 extended = value - extendedOffsetForNibble[nibble];
+    if (extendedBytesForNibble[nibble] == 2)
+        *out++ = static_cast<char>((extended >> 8) & 0xFF);
+    if (extendedBytesForNibble[nibble] >= 1)
+        *out++ = static_cast<char>(extended & 0xFF);
+    return out;
+}
+
+template <typename Iterator>
+int encodedOptionsSize(Iterator begin, Iterator end)
+{
+    int size = 0;
+    quint16 lastOptionNumber = 0;
+    for (Iterator it = begin; it != end; ++it) {
+        const quint16 optionNumber = static_cast<quint16>(it->name());
+        const int length = it->length();
+        size += 1 + length
+                + extendedBytesForNibble[optionNibble(optionNumber - lastOptionNumber)]
+                + extendedBytesForNibble[optionNibble(static_cast<quint32>(length))];
+        lastOptionNumber = optionNumber;
+    }
+    return size;
+}
+
+template <typename Iterator>
+char *writeOptions(char *out, Iterator begin, Iterator end)
+{
+    quint16 lastOptionNumber = 0;
+    for (Iterator it = begin; it != end; ++it) {
+        const quint16 optionNumber = static_cast<quint16>(it->name());
+        const quint32 delta = optionNumber - lastOptionNumber;
+        const quint32 length = static_cast<quint32>(it->length());
+        const quint8 deltaNibble = optionNibble(delta);
+        const quint8 lengthNibble = optionNibble(length);
+
+        *out++ = static_cast<char>((deltaNibble << 4) | lengthNibble);
+        out = writeExtendedBytes(out, deltaNibble, delta);
+        out = writeExtendedBytes(out, lengthNibble, length);
+
+        memcpy(out, it->constData(), static_cast<size_t>(length));
+        out += length;
+
+        lastOptionNumber = optionNumber;
+    }
+    return out;
+}
+
+} // namespace
+
 /*!
     \internal
 
@@ -44,65 +116,286 @@ QCoapInternalMessagePrivate::~QCoapInternalMessagePrivate()
 /*!
     \internal
 
-    \class QCoapInternalMessage
-    \brief The QCoapInternalMessage class contains data related to
-    a received message or a message to send. It contains an instance of
-    QCoapMessage and other data for the block management.
+    Returns the CoAP frame for \a message, using \a code as the method or
+    response code.
 
-    \reentrant
+    The exact size of the frame is computed first, so that the frame is
+    written in a single allocation. The options of \a message are already
+    sorted by number, so they are written as they are stored.
 
-    The QCoapInternalMessage class is inherited by QCoapInternalRequest and
-    QCoapInternalReply that are used internally to manage requests to send
-    and receive replies.
+    For more details, refer to section
+    \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
+*/
+//! 0                   1                   2                   3
+//! 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//! |Ver| T |  TKL  |      Code     |          Message ID           |
+//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//! |   Token (if any, TKL bytes) ...
+//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//! |   Options (if any) ...
+//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//! |1 1 1 1 1 1 1 1|    Payload (if any) ...
+//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+QByteArray QCoapInternalMessagePrivate::encodeFrame(const QCoapMessage &message, quint8 code)
+{
+    const QByteArray token = message.token();
+    const QByteArray payload = message.payload();
+    // QCoapMessage keeps its options sorted by number
+    const QCoapOptionList &options = message.options();
+    Q_ASSERT(std::is_sorted(options.cbegin(), options.cend(),
+                            [](const QCoapOption &a, const QCoapOption &b) {
+                                return a.name() < b.name();
+                            }));
+
+    const int frameSize = 4 + token.size()
+            + encodedOptionsSize(options.cbegin(), options.cend())
+            + (payload.isEmpty() ? 0 : 1 + payload.size());
+
+    QByteArray pdu(frameSize, Qt::Uninitialized);
+    char *out = pdu.data();
+
+    // Insert header
+    *out++ = static_cast<char>((message.version() << 6)         // CoAP version
+                             | (message.type()    << 4)         // Message type
+                             | (token.size() & 0x0F));          // Token Length
+    *out++ = static_cast<char>(code);                           // Method or response code
+    *out++ = static_cast<char>((message.messageId() >> 8) & 0xFF); // Message ID
+    *out++ = static_cast<char>(message.messageId() & 0xFF);
+
+    // Insert Token
+    memcpy(out, token.constData(), static_cast<size_t>(token.size()));
+    out += token.size();
+
+    // Insert Options
+    out = writeOptions(out, options.cbegin(), options.cend());
+
+    // Insert Payload
+    if (!payload.isEmpty()) {
+        *out++ = static_cast<char>(0xFF);
+        memcpy(out, payload.constData(), static_cast<size_t>(payload.size()));
+        out += payload.size();
+    }
+
+    Q_ASSERT(out == pdu.constData() + pdu.size());
+    return pdu;
+}
 
-    \sa QCoapInternalReply, QCoapInternalRequest, QCoapMessage
+/*!
+    \internal
+
+    Writes the header of an empty message of the given \a type, with
+    \a messageId and \a token, to \a buffer, which must hold at least
+    MaxEmptyFrameSize bytes. Returns the size of the frame.
+
+    Acknowledgments and resets sent by the client are empty messages, so
+    they are written without building a QCoapMessage.
 */
+int QCoapInternalMessagePrivate::encodeEmptyFrame(char *buffer, QCoapMessage::MessageType type,
+                                                  quint16 messageId, const QByteArray &token)
+{
+    Q_ASSERT(token.size() <= 8);
+    const int tokenLength = qMin(token.size(), 8);
+
+    buffer[0] = static_cast<char>((1 << 6) | (type << 4) | tokenLength);
+    buffer[1] = static_cast<char>(QtCoap::EmptyMessage);
+    buffer[2] = static_cast<char>((messageId >> 8) & 0xFF);
+    buffer[3] = static_cast<char>(messageId & 0xFF);
+    memcpy(buffer + 4, token.constData(), static_cast<size_t>(tokenLength));
+    return 4 + tokenLength;
+}
 
 /*!
     \internal
 
-    Constructs a new QCoapInternalMessage and sets \a parent as the parent
-    object.
- */
-QCoapInternalMessage::QCoapInternalMessage(QObject *parent) :
-    QObject(*new QCoapInternalMessagePrivate, parent)
+    Returns the message ID in the header of the CoAP \a frame, or -1 if the
+    frame is too short to hold a header. The rest of the frame is not
+    decoded.
+*/
+int QCoapInternalMessagePrivate::frameMessageId(const QByteArray &frame)
 {
+    if (frame.size() < 4)
+        return -1;
+
+    const quint8 *pduData = reinterpret_cast<const quint8 *>(frame.constData());
+    return (pduData[2] << 8) | pduData[3];
 }
 
 /*!
     \internal
 
-    Constructs a new QCoapInternalMessage with the given \a message and sets
-    \a parent as the parent object.
- */
-QCoapInternalMessage::QCoapInternalMessage(const QCoapMessage &message, QObject *parent) :
-    QCoapInternalMessage(parent)
+    Returns \c true if the header of the CoAP \a frame is the header of an
+    empty message of the given \a type, with the 0.00 code. The rest of the
+    frame is not decoded: an empty message holding more than a token is
+    malformed.
+*/
+bool QCoapInternalMessagePrivate::isEmptyFrame(const QByteArray &frame,
+                                               QCoapMessage::MessageType type)
 {
-    Q_D(QCoapInternalMessage);
-    d->message = message;
+    if (frame.size() < 4)
+        return false;
+
+    const quint8 *pduData = reinterpret_cast<const quint8 *>(frame.constData());
+    return (pduData[0] >> 6) == 1
+            && ((pduData[0] >> 4) & 0x03) == type
+            && pduData[1] == QtCoap::EmptyMessage;
 }
 
 /*!
     \internal
 
-    Constructs a copy of \a other and sets \a parent as the parent object.
+    Returns the token in the header of the CoAP \a frame, or an empty byte
+    array if the frame is too short to hold it.
 */
-QCoapInternalMessage::QCoapInternalMessage(const QCoapInternalMessage &other, QObject *parent) :
-    QObject(*new QCoapInternalMessagePrivate(*other.d_func()), parent)
+QByteArray QCoapInternalMessagePrivate::frameToken(const QByteArray &frame)
 {
+    if (frame.isEmpty())
+        return QByteArray();
+
+    const int tokenLength = frame.at(0) & 0x0F;
+    if (tokenLength > 8 || 4 + tokenLength > frame.size())
+        return QByteArray();
+
+    return frame.mid(4, tokenLength);
 }
 
 /*!
     \internal
-    Constructs a new QCoapInternalMessage with \a dd as the d_ptr.
-    This constructor must be used when subclassing internally
-    the QCoapInternalMessage class.
+
+    Decodes the CoAP \a frame into \a message, and stores its method or
+    response code in \a code. Returns \c false if the frame is malformed,
+    in which case \a message is left in an unspecified state.
+
+    Every length read from the frame is checked against its size. Registered
+    options with an invalid length, or repeated while they must not be, are
+    handled like unrecognized options: dropped if they are elective, and
+    \a hasUnrecognizedCriticalOption is set if they are critical. See
+    section 5.4 of RFC 7252.
+
+    For more details, refer to section
+    \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
 */
-QCoapInternalMessage::QCoapInternalMessage(QCoapInternalMessagePrivate &dd, QObject *parent):
-    QObject(dd, parent)
+bool QCoapInternalMessagePrivate::decodeFrame(const QByteArray &frame, QCoapMessage *message,
+                                              quint8 *code, bool *hasUnrecognizedCriticalOption)
 {
+    const quint8 *pduData = reinterpret_cast<const quint8 *>(frame.constData());
+    const int size = frame.size();
+
+    // Parse Header and Token
+    if (size < 4)
+        return false;
+
+    const quint8 tokenLength = pduData[0] & 0x0F;
+    if (tokenLength > 8 || 4 + tokenLength > size)
+        return false;
+
+    message->setVersion((pduData[0] >> 6) & 0x03);
+    message->setType(QCoapMessage::MessageType((pduData[0] >> 4) & 0x03));
+    *code = pduData[1];
+    message->setMessageId(static_cast<quint16>((static_cast<quint16>(pduData[2]) << 8)
+                                               | static_cast<quint16>(pduData[3])));
+    message->setToken(frame.mid(4, tokenLength));
+
+    // Parse Options
+    int i = 4 + tokenLength;
+    quint32 lastOptionNumber = 0;
+    bool hasPreviousOption = false;
+    *hasUnrecognizedCriticalOption = false;
+    while (i < size && pduData[i] != 0xFF) {
+        const quint8 deltaNibble = (pduData[i] >> 4) & 0x0F;
+        const quint8 lengthNibble = pduData[i] & 0x0F;
+        ++i;
+
+        // 15 is reserved for the payload marker
+        if (deltaNibble == 15 || lengthNibble == 15)
+            return false;
+        if (i + extendedBytesForNibble[deltaNibble] + extendedBytesForNibble[lengthNibble] > size)
+            return false;
+
+        // Values > 12 : extended on one or two bytes
+        quint32 optionDelta = deltaNibble;
+        if (extendedBytesForNibble[deltaNibble] == 1) {
+            optionDelta = pduData[i] + 13u;
+            i += 1;
+        } else if (extendedBytesForNibble[deltaNibble] == 2) {
+            optionDelta = ((pduData[i] << 8) | pduData[i + 1]) + 269u;
+            i += 2;
+        }
+
+        quint32 optionLength = lengthNibble;
+        if (extendedBytesForNibble[lengthNibble] == 1) {
+            optionLength = pduData[i] + 13u;
+            i += 1;
+        } else if (extendedBytesForNibble[lengthNibble] == 2) {
+            optionLength = ((pduData[i] << 8) | pduData[i + 1]) + 269u;
+            i += 2;
+        }
+
+        const quint32 optionNumber = lastOptionNumber + optionDelta;
+        if (optionNumber > 0xFFFF || optionLength > static_cast<quint32>(size - i))
+            return false;
+
+        const QCoapOptionInfo info = qCoapOptionInfo(static_cast<quint16>(optionNumber));
+        const bool repeated = optionDelta == 0 && hasPreviousOption;
+        const bool recognized = info.isRegistered()
+                && info.acceptsLength(static_cast<int>(optionLength))
+                && (info.repeatable || !repeated);
+
+        if (!recognized && QCoapOptionInfo::isCritical(static_cast<quint16>(optionNumber)))
+            *hasUnrecognizedCriticalOption = true;
+
+        // Unregistered elective options are kept for the application
+        if (recognized || !info.isRegistered()) {
+            QCoapOption option(QCoapOption::OptionName(optionNumber));
+            option.assignValue(frame.constData() + i, static_cast<int>(optionLength));
+            message->addOption(option);
+        }
+
+        hasPreviousOption = true;
+        lastOptionNumber = optionNumber;
+        i += static_cast<int>(optionLength);
+    }
+
+    // Parse Payload. A payload marker followed by a zero-length payload is
+    // a message format error.
+    if (i < size) {
+        if (i + 1 == size)
+            return false;
+        message->setPayload(frame.mid(i + 1));
+    } else {
+        message->setPayload(QByteArray());
+    }
+
+    return true;
 }
 
+/*!
+    \internal
+
+    \class QCoapInternalMessage
+    \brief The QCoapInternalMessage class contains data related to
+    a received message or a message to send. It contains an instance of
+    QCoapMessage and other data for the block management.
+
+    \reentrant
+
+    The QCoapInternalMessage class is inherited by QCoapInternalRequest and
+    QCoapInternalReply that are used internally to manage requests to send
+    and receive replies. They are plain value types, without heap
+    allocated private data: the protocol keeps the requests in a pool and
+    the replies in the data of their exchange.
+
+    \sa QCoapInternalReply, QCoapInternalRequest, QCoapMessage
+*/
+
+/*!
+    \internal
+    \fn QCoapInternalMessage::QCoapInternalMessage()
+
+    Constructs a new QCoapInternalMessage. The subclass holds the private
+    data by value, and sets the d_ptr to it once it is constructed.
+*/
+
 /*!
     \internal
     Set block information from a descriptive block option. See
@@ -118,8 +411,8 @@ void QCoapInternalMessage::setFromDescriptiveBlockOption(const QCoapOption &opti
     Q_D(QCoapInternalMessage);
 
     //! TODO Cover with tests
-    const quint8 *optionData = reinterpret_cast<const quint8 *>(option.value().data());
-    const quint8 lastByte = optionData[option.length() - 1];
+    const quint8 *optionData = reinterpret_cast<const quint8 *>(option.constData());
+    const quint8 lastByte = option.length() > 0 ? optionData[option.length() - 1] : 0;
     quint32 blockNumber = 0;
 
     for (int i = 0; i < option.length() - 1; ++i)
@@ -31,18 +31,13 @@
 #define QCOAPINTERNALMESSAGE_H
 
 #include <QtCoap/qcoapmessage.h>
-#include <QtCore/qobject.h>
 
 QT_BEGIN_NAMESPACE
 
 class QCoapInternalMessagePrivate;
-class Q_AUTOTEST_EXPORT QCoapInternalMessage : public QObject
+class Q_AUTOTEST_EXPORT QCoapInternalMessage
 {
-    Q_OBJECT
 public:
-    explicit QCoapInternalMessage(QObject *parent = nullptr);
-    explicit QCoapInternalMessage(const QCoapMessage &message, QObject *parent = nullptr);
-    QCoapInternalMessage(const QCoapInternalMessage &other, QObject *parent = nullptr);
     virtual ~QCoapInternalMessage() {}
 
     void addOption(QCoapOption::OptionName name, const QByteArray &value);
@@ -61,11 +56,17 @@ public:
     static bool isUrlValid(const QUrl &url);
 
 protected:
-    explicit QCoapInternalMessage(QCoapInternalMessagePrivate &dd, QObject *parent = nullptr);
+    QCoapInternalMessage() = default;
 
     void setFromDescriptiveBlockOption(const QCoapOption &option);
 
+    // Points to the private data held by value in the subclass
+    QCoapInternalMessagePrivate *d_ptr = nullptr;
+
     Q_DECLARE_PRIVATE(QCoapInternalMessage)
+
+private:
+    Q_DISABLE_COPY(QCoapInternalMessage)
 };
 
 QT_END_NAMESPACE
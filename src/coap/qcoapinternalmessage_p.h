@@ -32,7 +32,6 @@
 
 #include <QtCoap/qcoapinternalmessage.h>
 #include <private/qcoapmessage_p.h>
-#include <private/qobject_p.h>
 
 //
 //  W A R N I N G
@@ -47,13 +46,25 @@
 
 QT_BEGIN_NAMESPACE
 
-class Q_AUTOTEST_EXPORT QCoapInternalMessagePrivate : public QObjectPrivate
+class Q_AUTOTEST_EXPORT QCoapInternalMessagePrivate
 {
 public:
     QCoapInternalMessagePrivate() = default;
     QCoapInternalMessagePrivate(const QCoapInternalMessagePrivate &other) = default;
     ~QCoapInternalMessagePrivate();
 
+    // An empty message is a header, followed by a token of up to 8 bytes
+    enum { MaxEmptyFrameSize = 4 + 8 };
+
+    static QByteArray encodeFrame(const QCoapMessage &message, quint8 code);
+    static int encodeEmptyFrame(char *buffer, QCoapMessage::MessageType type, quint16 messageId,
+                                const QByteArray &token = QByteArray());
+    static bool decodeFrame(const QByteArray &frame, QCoapMessage *message, quint8 *code,
+                            bool *hasUnrecognizedCriticalOption);
+    static int frameMessageId(const QByteArray &frame);
+    static bool isEmptyFrame(const QByteArray &frame, QCoapMessage::MessageType type);
+    static QByteArray frameToken(const QByteArray &frame);
+
     QCoapMessage message;
 
     uint currentBlockNumber = 0;
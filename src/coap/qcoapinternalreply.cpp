@@ -48,25 +48,58 @@ QT_BEGIN_NAMESPACE
 
 /*!
     \internal
-    Constructs a new QCoapInternalReply with \a parent as the parent object.
+    Constructs a new QCoapInternalReply.
 */
-QCoapInternalReply::QCoapInternalReply(QObject *parent) :
-    QCoapInternalMessage(*new QCoapInternalReplyPrivate, parent)
+QCoapInternalReply::QCoapInternalReply()
 {
+    d_ptr = &d_storage;
 }
 
 /*!
     \internal
-    Constructs a copy of \a other with \a parent as the parent obect.
+    Constructs a copy of \a other.
 */
-QCoapInternalReply::QCoapInternalReply(const QCoapInternalReply &other, QObject *parent) :
-    QCoapInternalMessage(*new QCoapInternalReplyPrivate(*other.d_func()), parent)
+QCoapInternalReply::QCoapInternalReply(const QCoapInternalReply &other) :
+    d_storage(other.d_storage)
 {
+    d_ptr = &d_storage;
 }
 
 /*!
     \internal
-    Creates a QCoapInternalReply from the CoAP \a reply frame.
+    Assigns \a other to this reply and returns a reference to it.
+*/
+QCoapInternalReply &QCoapInternalReply::operator=(const QCoapInternalReply &other)
+{
+    d_storage = other.d_storage;
+    return *this;
+}
+
+/*!
+    \internal
+    Creates a QCoapInternalReply from the CoAP \a frame. Returns
+    \c nullptr if the frame is malformed.
+
+    The caller takes ownership of the reply. The protocol decodes the
+    frames it receives with the overload taking the reply to fill instead.
+*/
+QCoapInternalReply *QCoapInternalReply::createFromFrame(const QByteArray &frame)
+{
+    QCoapInternalReply *internalReply = new QCoapInternalReply;
+    if (!createFromFrame(frame, internalReply)) {
+        delete internalReply;
+        return nullptr;
+    }
+
+    return internalReply;
+}
+
+/*!
+    \internal
+    \overload
+
+    Decodes the CoAP \a frame into \a reply, which is expected to be a
+    newly constructed reply. Returns \c false if the frame is malformed.
 
     For more details, refer to section
     \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
@@ -82,66 +115,38 @@ QCoapInternalReply::QCoapInternalReply(const QCoapInternalReply &other, QObject
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 //! |1 1 1 1 1 1 1 1|    Payload (if any) ...
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-QCoapInternalReply *QCoapInternalReply::createFromFrame(const QByteArray &reply, QObject *parent)
+bool QCoapInternalReply::createFromFrame(const QByteArray &frame, QCoapInternalReply *reply)
 {
-    QCoapInternalReply *internalReply = new QCoapInternalReply(parent);
-    QCoapInternalReplyPrivate *d = internalReply->d_func();
-
-    const quint8 *pduData = reinterpret_cast<const quint8 *>(reply.data());
-
-    // Parse Header and Token
-    d->message.setVersion((pduData[0] >> 6) & 0x03);
-    d->message.setType(QCoapMessage::MessageType((pduData[0] >> 4) & 0x03));
-    quint8 tokenLength = (pduData[0]) & 0x0F;
-    d->responseCode = static_cast<QtCoap::ResponseCode>(pduData[1]);
-    d->message.setMessageId(static_cast<quint16>((static_cast<quint16>(pduData[2]) << 8)
-                                                 | static_cast<quint16>(pduData[3])));
-    d->message.setToken(reply.mid(4, tokenLength));
-
-    // Parse Options
-    int i = 4 + tokenLength;
-    quint16 lastOptionNumber = 0;
-    while (i != reply.length() && pduData[i] != 0xFF) {
-        quint16 optionDelta = ((pduData[i] >> 4) & 0x0F);
-        quint16 optionLength = (pduData[i] & 0x0F);
-        quint8 optionLengthExtended = 0;
-
-        // Delta value > 12 : special values
-        if (optionDelta == 13) {
-            ++i;
-            optionDelta = pduData[i] + 13;
-        } else if (optionDelta == 14) {
-            ++i;
-            optionDelta = pduData[i] + 269;
-        }
-
-        // Delta length > 12 : special values
-        if (optionLength == 13) {
-            ++i;
-            optionLengthExtended = pduData[i];
-            optionLength = optionLengthExtended + 13;
-        } else if (optionLength == 14) {
-            ++i;
-            optionLengthExtended = pduData[i];
-            optionLength = optionLengthExtended + 269;
-        }
-
-        quint16 optionNumber = lastOptionNumber + optionDelta;
-        internalReply->addOption(QCoapOption::OptionName(optionNumber),
-                                 QByteArray::fromRawData(reply.data() + i + 1,
-                                                         optionLength));
-        lastOptionNumber = optionNumber;
-        i += 1 + optionLength;
-    }
+    Q_ASSERT(reply);
+    QCoapInternalReplyPrivate *d = reply->d_func();
 
-    // Parse Payload
-    if (pduData[i] == 0xFF) {
-        // -1 because of 0xFF at the beginning
-        QByteArray currentPayload = reply.mid(i + 1);
-        d->message.setPayload(d->message.payload().append(currentPayload));
+    quint8 code = 0;
+    if (!QCoapInternalMessagePrivate::decodeFrame(frame, &d->message, &code,
+                                                  &d->hasUnrecognizedCriticalOption)) {
+        return false;
     }
+    d->responseCode = static_cast<QtCoap::ResponseCode>(code);
 
-    return internalReply;
+    const auto block2 = d->message.findOption(QCoapOption::Block2);
+    if (block2 != d->message.options().cend())
+        reply->setFromDescriptiveBlockOption(*block2);
+
+    return true;
+}
+
+/*!
+    \internal
+    Returns \c true if the frame carried a critical option that is not
+    recognized, in which case the reply must be rejected.
+
+    See section
+    \l{https://tools.ietf.org/html/rfc7252#section-5.4.1}{'Critical/Elective'}
+    of RFC 7252.
+*/
+bool QCoapInternalReply::hasUnrecognizedCriticalOption() const
+{
+    Q_D(const QCoapInternalReply);
+    return d->hasUnrecognizedCriticalOption;
 }
 
 /*!
@@ -191,8 +196,8 @@ int QCoapInternalReply::nextBlockToSend() const
     if (!option.isValid())
         return -1;
 
-    const quint8 *optionData = reinterpret_cast<const quint8 *>(option.value().data());
-    const quint8 lastByte = optionData[option.length() - 1];
+    const quint8 *optionData = reinterpret_cast<const quint8 *>(option.constData());
+    const quint8 lastByte = option.length() > 0 ? optionData[option.length() - 1] : 0;
 
     // M field
     bool hasNextBlock = ((lastByte & 0x8) == 0x8);
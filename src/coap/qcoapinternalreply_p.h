@@ -49,21 +49,32 @@
 
 QT_BEGIN_NAMESPACE
 
-class QCoapInternalReplyPrivate;
+class Q_AUTOTEST_EXPORT QCoapInternalReplyPrivate : public QCoapInternalMessagePrivate
+{
+public:
+    QCoapInternalReplyPrivate() = default;
+
+    QtCoap::ResponseCode responseCode = QtCoap::InvalidCode;
+    QHostAddress senderAddress;
+    bool hasUnrecognizedCriticalOption = false;
+};
+
 class Q_AUTOTEST_EXPORT QCoapInternalReply : public QCoapInternalMessage
 {
-    Q_OBJECT
 public:
-    explicit QCoapInternalReply(QObject *parent = nullptr);
-    QCoapInternalReply(const QCoapInternalReply &other, QObject *parent = nullptr);
+    QCoapInternalReply();
+    QCoapInternalReply(const QCoapInternalReply &other);
+    QCoapInternalReply &operator=(const QCoapInternalReply &other);
 
-    static QCoapInternalReply *createFromFrame(const QByteArray &frame, QObject *parent = nullptr);
+    static QCoapInternalReply *createFromFrame(const QByteArray &frame);
+    static bool createFromFrame(const QByteArray &frame, QCoapInternalReply *reply);
     void appendData(const QByteArray &data);
     bool hasMoreBlocksToSend() const;
     int nextBlockToSend() const;
+    bool hasUnrecognizedCriticalOption() const;
 
     using QCoapInternalMessage::addOption;
-    void addOption(const QCoapOption &option);
+    void addOption(const QCoapOption &option) Q_DECL_OVERRIDE;
     void setSenderAddress(const QHostAddress &address);
 
     QtCoap::ResponseCode responseCode() const;
@@ -71,15 +82,8 @@ public:
 
 private:
     Q_DECLARE_PRIVATE(QCoapInternalReply)
-};
-
-class Q_AUTOTEST_EXPORT QCoapInternalReplyPrivate : public QCoapInternalMessagePrivate
-{
-public:
-    QCoapInternalReplyPrivate() = default;
 
-    QtCoap::ResponseCode responseCode = QtCoap::InvalidCode;
-    QHostAddress senderAddress;
+    QCoapInternalReplyPrivate d_storage;
 };
 
 Q_DECLARE_METATYPE(QCoapInternalReply)
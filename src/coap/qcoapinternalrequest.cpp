@@ -30,6 +30,7 @@
 #include <QtCore/qmath.h>
 #include <QtCore/qrandom.h>
 #include <QtCore/qregularexpression.h>
+#include <QtNetwork/qhostaddress.h>
 #include "qcoapinternalrequest_p.h"
 #include "qcoaprequest.h"
 
@@ -49,36 +50,56 @@ QT_BEGIN_NAMESPACE
 
 /*!
     \internal
-    Constructs a new QCoapInternalRequest object and sets \a parent as
-    the parent object.
+    Constructs a new QCoapInternalRequest object.
 */
-QCoapInternalRequest::QCoapInternalRequest(QObject *parent) :
-    QCoapInternalMessage(*new QCoapInternalRequestPrivate, parent)
+QCoapInternalRequest::QCoapInternalRequest()
 {
-    Q_D(QCoapInternalRequest);
-    d->timeoutTimer = new QTimer(this);
-    connect(d->timeoutTimer, SIGNAL(timeout()), this, SLOT(_q_timeout()));
-
-    d->maxTransmitWaitTimer = new QTimer(this);
-    connect(d->maxTransmitWaitTimer, SIGNAL(timeout()), this, SLOT(_q_maxTransmissionSpanReached()));
+    d_ptr = &d_storage;
 }
 
 /*!
     \internal
     Constructs a new QCoapInternalRequest object with the information of
-    \a request and sets \a parent as the parent object.
+    \a request.
 */
-QCoapInternalRequest::QCoapInternalRequest(const QCoapRequest &request, QObject *parent) :
-    QCoapInternalRequest(parent)
+QCoapInternalRequest::QCoapInternalRequest(const QCoapRequest &request) :
+    QCoapInternalRequest()
 {
     Q_D(QCoapInternalRequest);
     d->message = request;
     d->method = request.method();
+    d->priority = request.priority();
     d->fullPayload = request.payload();
 
     addUriOptions(request.url(), request.proxyUrl());
 }
 
+/*!
+    \internal
+    Constructs a copy of \a other. The timers run for \a other are not
+    copied.
+*/
+QCoapInternalRequest::QCoapInternalRequest(const QCoapInternalRequest &other) :
+    d_storage(other.d_storage)
+{
+    d_ptr = &d_storage;
+    d_storage.timerIds[RetransmissionTimer] = 0;
+    d_storage.timerIds[ExchangeTimer] = 0;
+}
+
+/*!
+    \internal
+    Assigns \a other to this request and returns a reference to it. The
+    timers run for \a other are not copied.
+*/
+QCoapInternalRequest &QCoapInternalRequest::operator=(const QCoapInternalRequest &other)
+{
+    d_storage = other.d_storage;
+    d_storage.timerIds[RetransmissionTimer] = 0;
+    d_storage.timerIds[ExchangeTimer] = 0;
+    return *this;
+}
+
 /*!
     \internal
     Returns \c true if the request is considered valid.
@@ -131,101 +152,13 @@ void QCoapInternalRequest::initForReset(quint16 messageId)
     Returns the CoAP frame corresponding to the QCoapInternalRequest into
     a QByteArray object.
 
-    For more details, refer to section
-    \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
-*/
-//! 0                   1                   2                   3
-//! 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-//! |Ver| T |  TKL  |      Code     |          Message ID           |
-//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-//! |   Token (if any, TKL bytes) ...
-//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-//! |   Options (if any) ...
-//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-//! |1 1 1 1 1 1 1 1|    Payload (if any) ...
-//! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    \sa QCoapInternalMessagePrivate::encodeFrame()
+*/
 QByteArray QCoapInternalRequest::toQByteArray() const
 {
     Q_D(const QCoapInternalRequest);
-    QByteArray pdu;
-    auto appendToPdu = [&pdu](char data) { pdu.append(static_cast<char>(data)); };
-
-    // Insert header
-    appendToPdu((d->message.version()   << 6)           // CoAP version
-              | (d->message.type()      << 4)           // Message type
-              |  d->message.token().length());          // Token Length
-    appendToPdu( d->method                    & 0xFF);  // Method code
-    appendToPdu((d->message.messageId() >> 8) & 0xFF);  // Message ID
-    appendToPdu( d->message.messageId()       & 0xFF);
-
-    // Insert Token
-    pdu.append(d->message.token());
-
-    // Insert Options
-    if (!d->message.options().isEmpty()) {
-        // Sort options by ascending order
-        // TODO: sort at insertion time in QCoapMessage, and assert that options are sorted here
-        QVector<QCoapOption> options = d->message.options();
-        std::sort(options.begin(), options.end(),
-            [](const QCoapOption &a, const QCoapOption &b) -> bool {
-                return a.name() < b.name();
-        });
-
-        quint8 lastOptionNumber = 0;
-        for (const QCoapOption &option : qAsConst(options)) {
-
-            quint16 optionDelta = static_cast<quint16>(option.name()) - lastOptionNumber;
-            bool isOptionDeltaExtended = false;
-            quint8 optionDeltaExtended = 0;
-
-            // Delta value > 12 : special values
-            if (optionDelta > 268) {
-                optionDeltaExtended = static_cast<quint8>(optionDelta - 269);
-                optionDelta = 14;
-                isOptionDeltaExtended = true;
-            } else if (optionDelta > 12) {
-                optionDeltaExtended = static_cast<quint8>(optionDelta - 13);
-                optionDelta = 13;
-                isOptionDeltaExtended = true;
-            }
-
-            quint16 optionLength = static_cast<quint16>(option.length());
-            bool isOptionLengthExtended = false;
-            quint8 optionLengthExtended = 0;
-
-            // Length > 12 : special values
-            if (optionLength > 268) {
-                optionLengthExtended = static_cast<quint8>(optionLength - 269);
-                optionLength = 14;
-                isOptionLengthExtended = true;
-            } else if (optionLength > 12) {
-                optionLengthExtended = static_cast<quint8>(optionLength - 13);
-                optionLength = 13;
-                isOptionLengthExtended = true;
-            }
-
-            appendToPdu(static_cast<quint8>((static_cast<quint8>(optionDelta) << 4)
-                                          | (static_cast<quint8>(optionLength) & 0x0F)));
-
-            if (isOptionDeltaExtended)
-                appendToPdu(optionDeltaExtended);
-            if (isOptionLengthExtended)
-                appendToPdu(optionLengthExtended);
-
-            pdu.append(option.value());
-
-            lastOptionNumber = option.name();
-        }
-    }
-
-    // Insert Payload
-    if (!d->message.payload().isEmpty()) {
-        appendToPdu(0xFF);
-        pdu.append(d->message.payload());
-    }
-
-    return pdu;
+    return QCoapInternalMessagePrivate::encodeFrame(d->message,
+                                                    static_cast<quint8>(d->method & 0xFF));
 }
 
 /*!
@@ -381,7 +314,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
 {
     Q_D(QCoapInternalRequest);
     // Set to an invalid state
-    d->targetUri = QUrl();
+    d->setTargetUri(QUrl());
 
     // When using a proxy uri, we SHOULD NOT include Uri-Host/Port/Path/Query
     // options.
@@ -390,7 +323,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
             return false;
 
         addOption(QCoapOption(QCoapOption::ProxyUri, proxyUri.toString()));
-        d->targetUri = proxyUri;
+        d->setTargetUri(proxyUri);
         return true;
     }
 
@@ -429,7 +362,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
             addOption(QCoapOption(QCoapOption::UriQuery, queryElement.toString()));
     }
 
-    d->targetUri = uri;
+    d->setTargetUri(uri);
     return true;
 }
 
@@ -445,60 +378,113 @@ QCoapToken QCoapInternalRequest::token() const
 /*!
     \internal
     Used to mark the transmission as "in progress", when starting or retrying
-    to transmit a message. This method manages the retransmission counter,
-    the transmission timeout and the exchange timeout.
+    to transmit a message. This method manages the retransmission counter
+    and the transmission timeout, which the protocol then uses to run the
+    timers of the exchange.
+
+    The exchange enters the WaitingAcknowledgment state, whatever its
+    previous state, e.g. to transmit the next block of a transfer.
 */
 void QCoapInternalRequest::restartTransmission()
 {
     Q_D(QCoapInternalRequest);
 
-    if (!d->transmissionInProgress) {
-        d->transmissionInProgress = true;
-        d->maxTransmitWaitTimer->start();
+    if (d->exchangeState != WaitingAcknowledgment) {
+        d->exchangeState = WaitingAcknowledgment;
+        d->retransmissionCounter = 0;
+        d->transmissionTimer.start();
     } else {
         d->retransmissionCounter++;
         d->timeout *= 2;
     }
+}
+
+/*!
+    \internal
+    Returns the time elapsed since the first transmission of the message,
+    in microseconds, or -1 if no transmission is in progress.
+*/
+qint64 QCoapInternalRequest::transmissionElapsed() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->exchangeState == WaitingAcknowledgment
+            ? d->transmissionTimer.nsecsElapsed() / 1000 : -1;
+}
+
+/*!
+    \internal
+    Moves the exchange from the WaitingAcknowledgment state to the
+    WaitingSeparateResponse state, once an empty acknowledgment is received.
+    The message is not retransmitted anymore: the retransmission timer is
+    cleared, and the protocol runs the exchange timer until the separate
+    response is received.
+
+    Returns \c true if the state changed, or \c false in any other state.
+*/
+bool QCoapInternalRequest::waitForSeparateResponse()
+{
+    Q_D(QCoapInternalRequest);
+
+    if (d->exchangeState != WaitingAcknowledgment)
+        return false;
 
-    if (d->timeout > 0)
-        d->timeoutTimer->start(d->timeout);
+    d->exchangeState = WaitingSeparateResponse;
+    d->retransmissionCounter = 0;
+    d->timerIds[RetransmissionTimer] = 0;
+    return true;
 }
 
 /*!
     \internal
     Marks the transmission as not running, after a successful reception, or an
-    error. It resets the retranmission count and stops all timeout timers.
+    error. It resets the retranmission count and clears all timers.
+
+    The exchange enters the Done state.
 */
 void QCoapInternalRequest::stopTransmission()
 {
     Q_D(QCoapInternalRequest);
-    d->transmissionInProgress = false;
+    d->exchangeState = Done;
     d->retransmissionCounter = 0;
-    d->maxTransmitWaitTimer->stop();
-    d->timeoutTimer->stop();
+    d->timerIds[RetransmissionTimer] = 0;
+    d->timerIds[ExchangeTimer] = 0;
+}
+
+/*!
+    \internal
+    Returns the state of the exchange.
+*/
+QCoapInternalRequest::ExchangeState QCoapInternalRequest::exchangeState() const
+{
+    Q_D(const QCoapInternalRequest);
+    return static_cast<ExchangeState>(d->exchangeState);
 }
 
 /*!
     \internal
-    This slot emits a \l{QCoapInternalRequest::timeout(QCoapInternalRequest*)}
-    {timeout(QCoapInternalRequest*)} signal, which gets forwarded to
-    QCoapProtocolPrivate::onRequestTimeout().
+    Returns the identifier of the timer of the given \a type that the
+    protocol runs for this request, or 0 if the timer is not running.
+
+    \sa setTimerId()
 */
-void QCoapInternalRequestPrivate::_q_timeout()
+quint64 QCoapInternalRequest::timerId(TimerType type) const
 {
-    Q_Q(QCoapInternalRequest);
-    emit q->timeout(q);
+    Q_D(const QCoapInternalRequest);
+    return d->timerIds[type];
 }
 
 /*!
     \internal
-    This slot emits a \l{QCoapInternalRequest::maxTransmissionSpanReached(QCoapInternalRequest*)}
-    {timeout(QCoapInternalRequest*)} signal.
+    Sets the identifier of the timer of the given \a type to \a id. A
+    timer whose identifier no longer matches when it expires is ignored,
+    so that setting it to 0 stops the timer.
+
+    \sa timerId()
 */
-void QCoapInternalRequestPrivate::_q_maxTransmissionSpanReached()
+void QCoapInternalRequest::setTimerId(TimerType type, quint64 id)
 {
-    Q_Q(QCoapInternalRequest);
-    emit q->maxTransmissionSpanReached(q);
+    Q_D(QCoapInternalRequest);
+    d->timerIds[type] = id;
 }
 
 /*!
@@ -513,6 +499,19 @@ QUrl QCoapInternalRequest::targetUri() const
     return d->targetUri;
 }
 
+/*!
+    \internal
+    Returns the address of the host of the target uri, or a null address
+    if the host is not an IP address.
+
+    \sa targetUri()
+*/
+QHostAddress QCoapInternalRequest::targetAddress() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->targetAddress;
+}
+
 /*!
     \internal
     Returns the connection used to send this request.
@@ -537,6 +536,16 @@ QtCoap::Method QCoapInternalRequest::method() const
     return d->method;
 }
 
+/*!
+    \internal
+    Returns true if the target of the request is a multicast address.
+*/
+bool QCoapInternalRequest::isMulticast() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->targetAddress.isMulticast();
+}
+
 /*!
     \internal
     Returns true if the request is an Observe request.
@@ -570,6 +579,16 @@ int QCoapInternalRequest::retransmissionCounter() const
     return d->retransmissionCounter;
 }
 
+/*!
+    \internal
+    Returns the priority of the request.
+*/
+QCoapRequest::Priority QCoapInternalRequest::priority() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->priority;
+}
+
 /*!
     \internal
     Sets the method of the request to the given \a method.
@@ -615,7 +634,18 @@ void QCoapInternalRequest::setObserveCancelled()
 void QCoapInternalRequest::setTargetUri(QUrl targetUri)
 {
     Q_D(QCoapInternalRequest);
-    d->targetUri = targetUri;
+    d->setTargetUri(targetUri);
+}
+
+/*!
+    \internal
+    Sets the target uri to \a uri, and keeps the address of its host, so
+    that the replies can be checked without parsing the uri again.
+*/
+void QCoapInternalRequestPrivate::setTargetUri(const QUrl &uri)
+{
+    targetUri = uri;
+    targetAddress = QHostAddress(uri.host());
 }
 
 /*!
@@ -631,6 +661,30 @@ void QCoapInternalRequest::setTimeout(uint timeout)
     d->timeout = static_cast<int>(timeout);
 }
 
+/*!
+    \internal
+    Returns the current retransmission timeout in milliseconds.
+
+    \sa setTimeout()
+*/
+int QCoapInternalRequest::timeout() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->timeout;
+}
+
+/*!
+    \internal
+    Returns the maximum transmission span for the request, in milliseconds.
+
+    \sa setMaxTransmissionWait()
+*/
+int QCoapInternalRequest::maxTransmissionWait() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->maxTransmitWait;
+}
+
 /*!
     \internal
     Sets the maximum transmission span for the request. If the request is
@@ -639,7 +693,7 @@ void QCoapInternalRequest::setTimeout(uint timeout)
 void QCoapInternalRequest::setMaxTransmissionWait(int duration)
 {
     Q_D(QCoapInternalRequest);
-    d->maxTransmitWaitTimer->setInterval(duration);
+    d->maxTransmitWait = duration;
 }
 
 /*!
@@ -35,8 +35,10 @@
 #include <QtCoap/qcoapnamespace.h>
 #include <QtCoap/qcoapinternalmessage.h>
 #include <QtCoap/qcoapconnection.h>
-#include <QtCore/qtimer.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qurl.h>
+#include <QtNetwork/qhostaddress.h>
 #include <private/qcoapinternalmessage_p.h>
 
 //
@@ -52,14 +54,54 @@
 
 QT_BEGIN_NAMESPACE
 
-class QCoapRequest;
-class QCoapInternalRequestPrivate;
+class Q_AUTOTEST_EXPORT QCoapInternalRequestPrivate : public QCoapInternalMessagePrivate
+{
+public:
+    QCoapInternalRequestPrivate() = default;
+
+    QUrl targetUri;
+    QHostAddress targetAddress;
+    QtCoap::Method method = QtCoap::Invalid;
+    QCoapRequest::Priority priority = QCoapRequest::NormalPriority;
+    QCoapConnection *connection = nullptr;
+    QByteArray fullPayload;
+
+    int timeout = 0;
+    int maxTransmitWait = 0;
+    int retransmissionCounter = 0;
+    QElapsedTimer transmissionTimer;
+
+    // The state of the exchange, and the timers the protocol runs for it,
+    // by QCoapInternalRequest::ExchangeState and TimerType
+    int exchangeState = 0;
+    quint64 timerIds[2] = { 0, 0 };
+
+    bool observeCancelled = false;
+
+    void setTargetUri(const QUrl &uri);
+};
+
 class Q_AUTOTEST_EXPORT QCoapInternalRequest : public QCoapInternalMessage
 {
-    Q_OBJECT
 public:
-    explicit QCoapInternalRequest(QObject *parent = nullptr);
-    explicit QCoapInternalRequest(const QCoapRequest &request, QObject *parent = nullptr);
+    QCoapInternalRequest();
+    explicit QCoapInternalRequest(const QCoapRequest &request);
+    QCoapInternalRequest(const QCoapInternalRequest &other);
+    QCoapInternalRequest &operator=(const QCoapInternalRequest &other);
+
+    // The states of the exchange, each with its own deadline
+    enum ExchangeState {
+        Idle,
+        WaitingAcknowledgment,      // retransmission timeout and MAX_TRANSMIT_WAIT
+        WaitingSeparateResponse,    // separate response timeout
+        Done                        // none
+    };
+
+    // The timers run by the protocol for the exchange
+    enum TimerType {
+        RetransmissionTimer,
+        ExchangeTimer
+    };
 
     bool isValid() const Q_DECL_OVERRIDE;
 
@@ -79,11 +121,19 @@ public:
 
     QCoapToken token() const;
     QUrl targetUri() const;
+    QHostAddress targetAddress() const;
     QtCoap::Method method() const;
+    QCoapRequest::Priority priority() const;
     bool isObserve() const;
     bool isObserveCancelled() const;
+    bool isMulticast() const;
     QCoapConnection *connection() const;
     int retransmissionCounter() const;
+    ExchangeState exchangeState() const;
+    qint64 transmissionElapsed() const;
+    int timeout() const;
+    int maxTransmissionWait() const;
+    quint64 timerId(TimerType type) const;
     void setMethod(QtCoap::Method method);
     void setConnection(QCoapConnection *connection);
     void setObserveCancelled();
@@ -91,45 +141,19 @@ public:
     void setTargetUri(QUrl targetUri);
     void setTimeout(uint timeout);
     void setMaxTransmissionWait(int timeout);
+    void setTimerId(TimerType type, quint64 id);
     void restartTransmission();
+    bool waitForSeparateResponse();
     void stopTransmission();
 
-Q_SIGNALS:
-    void timeout(QCoapInternalRequest*);
-    void maxTransmissionSpanReached(QCoapInternalRequest*);
-
 protected:
     QCoapOption uriHostOption(const QUrl &uri) const;
     QCoapOption blockOption(QCoapOption::OptionName name, uint blockNumber, uint blockSize) const;
 
 private:
     Q_DECLARE_PRIVATE(QCoapInternalRequest)
-    Q_PRIVATE_SLOT(d_func(), void _q_timeout())
-    Q_PRIVATE_SLOT(d_func(), void _q_maxTransmissionSpanReached())
-};
-
-class Q_AUTOTEST_EXPORT QCoapInternalRequestPrivate : public QCoapInternalMessagePrivate
-{
-public:
-    QCoapInternalRequestPrivate() = default;
-
-    QUrl targetUri;
-    QtCoap::Method method = QtCoap::Invalid;
-    QCoapConnection *connection = nullptr;
-    QByteArray fullPayload;
-
-    int timeout = 0;
-    int retransmissionCounter = 0;
-    QTimer *timeoutTimer = nullptr;
-    QTimer *maxTransmitWaitTimer = nullptr;
-
-    bool observeCancelled = false;
-    bool transmissionInProgress = false;
-
-    void _q_timeout();
-    void _q_maxTransmissionSpanReached();
 
-    Q_DECLARE_PUBLIC(QCoapInternalRequest)
+    QCoapInternalRequestPrivate d_storage;
 };
 
 QT_END_NAMESPACE
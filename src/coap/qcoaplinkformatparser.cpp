@@ -0,0 +1,530 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaplinkformatparser_p.h"
+#include "qcoapattributepool_p.h"
+#include <QtCore/qalgorithms.h>
+#include <private/qsimd_p.h>
+
+#include <algorithm>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline const char *skipSpaces(const char *p, const char *end)
+{
+    while (p != end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+// Returns the first occurrence of \a a or \a b in [p, end), or end. Titles
+// and paths make most of a link-format document, so that they are scanned
+// 16 bytes at a time when possible.
+const char *findEither(const char *p, const char *end, char a, char b)
+{
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(a);
+    const __m128i second = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, first), _mm_cmpeq_epi8(chunk, second))));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+    }
+#endif
+    for (; p != end; ++p) {
+        if (*p == a || *p == b)
+            return p;
+    }
+    return end;
+}
+
+// Returns the end of the quoted-string starting after the opening quote at
+// \a p, which is its closing quote or end. Sets \a isEscaped if it contains
+// quoted-pairs.
+const char *findClosingQuote(const char *p, const char *end, bool *isEscaped)
+{
+    for (;;) {
+        p = findEither(p, end, '"', '\\');
+        if (p == end || *p == '"')
+            return p;
+
+        *isEscaped = true;
+        p += 2;
+        if (p >= end)
+            return end;
+    }
+}
+
+// Returns the position after the ',' ending the link at \a p, skipping
+// quoted-strings, or end if there is none. Sets \a isComplete if the
+// ',' is found.
+const char *skipLink(const char *p, const char *end, bool *isComplete)
+{
+    for (;;) {
+        p = findEither(p, end, ',', '"');
+        if (p == end)
+            return end;
+        if (*p == ',') {
+            *isComplete = true;
+            return p + 1;
+        }
+
+        bool isEscaped = false;
+        p = findClosingQuote(p + 1, end, &isEscaped);
+        if (p == end)
+            return end;
+        ++p;
+    }
+}
+
+QString toString(const char *value, int length, bool isEscaped)
+{
+    if (!isEscaped)
+        return QString::fromUtf8(value, length);
+
+    QByteArray unescaped;
+    unescaped.reserve(length);
+    for (const char *p = value, *end = value + length; p != end; ++p) {
+        if (*p == '\\' && p + 1 != end)
+            ++p;
+        unescaped.append(*p);
+    }
+    return QString::fromUtf8(unescaped);
+}
+
+// Returns the value of an 'rt' or 'if' attribute, taken from \a pool.
+QString toAttribute(QCoapAttributePool *pool, const char *value, int length, bool isEscaped)
+{
+    return isEscaped ? pool->intern(toString(value, length, true))
+                     : pool->intern(value, length);
+}
+
+// Parses the leading digits of \a value, as the first number of a
+// space-separated list like ct="0 41".
+uint toUInt(const char *value, int length)
+{
+    uint number = 0;
+    for (const char *p = value, *end = value + length; p != end && *p >= '0' && *p <= '9'; ++p)
+        number = number * 10 + static_cast<uint>(*p - '0');
+    return number;
+}
+
+void appendQuoted(QByteArray *links, const char *name, const QString &value)
+{
+    links->append(';').append(name).append("=\"");
+    for (const char c : value.toUtf8()) {
+        if (c == '"' || c == '\\')
+            links->append('\\');
+        links->append(c);
+    }
+    links->append('"');
+}
+
+// Returns true if \a attribute is \a value, or starts with it when it ends
+// with a '*'.
+bool matchesValue(const QStringRef &attribute, const QStringRef &value)
+{
+    if (value.endsWith(QLatin1Char('*')))
+        return attribute.startsWith(value.chopped(1));
+    return attribute == value;
+}
+
+bool matchesAnyValue(const QString &attribute, const QStringRef &value)
+{
+    const auto values = attribute.splitRef(QLatin1Char(' '), QString::SkipEmptyParts);
+    return std::any_of(values.cbegin(), values.cend(), [&value](const QStringRef &candidate) {
+        return matchesValue(candidate, value);
+    });
+}
+
+bool matchesFilter(const QString &target, const QCoapResource &resource,
+                   const QStringRef &name, const QStringRef &value)
+{
+    if (name == QLatin1String("href"))
+        return matchesValue(QStringRef(&target), value);
+    if (name == QLatin1String("rt"))
+        return matchesAnyValue(resource.resourceType(), value);
+    if (name == QLatin1String("if"))
+        return matchesAnyValue(resource.interface(), value);
+    if (name == QLatin1String("ct")) {
+        const QString contentFormat = QString::number(resource.contentFormat());
+        return matchesValue(QStringRef(&contentFormat), value);
+    }
+    if (name == QLatin1String("sz")) {
+        const QString maximumSize = QString::number(resource.maximumSize());
+        return resource.maximumSize() >= 0 && matchesValue(QStringRef(&maximumSize), value);
+    }
+    if (name == QLatin1String("title")) {
+        const QString title = resource.title();
+        return matchesValue(QStringRef(&title), value);
+    }
+    if (name == QLatin1String("obs"))
+        return resource.observable();
+
+    // Links cannot be filtered by the parameters that are not kept
+    return true;
+}
+
+template <int N>
+inline bool isName(const char *name, int length, const char (&literal)[N])
+{
+    return length == N - 1 && memcmp(name, literal, N - 1) == 0;
+}
+
+} // namespace
+
+/*!
+    \internal
+
+    \class QCoapLinkFormatParser
+    \brief The QCoapLinkFormatParser class decodes CoRE link-format
+    documents.
+
+    \reentrant
+
+    The document is parsed in a single pass, following the grammar of
+    \l{https://tools.ietf.org/html/rfc6690#section-2}{RFC 6690}: commas
+    and semicolons inside quoted-strings do not split links or
+    parameters, and quoted-pairs are unescaped. Strings are only created
+    for the attributes stored in QCoapResource.
+
+    A document received in several parts, like the blocks of a blockwise
+    transfer, is parsed with feed() as the parts arrive. Each call returns
+    the links completed by the part, and keeps the start of the last link
+    until the next part. finish() then returns the last link.
+
+    \sa QCoapProtocol::resourcesFromCoreLinkList()
+*/
+
+/*!
+    \internal
+
+    Constructs a parser for a document received from \a sender.
+*/
+QCoapLinkFormatParser::QCoapLinkFormatParser(const QHostAddress &sender) :
+    sender(sender)
+{
+}
+
+/*!
+    \internal
+
+    Parses \a data, the next part of the document, and returns the
+    resources of the links it completes. Only the incomplete link at the
+    end of \a data is copied, to be parsed again with the next part.
+*/
+QVector<QCoapResource> QCoapLinkFormatParser::feed(const QByteArray &data)
+{
+    QVector<QCoapResource> resources;
+    const char *rest = nullptr;
+
+    if (pending.isEmpty()) {
+        resources = parseLinks(data.constData(), data.constData() + data.size(), false, &rest);
+        pending = QByteArray(rest, static_cast<int>(data.constData() + data.size() - rest));
+    } else {
+        pending.append(data);
+        resources = parseLinks(pending.constData(), pending.constData() + pending.size(), false,
+                               &rest);
+        pending.remove(0, static_cast<int>(rest - pending.constData()));
+    }
+
+    return resources;
+}
+
+/*!
+    \internal
+
+    Returns the resource of the last link of the document, if any, and
+    resets the parser for a new document.
+*/
+QVector<QCoapResource> QCoapLinkFormatParser::finish()
+{
+    const char *rest = nullptr;
+    const QVector<QCoapResource> resources =
+            parseLinks(pending.constData(), pending.constData() + pending.size(), true, &rest);
+    pending.clear();
+    return resources;
+}
+
+/*!
+    \internal
+
+    Returns the resources of the link-format document \a data, received
+    from \a sender. Links without URI are skipped.
+*/
+QVector<QCoapResource> QCoapLinkFormatParser::parse(const QHostAddress &sender,
+                                                    const QByteArray &data)
+{
+    const char *rest = nullptr;
+    return QCoapLinkFormatParser(sender).parseLinks(data.constData(),
+                                                    data.constData() + data.size(), true, &rest);
+}
+
+/*!
+    \internal
+
+    Returns the resources of the link-format document \a data, received
+    from \a sender, like parse(). The values of the link-params listed in
+    \a parameterNames, which are not attributes of QCoapResource, like
+    \c ep or \c anchor, are stored in \a parameterValues: one list per
+    resource, with a null string for the parameters it does not have.
+*/
+QVector<QCoapResource> QCoapLinkFormatParser::parse(const QHostAddress &sender,
+                                                    const QByteArray &data,
+                                                    const QByteArrayList &parameterNames,
+                                                    QVector<QStringList> *parameterValues)
+{
+    const char *rest = nullptr;
+    parameterValues->clear();
+    return QCoapLinkFormatParser(sender).parseLinks(data.constData(),
+                                                    data.constData() + data.size(), true, &rest,
+                                                    &parameterNames, parameterValues);
+}
+
+/*!
+    \internal
+
+    Appends to \a links the link to \a target with the attributes of
+    \a resource, in the format read by parse().
+*/
+void QCoapLinkFormatParser::appendLink(QByteArray *links, const QByteArray &target,
+                                       const QCoapResource &resource)
+{
+    if (!links->isEmpty())
+        links->append(',');
+    links->append('<').append(target).append('>');
+
+    if (!resource.resourceType().isEmpty())
+        appendQuoted(links, "rt", resource.resourceType());
+    if (!resource.interface().isEmpty())
+        appendQuoted(links, "if", resource.interface());
+    if (resource.maximumSize() >= 0)
+        links->append(";sz=").append(QByteArray::number(resource.maximumSize()));
+    if (resource.contentFormat() != 0)
+        links->append(";ct=").append(QByteArray::number(resource.contentFormat()));
+    if (resource.observable())
+        links->append(";obs");
+    if (!resource.title().isEmpty())
+        appendQuoted(links, "title", resource.title());
+}
+
+/*!
+    \internal
+
+    Returns \c true if the link to \a target, with the attributes of
+    \a resource, matches \a query. The query is a filter like
+    \c rt=temperature, described in section
+    \l{https://tools.ietf.org/html/rfc6690#section-4.1}{'Query Filtering'}
+    of RFC 6690: a value ending with \c * matches the attributes starting
+    with it, and \c rt and \c if match any of their values. Several filters
+    separated by \c & must all match, and a filter on a parameter that is
+    not an attribute of QCoapResource matches all links.
+*/
+bool QCoapLinkFormatParser::matchesQuery(const QString &target, const QCoapResource &resource,
+                                         const QString &query)
+{
+    const auto filters = query.splitRef(QLatin1Char('&'), QString::SkipEmptyParts);
+    for (const QStringRef &filter : filters) {
+        const int separator = filter.indexOf(QLatin1Char('='));
+        const QStringRef name = separator < 0 ? filter : filter.left(separator);
+        const QStringRef value = separator < 0 ? QStringRef() : filter.mid(separator + 1);
+        if (!matchesFilter(target, resource, name, value))
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns the resources of the links between \a p and \a end, and sets
+    \a rest to the end of the last link parsed. Unless \a isLast is
+    \c true, a link that is not followed by a comma may continue after
+    \a end, so that it is not parsed. The values of \a parameterNames are
+    appended to \a parameterValues, if not null.
+*/
+QVector<QCoapResource> QCoapLinkFormatParser::parseLinks(const char *p, const char *end,
+                                                         bool isLast, const char **rest,
+                                                         const QByteArrayList *parameterNames,
+                                                         QVector<QStringList> *parameterValues)
+{
+    QVector<QCoapResource> resources;
+    QStringList values;
+
+    while (p != end) {
+        QCoapResource resource;
+        bool isComplete = false;
+        if (parameterNames) {
+            values.clear();
+            values.reserve(parameterNames->size());
+            for (int i = 0; i < parameterNames->size(); ++i)
+                values.append(QString());
+        }
+
+        const char *next = parseLink(p, end, &resource, &isComplete, parameterNames, &values);
+        if (!isComplete && !isLast)
+            break;
+
+        if (!resource.path().isEmpty()) {
+            resources.append(resource);
+            if (parameterValues)
+                parameterValues->append(values);
+        }
+        p = next;
+    }
+
+    *rest = p;
+    return resources;
+}
+
+/*!
+    \internal
+
+    Parses the link starting at \a p into \a resource, and returns the
+    position of the next link. Malformed links are skipped up to the next
+    link. \a isComplete is set to \c true if the link ends with a comma.
+    The values of \a parameterNames, if not null, are set in \a values.
+*/
+const char *QCoapLinkFormatParser::parseLink(const char *p, const char *end,
+                                             QCoapResource *resource, bool *isComplete,
+                                             const QByteArrayList *parameterNames,
+                                             QStringList *values)
+{
+    p = skipSpaces(p, end);
+    if (p == end || *p != '<')
+        return skipLink(p, end, isComplete);
+
+    const char *uriEnd = static_cast<const char *>(memchr(p + 1, '>',
+                                                          static_cast<size_t>(end - p - 1)));
+    if (!uriEnd)
+        return end;
+
+    resource->setHost(sender);
+    resource->setPath(QString::fromUtf8(p + 1, static_cast<int>(uriEnd - p - 1)));
+    p = uriEnd + 1;
+
+    for (;;) {
+        p = skipSpaces(p, end);
+        if (p == end)
+            return end;
+        if (*p == ',') {
+            *isComplete = true;
+            return p + 1;
+        }
+        if (*p != ';')
+            return skipLink(p, end, isComplete);
+
+        const char *name = p = skipSpaces(p + 1, end);
+        while (p != end && *p != '=' && *p != ';' && *p != ',' && !isSpace(*p))
+            ++p;
+        const int nameLength = static_cast<int>(p - name);
+
+        const char *value = nullptr;
+        int valueLength = 0;
+        bool isEscaped = false;
+        p = skipSpaces(p, end);
+        if (p != end && *p == '=') {
+            p = skipSpaces(p + 1, end);
+            if (p != end && *p == '"') {
+                value = p + 1;
+                p = findClosingQuote(value, end, &isEscaped);
+                valueLength = static_cast<int>(p - value);
+                if (p != end)
+                    ++p;
+            } else {
+                value = p;
+                p = findEither(p, end, ';', ',');
+                const char *valueEnd = p;
+                while (valueEnd != value && isSpace(valueEnd[-1]))
+                    --valueEnd;
+                valueLength = static_cast<int>(valueEnd - value);
+            }
+        }
+
+        setParameter(resource, name, nameLength, value, valueLength, isEscaped, parameterNames,
+                     values);
+    }
+}
+
+/*!
+    \internal
+
+    Sets the attribute of \a resource matching the link-param \a name to
+    \a value, which is null for parameters without value. Parameters listed
+    in \a parameterNames, if not null, are set in \a values instead, as
+    an empty string when they have no value.
+*/
+void QCoapLinkFormatParser::setParameter(QCoapResource *resource, const char *name,
+                                         int nameLength, const char *value, int valueLength,
+                                         bool isEscaped, const QByteArrayList *parameterNames,
+                                         QStringList *values)
+{
+    if (parameterNames) {
+        for (int i = 0; i < parameterNames->size(); ++i) {
+            const QByteArray &parameterName = parameterNames->at(i);
+            if (parameterName.size() == nameLength
+                    && memcmp(parameterName.constData(), name, static_cast<size_t>(nameLength)) == 0) {
+                (*values)[i] = value ? toString(value, valueLength, isEscaped)
+                                     : QString(QLatin1String(""));
+                return;
+            }
+        }
+    }
+
+    if (isName(name, nameLength, "obs")) {
+        resource->setObservable(true);
+        return;
+    }
+
+    if (!value)
+        return;
+
+    if (isName(name, nameLength, "title"))
+        resource->setTitle(toString(value, valueLength, isEscaped));
+    else if (isName(name, nameLength, "rt"))
+        resource->setResourceType(toAttribute(&attributes, value, valueLength, isEscaped));
+    else if (isName(name, nameLength, "if"))
+        resource->setInterface(toAttribute(&attributes, value, valueLength, isEscaped));
+    else if (isName(name, nameLength, "sz"))
+        resource->setMaximumSize(static_cast<int>(toUInt(value, valueLength)));
+    else if (isName(name, nameLength, "ct"))
+        resource->setContentFormat(toUInt(value, valueLength));
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPLINKFORMATPARSER_P_H
+#define QCOAPLINKFORMATPARSER_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCore/qbytearraylist.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
+#include <QtNetwork/qhostaddress.h>
+#include <private/qcoapattributepool_p.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapLinkFormatParser
+{
+public:
+    explicit QCoapLinkFormatParser(const QHostAddress &sender = QHostAddress());
+
+    QVector<QCoapResource> feed(const QByteArray &data);
+    QVector<QCoapResource> finish();
+
+    static QVector<QCoapResource> parse(const QHostAddress &sender, const QByteArray &data);
+    static QVector<QCoapResource> parse(const QHostAddress &sender, const QByteArray &data,
+                                        const QByteArrayList &parameterNames,
+                                        QVector<QStringList> *parameterValues);
+    static void appendLink(QByteArray *links, const QByteArray &target,
+                           const QCoapResource &resource);
+    static bool matchesQuery(const QString &target, const QCoapResource &resource,
+                             const QString &query);
+
+private:
+    QVector<QCoapResource> parseLinks(const char *p, const char *end, bool isLast,
+                                      const char **rest,
+                                      const QByteArrayList *parameterNames = nullptr,
+                                      QVector<QStringList> *parameterValues = nullptr);
+    const char *parseLink(const char *p, const char *end, QCoapResource *resource,
+                          bool *isComplete, const QByteArrayList *parameterNames,
+                          QStringList *values);
+    void setParameter(QCoapResource *resource, const char *name, int nameLength,
+                      const char *value, int valueLength, bool isEscaped,
+                      const QByteArrayList *parameterNames, QStringList *values);
+
+    QHostAddress sender;
+    QByteArray pending;   // start of the link not complete yet
+    QCoapAttributePool attributes;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPLINKFORMATPARSER_P_H
@@ -29,6 +29,8 @@
 
 #include "qcoapmessage_p.h"
 
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 QCoapMessagePrivate::QCoapMessagePrivate(QCoapMessage::MessageType _type) :
@@ -39,7 +41,8 @@ QCoapMessagePrivate::QCoapMessagePrivate(QCoapMessage::MessageType _type) :
 QCoapMessagePrivate::QCoapMessagePrivate(const QCoapMessagePrivate &other) :
     QSharedData(other),
     version(other.version), type(other.type), messageId(other.messageId),
-    token(other.token), options(other.options), payload(other.payload)
+    token(other.token), options(other.options), optionMask(other.optionMask),
+    payload(other.payload)
 {
 }
 
@@ -47,6 +50,46 @@ QCoapMessagePrivate::~QCoapMessagePrivate()
 {
 }
 
+/*!
+    \internal
+
+    Returns an iterator to the first option whose number is not less
+    than \a name.
+*/
+QCoapOptionList::const_iterator QCoapMessagePrivate::lowerBound(QCoapOption::OptionName name) const
+{
+    return std::lower_bound(options.cbegin(), options.cend(), name,
+                            [](const QCoapOption &option, QCoapOption::OptionName value) {
+        return option.name() < value;
+    });
+}
+
+/*!
+    \internal
+
+    Returns an iterator to the first option whose number is greater
+    than \a name.
+*/
+QCoapOptionList::const_iterator QCoapMessagePrivate::upperBound(QCoapOption::OptionName name) const
+{
+    return std::upper_bound(options.cbegin(), options.cend(), name,
+                            [](QCoapOption::OptionName value, const QCoapOption &option) {
+        return value < option.name();
+    });
+}
+
+/*!
+    \internal
+
+    Updates the presence bit of \a name after an option was removed.
+*/
+void QCoapMessagePrivate::updateOptionMask(QCoapOption::OptionName name)
+{
+    const auto it = lowerBound(name);
+    if (it == options.cend() || it->name() != name)
+        optionMask &= ~optionBit(name);
+}
+
 /*!
     \class QCoapMessage
     \brief The QCoapMessage class holds information about a CoAP message that
@@ -127,11 +170,16 @@ void QCoapMessage::addOption(QCoapOption::OptionName name, const QByteArray &val
 
 /*!
     Adds the given CoAP \a option.
+
+    Options are kept sorted by number. An option repeating an existing
+    one is inserted after it, so repeated options keep the order in
+    which they were added.
 */
 void QCoapMessage::addOption(const QCoapOption &option)
 {
     Q_D(QCoapMessage);
-    d->options.push_back(option);
+    d->options.insert(d->upperBound(option.name()), option);
+    d->optionMask |= QCoapMessagePrivate::optionBit(option.name());
 }
 
 /*!
@@ -140,7 +188,13 @@ void QCoapMessage::addOption(const QCoapOption &option)
 void QCoapMessage::removeOption(const QCoapOption &option)
 {
     Q_D(QCoapMessage);
-    d->options.removeOne(option);
+    const auto end = d->upperBound(option.name());
+    const auto it = std::find(d->lowerBound(option.name()), end, option);
+    if (it == end)
+        return;
+
+    d->options.erase(it);
+    d->updateOptionMask(option.name());
 }
 
 /*!
@@ -150,13 +204,8 @@ void QCoapMessage::removeOption(const QCoapOption &option)
 void QCoapMessage::removeOption(QCoapOption::OptionName name)
 {
     Q_D(QCoapMessage);
-    auto namesMatch = [name](const QCoapOption &option) {
-        return option.name() == name;
-    };
-
-    auto &options = d->options;
-    options.erase(std::remove_if(options.begin(), options.end(), namesMatch),
-                  options.end());
+    d->options.erase(d->lowerBound(name), d->upperBound(name));
+    d->optionMask &= ~QCoapMessagePrivate::optionBit(name);
 }
 
 /*!
@@ -166,6 +215,7 @@ void QCoapMessage::removeAllOptions()
 {
     Q_D(QCoapMessage);
     d->options.clear();
+    d->optionMask = 0;
 }
 
 /*!
@@ -258,12 +308,11 @@ QCoapOption QCoapMessage::option(QCoapOption::OptionName name) const
     with the given \a name.
     If there is no such option, returns \c d->options.end().
 */
-QVector<QCoapOption>::const_iterator QCoapMessage::findOption(QCoapOption::OptionName name) const
+QCoapOptionList::const_iterator QCoapMessage::findOption(QCoapOption::OptionName name) const
 {
     Q_D(const QCoapMessage);
-    return std::find_if(d->options.begin(), d->options.end(), [name](const QCoapOption &option) {
-        return option.name() == name;
-    });
+    const auto it = d->lowerBound(name);
+    return (it != d->options.cend() && it->name() == name) ? it : d->options.cend();
 }
 
 /*!
@@ -272,13 +321,16 @@ QVector<QCoapOption>::const_iterator QCoapMessage::findOption(QCoapOption::Optio
 bool QCoapMessage::hasOption(QCoapOption::OptionName name) const
 {
     Q_D(const QCoapMessage);
-    return findOption(name) != d->options.end();
+    if (name < 64)
+        return (d->optionMask & QCoapMessagePrivate::optionBit(name)) != 0;
+
+    return findOption(name) != d->options.cend();
 }
 
 /*!
-    Returns the list of options.
+    Returns the list of options, sorted by option number.
 */
-const QVector<QCoapOption> &QCoapMessage::options() const
+const QCoapOptionList &QCoapMessage::options() const
 {
     Q_D(const QCoapMessage);
     return d->options;
@@ -34,11 +34,13 @@
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapoption.h>
 #include <QtCore/qobject.h>
-#include <QtCore/qvector.h>
+#include <QtCore/qvarlengtharray.h>
 #include <QtCore/qshareddata.h>
 
 QT_BEGIN_NAMESPACE
 
+typedef QVarLengthArray<QCoapOption, 8> QCoapOptionList;
+
 class QCoapMessagePrivate;
 class Q_COAP_EXPORT QCoapMessage
 {
@@ -73,9 +75,9 @@ public:
     QCoapOption option(int index) const;
     //! TODO: Add the possibility to retrieve multiple QCoapOption with the same OptionName.
     QCoapOption option(QCoapOption::OptionName name) const;
-    QVector<QCoapOption>::const_iterator findOption(QCoapOption::OptionName name) const;
+    QCoapOptionList::const_iterator findOption(QCoapOption::OptionName name) const;
     bool hasOption(QCoapOption::OptionName name) const;
-    const QVector<QCoapOption> &options() const;
+    const QCoapOptionList &options() const;
     int optionCount() const;
     void addOption(QCoapOption::OptionName name, const QByteArray &value = QByteArray());
     virtual void addOption(const QCoapOption &option);
@@ -54,11 +54,21 @@ public:
     QCoapMessagePrivate(const QCoapMessagePrivate &other);
     ~QCoapMessagePrivate();
 
+    QCoapOptionList::const_iterator lowerBound(QCoapOption::OptionName name) const;
+    QCoapOptionList::const_iterator upperBound(QCoapOption::OptionName name) const;
+    void updateOptionMask(QCoapOption::OptionName name);
+
+    static quint64 optionBit(QCoapOption::OptionName name)
+    {
+        return name < 64 ? (Q_UINT64_C(1) << name) : 0;
+    }
+
     quint8 version = 1;
     QCoapMessage::MessageType type = QCoapMessage::NonConfirmable;
     quint16 messageId = 0;
     QByteArray token;
-    QVector<QCoapOption> options;
+    QCoapOptionList options;           // sorted by option number
+    quint64 optionMask = 0;            // presence of options numbered below 64
     QByteArray payload;
 };
 
@@ -100,6 +100,13 @@ public:
     };
     Q_ENUM(Method)
 
+    enum MulticastGroup {
+        AllCoapNodesIPv4,
+        AllCoapNodesIPv6LinkLocal,
+        AllCoapNodesIPv6SiteLocal
+    };
+    Q_ENUM(MulticastGroup)
+
     static const int DefaultPort = 5683;
 
     static bool isError(ResponseCode code)
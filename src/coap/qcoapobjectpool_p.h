@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPOBJECTPOOL_P_H
+#define QCOAPOBJECTPOOL_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qvector.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Storage for objects created and destroyed at a high rate, e.g. the
+    internal requests of a protocol. The slots are allocated by blocks of
+    BlockSize objects and reused once their object is destroyed, the
+    memory is only released with the pool. Objects keep their address
+    until they are destroyed.
+
+    The pool does not destroy the objects still alive when it is
+    destroyed: its owner must destroy them first.
+*/
+template <typename T, int BlockSize = 64>
+class QCoapObjectPool
+{
+    Q_DISABLE_COPY(QCoapObjectPool)
+public:
+    QCoapObjectPool() = default;
+    ~QCoapObjectPool()
+    {
+        Q_ASSERT(liveCount == 0);
+        for (Slot *block : qAsConst(blocks))
+            delete[] block;
+    }
+
+    template <typename... Args>
+    T *create(Args &&... args)
+    {
+        if (freeSlots.isEmpty())
+            allocateBlock();
+
+        void *slot = freeSlots.takeLast();
+        T *object = new (slot) T(std::forward<Args>(args)...);
+        ++liveCount;
+        return object;
+    }
+
+    void destroy(T *object)
+    {
+        if (!object)
+            return;
+
+        object->~T();
+        freeSlots.append(object);
+        --liveCount;
+    }
+
+    int size() const { return liveCount; }
+    int capacity() const { return blocks.size() * BlockSize; }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    void allocateBlock()
+    {
+        Slot *block = new Slot[BlockSize];
+        blocks.append(block);
+        freeSlots.reserve(capacity());
+
+        // Slots are taken from the end: the first ones of the block first
+        for (int i = BlockSize - 1; i >= 0; --i)
+            freeSlots.append(block + i);
+    }
+
+    QVector<Slot *> blocks;
+    QVector<void *> freeSlots;
+    int liveCount = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPOBJECTPOOL_P_H
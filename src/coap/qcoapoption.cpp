@@ -80,10 +80,8 @@ QT_BEGIN_NAMESPACE
     \sa isValid()
  */
 QCoapOption::QCoapOption(OptionName name, const QByteArray &value) :
-    d_ptr(new QCoapOptionPrivate)
+    m_name(static_cast<quint16>(name))
 {
-    Q_D(QCoapOption);
-    d->name = name;
     setValue(value);
 }
 
@@ -94,10 +92,8 @@ QCoapOption::QCoapOption(OptionName name, const QByteArray &value) :
     \sa isValid()
  */
 QCoapOption::QCoapOption(OptionName name, QStringView value) :
-    d_ptr(new QCoapOptionPrivate)
+    m_name(static_cast<quint16>(name))
 {
-    Q_D(QCoapOption);
-    d->name = name;
     setValue(value);
 }
 
@@ -108,10 +104,8 @@ QCoapOption::QCoapOption(OptionName name, QStringView value) :
     \sa isValid()
  */
 QCoapOption::QCoapOption(OptionName name, const char *value) :
-    d_ptr(new QCoapOptionPrivate)
+    m_name(static_cast<quint16>(name))
 {
-    Q_D(QCoapOption);
-    d->name = name;
     setValue(value);
 }
 
@@ -122,10 +116,8 @@ QCoapOption::QCoapOption(OptionName name, const char *value) :
     \sa isValid()
  */
 QCoapOption::QCoapOption(OptionName name, quint32 value) :
-    d_ptr(new QCoapOptionPrivate)
+    m_name(static_cast<quint16>(name))
 {
-    Q_D(QCoapOption);
-    d->name = name;
     setValue(value);
 }
 
@@ -135,17 +127,20 @@ QCoapOption::QCoapOption(OptionName name, quint32 value) :
     \sa isValid()
  */
 QCoapOption::QCoapOption(const QCoapOption &other) :
-    d_ptr(new QCoapOptionPrivate(*other.d_ptr))
+    m_name(other.m_name), m_inlineLength(other.m_inlineLength),
+    m_heapValue(other.m_heapValue)
 {
+    memcpy(m_inlineValue, other.m_inlineValue, m_inlineLength);
 }
 
 /*!
     QCoapOption move constructor.
  */
 QCoapOption::QCoapOption(QCoapOption &&other) :
-    d_ptr(other.d_ptr)
+    m_name(other.m_name), m_inlineLength(other.m_inlineLength),
+    m_heapValue(std::move(other.m_heapValue))
 {
-    other.d_ptr = nullptr;
+    memcpy(m_inlineValue, other.m_inlineValue, m_inlineLength);
 }
 
 /*!
@@ -153,7 +148,6 @@ QCoapOption::QCoapOption(QCoapOption &&other) :
  */
 QCoapOption::~QCoapOption()
 {
-    delete d_ptr;
 }
 
 /*!
@@ -161,15 +155,20 @@ QCoapOption::~QCoapOption()
  */
 QCoapOption &QCoapOption::operator=(const QCoapOption &other)
 {
-    d_ptr->name = other.d_ptr->name;
-    d_ptr->value = other.d_ptr->value;
+    if (this == &other)
+        return *this;
+
+    m_name = other.m_name;
+    m_inlineLength = other.m_inlineLength;
+    memcpy(m_inlineValue, other.m_inlineValue, m_inlineLength);
+    m_heapValue = other.m_heapValue;
     return *this;
 }
 
 /*!
     Move assignment operator.
  */
-QCoapOption &QCoapOption::operator=(QCoapOption &&other)
+QCoapOption &QCoapOption::operator=(QCoapOption &&other) Q_DECL_NOTHROW
 {
     swap(other);
     return *this;
@@ -178,30 +177,58 @@ QCoapOption &QCoapOption::operator=(QCoapOption &&other)
 /*!
     Swap object with another.
  */
-void QCoapOption::swap(QCoapOption &other)
+void QCoapOption::swap(QCoapOption &other) Q_DECL_NOTHROW
 {
-    qSwap(d_ptr, other.d_ptr);
+    char inlineValue[InlineCapacity];
+    memcpy(inlineValue, m_inlineValue, m_inlineLength);
+    memcpy(m_inlineValue, other.m_inlineValue, other.m_inlineLength);
+    memcpy(other.m_inlineValue, inlineValue, m_inlineLength);
+
+    qSwap(m_name, other.m_name);
+    qSwap(m_inlineLength, other.m_inlineLength);
+    m_heapValue.swap(other.m_heapValue);
 }
 
 /*!
     Returns the value of the option.
+
+    \sa constData(), length()
  */
 QByteArray QCoapOption::value() const
 {
-    Q_D(const QCoapOption);
-    return d->value;
+    if (!m_heapValue.isEmpty())
+        return m_heapValue;
+
+    return QByteArray(m_inlineValue, m_inlineLength);
+}
+
+/*!
+    Returns a pointer to the value of the option, which is length()
+    bytes long. Unlike value(), this never allocates. The pointer
+    remains valid as long as the option is not modified or destroyed.
+
+    \sa value(), length()
+ */
+const char *QCoapOption::constData() const
+{
+    return m_heapValue.isEmpty() ? m_inlineValue : m_heapValue.constData();
 }
 
 /*!
     Returns the integer value of the option.
+
+    The value is read as an unsigned integer in network byte order, as
+    described in section
+    \l{https://tools.ietf.org/html/rfc7252#section-3.2}{'Option Value Formats'}
+    of RFC 7252.
  */
 quint32 QCoapOption::valueToInt() const
 {
-    Q_D(const QCoapOption);
+    const quint8 *data = reinterpret_cast<const quint8 *>(constData());
 
     quint32 intValue = 0;
-    for (int i = 0; i < d->value.length(); i++)
-        intValue |= static_cast<quint8>(d->value.at(i)) << (8 * i);
+    for (int i = 0; i < length(); i++)
+        intValue = (intValue << 8) | data[i];
 
     return intValue;
 }
@@ -211,8 +238,7 @@ quint32 QCoapOption::valueToInt() const
  */
 int QCoapOption::length() const
 {
-    Q_D(const QCoapOption);
-    return d->value.length();
+    return m_heapValue.isEmpty() ? m_inlineLength : m_heapValue.length();
 }
 
 /*!
@@ -220,8 +246,7 @@ int QCoapOption::length() const
  */
 QCoapOption::OptionName QCoapOption::name() const
 {
-    Q_D(const QCoapOption);
-    return d->name;
+    return static_cast<OptionName>(m_name);
 }
 
 /*!
@@ -229,8 +254,7 @@ QCoapOption::OptionName QCoapOption::name() const
  */
 bool QCoapOption::isValid() const
 {
-    Q_D(const QCoapOption);
-    return d->name != QCoapOption::Invalid;
+    return m_name != QCoapOption::Invalid;
 }
 
 /*!
@@ -238,9 +262,9 @@ bool QCoapOption::isValid() const
  */
 bool QCoapOption::operator==(const QCoapOption &other) const
 {
-    Q_D(const QCoapOption);
-    return (d->name == other.d_ptr->name
-            && d->value == other.d_ptr->value);
+    return (m_name == other.m_name
+            && length() == other.length()
+            && memcmp(constData(), other.constData(), static_cast<size_t>(length())) == 0);
 }
 
 /*!
@@ -256,63 +280,47 @@ bool QCoapOption::operator!=(const QCoapOption &other) const
  */
 void QCoapOption::setValue(const QByteArray &value)
 {
-    Q_D(QCoapOption);
-    bool oversized = false;
-
-    // Check for value maximum size, according to section 5.10 of RFC 7252
-    // https://tools.ietf.org/html/rfc7252#section-5.10
-    switch (d_ptr->name) {
-    case IfNoneMatch:
-        if (value.size() > 0)
-            oversized = true;
-        break;
-
-    case UriPort:
-    case ContentFormat:
-    case Accept:
-        if (value.size() > 2)
-            oversized = true;
-        break;
-
-    case MaxAge:
-    case Size1:
-        if (value.size() > 4)
-            oversized = true;
-        break;
-
-    case IfMatch:
-    case Etag:
-        if (value.size() > 8)
-            oversized = true;
-        break;
-
-    case UriHost:
-    case LocationPath:
-    case UriPath:
-    case UriQuery:
-    case LocationQuery:
-    case ProxyScheme:
-        if (value.size() > 255)
-            oversized = true;
-        break;
-
-    case ProxyUri:
-        if (value.size() > 1034)
-            oversized = true;
-        break;
-
-    case Observe:
-    case Block2:
-    case Block1:
-    case Size2:
-    default:
-        break;
+    if (value.size() > InlineCapacity) {
+        checkValueLength(value.size());
+        m_inlineLength = 0;
+        m_heapValue = value;
+    } else {
+        assignValue(value.constData(), value.size());
     }
+}
 
-    if (oversized)
-        qWarning() << "QCoapOption::setValue: value is probably too big for option" << d->name;
+/*!
+    \internal
 
-    d->value = value;
+    Warns if a value of \a size bytes is longer than the option allows.
+    The limits come from the option registry, which follows section 5.10
+    of \l{https://tools.ietf.org/html/rfc7252#section-5.10}{RFC 7252}.
+*/
+void QCoapOption::checkValueLength(int size) const
+{
+    if (size > qCoapOptionInfo(m_name).maxLength)
+        qWarning() << "QCoapOption::setValue: value is probably too big for option" << name();
+}
+
+/*!
+    \internal
+
+    Sets the value of the option to the \a size bytes pointed to by
+    \a data, which are always copied.
+*/
+void QCoapOption::assignValue(const char *data, int size)
+{
+    checkValueLength(size);
+
+    if (size <= InlineCapacity) {
+        m_heapValue.clear();
+        m_inlineLength = static_cast<quint8>(size);
+        if (size > 0)
+            memcpy(m_inlineValue, data, static_cast<size_t>(size));
+    } else {
+        m_inlineLength = 0;
+        m_heapValue = QByteArray(data, size);
+    }
 }
 
 /*!
@@ -332,7 +340,7 @@ void QCoapOption::setValue(QStringView value)
  */
 void QCoapOption::setValue(const char *value)
 {
-    setValue(QByteArray::fromRawData(value, static_cast<int>(strlen(value))));
+    assignValue(value, value ? static_cast<int>(strlen(value)) : 0);
 }
 
 /*!
@@ -342,11 +350,15 @@ void QCoapOption::setValue(const char *value)
  */
 void QCoapOption::setValue(quint32 value)
 {
-    QByteArray data;
-    for (; value; value >>= 8)
-        data.append(static_cast<qint8>(value & 0xFF));
+    // Network byte order, without leading zero bytes
+    char data[sizeof(value)];
+    int size = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        if (size > 0 || (value >> shift) != 0)
+            data[size++] = static_cast<char>((value >> shift) & 0xFF);
+    }
 
-    setValue(data);
+    assignValue(data, size);
 }
 
 QT_END_NAMESPACE
@@ -33,10 +33,10 @@
 #include <QtCore/qglobal.h>
 #include <QtCoap/qcoapglobal.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qbytearray.h>
 
 QT_BEGIN_NAMESPACE
 
-class QCoapOptionPrivate;
 class Q_COAP_EXPORT QCoapOption
 {
 public:
@@ -76,6 +76,7 @@ public:
     void swap(QCoapOption &other) Q_DECL_NOTHROW;
 
     QByteArray value() const;
+    const char *constData() const;
     quint32 valueToInt() const;
     int length() const;
     OptionName name() const;
@@ -91,19 +92,22 @@ protected:
     void setValue(quint32 value);
 
 private:
-    QCoapOptionPrivate *d_ptr;
-
-    // Q_DECLARE_PRIVATE equivalent for shared data pointers
-    QCoapOptionPrivate *d_func()
-    {
-        return d_ptr;
-    }
-    const QCoapOptionPrivate *d_func() const
-    {
-        return d_ptr;
-    }
+    friend class QCoapInternalMessagePrivate;
+
+    void checkValueLength(int size) const;
+    void assignValue(const char *data, int size);
+
+    // Values up to InlineCapacity bytes are stored in the option itself,
+    // longer values are shared with the QByteArray they were set from.
+    enum { InlineCapacity = 20 };
+
+    quint16 m_name = Invalid;
+    quint8 m_inlineLength = 0;
+    char m_inlineValue[InlineCapacity];
+    QByteArray m_heapValue;
 };
 
+Q_DECLARE_TYPEINFO(QCoapOption, Q_MOVABLE_TYPE);
 Q_DECLARE_METATYPE(QCoapOption::OptionName)
 Q_DECLARE_METATYPE(QCoapOption)
 
@@ -31,7 +31,8 @@
 #define QCOAPOPTION_P_H
 
 #include <QtCoap/qcoapoption.h>
-#include <private/qobject_p.h>
+
+#include <utility>
 
 //
 //  W A R N I N G
@@ -46,15 +47,105 @@
 
 QT_BEGIN_NAMESPACE
 
-class Q_AUTOTEST_EXPORT QCoapOptionPrivate
+// Registered options: name, number, value format, minimum and maximum
+// length and whether the option may be repeated. See section 5.10 of
+// RFC 7252, section 2 of RFC 7641 and section 2.1 of RFC 7959.
+#define FOR_EACH_COAP_OPTION(X) \
+    X(IfMatch,        1, Opaque, 0,    8, true)  X(UriHost,        3, String, 1,  255, false) \
+    X(Etag,           4, Opaque, 1,    8, true)  X(IfNoneMatch,    5, Empty,  0,    0, false) \
+    X(Observe,        6, UInt,   0,    3, false) X(UriPort,        7, UInt,   0,    2, false) \
+    X(LocationPath,   8, String, 0,  255, true)  X(UriPath,       11, String, 0,  255, true)  \
+    X(ContentFormat, 12, UInt,   0,    2, false) X(MaxAge,        14, UInt,   0,    4, false) \
+    X(UriQuery,      15, String, 0,  255, true)  X(Accept,        17, UInt,   0,    2, false) \
+    X(LocationQuery, 20, String, 0,  255, true)  X(Block2,        23, UInt,   0,    3, false) \
+    X(Block1,        27, UInt,   0,    3, false) X(Size2,         28, UInt,   0,    4, false) \
+    X(ProxyUri,      35, String, 1, 1034, false) X(ProxyScheme,   39, String, 1,  255, false) \
+    X(Size1,         60, UInt,   0,    4, false)
+
+struct QCoapOptionInfo
+{
+    enum Format : quint8 {
+        Unknown,
+        Empty,
+        Opaque,
+        UInt,
+        String
+    };
+
+    Format format;
+    bool repeatable;
+    quint16 minLength;
+    quint16 maxLength;
+
+    constexpr bool isRegistered() const { return format != Unknown; }
+    constexpr bool acceptsLength(int length) const
+    {
+        return length >= minLength && length <= maxLength;
+    }
+
+    // Encoded in the option number itself, see section 5.4.6 of RFC 7252.
+    static constexpr bool isCritical(quint16 number) { return number & 0x01; }
+
+    static constexpr QCoapOptionInfo unknown() { return { Unknown, true, 0, 0xFFFF }; }
+};
+
+class QCoapOptionRegistry
 {
 public:
-    QCoapOptionPrivate() = default;
+    enum { Size = 61 };
+
+    constexpr QCoapOptionRegistry() :
+        QCoapOptionRegistry(std::make_index_sequence<Size>())
+    {
+    }
 
-    QCoapOption::OptionName name = QCoapOption::Invalid;
-    QByteArray value;
+    constexpr QCoapOptionInfo info(quint16 number) const
+    {
+        return number < Size ? entries[number] : QCoapOptionInfo::unknown();
+    }
+
+private:
+    template <std::size_t... Numbers>
+    constexpr QCoapOptionRegistry(std::index_sequence<Numbers...>) :
+        entries { entry(Numbers)... }
+    {
+    }
+
+    static constexpr QCoapOptionInfo entry(std::size_t number)
+    {
+#define COAP_OPTION_ENTRY(name, optionNumber, valueFormat, minimum, maximum, canRepeat) \
+        number == optionNumber \
+            ? QCoapOptionInfo { QCoapOptionInfo::valueFormat, canRepeat, minimum, maximum } :
+        return FOR_EACH_COAP_OPTION(COAP_OPTION_ENTRY) QCoapOptionInfo::unknown();
+#undef COAP_OPTION_ENTRY
+    }
+
+    QCoapOptionInfo entries[Size];
 };
 
+constexpr QCoapOptionRegistry qCoapOptionRegistry;
+
+/*!
+    \internal
+
+    Returns the properties of the option with the given \a number.
+    Unregistered options have the Unknown format and accept any value.
+*/
+constexpr QCoapOptionInfo qCoapOptionInfo(quint16 number)
+{
+    return qCoapOptionRegistry.info(number);
+}
+
+#define COAP_OPTION_CHECK(name, number, valueFormat, minimum, maximum, canRepeat) \
+    Q_STATIC_ASSERT(QCoapOption::name == number); \
+    Q_STATIC_ASSERT(number < QCoapOptionRegistry::Size);
+FOR_EACH_COAP_OPTION(COAP_OPTION_CHECK)
+#undef COAP_OPTION_CHECK
+
+Q_STATIC_ASSERT(qCoapOptionInfo(QCoapOption::UriPath).repeatable);
+Q_STATIC_ASSERT(!qCoapOptionInfo(QCoapOption::Invalid).isRegistered());
+Q_STATIC_ASSERT(QCoapOptionInfo::isCritical(QCoapOption::UriPath));
+
 QT_END_NAMESPACE
 
 #endif // QCOAPOPTION_P_H
@@ -29,13 +29,32 @@
 
 #include <QtCore/qrandom.h>
 #include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qvarlengtharray.h>
 #include <QtNetwork/qnetworkdatagram.h>
 #include "qcoapprotocol_p.h"
+#include "qcoapdiscoveryreply.h"
 #include "qcoapinternalrequest_p.h"
 #include "qcoapinternalreply_p.h"
+#include "qcoapconnection_p.h"
+#include "qcoaplinkformatparser_p.h"
+#include <qtcoap_tracepoints_p.h>
+
+#include <algorithm>
+#include <limits>
 
 QT_BEGIN_NAMESPACE
 
+namespace {
+
+// Orders the request timers in a heap, the earliest deadline first
+bool expiresLater(const CoapRequestTimer &a, const CoapRequestTimer &b)
+{
+    return a.deadline > b.deadline;
+}
+
+} // namespace
+
 /*!
     \class QCoapProtocol
     \brief The QCoapProtocol class handles the logical part of the CoAP
@@ -57,7 +76,6 @@ QT_BEGIN_NAMESPACE
 QCoapProtocol::QCoapProtocol(QObject *parent) :
     QObject(*new QCoapProtocolPrivate, parent)
 {
-    qRegisterMetaType<QCoapInternalRequest *>();
     qRegisterMetaType<QHostAddress>();
 }
 
@@ -65,8 +83,15 @@ QCoapProtocol::~QCoapProtocol()
 {
     Q_D(QCoapProtocol);
 
-    // Clear table to avoid double deletion from QObject parenting and QSharedPointer.
+    // Futures still waiting will not get any result
+    for (auto it = d->exchangeMap.begin(); it != d->exchangeMap.end(); ++it) {
+        QCoapProtocolPrivate::finishFuture(*it, true);
+        QCoapProtocolPrivate::invokeCallback(*it, nullptr);
+        d->requestPool.destroy(it->request);
+    }
+
     d->exchangeMap.clear();
+    d->statistics.setExchangesInFlight(0);
 }
 
 /*!
@@ -82,39 +107,75 @@ void QCoapProtocol::sendRequest(QPointer<QCoapReply> reply, QCoapConnection *con
     if (reply.isNull() || !reply->request().isValid())
         return;
 
-    auto internalRequest = QSharedPointer<QCoapInternalRequest>::create(reply->request(), this);
-    internalRequest->setMaxTransmissionWait(maxTransmitWait());
     connect(reply, &QCoapReply::finished, this, &QCoapProtocol::finished);
 
+    CoapExchangeData exchange;
+    exchange.userReply = reply;
+    exchange.discovery = qobject_cast<QCoapDiscoveryReply *>(reply.data()) != nullptr;
+    d->startExchange(reply->request(), exchange, connection);
+}
+
+/*!
+    \internal
+
+    Creates and sets up a new QCoapInternalRequest for \a request, registers
+    its exchange and sends it using the given \a connection.
+
+    The result of the exchange is delivered to the user reply, the future
+    and the callback set in \a exchange. A future is finished with the last
+    reply to the request, with all the replies of a multicast request, or is
+    canceled if the exchange fails. A callback is invoked once, with the
+    first response received, or without response if the exchange fails.
+*/
+void QCoapProtocolPrivate::startExchange(const QCoapRequest &request, CoapExchangeData exchange,
+                                         QCoapConnection *connection)
+{
+    Q_Q(QCoapProtocol);
+    Q_ASSERT(QThread::currentThread() == q->thread());
+
+    if (!request.isValid() || !isAwaited(exchange)) {
+        finishFuture(exchange, true);
+        invokeCallback(exchange, nullptr);
+        return;
+    }
+
+    QCoapInternalRequest *internalRequest = requestPool.create(request);
+    internalRequest->setMaxTransmissionWait(q->maxTransmitWait());
+
     // Set a unique Message Id and Token
     QCoapMessage *requestMessage = internalRequest->message();
-    internalRequest->setMessageId(d->generateUniqueMessageId());
-    internalRequest->setToken(d->generateUniqueToken());
+    internalRequest->setMessageId(generateUniqueMessageId());
+    internalRequest->setToken(generateUniqueToken());
     internalRequest->setConnection(connection);
 
-    d->registerExchange(requestMessage->token(), reply, internalRequest);
-    QMetaObject::invokeMethod(reply, "_q_setRunning", Qt::QueuedConnection,
-                              Q_ARG(QCoapToken, requestMessage->token()),
-                              Q_ARG(QCoapMessageId, requestMessage->messageId()));
+    exchange.request = internalRequest;
+    registerExchange(requestMessage->token(), exchange);
+    if (QCoapReply *reply = exchange.userReply.data()) {
+        QMetaObject::invokeMethod(reply, "_q_setRunning", Qt::QueuedConnection,
+                                  Q_ARG(QCoapToken, requestMessage->token()),
+                                  Q_ARG(QCoapMessageId, requestMessage->messageId()));
+    }
 
     // Set block size for blockwise request/replies, if specified
-    if (d->blockSize > 0) {
-        internalRequest->setToRequestBlock(0, d->blockSize);
-        if (requestMessage->payload().length() > d->blockSize)
-            internalRequest->setToSendBlock(0, d->blockSize);
+    if (blockSize > 0) {
+        internalRequest->setToRequestBlock(0, blockSize);
+        if (requestMessage->payload().length() > blockSize)
+            internalRequest->setToSendBlock(0, blockSize);
     }
 
-    if (requestMessage->type() == QCoapMessage::Confirmable)
-        internalRequest->setTimeout(QtCoap::randomGenerator.bounded(minTimeout(), maxTimeout()));
-    else
-        internalRequest->setTimeout(maxTimeout());
-
-    connect(internalRequest.data(), SIGNAL(timeout(QCoapInternalRequest *)),
-            this, SLOT(onRequestTimeout(QCoapInternalRequest *)));
-    connect(internalRequest.data(), SIGNAL(maxTransmissionSpanReached(QCoapInternalRequest *)),
-            this, SLOT(onRequestMaxTransmissionSpanReached(QCoapInternalRequest *)));
+    // Multicast requests are non-confirmable, and their responses are
+    // collected until the end of the Leisure. See section 8.2 of RFC 7252.
+    if (internalRequest->isMulticast()) {
+        requestMessage->setType(QCoapMessage::NonConfirmable);
+        internalRequest->setTimeout(static_cast<uint>(leisure));
+    } else if (requestMessage->type() == QCoapMessage::Confirmable) {
+        internalRequest->setTimeout(QtCoap::randomGenerator.bounded(q->minTimeout(),
+                                                                    q->maxTimeout()));
+    } else {
+        internalRequest->setTimeout(q->maxTimeout());
+    }
 
-    d->sendRequest(internalRequest.data());
+    sendRequest(internalRequest);
 }
 
 /*!
@@ -132,17 +193,376 @@ void QCoapProtocolPrivate::sendRequest(QCoapInternalRequest *request)
         return;
     }
 
-    request->restartTransmission();
     QByteArray requestFrame = encode(request);
-    QUrl uri = request->targetUri();
-    request->connection()->sendRequest(requestFrame, uri.host(), static_cast<quint16>(uri.port()));
+
+    // Keep the frame, so that retransmissions send the exact same bytes
+    auto it = exchangeMap.find(request->token());
+    if (it != exchangeMap.end() && it->request == request)
+        it->frame = requestFrame;
+
+    transmit(request, requestFrame);
+}
+
+/*!
+    \internal
+
+    Sends the given \a request again, reusing the frame encoded by the last
+    call to sendRequest() for this exchange.
+*/
+void QCoapProtocolPrivate::resendRequest(QCoapInternalRequest *request)
+{
+    Q_Q(const QCoapProtocol);
+    Q_ASSERT(QThread::currentThread() == q->thread());
+
+    auto it = exchangeMap.constFind(request->token());
+    if (it == exchangeMap.constEnd() || it->request != request || it->frame.isEmpty()) {
+        sendRequest(request);
+        return;
+    }
+
+    if (!request->connection()) {
+        qWarning("QtCoap: Request not bound to any connection: aborted.");
+        return;
+    }
+
+    const QByteArray requestFrame = it->frame;
+    transmit(request, requestFrame);
+}
+
+/*!
+    \internal
+
+    Writes the encoded \a frame of \a request to its connection, once the
+    rate limits of its endpoint allow it.
+*/
+void QCoapProtocolPrivate::transmit(QCoapInternalRequest *request, const QByteArray &frame)
+{
+    const QCoapMessage::MessageType type = request->message()->type();
+    const QUrl uri = request->targetUri();
+    CoapThrottledFrame throttledFrame = {
+        frame, request->connection(), uri.host(), static_cast<quint16>(uri.port()),
+        request->priority(), type == QCoapMessage::NonConfirmable, 0, request, request->token()
+    };
+
+    // Acknowledgments and resets answer the peer, and the replies to
+    // multicast requests come from other endpoints: they are not limited.
+    if (type == QCoapMessage::Acknowledgment || type == QCoapMessage::Reset
+            || request->isMulticast()) {
+        sendFrame(throttledFrame);
+        return;
+    }
+
+    dispatch(throttledFrame);
+}
+
+/*!
+    \internal
+
+    Sends the given \a frame if the rate limits of its endpoint allow it,
+    otherwise queues it until they do. Frames held back for an endpoint are
+    sent by order of priority, then in the order they were dispatched.
+*/
+void QCoapProtocolPrivate::dispatch(CoapThrottledFrame frame)
+{
+    const QHostAddress address(frame.host);
+    const auto key = QCoapRateLimiter::endpointKey(address, frame.port);
+    const qint64 now = throttleTime();
+
+    auto it = throttledFrames.find(key);
+    if (it == throttledFrames.end()) {
+        const qint64 delay = rateLimiter.acquire(address, frame.port, frame.frame.size(),
+                                                 frame.nonConfirmable, now);
+        if (delay == 0) {
+            sendFrame(frame);
+            return;
+        }
+
+        it = throttledFrames.insert(key, QVector<CoapThrottledFrame>());
+        scheduleThrottledFrames(delay);
+    }
+
+    frame.queuedAt = now;
+    auto position = std::upper_bound(it->begin(), it->end(), frame,
+                                     [](const CoapThrottledFrame &a, const CoapThrottledFrame &b) {
+        return a.priority < b.priority;
+    });
+    it->insert(position, frame);
 }
 
 /*!
     \internal
 
-    This slot is used to send again the given \a request after a timeout or
-    aborts the request and transfers a timeout error to the reply.
+    Hands the \a frame to its connection, and starts the transmission of
+    its request. The timers of the exchange and the round-trip time only
+    run from then on, so that a frame held back by the rate limits does not
+    time out, nor is retransmitted, before it is sent.
+*/
+void QCoapProtocolPrivate::sendFrame(const CoapThrottledFrame &frame)
+{
+    QCoapInternalRequest *request = frame.request;
+    restartTransmission(request);
+
+    const auto bytes = static_cast<quint64>(frame.frame.size());
+    const QCoapMessage::MessageType type = request->message()->type();
+    if (type == QCoapMessage::Acknowledgment || type == QCoapMessage::Reset) {
+        statistics.addControlSent(bytes);
+    } else if (request->retransmissionCounter() > 0) {
+        statistics.addRetransmission(bytes);
+        Q_TRACE(QCoapProtocol_retransmit, request->token(), request->message()->messageId(),
+                request->retransmissionCounter());
+    } else {
+        statistics.addRequestSent(bytes);
+    }
+
+    if (frame.connection)
+        frame.connection->sendRequest(frame.frame, frame.host, frame.port, frame.priority);
+}
+
+/*!
+    \internal
+
+    Sends the frames held back that the rate limits of their endpoints now
+    allow, and schedules the next release if frames remain.
+*/
+void QCoapProtocolPrivate::releaseThrottledFrames()
+{
+    const qint64 now = throttleTime();
+    qint64 nextDelay = -1;
+
+    for (auto it = throttledFrames.begin(); it != throttledFrames.end();) {
+        QVector<CoapThrottledFrame> &frames = *it;
+        while (!frames.isEmpty()) {
+            const CoapThrottledFrame &frame = frames.first();
+            const qint64 delay = rateLimiter.acquire(it.key().first, it.key().second,
+                                                     frame.frame.size(), frame.nonConfirmable,
+                                                     now);
+            if (delay > 0) {
+                nextDelay = nextDelay < 0 ? delay : qMin(nextDelay, delay);
+                break;
+            }
+
+            statistics.addThrottled((now - frame.queuedAt) / 1000);
+            if (requestForToken(frame.token) == frame.request)
+                sendFrame(frame);
+            frames.removeFirst();
+        }
+
+        if (frames.isEmpty())
+            it = throttledFrames.erase(it);
+        else
+            ++it;
+    }
+
+    if (nextDelay >= 0)
+        scheduleThrottledFrames(nextDelay);
+}
+
+/*!
+    \internal
+
+    Removes the \a frame held back, if any, as its exchange is over.
+*/
+void QCoapProtocolPrivate::dropThrottledFrame(const QByteArray &frame)
+{
+    for (auto it = throttledFrames.begin(); it != throttledFrames.end(); ++it) {
+        auto found = std::find_if(it->begin(), it->end(), [&frame](const CoapThrottledFrame &f) {
+            return f.frame == frame;
+        });
+        if (found == it->end())
+            continue;
+
+        it->erase(found);
+        if (it->isEmpty())
+            throttledFrames.erase(it);
+        return;
+    }
+}
+
+/*!
+    \internal
+
+    Makes sure that the frames held back are released in \a delay
+    nanoseconds at the latest.
+*/
+void QCoapProtocolPrivate::scheduleThrottledFrames(qint64 delay)
+{
+    Q_Q(QCoapProtocol);
+
+    if (!throttleTimer) {
+        throttleTimer = new QTimer(q);
+        throttleTimer->setSingleShot(true);
+        throttleTimer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(throttleTimer, &QTimer::timeout, q, [this] {
+            releaseThrottledFrames();
+        });
+    }
+
+    // Round up, so that the buckets are out of debt when the timer fires
+    const int milliseconds = static_cast<int>(qMin<qint64>((delay + 999999) / 1000000,
+                                                           std::numeric_limits<int>::max()));
+    if (!throttleTimer->isActive() || throttleTimer->remainingTime() > milliseconds)
+        throttleTimer->start(milliseconds);
+}
+
+/*!
+    \internal
+
+    Returns the time of the rate limiter clock, in nanoseconds.
+*/
+qint64 QCoapProtocolPrivate::throttleTime()
+{
+    if (!throttleClock.isValid())
+        throttleClock.start();
+    return throttleClock.nsecsElapsed();
+}
+
+/*!
+    \internal
+
+    Marks the transmission of \a request as in progress, and starts its
+    timers: the retransmission timer for each transmission, and the
+    exchange timer for the first one, which is MAX_TRANSMIT_WAIT.
+*/
+void QCoapProtocolPrivate::restartTransmission(QCoapInternalRequest *request)
+{
+    request->restartTransmission();
+
+    if (request->retransmissionCounter() == 0) {
+        startRequestTimer(request, QCoapInternalRequest::ExchangeTimer,
+                          request->maxTransmissionWait());
+    }
+    if (request->timeout() > 0)
+        startRequestTimer(request, QCoapInternalRequest::RetransmissionTimer, request->timeout());
+}
+
+/*!
+    \internal
+
+    Starts the timer of the given \a type for \a request, expiring in
+    \a timeout milliseconds. The timer replaces the previous timer of this
+    type, if any.
+
+    The timers of all the requests are kept in a heap, by deadline, and a
+    single QTimer expires at the earliest deadline: the requests do not own
+    any timer. A timer is stopped by clearing its identifier in the
+    request, and its entry is dropped from the heap when it expires.
+*/
+void QCoapProtocolPrivate::startRequestTimer(QCoapInternalRequest *request,
+                                             QCoapInternalRequest::TimerType type, int timeout)
+{
+    const quint64 id = ++lastTimerId;
+    request->setTimerId(type, id);
+
+    // Stopped timers are only dropped when they expire, and they can
+    // expire long after their exchange, e.g. for separate responses.
+    if (requestTimers.size() > 4 * exchangeMap.size() + 64)
+        purgeRequestTimers();
+
+    const qint64 deadline = timerTime() + qint64(qMax(0, timeout)) * 1000000;
+    const bool earliest = requestTimers.isEmpty() || deadline < requestTimers.first().deadline;
+    const CoapRequestTimer timer = { deadline, request, request->token(), id, type };
+    requestTimers.append(timer);
+    std::push_heap(requestTimers.begin(), requestTimers.end(), expiresLater);
+
+    if (earliest)
+        scheduleRequestTimers();
+}
+
+/*!
+    \internal
+
+    Handles the request timers which expired, and schedules the next one.
+    A timer is ignored if its request is no longer registered, or if it was
+    stopped or started again since.
+*/
+void QCoapProtocolPrivate::processRequestTimers()
+{
+    const qint64 now = timerTime();
+
+    while (!requestTimers.isEmpty() && requestTimers.first().deadline <= now) {
+        std::pop_heap(requestTimers.begin(), requestTimers.end(), expiresLater);
+        const CoapRequestTimer timer = requestTimers.takeLast();
+
+        auto it = exchangeMap.constFind(timer.token);
+        if (it == exchangeMap.constEnd() || it->request != timer.request
+                || timer.request->timerId(timer.type) != timer.id) {
+            continue;
+        }
+
+        timer.request->setTimerId(timer.type, 0);
+        if (timer.type == QCoapInternalRequest::RetransmissionTimer)
+            onRequestTimeout(timer.request);
+        else
+            onRequestMaxTransmissionSpanReached(timer.request);
+    }
+
+    scheduleRequestTimers();
+}
+
+/*!
+    \internal
+
+    Makes the timer of the protocol expire at the earliest deadline of the
+    request timers, or stops it if there are none.
+*/
+void QCoapProtocolPrivate::scheduleRequestTimers()
+{
+    Q_Q(QCoapProtocol);
+
+    if (requestTimers.isEmpty()) {
+        if (requestTimer)
+            requestTimer->stop();
+        return;
+    }
+
+    if (!requestTimer) {
+        requestTimer = new QTimer(q);
+        requestTimer->setSingleShot(true);
+        QObject::connect(requestTimer, &QTimer::timeout, q, [this] {
+            processRequestTimers();
+        });
+    }
+
+    // Round up, so that the deadline is reached when the timer fires
+    const qint64 delay = qMax<qint64>(0, requestTimers.first().deadline - timerTime());
+    requestTimer->start(static_cast<int>(qMin<qint64>((delay + 999999) / 1000000,
+                                                      std::numeric_limits<int>::max())));
+}
+
+/*!
+    \internal
+
+    Drops the request timers which were stopped, or whose exchange is over.
+*/
+void QCoapProtocolPrivate::purgeRequestTimers()
+{
+    const auto stopped = [this](const CoapRequestTimer &timer) {
+        auto it = exchangeMap.constFind(timer.token);
+        return it == exchangeMap.constEnd() || it->request != timer.request
+                || timer.request->timerId(timer.type) != timer.id;
+    };
+    requestTimers.erase(std::remove_if(requestTimers.begin(), requestTimers.end(), stopped),
+                        requestTimers.end());
+    std::make_heap(requestTimers.begin(), requestTimers.end(), expiresLater);
+}
+
+/*!
+    \internal
+
+    Returns the time of the clock of the request timers, in nanoseconds.
+*/
+qint64 QCoapProtocolPrivate::timerTime()
+{
+    if (!timerClock.isValid())
+        timerClock.start();
+    return timerClock.nsecsElapsed();
+}
+
+/*!
+    \internal
+
+    Sends again the given \a request after a timeout, or aborts the request
+    and transfers a timeout error to the reply.
 */
 void QCoapProtocolPrivate::onRequestTimeout(QCoapInternalRequest *request)
 {
@@ -152,10 +572,24 @@ void QCoapProtocolPrivate::onRequestTimeout(QCoapInternalRequest *request)
     if (!isRequestRegistered(request))
         return;
 
+    // Nobody waits for the result anymore, do not retransmit
+    auto it = exchangeMap.constFind(request->token());
+    if ((it->future || it->callback) && !isAwaited(*it)) {
+        forgetExchange(request);
+        return;
+    }
+
+    if (request->isMulticast()) {
+        onMulticastRequestExpired(request);
+        return;
+    }
+
     if (request->message()->type() == QCoapMessage::Confirmable
             && request->retransmissionCounter() < maxRetransmit) {
-        sendRequest(request);
+        resendRequest(request);
     } else {
+        statistics.addTimeout();
+        Q_TRACE(QCoapProtocol_timeout, request->token(), request->message()->messageId());
         onRequestError(request, QtCoap::TimeOutError);
     }
 }
@@ -163,16 +597,25 @@ void QCoapProtocolPrivate::onRequestTimeout(QCoapInternalRequest *request)
 /*!
     \internal
 
-    This slot is called when the maximum span for this transmission has been
-    reached, and triggers a timeout error if the request is still running.
+    Called when the maximum span for this transmission has been reached, or
+    when the separate response to the request was not received in time, and
+    triggers a timeout error if the request is still running.
 */
 void QCoapProtocolPrivate::onRequestMaxTransmissionSpanReached(QCoapInternalRequest *request)
 {
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
 
-    if (isRequestRegistered(request))
+    if (!isRequestRegistered(request))
+        return;
+
+    if (request->isMulticast()) {
+        onMulticastRequestExpired(request);
+    } else {
+        statistics.addTimeout();
+        Q_TRACE(QCoapProtocol_timeout, request->token(), request->message()->messageId());
         onRequestError(request, QtCoap::TimeOutError);
+    }
 }
 
 /*!
@@ -215,6 +658,10 @@ void QCoapProtocolPrivate::onRequestError(QCoapInternalRequest *request, QtCoap:
                                   Q_ARG(QtCoap::Error, QtCoap::NoError));
     }
 
+    auto it = exchangeMap.find(request->token());
+    if (it != exchangeMap.end())
+        invokeCallback(*it, reply);
+
     forgetExchange(request);
     emit q->error(userReply.data(), error);
 }
@@ -228,8 +675,24 @@ void QCoapProtocolPrivate::onFrameReceived(const QNetworkDatagram &frame)
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
 
-    QSharedPointer<QCoapInternalReply> reply(decode(frame));
-    const QCoapMessage *messageReceived = reply->message();
+    const QByteArray data = frame.data();
+    statistics.addReceived(static_cast<quint64>(data.size()));
+
+    // Empty acknowledgments are handled from their header, without decoding
+    if (QCoapInternalMessagePrivate::isEmptyFrame(data, QCoapMessage::Acknowledgment)) {
+        onEmptyAcknowledgmentReceived(frame);
+        return;
+    }
+
+    QCoapInternalReply reply;
+    if (!decode(frame, &reply)) {
+        qDebug() << "QtCoap: Malformed frame dropped";
+        return;
+    }
+
+    onEndpointAnswered(frame);
+
+    const QCoapMessage *messageReceived = reply.message();
 
     QCoapInternalRequest *request = nullptr;
     if (!messageReceived->token().isEmpty())
@@ -239,23 +702,63 @@ void QCoapProtocolPrivate::onFrameReceived(const QNetworkDatagram &frame)
         request = findRequestByMessageId(messageReceived->messageId());
 
         // No matching request found, drop the frame.
-        if (!request)
+        if (!request) {
+            Q_TRACE(QCoapProtocol_match, messageReceived->token(),
+                    messageReceived->messageId(), 0);
             return;
+        }
     }
 
-    QHostAddress originalTarget(request->targetUri().host());
-    if (!originalTarget.isMulticast() && !originalTarget.isEqual(frame.senderAddress())) {
+    Q_TRACE(QCoapProtocol_match, request->token(), messageReceived->messageId(), 1);
+
+    const QHostAddress originalTarget = request->targetAddress();
+    if (originalTarget.isMulticast()) {
+        onMulticastReplyReceived(request, &reply, frame);
+        return;
+    }
+
+    if (!originalTarget.isEqual(frame.senderAddress())) {
         qDebug().nospace() << "QtCoap: Answer received from incorrect host ("
                            << frame.senderAddress() << " instead of "
                            << originalTarget << ")";
         return;
     }
 
+    // Replies with critical options we do not understand are rejected,
+    // with a Reset message when they are confirmable.
+    if (reply.hasUnrecognizedCriticalOption()) {
+        qDebug() << "QtCoap: Reply rejected, it carries an unrecognized critical option";
+        if (messageReceived->type() == QCoapMessage::Confirmable)
+            sendReset(request->connection(), frame, messageReceived->messageId());
+        return;
+    }
+
+    // A copy of a reply already received, sent again because its
+    // acknowledgment was lost.
+    if (isReplyReceived(request, messageReceived->messageId())) {
+        statistics.addDuplicate();
+        if (messageReceived->type() == QCoapMessage::Confirmable) {
+            sendAcknowledgment(request->connection(), frame, messageReceived->messageId(),
+                               messageReceived->token());
+        }
+        return;
+    }
+
+    // Retransmitted messages are not measured, as the transmission
+    // answered is unknown.
+    if (request->retransmissionCounter() == 0) {
+        const qint64 rtt = request->transmissionElapsed();
+        if (rtt >= 0) {
+            const QUrl uri = request->targetUri();
+            statistics.addRttSample(uri.host(), uri.port(), rtt);
+        }
+    }
+
     request->stopTransmission();
     addReply(request->token(), reply);
 
-    if (QtCoap::isError(reply->responseCode())) {
-        onRequestError(request, reply.data());
+    if (QtCoap::isError(reply.responseCode())) {
+        onRequestError(request, &reply);
         return;
     }
 
@@ -263,18 +766,34 @@ void QCoapProtocolPrivate::onFrameReceived(const QNetworkDatagram &frame)
     if (request->isObserveCancelled()) {
         // Remove option to ensure that it will stop
         request->removeOption(QCoapOption::Observe);
-        sendReset(request);
+        sendReset(request->connection(), frame, messageReceived->messageId());
     } else if (messageReceived->type() == QCoapMessage::Confirmable) {
-        sendAcknowledgment(request);
+        sendAcknowledgment(request->connection(), frame, messageReceived->messageId(),
+                           messageReceived->token());
     }
 
     // Send next block, ask for next block, or process the final reply
-    if (reply->hasMoreBlocksToSend()) {
-        request->setToSendBlock(reply->nextBlockToSend(), blockSize);
+    if (reply.hasMoreBlocksToSend()) {
+        request->setToSendBlock(reply.nextBlockToSend(), blockSize);
         request->setMessageId(generateUniqueMessageId());
         sendRequest(request);
-    } else if (reply->hasMoreBlocksToReceive()) {
-        request->setToRequestBlock(reply->currentBlockNumber() + 1, reply->blockSize());
+    } else if (reply.hasMoreBlocksToReceive()) {
+        // Let a discovery reply report the resources the block completes
+        // before the next one is received. Other replies only use the
+        // merged response, so nothing is queued for them.
+        const auto it = exchangeMap.constFind(request->token());
+        const QPointer<QCoapReply> userReply = it != exchangeMap.cend() && it->discovery
+                ? it->userReply : QPointer<QCoapReply>();
+        if (userReply && !request->isObserve()) {
+            const int offset = static_cast<int>(reply.currentBlockNumber() * reply.blockSize());
+            QMetaObject::invokeMethod(userReply.data(), "_q_setBlockReceived",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QHostAddress, frame.senderAddress()),
+                                      Q_ARG(QByteArray, messageReceived->payload()),
+                                      Q_ARG(int, offset));
+        }
+
+        request->setToRequestBlock(reply.currentBlockNumber() + 1, reply.blockSize());
         request->setMessageId(generateUniqueMessageId());
         sendRequest(request);
     } else {
@@ -282,6 +801,69 @@ void QCoapProtocolPrivate::onFrameReceived(const QNetworkDatagram &frame)
     }
 }
 
+/*!
+    \internal
+
+    Handles the empty acknowledgment in \a frame, announcing that the
+    response to the request it acknowledges will be sent separately. The
+    exchange of the request moves to the WaitingSeparateResponse state, and
+    the acknowledgment is not stored.
+
+    Acknowledgments are matched by message ID only, and acknowledgments
+    which do not match a request waiting for one are dropped.
+*/
+void QCoapProtocolPrivate::onEmptyAcknowledgmentReceived(const QNetworkDatagram &frame)
+{
+    const QByteArray data = frame.data();
+    const int tokenLength = data.at(0) & 0x0F;
+    if (tokenLength > 8 || data.size() != 4 + tokenLength) {
+        qDebug() << "QtCoap: Malformed frame dropped";
+        return;
+    }
+
+    onEndpointAnswered(frame);
+
+    const auto messageId = static_cast<quint16>(QCoapInternalMessagePrivate::frameMessageId(data));
+    QCoapInternalRequest *request = findRequestByMessageId(messageId);
+    if (!request || request->exchangeState() != QCoapInternalRequest::WaitingAcknowledgment
+            || request->isMulticast()
+            || !request->targetAddress().isEqual(frame.senderAddress())) {
+        Q_TRACE(QCoapProtocol_match, QByteArray(), messageId, 0);
+        return;
+    }
+
+    Q_TRACE(QCoapProtocol_match, request->token(), messageId, 1);
+
+    if (request->retransmissionCounter() == 0) {
+        const qint64 rtt = request->transmissionElapsed();
+        if (rtt >= 0) {
+            const QUrl uri = request->targetUri();
+            statistics.addRttSample(uri.host(), uri.port(), rtt);
+        }
+    }
+
+    if (request->waitForSeparateResponse()) {
+        startRequestTimer(request, QCoapInternalRequest::ExchangeTimer,
+                          separateResponseTimeout);
+    }
+}
+
+/*!
+    \internal
+
+    Records that the sender of \a frame answered, so that the PROBING_RATE
+    no longer applies to it, and releases the frames it held back.
+*/
+void QCoapProtocolPrivate::onEndpointAnswered(const QNetworkDatagram &frame)
+{
+    const QHostAddress sender = frame.senderAddress();
+    const auto senderPort = static_cast<quint16>(frame.senderPort());
+    if (rateLimiter.setAnswered(sender, senderPort)
+            && throttledFrames.contains(QCoapRateLimiter::endpointKey(sender, senderPort))) {
+        releaseThrottledFrames();
+    }
+}
+
 /*!
     \internal
 
@@ -291,7 +873,7 @@ QCoapInternalRequest *QCoapProtocolPrivate::requestForToken(const QByteArray &to
 {
     auto it = exchangeMap.find(token);
     if (it != exchangeMap.constEnd())
-        return it->request.data();
+        return it->request;
 
     return nullptr;
 }
@@ -315,8 +897,7 @@ QPointer<QCoapReply> QCoapProtocolPrivate::userReplyForToken(const QCoapToken &t
 
     Returns the replies for the exchange identified by \a token.
 */
-QVector<QSharedPointer<QCoapInternalReply> > QCoapProtocolPrivate::repliesForToken(
-    const QCoapToken &token)
+QVector<QCoapInternalReply> QCoapProtocolPrivate::repliesForToken(const QCoapToken &token)
 {
     auto it = exchangeMap.find(token);
     if (it != exchangeMap.constEnd())
@@ -333,8 +914,8 @@ QVector<QSharedPointer<QCoapInternalReply> > QCoapProtocolPrivate::repliesForTok
 QCoapInternalReply *QCoapProtocolPrivate::lastReplyForToken(const QCoapToken &token)
 {
     auto it = exchangeMap.find(token);
-    if (it != exchangeMap.constEnd())
-        return it->replies.last().data();
+    if (it != exchangeMap.end() && !it->replies.isEmpty())
+        return &it->replies.last();
 
     return nullptr;
 }
@@ -348,7 +929,7 @@ QCoapInternalRequest *QCoapProtocolPrivate::findRequestByUserReply(const QCoapRe
 {
     for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
         if (it->userReply == reply)
-            return it->request.data();
+            return it->request;
     }
 
     return nullptr;
@@ -363,7 +944,7 @@ QCoapInternalRequest *QCoapProtocolPrivate::findRequestByMessageId(quint16 messa
 {
     for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
         if (it->request->message()->messageId() == messageId)
-            return it->request.data();
+            return it->request;
     }
 
     return nullptr;
@@ -384,36 +965,35 @@ void QCoapProtocolPrivate::onLastMessageReceived(QCoapInternalRequest *request)
     if (!request || !isRequestRegistered(request))
         return;
 
-    auto replies = repliesForToken(request->token());
-    Q_ASSERT(!replies.isEmpty());
-
     //! TODO: Change QPointer<QCoapReply> into something independent from
     //! User. QSharedPointer(s)?
-    QPointer<QCoapReply> userReply = userReplyForToken(request->token());
-    if (userReply.isNull() || replies.isEmpty()
+    auto exchange = exchangeMap.find(request->token());
+    QVector<QCoapInternalReply> &replies = exchange->replies;
+    Q_ASSERT(!replies.isEmpty());
+
+    QPointer<QCoapReply> userReply = exchange->userReply;
+    if (!isAwaited(*exchange) || replies.isEmpty()
             || (request->isObserve() && request->isObserveCancelled())) {
         forgetExchange(request);
         return;
     }
 
-    auto lastReply = replies.last();
-    // Ignore empty ACK messages
-    if (lastReply->message()->type() == QCoapMessage::Acknowledgment
-            && lastReply->responseCode() == QtCoap::EmptyMessage) {
-        exchangeMap[request->token()].replies.takeLast();
-        return;
-    }
+    QCoapInternalReply *lastReply = &replies.last();
 
-    // Merge payloads for blockwise transfers
+    // Merge payloads for blockwise transfers, sorting the replies by
+    // address rather than copying them around.
     if (replies.size() > 1) {
-        std::stable_sort(std::begin(replies), std::end(replies),
-        [](auto a, auto b) -> bool {
+        QVarLengthArray<const QCoapInternalReply *, 32> blocks;
+        for (const QCoapInternalReply &reply : qAsConst(replies))
+            blocks.append(&reply);
+        std::stable_sort(blocks.begin(), blocks.end(),
+        [](const QCoapInternalReply *a, const QCoapInternalReply *b) -> bool {
             return (a->currentBlockNumber() < b->currentBlockNumber());
         });
 
         QByteArray finalPayload;
         int lastBlockNumber = -1;
-        for (auto reply : qAsConst(replies)) {
+        for (const QCoapInternalReply *reply : qAsConst(blocks)) {
             int currentBlock = static_cast<int>(reply->currentBlockNumber());
             QByteArray replyPayload = reply->message()->payload();
             if (replyPayload.isEmpty() || currentBlock <= lastBlockNumber)
@@ -427,6 +1007,17 @@ void QCoapProtocolPrivate::onLastMessageReceived(QCoapInternalRequest *request)
     }
 
     // Forward the answer
+    if (exchange->future) {
+        exchange->future->reportResult(*lastReply->message());
+        finishFuture(*exchange, false);
+    }
+    invokeCallback(*exchange, lastReply);
+
+    if (userReply.isNull()) {
+        forgetExchange(request);
+        return;
+    }
+
     QMetaObject::invokeMethod(userReply, "_q_setContent", Qt::QueuedConnection,
                               Q_ARG(QHostAddress, lastReply->senderAddress()),
                               Q_ARG(QCoapMessage, *lastReply->message()),
@@ -445,43 +1036,142 @@ void QCoapProtocolPrivate::onLastMessageReceived(QCoapInternalRequest *request)
 /*!
     \internal
 
-    Sends an internal request acknowledging the given \a request, reusing its
-    URI and connection.
+    Handles the \a reply to the multicast \a request, received in \a frame.
+
+    Any number of servers may answer a multicast request, so that the
+    exchange is not finished by a reply: the reply of each responder is
+    forwarded as soon as it is received, and the exchange ends with the
+    Leisure. Duplicates and later replies of a responder are dropped, as
+    well as error replies. Blockwise transfers are not continued, the
+    first block of each reply is forwarded.
 */
-void QCoapProtocolPrivate::sendAcknowledgment(QCoapInternalRequest *request)
+void QCoapProtocolPrivate::onMulticastReplyReceived(QCoapInternalRequest *request,
+                                                    QCoapInternalReply *reply,
+                                                    const QNetworkDatagram &frame)
 {
-    Q_Q(const QCoapProtocol);
-    Q_ASSERT(QThread::currentThread() == q->thread());
+    const QCoapMessage *message = reply->message();
+    const QHostAddress sender = frame.senderAddress();
+    const quint16 senderPort = static_cast<quint16>(frame.senderPort());
 
-    QCoapInternalRequest ackRequest;
-    ackRequest.setTargetUri(request->targetUri());
+    // Replies to multicast requests should not be confirmable, but the
+    // sender expects an acknowledgment if they are.
+    if (message->type() == QCoapMessage::Confirmable)
+        sendAcknowledgment(request->connection(), frame, message->messageId(), message->token());
+
+    auto it = exchangeMap.find(request->token());
+    if (it == exchangeMap.end() || it->request != request)
+        return;
+
+    const auto responder = qMakePair(sender, senderPort);
+    if (it->responders.contains(responder)) {
+        statistics.addDuplicate();
+        return;
+    }
+    it->responders.insert(responder);
+
+    if (reply->hasUnrecognizedCriticalOption() || QtCoap::isError(reply->responseCode())) {
+        qDebug() << "QtCoap: Reply to multicast request from" << sender << "dropped";
+        return;
+    }
+
+    if (it->future && !it->future->isCanceled())
+        it->future->reportResult(*message);
+    invokeCallback(*it, reply);
+
+    if (it->userReply.isNull())
+        return;
 
-    auto internalReply = lastReplyForToken(request->token());
-    ackRequest.initForAcknowledgment(internalReply->message()->messageId(),
-                                     internalReply->message()->token());
-    ackRequest.setConnection(request->connection());
-    sendRequest(&ackRequest);
+    QMetaObject::invokeMethod(it->userReply.data(), "_q_setContent", Qt::QueuedConnection,
+                              Q_ARG(QHostAddress, sender),
+                              Q_ARG(QCoapMessage, *message),
+                              Q_ARG(QtCoap::ResponseCode, reply->responseCode()));
 }
 
 /*!
     \internal
 
-    Sends a Reset message (RST), reusing the details of the given
-    \a request. A Reset message indicates that a specific message has been
-    received, but cannot be properly processed.
+    Finishes the multicast \a request at the end of its Leisure. This is not
+    an error, even if no server answered.
 */
-void QCoapProtocolPrivate::sendReset(QCoapInternalRequest *request)
+void QCoapProtocolPrivate::onMulticastRequestExpired(QCoapInternalRequest *request)
+{
+    auto it = exchangeMap.find(request->token());
+    if (it != exchangeMap.end())
+        finishFuture(*it, false);
+
+    auto userReply = userReplyForToken(request->token());
+    if (!userReply.isNull()) {
+        QMetaObject::invokeMethod(userReply.data(), "_q_setFinished", Qt::QueuedConnection,
+                                  Q_ARG(QtCoap::Error, QtCoap::NoError));
+    }
+
+    forgetExchange(request);
+}
+
+/*!
+    \internal
+
+    Sends an acknowledgment for the message with the given \a messageId and
+    \a token to the sender of \a frame, through \a connection.
+*/
+void QCoapProtocolPrivate::sendAcknowledgment(QCoapConnection *connection,
+                                              const QNetworkDatagram &frame, quint16 messageId,
+                                              const QByteArray &token)
+{
+    sendEmptyMessage(connection, QCoapMessage::Acknowledgment, messageId, token,
+                     frame.senderAddress(), static_cast<quint16>(frame.senderPort()));
+}
+
+/*!
+    \internal
+
+    Sends a Reset message (RST) for the message with the given
+    \a messageId to the sender of \a frame, through \a connection. A Reset
+    message indicates that a specific message has been received, but
+    cannot be properly processed.
+*/
+void QCoapProtocolPrivate::sendReset(QCoapConnection *connection, const QNetworkDatagram &frame,
+                                     quint16 messageId)
+{
+    sendEmptyMessage(connection, QCoapMessage::Reset, messageId, QByteArray(),
+                     frame.senderAddress(), static_cast<quint16>(frame.senderPort()));
+}
+
+/*!
+    \internal
+
+    Sends an empty message of the given \a type, with \a messageId and
+    \a token, to \a host and \a port through \a connection.
+
+    The frame is written on the stack, and straight to the socket once it
+    is bound: acknowledgments and resets are sent before any queued frame
+    anyway, and are not rate limited.
+*/
+void QCoapProtocolPrivate::sendEmptyMessage(QCoapConnection *connection,
+                                            QCoapMessage::MessageType type, quint16 messageId,
+                                            const QByteArray &token, const QHostAddress &host,
+                                            quint16 port)
 {
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
 
-    QCoapInternalRequest resetRequest;
-    resetRequest.setTargetUri(request->targetUri());
+    if (!connection) {
+        qWarning("QtCoap: Message not bound to any connection: aborted.");
+        return;
+    }
+
+    char frame[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const int size = QCoapInternalMessagePrivate::encodeEmptyFrame(frame, type, messageId, token);
+    Q_TRACE(QCoapProtocol_encode, token, messageId, size);
+    statistics.addControlSent(static_cast<quint64>(size));
 
-    auto lastReply = lastReplyForToken(request->token());
-    resetRequest.initForReset(lastReply->message()->messageId());
-    resetRequest.setConnection(request->connection());
-    sendRequest(&resetRequest);
+    if (connection->state() == QCoapConnection::Bound) {
+        auto connectionPrivate = static_cast<QCoapConnectionPrivate *>(
+                    QObjectPrivate::get(connection));
+        connectionPrivate->writeToSocket(frame, size, host, port);
+    } else {
+        connection->sendRequest(QByteArray(frame, size), host.toString(), port);
+    }
 }
 
 /*!
@@ -556,22 +1246,27 @@ QCoapToken QCoapProtocolPrivate::generateUniqueToken() const
 */
 QByteArray QCoapProtocolPrivate::encode(QCoapInternalRequest *request)
 {
-    return request->toQByteArray();
+    const QByteArray frame = request->toQByteArray();
+    Q_TRACE(QCoapProtocol_encode, request->token(), request->message()->messageId(),
+            frame.size());
+    return frame;
 }
 
 /*!
     \internal
 
-    Decodes the \a frame and returns a new unmanaged
-    QCoapInternalReply object.
+    Decodes the \a frame into \a reply. Returns \c false if the frame is
+    malformed.
 */
-QCoapInternalReply *QCoapProtocolPrivate::decode(const QNetworkDatagram &frame)
+bool QCoapProtocolPrivate::decode(const QNetworkDatagram &frame, QCoapInternalReply *reply)
 {
-    Q_Q(QCoapProtocol);
-    QCoapInternalReply *reply = QCoapInternalReply::createFromFrame(frame.data(), q);
-    reply->setSenderAddress(frame.senderAddress());
+    if (!QCoapInternalReply::createFromFrame(frame.data(), reply))
+        return false;
 
-    return reply;
+    reply->setSenderAddress(frame.senderAddress());
+    Q_TRACE(QCoapProtocol_decode, reply->message()->token(),
+            reply->message()->messageId(), reply->responseCode());
+    return true;
 }
 
 /*!
@@ -618,59 +1313,45 @@ void QCoapProtocolPrivate::onConnectionError(QAbstractSocket::SocketError socket
 
 /*!
     Decodes the \a data to a list of QCoapResource objects.
-    The \a data byte array is a frame returned by a discovery request.
+    The \a data byte array is a frame returned by a discovery request, in
+    the CoRE link format, and \a sender is the host of the resources.
 */
 QVector<QCoapResource> QCoapProtocol::resourcesFromCoreLinkList(const QHostAddress &sender,
                                                                 const QByteArray &data)
 {
-    QVector<QCoapResource> resourceList;
-
-    QLatin1String quote = QLatin1String("\"");
-    const QList<QByteArray> links = data.split(',');
-    for (QByteArray link : links) {
-        QCoapResource resource;
-        resource.setHost(sender);
-
-        const QList<QByteArray> parameterList = link.split(';');
-        for (QByteArray parameter : parameterList) {
-            QString parameterString = QString::fromUtf8(parameter);
-            int length = parameterString.length();
-            if (parameter.startsWith('<'))
-                resource.setPath(parameterString.mid(1, length - 2));
-            else if (parameter.startsWith("title="))
-                resource.setTitle(parameterString.mid(6).remove(quote));
-            else if (parameter.startsWith("rt="))
-                resource.setResourceType(parameterString.mid(3).remove(quote));
-            else if (parameter.startsWith("if="))
-                resource.setInterface(parameterString.mid(3).remove(quote));
-            else if (parameter.startsWith("sz="))
-                resource.setMaximumSize(parameterString.mid(3).remove(quote).toInt());
-            else if (parameter.startsWith("ct="))
-                resource.setContentFormat(parameterString.mid(3).remove(quote).toUInt());
-            else if (parameter == "obs")
-                resource.setObservable(true);
-        }
-
-        if (!resource.path().isEmpty())
-            resourceList.push_back(resource);
-    }
-
-    return resourceList;
+    return QCoapLinkFormatParser::parse(sender, data);
 }
 
 /*!
     \internal
 
-    Registers a new CoAP exchange using \a token.
+    Registers a new CoAP exchange using \a token. The exchange takes
+    ownership of \a request, which must have been created by the request
+    pool of the protocol.
 */
 void QCoapProtocolPrivate::registerExchange(const QCoapToken &token, QCoapReply *reply,
-                                            QSharedPointer<QCoapInternalRequest> request)
+                                            QCoapInternalRequest *request)
 {
-    CoapExchangeData data = { reply, request,
-                              QVector<QSharedPointer<QCoapInternalReply> >()
-                            };
+    CoapExchangeData data;
+    data.userReply = reply;
+    data.request = request;
 
-    exchangeMap.insert(token, data);
+    registerExchange(token, data);
+}
+
+/*!
+    \internal
+
+    Registers a new CoAP exchange using \a token, delivering its result to
+    the user reply, the future and the callback of \a exchange.
+*/
+void QCoapProtocolPrivate::registerExchange(const QCoapToken &token,
+                                            const CoapExchangeData &exchange)
+{
+    exchangeMap.insert(token, exchange);
+    statistics.setExchangesInFlight(exchangeMap.size());
+    Q_TRACE(QCoapProtocol_registerExchange, token,
+            exchange.request ? exchange.request->message()->messageId() : -1);
 }
 
 /*!
@@ -682,15 +1363,15 @@ void QCoapProtocolPrivate::registerExchange(const QCoapToken &token, QCoapReply
     and return \c false if no exchange is associated with the \a token
     provided.
 */
-bool QCoapProtocolPrivate::addReply(const QCoapToken &token,
-                                    QSharedPointer<QCoapInternalReply> reply)
+bool QCoapProtocolPrivate::addReply(const QCoapToken &token, const QCoapInternalReply &reply)
 {
-    if (!isTokenRegistered(token) || !reply) {
-        qWarning() << "QtCoap: Reply token '" << token << "' not registered, or reply is null.";
+    auto it = exchangeMap.find(token);
+    if (it == exchangeMap.end()) {
+        qWarning() << "QtCoap: Reply token '" << token << "' not registered.";
         return false;
     }
 
-    exchangeMap[token].replies.push_back(reply);
+    it->replies.push_back(reply);
     return true;
 }
 
@@ -699,14 +1380,94 @@ bool QCoapProtocolPrivate::addReply(const QCoapToken &token,
 
     Remove the exchange identified by its \a token. This is
     typically done when finished or aborted.
-    It will delete the QCoapInternalRequest and QCoapInternalReplies
-    associated with the exchange.
+    It will release the QCoapInternalRequest of the exchange to the request
+    pool, along with its replies, and cancel its future if it is not
+    finished yet.
 
     Returns \c true if the exchange was found and removed, \c false otherwise.
 */
 bool QCoapProtocolPrivate::forgetExchange(const QCoapToken &token)
 {
-    return exchangeMap.remove(token) > 0;
+    auto it = exchangeMap.find(token);
+    if (it == exchangeMap.end())
+        return false;
+
+    finishFuture(*it, true);
+    invokeCallback(*it, nullptr);
+    if (!throttledFrames.isEmpty() && !it->frame.isEmpty())
+        dropThrottledFrame(it->frame);
+    QCoapInternalRequest *request = it->request;
+    exchangeMap.erase(it);
+    requestPool.destroy(request);
+    statistics.setExchangesInFlight(exchangeMap.size());
+    return true;
+}
+
+/*!
+    \internal
+
+    Finishes the future of the given \a exchange if there is one, and if it
+    is not finished yet. The future is first canceled if \a canceled is
+    \c true.
+*/
+void QCoapProtocolPrivate::finishFuture(CoapExchangeData &exchange, bool canceled)
+{
+    if (!exchange.future || exchange.future->isFinished())
+        return;
+
+    if (canceled)
+        exchange.future->reportCanceled();
+    exchange.future->reportFinished();
+}
+
+/*!
+    \internal
+
+    Returns \c true if the result of the \a exchange is still expected by
+    a user reply, a future or a callback.
+
+    The callback context lives in another thread, so it may be destroyed
+    right after this check. The callback is then dropped when it is
+    delivered.
+*/
+bool QCoapProtocolPrivate::isAwaited(const CoapExchangeData &exchange)
+{
+    return !exchange.userReply.isNull()
+            || (exchange.future && !exchange.future->isCanceled())
+            || (exchange.callback && !exchange.callbackContext.isNull());
+}
+
+/*!
+    \internal
+
+    Invokes the callback of the given \a exchange, if it was not invoked
+    yet, in the thread of its context object. The callback gets the
+    response code and the message of \a reply, or QtCoap::InvalidCode and
+    an empty message if \a reply is \c nullptr.
+
+    The context can only be checked safely from its own thread, so the call
+    is queued to the callback receiver of the client, which lives in that
+    thread and outlives the protocol. The context is checked there.
+*/
+void QCoapProtocolPrivate::invokeCallback(CoapExchangeData &exchange,
+                                          const QCoapInternalReply *reply)
+{
+    if (!exchange.callback)
+        return;
+
+    CoapResponseCallback callback;
+    callback.swap(exchange.callback);
+    if (exchange.callbackContext.isNull())
+        return;
+
+    const QtCoap::ResponseCode code = reply ? reply->responseCode() : QtCoap::InvalidCode;
+    const QCoapMessage message = reply ? *reply->message() : QCoapMessage();
+    const QPointer<QObject> context = exchange.callbackContext;
+    QMetaObject::invokeMethod(exchange.callbackReceiver,
+                              [callback = std::move(callback), context, code, message] {
+                                  if (!context.isNull())
+                                      callback(code, message);
+                              }, Qt::QueuedConnection);
 }
 
 /*!
@@ -724,7 +1485,9 @@ bool QCoapProtocolPrivate::forgetExchange(const QCoapInternalRequest *request)
 /*!
     \internal
 
-    Remove all replies for the exchange corresponding to \a token.
+    Remove all replies for the exchange corresponding to \a token. The
+    storage of the replies is kept for the next ones, e.g. the next
+    notifications of an observed resource.
 */
 bool QCoapProtocolPrivate::forgetExchangeReplies(const QCoapToken &token)
 {
@@ -760,7 +1523,28 @@ bool QCoapProtocolPrivate::isTokenRegistered(const QCoapToken &token) const
 bool QCoapProtocolPrivate::isRequestRegistered(const QCoapInternalRequest *request) const
 {
     for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
-        if (it->request.data() == request)
+        if (it->request == request)
+            return true;
+    }
+
+    return false;
+}
+
+/*!
+    \internal
+
+    Returns \c true if a reply with the given \a messageId was already
+    received for the exchange of \a request.
+*/
+bool QCoapProtocolPrivate::isReplyReceived(const QCoapInternalRequest *request,
+                                           quint16 messageId) const
+{
+    auto it = exchangeMap.constFind(request->token());
+    if (it == exchangeMap.constEnd())
+        return false;
+
+    for (const QCoapInternalReply &reply : it->replies) {
+        if (reply.message()->messageId() == messageId)
             return true;
     }
 
@@ -824,6 +1608,46 @@ int QCoapProtocol::maxRetransmit() const
     return d->maxRetransmit;
 }
 
+/*!
+    Returns the PROBING_RATE in bytes per second.
+
+    \sa setProbingRate()
+*/
+double QCoapProtocol::probingRate() const
+{
+    Q_D(const QCoapProtocol);
+    return d->rateLimiter.probingRate();
+}
+
+/*!
+    Returns the Leisure in milliseconds, during which the replies to a
+    multicast request are collected.
+    The default is 5000, the DEFAULT_LEISURE of
+    \l{https://tools.ietf.org/html/rfc7252#section-8.2}{RFC 7252}.
+
+    \sa setLeisure()
+*/
+int QCoapProtocol::leisure() const
+{
+    Q_D(const QCoapProtocol);
+    return d->leisure;
+}
+
+/*!
+    Returns the time in milliseconds during which the response to a
+    request is awaited, once the server acknowledged the request with an
+    empty acknowledgment, announcing a separate response.
+    The default is 247000, the EXCHANGE_LIFETIME of
+    \l{https://tools.ietf.org/html/rfc7252#section-4.8.2}{RFC 7252}.
+
+    \sa setSeparateResponseTimeout()
+*/
+int QCoapProtocol::separateResponseTimeout() const
+{
+    Q_D(const QCoapProtocol);
+    return d->separateResponseTimeout;
+}
+
 /*!
     Returns the max block size wanted.
     The default is 0, which invites the server to choose the block size.
@@ -960,6 +1784,95 @@ void QCoapProtocol::setMaxRetransmit(int maxRetransmit)
     d->maxRetransmit = maxRetransmit;
 }
 
+/*!
+    Sets the Leisure to \a leisure milliseconds. The replies to a multicast
+    request are collected during the Leisure, after which the request is
+    finished.
+    The default is 5000 ms.
+
+    \sa leisure()
+*/
+void QCoapProtocol::setLeisure(int leisure)
+{
+    Q_D(QCoapProtocol);
+    if (leisure <= 0) {
+        qWarning("QtCoap: Leisure must be positive.");
+        return;
+    }
+
+    d->leisure = leisure;
+}
+
+/*!
+    Sets the time during which a separate response is awaited to
+    \a timeout milliseconds. If the response is not received in time, the
+    request fails with a QtCoap::TimeOutError.
+    The default is 247000 ms.
+
+    \sa separateResponseTimeout()
+*/
+void QCoapProtocol::setSeparateResponseTimeout(int timeout)
+{
+    Q_D(QCoapProtocol);
+    if (timeout <= 0) {
+        qWarning("QtCoap: Separate response timeout must be positive.");
+        return;
+    }
+
+    d->separateResponseTimeout = timeout;
+}
+
+/*!
+    Sets the rate limit of the endpoints without a limit of their own to
+    \a bytesPerSecond and \a messagesPerSecond. A rate of 0 means no
+    limit, which is the default.
+
+    Each endpoint has token buckets holding up to one second of traffic at
+    these rates. The frames of requests exceeding them are held back and
+    sent as soon as the buckets allow it, they are never dropped.
+    Acknowledgments, resets and multicast requests are not limited.
+
+    \sa setProbingRate(), QCoapClientStatistics::throttledTime()
+*/
+void QCoapProtocol::setRateLimit(double bytesPerSecond, double messagesPerSecond)
+{
+    Q_D(QCoapProtocol);
+    d->rateLimiter.setDefaultLimit({ qMax(0.0, bytesPerSecond), qMax(0.0, messagesPerSecond) });
+}
+
+/*!
+    \overload
+
+    Sets the rate limit of the endpoint at \a host and \a port to
+    \a bytesPerSecond and \a messagesPerSecond, overriding the default
+    limit. A rate of 0 means no limit.
+*/
+void QCoapProtocol::setRateLimit(const QHostAddress &host, quint16 port,
+                                 double bytesPerSecond, double messagesPerSecond)
+{
+    Q_D(QCoapProtocol);
+    d->rateLimiter.setLimit(host, port,
+                            { qMax(0.0, bytesPerSecond), qMax(0.0, messagesPerSecond) });
+}
+
+/*!
+    Sets the PROBING_RATE to \a bytesPerSecond. It limits the average rate
+    of non-confirmable requests sent to an endpoint that has not answered
+    yet. The default is 1 byte per second, as in
+    \l{https://tools.ietf.org/html/rfc7252#section-4.8}{RFC 7252}; 0
+    disables it.
+
+    As the limit applies on average, a first request is always sent
+    immediately.
+
+    \sa probingRate(), setRateLimit()
+*/
+void QCoapProtocol::setProbingRate(double bytesPerSecond)
+{
+    Q_D(QCoapProtocol);
+    d->rateLimiter.setProbingRate(bytesPerSecond);
+}
+
 /*!
     Sets the max block size wanted to \a blockSize.
 
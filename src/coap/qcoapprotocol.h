@@ -40,8 +40,6 @@
 
 QT_BEGIN_NAMESPACE
 
-class QCoapInternalRequest;
-class QCoapInternalReply;
 class QCoapProtocolPrivate;
 class Q_COAP_EXPORT QCoapProtocol : public QObject
 {
@@ -53,6 +51,8 @@ public:
     int ackTimeout() const;
     double ackRandomFactor() const;
     int maxRetransmit() const;
+    int leisure() const;
+    int separateResponseTimeout() const;
     quint16 blockSize() const;
     int maxTransmitSpan() const;
     int maxTransmitWait() const;
@@ -60,6 +60,7 @@ public:
 
     int minTimeout() const;
     int maxTimeout() const;
+    double probingRate() const;
 
     static QVector<QCoapResource> resourcesFromCoreLinkList(const QHostAddress &sender, const QByteArray &data);
 
@@ -73,13 +74,16 @@ public Q_SLOTS:
     void setAckTimeout(int ackTimeout);
     void setAckRandomFactor(double ackRandomFactor);
     void setMaxRetransmit(int maxRetransmit);
+    void setLeisure(int leisure);
+    void setSeparateResponseTimeout(int timeout);
     void setBlockSize(quint16 blockSize);
+    void setRateLimit(double bytesPerSecond, double messagesPerSecond);
+    void setRateLimit(const QHostAddress &host, quint16 port, double bytesPerSecond,
+                      double messagesPerSecond);
+    void setProbingRate(double bytesPerSecond);
 
 private:
     Q_DECLARE_PRIVATE(QCoapProtocol)
-    Q_PRIVATE_SLOT(d_func(), void onRequestTimeout(QCoapInternalRequest*))
-    Q_PRIVATE_SLOT(d_func(), void onRequestMaxTransmissionSpanReached(QCoapInternalRequest*))
-    Q_PRIVATE_SLOT(d_func(), void sendRequest(QCoapInternalRequest*))
     Q_PRIVATE_SLOT(d_func(), void onFrameReceived(const QNetworkDatagram&))
     Q_PRIVATE_SLOT(d_func(), void onRequestAborted(const QCoapToken&))
     Q_PRIVATE_SLOT(d_func(), void onConnectionError(QAbstractSocket::SocketError))
@@ -31,11 +31,22 @@
 #define QCOAPPROTOCOL_P_H
 
 #include <QtCoap/qcoapprotocol.h>
+#include <private/qcoapclientstatistics_p.h>
+#include <private/qcoapratelimiter_p.h>
+#include <private/qcoapobjectpool_p.h>
+#include <private/qcoapinternalrequest_p.h>
+#include <private/qcoapinternalreply_p.h>
 #include <QtCore/qvector.h>
 #include <QtCore/qqueue.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qset.h>
+#include <QtCore/qfutureinterface.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtNetwork/qhostaddress.h>
 #include <private/qobject_p.h>
 
+#include <functional>
+
 //
 //  W A R N I N G
 //  -------------
@@ -49,14 +60,44 @@
 
 QT_BEGIN_NAMESPACE
 
+// Same type as QCoapClient::ResponseCallback
+typedef std::function<void(QtCoap::ResponseCode, const QCoapMessage &)> CoapResponseCallback;
+
 struct CoapExchangeData {
     QPointer<QCoapReply> userReply;
-    QSharedPointer<QCoapInternalRequest> request;
-    QVector<QSharedPointer<QCoapInternalReply> > replies;
+    bool discovery = false; // userReply is a QCoapDiscoveryReply, which reports each block
+    QCoapInternalRequest *request = nullptr; // in the request pool of the protocol
+    QVector<QCoapInternalReply> replies;
+    QByteArray frame;
+    QSet<QPair<QHostAddress, quint16> > responders; // of multicast requests
+    QSharedPointer<QFutureInterface<QCoapMessage> > future; // of asynchronous requests
+    QObject *callbackReceiver = nullptr; // in the thread of the context, outlives the protocol
+    QPointer<QObject> callbackContext;
+    CoapResponseCallback callback;
 };
 
 typedef QMap<QByteArray, CoapExchangeData> CoapExchangeMap;
 
+struct CoapThrottledFrame {
+    QByteArray frame;
+    QPointer<QCoapConnection> connection;
+    QString host;
+    quint16 port;
+    QCoapRequest::Priority priority;
+    bool nonConfirmable;
+    qint64 queuedAt; // in nanoseconds of the throttle clock
+    QCoapInternalRequest *request; // in the request pool, checked with token once held
+    QCoapToken token;
+};
+
+struct CoapRequestTimer {
+    qint64 deadline; // in nanoseconds of the timer clock
+    QCoapInternalRequest *request;
+    QCoapToken token;
+    quint64 id;
+    QCoapInternalRequest::TimerType type;
+};
+
 class Q_AUTOTEST_EXPORT QCoapProtocolPrivate : public QObjectPrivate
 {
 public:
@@ -67,13 +108,42 @@ public:
 
     QByteArray encode(QCoapInternalRequest *request);
     void onFrameReceived(const QNetworkDatagram &frame);
-    QCoapInternalReply *decode(const QNetworkDatagram &frame);
-
-    void sendAcknowledgment(QCoapInternalRequest *request);
-    void sendReset(QCoapInternalRequest *request);
+    void onEmptyAcknowledgmentReceived(const QNetworkDatagram &frame);
+    void onEndpointAnswered(const QNetworkDatagram &frame);
+    bool decode(const QNetworkDatagram &frame, QCoapInternalReply *reply);
+
+    void startExchange(const QCoapRequest &request, CoapExchangeData exchange,
+                       QCoapConnection *connection);
+    static bool isAwaited(const CoapExchangeData &exchange);
+    static void finishFuture(CoapExchangeData &exchange, bool canceled);
+    static void invokeCallback(CoapExchangeData &exchange, const QCoapInternalReply *reply);
+    void sendAcknowledgment(QCoapConnection *connection, const QNetworkDatagram &frame,
+                            quint16 messageId, const QByteArray &token);
+    void sendReset(QCoapConnection *connection, const QNetworkDatagram &frame, quint16 messageId);
+    void sendEmptyMessage(QCoapConnection *connection, QCoapMessage::MessageType type,
+                          quint16 messageId, const QByteArray &token,
+                          const QHostAddress &host, quint16 port);
     void sendRequest(QCoapInternalRequest *request);
+    void resendRequest(QCoapInternalRequest *request);
+    void transmit(QCoapInternalRequest *request, const QByteArray &frame);
+    void dispatch(CoapThrottledFrame frame);
+    void sendFrame(const CoapThrottledFrame &frame);
+    void releaseThrottledFrames();
+    void dropThrottledFrame(const QByteArray &frame);
+    void scheduleThrottledFrames(qint64 delay);
+    qint64 throttleTime();
+    void restartTransmission(QCoapInternalRequest *request);
+    void startRequestTimer(QCoapInternalRequest *request, QCoapInternalRequest::TimerType type,
+                           int timeout);
+    void processRequestTimers();
+    void scheduleRequestTimers();
+    void purgeRequestTimers();
+    qint64 timerTime();
 
     void onLastMessageReceived(QCoapInternalRequest *request);
+    void onMulticastReplyReceived(QCoapInternalRequest *request, QCoapInternalReply *reply,
+                                  const QNetworkDatagram &frame);
+    void onMulticastRequestExpired(QCoapInternalRequest *request);
     void onConnectionError(QAbstractSocket::SocketError error);
     void onRequestAborted(const QCoapToken &token);
     void onRequestTimeout(QCoapInternalRequest *request);
@@ -85,27 +155,41 @@ public:
     bool isMessageIdRegistered(quint16 id) const;
     bool isTokenRegistered(const QCoapToken &token) const;
     bool isRequestRegistered(const QCoapInternalRequest *request) const;
+    bool isReplyReceived(const QCoapInternalRequest *request, quint16 messageId) const;
 
     QCoapInternalRequest *requestForToken(const QCoapToken &token);
     QPointer<QCoapReply> userReplyForToken(const QCoapToken &token);
-    QVector<QSharedPointer<QCoapInternalReply> > repliesForToken(const QCoapToken &token);
+    QVector<QCoapInternalReply> repliesForToken(const QCoapToken &token);
     QCoapInternalReply *lastReplyForToken(const QCoapToken &token);
     QCoapInternalRequest *findRequestByMessageId(quint16 messageId);
     QCoapInternalRequest *findRequestByUserReply(const QCoapReply *reply);
 
     void registerExchange(const QCoapToken &token, QCoapReply *reply,
-                          QSharedPointer<QCoapInternalRequest> request);
-    bool addReply(const QCoapToken &token, QSharedPointer<QCoapInternalReply> reply);
+                          QCoapInternalRequest *request);
+    void registerExchange(const QCoapToken &token, const CoapExchangeData &exchange);
+    bool addReply(const QCoapToken &token, const QCoapInternalReply &reply);
     bool forgetExchange(const QCoapToken &token);
     bool forgetExchange(const QCoapInternalRequest *request);
     bool forgetExchangeReplies(const QCoapToken &token);
 
     CoapExchangeMap exchangeMap;
+    QCoapObjectPool<QCoapInternalRequest> requestPool;
+    QVector<CoapRequestTimer> requestTimers; // a heap, by deadline
+    QTimer *requestTimer = nullptr;
+    QElapsedTimer timerClock;
+    quint64 lastTimerId = 0;
+    QCoapStatisticsCounters statistics;
+    QCoapRateLimiter rateLimiter;
+    QHash<QCoapRateLimiter::EndpointKey, QVector<CoapThrottledFrame> > throttledFrames;
+    QTimer *throttleTimer = nullptr;
+    QElapsedTimer throttleClock;
     quint16 blockSize = 0;
 
     int maxRetransmit = 4;
     int ackTimeout = 2000;
     double ackRandomFactor = 1.5;
+    int leisure = 5000;
+    int separateResponseTimeout = 247000;
 
     Q_DECLARE_PUBLIC(QCoapProtocol)
 };
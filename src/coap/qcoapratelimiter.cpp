@@ -0,0 +1,201 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapratelimiter_p.h"
+#include <QtCore/qmath.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapRateLimiter
+    \brief The QCoapRateLimiter class holds the token buckets limiting the
+    traffic sent to each endpoint.
+
+    Each endpoint has a bucket of bytes and a bucket of messages, filled at
+    the rates of its limit, and holding up to one second of traffic. A frame
+    can be sent as soon as the buckets are not in debt, and its cost is then
+    taken from them, so that a frame larger than a bucket is not blocked
+    forever.
+
+    Non-confirmable messages sent to an endpoint that never answered are
+    also limited to the PROBING_RATE, as required by section
+    \l{https://tools.ietf.org/html/rfc7252#section-4.7}{'Congestion Control'}
+    of RFC 7252.
+
+    Endpoints are identified by their address and port. IPv4 addresses
+    mapped to IPv6 are the same endpoint as the IPv4 address.
+*/
+
+/*!
+    \internal
+
+    Sets the \a limit of the endpoints without a limit of their own. The
+    default is no limit.
+*/
+void QCoapRateLimiter::setDefaultLimit(const Limit &limit)
+{
+    defaultLimit = limit;
+}
+
+/*!
+    \internal
+
+    Sets the \a limit of the endpoint at \a host and \a port, overriding the
+    default limit.
+*/
+void QCoapRateLimiter::setLimit(const QHostAddress &host, quint16 port, const Limit &limit)
+{
+    limits.insert(endpointKey(host, port), limit);
+}
+
+/*!
+    \internal
+
+    Returns the limit of the endpoint at \a host and \a port.
+*/
+QCoapRateLimiter::Limit QCoapRateLimiter::limit(const QHostAddress &host, quint16 port) const
+{
+    return limits.value(endpointKey(host, port), defaultLimit);
+}
+
+/*!
+    \internal
+
+    Sets the PROBING_RATE to \a bytesPerSecond. The default is 1 byte per
+    second; 0 disables the probing limit.
+*/
+void QCoapRateLimiter::setProbingRate(double bytesPerSecond)
+{
+    probingBytesPerSecond = qMax(0.0, bytesPerSecond);
+}
+
+/*!
+    \internal
+
+    Records that the endpoint at \a host and \a port answered, so that the
+    PROBING_RATE no longer applies to it. Returns \c true if it had not
+    answered before.
+*/
+bool QCoapRateLimiter::setAnswered(const QHostAddress &host, quint16 port)
+{
+    Endpoint &endpoint = endpoints[endpointKey(host, port)];
+    if (endpoint.answered)
+        return false;
+
+    endpoint.answered = true;
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the endpoint at \a host and \a port answered.
+*/
+bool QCoapRateLimiter::isAnswered(const QHostAddress &host, quint16 port) const
+{
+    return endpoints.value(endpointKey(host, port)).answered;
+}
+
+/*!
+    \internal
+
+    Takes the cost of a frame of \a bytes from the buckets of the endpoint
+    at \a host and \a port, at the time \a now in nanoseconds, and returns
+    0 if the frame can be sent. Otherwise, nothing is taken, and the delay
+    in nanoseconds before the frame may be sent is returned.
+
+    The PROBING_RATE applies if the frame is \a nonConfirmable.
+*/
+qint64 QCoapRateLimiter::acquire(const QHostAddress &host, quint16 port, int bytes,
+                                 bool nonConfirmable, qint64 now)
+{
+    const EndpointKey key = endpointKey(host, port);
+    const Limit endpointLimit = limits.value(key, defaultLimit);
+    const bool probing = nonConfirmable && probingBytesPerSecond > 0;
+    if (endpointLimit.bytesPerSecond <= 0 && endpointLimit.messagesPerSecond <= 0 && !probing)
+        return 0;
+
+    Endpoint &endpoint = endpoints[key];
+    const bool probed = probing && !endpoint.answered;
+
+    qint64 wait = 0;
+    if (endpointLimit.bytesPerSecond > 0)
+        wait = qMax(wait, endpoint.bytes.delay(endpointLimit.bytesPerSecond, now));
+    if (endpointLimit.messagesPerSecond > 0)
+        wait = qMax(wait, endpoint.messages.delay(endpointLimit.messagesPerSecond, now));
+    if (probed)
+        wait = qMax(wait, endpoint.probing.delay(probingBytesPerSecond, now));
+    if (wait > 0)
+        return wait;
+
+    if (endpointLimit.bytesPerSecond > 0)
+        endpoint.bytes.tokens -= bytes;
+    if (endpointLimit.messagesPerSecond > 0)
+        endpoint.messages.tokens -= 1;
+    if (probed)
+        endpoint.probing.tokens -= bytes;
+    return 0;
+}
+
+/*!
+    \internal
+
+    Returns the key of the endpoint at \a host and \a port.
+*/
+QCoapRateLimiter::EndpointKey QCoapRateLimiter::endpointKey(const QHostAddress &host,
+                                                            quint16 port)
+{
+    bool isIPv4 = false;
+    const quint32 ipv4 = host.toIPv4Address(&isIPv4);
+    return qMakePair(isIPv4 ? QHostAddress(ipv4) : host, port);
+}
+
+/*!
+    \internal
+
+    Fills the bucket at \a rate per second up to the time \a now, and
+    returns the delay in nanoseconds before it is out of debt.
+*/
+qint64 QCoapRateLimiter::Bucket::delay(double rate, qint64 now)
+{
+    const double capacity = qMax(rate, 1.0);
+    if (updated < 0)
+        tokens = capacity;
+    else
+        tokens = qMin(capacity, tokens + rate * double(now - updated) / 1e9);
+    updated = now;
+
+    if (tokens >= 0)
+        return 0;
+    return qMax(qint64(1), qint64(qCeil(-tokens / rate * 1e9)));
+}
+
+QT_END_NAMESPACE
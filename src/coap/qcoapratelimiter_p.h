@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRATELIMITER_P_H
+#define QCOAPRATELIMITER_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpair.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapRateLimiter
+{
+public:
+    struct Limit
+    {
+        double bytesPerSecond = 0;      // 0 for no limit
+        double messagesPerSecond = 0;   // 0 for no limit
+    };
+
+    void setDefaultLimit(const Limit &limit);
+    void setLimit(const QHostAddress &host, quint16 port, const Limit &limit);
+    Limit limit(const QHostAddress &host, quint16 port) const;
+    void setProbingRate(double bytesPerSecond);
+    double probingRate() const { return probingBytesPerSecond; }
+
+    bool setAnswered(const QHostAddress &host, quint16 port);
+    bool isAnswered(const QHostAddress &host, quint16 port) const;
+
+    qint64 acquire(const QHostAddress &host, quint16 port, int bytes, bool nonConfirmable,
+                   qint64 now);
+
+    typedef QPair<QHostAddress, quint16> EndpointKey;
+    static EndpointKey endpointKey(const QHostAddress &host, quint16 port);
+
+private:
+    struct Bucket
+    {
+        double tokens = 0;
+        qint64 updated = -1;    // in nanoseconds, -1 while the bucket is full
+
+        qint64 delay(double rate, qint64 now);
+    };
+
+    struct Endpoint
+    {
+        Bucket bytes;
+        Bucket messages;
+        Bucket probing;
+        bool answered = false;
+    };
+
+    Limit defaultLimit;
+    QHash<EndpointKey, Limit> limits;
+    QHash<EndpointKey, Endpoint> endpoints;
+    double probingBytesPerSecond = 1;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRATELIMITER_P_H
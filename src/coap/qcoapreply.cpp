@@ -29,6 +29,7 @@
 
 #include "qcoapreply_p.h"
 #include "qcoapinternalreply_p.h"
+#include <qtcoap_tracepoints_p.h>
 #include <QtCore/qmath.h>
 
 QT_BEGIN_NAMESPACE
@@ -74,6 +75,18 @@ void QCoapReplyPrivate::_q_setObserveCancelled()
         emit q->finished(q);
 }
 
+/*!
+    \internal
+
+    Called when the block of the response starting at \a offset is received
+    from \a sender, with \a payload, before the whole response is merged.
+    The default implementation does nothing, the response is only set by
+    _q_setContent(). The protocol only calls it for discovery replies.
+*/
+void QCoapReplyPrivate::_q_setBlockReceived(const QHostAddress &, const QByteArray &, int)
+{
+}
+
 /*!
     \internal
 
@@ -88,6 +101,8 @@ void QCoapReplyPrivate::_q_setContent(const QHostAddress &, const QCoapMessage &
     if (q->isFinished())
         return;
 
+    Q_TRACE(QCoapReply_setContent, msg.token(), msg.messageId(), code);
+
     message = msg;
     responseCode = code;
     seekBuffer(0);
@@ -124,6 +139,8 @@ void QCoapReplyPrivate::_q_setFinished(QtCoap::Error newError)
     if (q->isFinished())
         return;
 
+    Q_TRACE(QCoapReply_setFinished, request.token(), request.messageId(), newError);
+
     isFinished = true;
     isRunning = false;
 
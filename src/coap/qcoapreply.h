@@ -81,6 +81,8 @@ protected:
     Q_PRIVATE_SLOT(d_func(), void _q_setRunning(const QCoapToken &, QCoapMessageId))
     Q_PRIVATE_SLOT(d_func(), void _q_setContent(const QHostAddress &host, const QCoapMessage &,
                                                 QtCoap::ResponseCode))
+    Q_PRIVATE_SLOT(d_func(), void _q_setBlockReceived(const QHostAddress &, const QByteArray &,
+                                                      int))
     Q_PRIVATE_SLOT(d_func(), void _q_setNotified())
     Q_PRIVATE_SLOT(d_func(), void _q_setObserveCancelled())
     Q_PRIVATE_SLOT(d_func(), void _q_setFinished(QtCoap::Error))
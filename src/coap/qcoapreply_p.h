@@ -54,6 +54,8 @@ public:
 
     void _q_setRunning(const QCoapToken &, QCoapMessageId);
     virtual void _q_setContent(const QHostAddress &sender, const QCoapMessage &, QtCoap::ResponseCode);
+    virtual void _q_setBlockReceived(const QHostAddress &sender, const QByteArray &payload,
+                                     int offset);
     void _q_setNotified();
     void _q_setObserveCancelled();
     void _q_setFinished(QtCoap::Error = QtCoap::NoError);
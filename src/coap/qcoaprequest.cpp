@@ -94,6 +94,19 @@ void QCoapRequestPrivate::setUrl(const QUrl &url)
     \sa QCoapClient, QCoapReply, QCoapDiscoveryReply
 */
 
+/*!
+    \enum QCoapRequest::Priority
+
+    Indicates the order in which the frames waiting to be written to the
+    socket are sent.
+
+    \value CriticalPriority    Sent before all the other requests, such as
+                                alarms.
+    \value NormalPriority      The default priority.
+    \value BulkPriority        Sent when no other request is waiting, such
+                                as bulk telemetry.
+*/
+
 /*!
     Constructs a QCoapRequest object with the target \a url,
     the proxy URL \a proxyUrl and the \a type of the message.
@@ -169,6 +182,18 @@ QtCoap::Method QCoapRequest::method() const
     return d->method;
 }
 
+/*!
+    Returns the priority of the request. Requests are sent with the
+    normal priority by default.
+
+    \sa setPriority()
+*/
+QCoapRequest::Priority QCoapRequest::priority() const
+{
+    Q_D(const QCoapRequest);
+    return d->priority;
+}
+
 /*!
     Returns true if the request is an observe request.
 
@@ -215,6 +240,22 @@ void QCoapRequest::setMethod(QtCoap::Method method)
     d->method = method;
 }
 
+/*!
+    Sets the priority of the request to the given \a priority.
+
+    When several frames are waiting to be written to the socket, the frames
+    of requests with a higher priority are written first, after the
+    acknowledgments and resets. Frames of the same priority are written in
+    the order they were sent.
+
+    \sa priority()
+*/
+void QCoapRequest::setPriority(Priority priority)
+{
+    Q_D(QCoapRequest);
+    d->priority = priority;
+}
+
 /*!
     Sets the observe to true to make an observe request.
 
@@ -33,7 +33,6 @@
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapnamespace.h>
 #include <QtCoap/qcoapmessage.h>
-#include <QtCoap/qcoapconnection.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qurl.h>
 
@@ -44,6 +43,12 @@ class QCoapRequestPrivate;
 class Q_COAP_EXPORT QCoapRequest : public QCoapMessage
 {
 public:
+    enum Priority {
+        CriticalPriority,
+        NormalPriority,
+        BulkPriority
+    };
+
     explicit QCoapRequest(const QUrl &url = QUrl(),
                  MessageType type = NonConfirmable,
                  const QUrl &proxyUrl = QUrl());
@@ -58,10 +63,12 @@ public:
     QUrl url() const;
     QUrl proxyUrl() const;
     QtCoap::Method method() const;
+    Priority priority() const;
     bool isObserve() const;
     void setUrl(const QUrl &url);
     void setProxyUrl(const QUrl &proxyUrl);
     void setMethod(QtCoap::Method method);
+    void setPriority(Priority priority);
     void enableObserve();
 
     bool isValid() const;
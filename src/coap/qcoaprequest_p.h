@@ -61,6 +61,7 @@ public:
     QUrl uri;
     QUrl proxyUri;
     QtCoap::Method method = QtCoap::Invalid;
+    QCoapRequest::Priority priority = QCoapRequest::NormalPriority;
 };
 
 QT_END_NAMESPACE
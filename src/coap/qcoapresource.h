@@ -31,6 +31,7 @@
 #define QCOAPRESOURCE_H
 
 #include <QtCoap/qcoapglobal.h>
+#include <QtCore/qmetatype.h>
 #include <QtCore/qshareddata.h>
 #include <QtNetwork/qhostaddress.h>
 
@@ -71,6 +72,7 @@ private:
 };
 
 Q_DECLARE_SHARED(QCoapResource)
+Q_DECLARE_METATYPE(QCoapResource)
 
 QT_END_NAMESPACE
 
@@ -47,23 +47,27 @@
 
 QT_BEGIN_NAMESPACE
 
+// The fields are ordered by size, so that the record has no padding
+// besides the one at its end. The 'rt' and 'if' values of parsed links
+// are interned by the parser and shared by every resource using them.
 class Q_AUTOTEST_EXPORT QCoapResourcePrivate : public QSharedData
 {
 public:
     QCoapResourcePrivate() {}
     QCoapResourcePrivate(const QCoapResourcePrivate &other)
-      : QSharedData(other), maximumSize(other.maximumSize), contentFormat(other.contentFormat)
-      , resourceType(other.resourceType), interface(other.interface), host(other.host)
-      , path(other.path), title(other.title), observable(other.observable) {}
+      : QSharedData(other), maximumSize(other.maximumSize), host(other.host)
+      , path(other.path), title(other.title), resourceType(other.resourceType)
+      , interface(other.interface), contentFormat(other.contentFormat)
+      , observable(other.observable) {}
     ~QCoapResourcePrivate() {}
 
     int maximumSize = -1;    // sz field
-    uint contentFormat = 0;  // ct field
-    QString resourceType;    // rt field
-    QString interface;       // if field
     QHostAddress host;
     QString path;
     QString title;
+    QString resourceType;    // rt field
+    QString interface;       // if field
+    uint contentFormat = 0;  // ct field
     bool observable = false; // obs field
 };
 
@@ -0,0 +1,967 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapresourcedirectory_p.h"
+#include "qcoaplinkformatparser_p.h"
+#include <QtCoap/qcoapclient.h>
+#include <QtCore/qurlquery.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Default freshness of a response without Max-Age option, in seconds.
+const qint64 DefaultMaxAge = 60;
+
+// Link-params of the lookup results that are not attributes of QCoapResource.
+enum LookupParameter {
+    AnchorParameter,
+    EndpointParameter,
+    BaseParameter,
+    LifetimeParameter
+};
+
+const QByteArrayList lookupParameterNames = { "anchor", "ep", "base", "lt" };
+
+} // namespace
+
+QCoapResourceDirectoryPrivate::QCoapResourceDirectoryPrivate(QCoapClient *client,
+                                                             const QUrl &url) :
+    client(client),
+    url(url)
+{
+    clock.start();
+}
+
+/*!
+    \class QCoapResourceDirectory
+    \brief The QCoapResourceDirectory class registers endpoints and looks
+    up resources in a CoAP Resource Directory.
+
+    \reentrant
+
+    A Resource Directory, described in
+    \l{https://tools.ietf.org/html/rfc9176}{RFC 9176}, holds the links of
+    the resources registered by the endpoints of a network. An endpoint
+    registers its resources with registerEndpoint(), and keeps its
+    registration alive by calling refreshRegistration() before its lifetime
+    elapses.
+
+    The results of lookupEndpoints() and lookupResources() are kept in a
+    local index, where resources() finds them by resource type, interface,
+    endpoint name and host without sending any request. A lookup repeated
+    while its results are fresh, according to their Max-Age, is answered
+    from the index. Otherwise each page of the results is revalidated with
+    its ETag, and only the pages that changed are transferred again.
+
+    Resources are kept while the results of a lookup list them. Those of an
+    endpoint found by lookupEndpoints() also expire with the lifetime of
+    its registration.
+
+    The registration and lookup interfaces of the directory are expected at
+    \c /rd, \c /rd-lookup/ep and \c /rd-lookup/res.
+
+    \sa QCoapClient, QCoapResource
+*/
+
+/*!
+    \fn void QCoapResourceDirectory::registered(const QUrl &registrationUrl)
+
+    This signal is emitted when the directory accepted the registration of
+    the endpoint, at \a registrationUrl.
+
+    \sa registerEndpoint()
+*/
+
+/*!
+    \fn void QCoapResourceDirectory::registrationRefreshed()
+
+    This signal is emitted when the directory extended the lifetime of the
+    registration.
+
+    \sa refreshRegistration()
+*/
+
+/*!
+    \fn void QCoapResourceDirectory::endpointsFound(const QStringList &endpointNames)
+
+    This signal is emitted when a lookup of endpoints is finished, with the
+    \a endpointNames found.
+
+    \sa lookupEndpoints()
+*/
+
+/*!
+    \fn void QCoapResourceDirectory::resourcesFound(const QVector<QCoapResource> &resources)
+
+    This signal is emitted when a lookup of resources is finished, with the
+    \a resources of the index matching the lookup.
+
+    \sa lookupResources(), resources()
+*/
+
+/*!
+    \fn void QCoapResourceDirectory::error(QtCoap::Error error)
+
+    This signal is emitted when a registration or a lookup fails, with the
+    \a error.
+*/
+
+/*!
+    Constructs a QCoapResourceDirectory object for the directory at \a url,
+    sending its requests with \a client, and sets \a parent as the parent
+    object.
+*/
+QCoapResourceDirectory::QCoapResourceDirectory(QCoapClient *client, const QUrl &url,
+                                               QObject *parent) :
+    QObject(*new QCoapResourceDirectoryPrivate(client, url), parent)
+{
+}
+
+/*!
+    Destroys the QCoapResourceDirectory object. The registration is not
+    removed from the directory, it expires with its lifetime.
+*/
+QCoapResourceDirectory::~QCoapResourceDirectory()
+{
+}
+
+/*!
+    Returns the URL of the directory.
+*/
+QUrl QCoapResourceDirectory::url() const
+{
+    Q_D(const QCoapResourceDirectory);
+    return d->url;
+}
+
+/*!
+    Returns the name of the endpoint registered with registerEndpoint().
+*/
+QString QCoapResourceDirectory::endpointName() const
+{
+    Q_D(const QCoapResourceDirectory);
+    return d->endpointName;
+}
+
+/*!
+    Returns the URL of the registration resource created by the directory,
+    or an empty URL if the endpoint is not registered.
+*/
+QUrl QCoapResourceDirectory::registrationUrl() const
+{
+    Q_D(const QCoapResourceDirectory);
+    return d->registrationUrl;
+}
+
+/*!
+    Returns \c true if the directory accepted the registration of the
+    endpoint.
+*/
+bool QCoapResourceDirectory::isRegistered() const
+{
+    Q_D(const QCoapResourceDirectory);
+    return !d->registrationUrl.isEmpty();
+}
+
+/*!
+    Returns the number of links requested per page of lookup results, or 0
+    if they are requested at once.
+
+    \sa setLookupPageSize()
+*/
+int QCoapResourceDirectory::lookupPageSize() const
+{
+    Q_D(const QCoapResourceDirectory);
+    return d->lookupPageSize;
+}
+
+/*!
+    Sets to \a count the number of links requested per page of lookup
+    results. A page that did not change is revalidated without being
+    transferred again, so that large results are best split in pages.
+    If \a count is 0, the results are requested at once.
+
+    The results already kept are dropped, as their pages no longer match.
+*/
+void QCoapResourceDirectory::setLookupPageSize(int count)
+{
+    Q_D(QCoapResourceDirectory);
+
+    count = qMax(0, count);
+    if (count == d->lookupPageSize)
+        return;
+
+    d->lookupPageSize = count;
+    for (const auto &lookup : qAsConst(d->lookups)) {
+        for (const auto &page : lookup.pages)
+            d->releasePage(page);
+    }
+    d->lookups.clear();
+}
+
+/*!
+    Registers the endpoint \a endpointName with its \a resources, for
+    \a lifetime seconds. The registered() signal is emitted once the
+    registration is accepted, otherwise the error() signal is emitted.
+
+    \sa refreshRegistration()
+*/
+void QCoapResourceDirectory::registerEndpoint(const QString &endpointName,
+                                              const QVector<QCoapResource> &resources,
+                                              int lifetime)
+{
+    Q_D(QCoapResourceDirectory);
+
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("ep"), endpointName);
+    query.addQueryItem(QStringLiteral("lt"), QString::number(lifetime));
+
+    QUrl registrationUrl = d->url;
+    registrationUrl.setPath(QStringLiteral("/rd"));
+    registrationUrl.setQuery(query);
+
+    QByteArray links;
+    for (const QCoapResource &resource : resources)
+        QCoapLinkFormatParser::appendLink(&links, resource.path().toUtf8(), resource);
+
+    QCoapRequest request(registrationUrl, QCoapMessage::Confirmable);
+    request.addOption(QCoapOption(QCoapOption::ContentFormat, 40)); // application/link-format
+
+    d->endpointName = endpointName;
+    d->registrationUrl.clear();
+    if (!d->send(QCoapResourceDirectoryPrivate::Registration, request, links))
+        emit error(QtCoap::UnknownError);
+}
+
+/*!
+    Extends the registration of the endpoint, for \a lifetime seconds if
+    it is positive, otherwise for the lifetime it was registered with.
+    Nothing is sent if the endpoint is not registered.
+
+    The registrationRefreshed() signal is emitted once the directory
+    extended the registration. If the registration already expired, the
+    error() signal is emitted and the endpoint must be registered again.
+*/
+void QCoapResourceDirectory::refreshRegistration(int lifetime)
+{
+    Q_D(QCoapResourceDirectory);
+
+    if (d->registrationUrl.isEmpty()) {
+        qWarning("QCoapResourceDirectory: Failed to refresh the registration of an "
+                 "unregistered endpoint.");
+        return;
+    }
+
+    QUrl refreshUrl = d->registrationUrl;
+    if (lifetime > 0)
+        refreshUrl.setQuery(QStringLiteral("lt=") + QString::number(lifetime));
+
+    if (!d->send(QCoapResourceDirectoryPrivate::RegistrationRefresh,
+                 QCoapRequest(refreshUrl, QCoapMessage::Confirmable))) {
+        emit error(QtCoap::UnknownError);
+    }
+}
+
+/*!
+    Looks up the endpoints registered in the directory, only
+    \a endpointName if not empty. The endpointsFound() signal is emitted
+    with the names found.
+
+    The host and the registration lifetime of the endpoints are kept, so
+    that the resources found afterwards on these hosts are indexed with
+    their endpoint name, and expire with the registration.
+*/
+void QCoapResourceDirectory::lookupEndpoints(const QString &endpointName)
+{
+    Q_D(QCoapResourceDirectory);
+    d->startLookup(QCoapResourceDirectoryPrivate::EndpointLookup, QString(), QString(),
+                   endpointName);
+}
+
+/*!
+    Looks up the resources registered in the directory, with the resource
+    type \a resourceType, the interface \a interface and the endpoint name
+    \a endpointName, for those that are not empty. The resourcesFound()
+    signal is emitted with the resources found.
+
+    The lookup is answered from the index while its results are fresh.
+*/
+void QCoapResourceDirectory::lookupResources(const QString &resourceType,
+                                             const QString &interface,
+                                             const QString &endpointName)
+{
+    Q_D(QCoapResourceDirectory);
+    d->startLookup(QCoapResourceDirectoryPrivate::ResourceLookup, resourceType, interface,
+                   endpointName);
+}
+
+/*!
+    Returns the names of the endpoints found by lookupEndpoints(), whose
+    registration did not expire.
+*/
+QStringList QCoapResourceDirectory::endpoints() const
+{
+    Q_D(const QCoapResourceDirectory);
+
+    const qint64 now = d->clock.elapsed();
+    QStringList names;
+    for (auto it = d->endpoints.cbegin(); it != d->endpoints.cend(); ++it) {
+        if (it->expiry > now)
+            names.append(it.key());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+/*!
+    Returns the resources of the index with the resource type
+    \a resourceType, the interface \a interface, the endpoint name
+    \a endpointName and the \a host, for those that are not empty. No
+    request is sent, expired resources are skipped.
+
+    \sa lookupResources()
+*/
+QVector<QCoapResource> QCoapResourceDirectory::resources(const QString &resourceType,
+                                                         const QString &interface,
+                                                         const QString &endpointName,
+                                                         const QHostAddress &host) const
+{
+    Q_D(const QCoapResourceDirectory);
+
+    // Candidates are taken from the index of the most selective criterion
+    enum { All, ByResourceType, ByInterface, ByEndpoint, ByHost } selected = All;
+    int selectedCount = 0;
+    const auto select = [&](decltype(selected) index, int count) {
+        if (selected == All || count < selectedCount) {
+            selected = index;
+            selectedCount = count;
+        }
+    };
+    if (!resourceType.isEmpty())
+        select(ByResourceType, d->entriesByResourceType.count(resourceType));
+    if (!interface.isEmpty())
+        select(ByInterface, d->entriesByInterface.count(interface));
+    if (!endpointName.isEmpty())
+        select(ByEndpoint, d->entriesByEndpoint.count(endpointName));
+    if (!host.isNull())
+        select(ByHost, d->entriesByHost.count(host));
+
+    QList<int> candidates;
+    switch (selected) {
+    case All:
+        for (int id = 0; id < d->entries.size(); ++id) {
+            if (d->entries.at(id).references > 0)
+                candidates.append(id);
+        }
+        break;
+    case ByResourceType:
+        candidates = d->entriesByResourceType.values(resourceType);
+        break;
+    case ByInterface:
+        candidates = d->entriesByInterface.values(interface);
+        break;
+    case ByEndpoint:
+        candidates = d->entriesByEndpoint.values(endpointName);
+        break;
+    case ByHost:
+        candidates = d->entriesByHost.values(host);
+        break;
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    QVector<QCoapResource> found;
+    for (int id : qAsConst(candidates)) {
+        const auto &entry = d->entries.at(id);
+        if (d->matches(entry, resourceType, interface, endpointName, host))
+            found.append(entry.resource);
+    }
+    return found;
+}
+
+/*!
+    \internal
+
+    Sends \a request for \a operation, with \a payload for registrations,
+    and returns \c true if it was sent. Its reply is deleted once it is
+    processed, for lookups once their page \a page of the lookup
+    \a lookupKey is processed.
+*/
+bool QCoapResourceDirectoryPrivate::send(Operation operation, const QCoapRequest &request,
+                                         const QByteArray &payload,
+                                         const QString &lookupKey, int page)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    QCoapReply *reply = (operation == Registration || operation == RegistrationRefresh)
+            ? client->post(request, payload) : client->get(request);
+    if (!reply)
+        return false;
+
+    pendingReplies.insert(reply, { operation, lookupKey, page });
+    q->connect(reply, SIGNAL(finished(QCoapReply*)), q, SLOT(_q_replyFinished(QCoapReply*)));
+    return true;
+}
+
+/*!
+    \internal
+
+    Processes the \a reply of the directory, according to the operation
+    it was sent for.
+*/
+void QCoapResourceDirectoryPrivate::_q_replyFinished(QCoapReply *reply)
+{
+    const auto it = pendingReplies.find(reply);
+    if (it == pendingReplies.end())
+        return;
+
+    const PendingReply pending = *it;
+    pendingReplies.erase(it);
+
+    switch (pending.operation) {
+    case Registration:
+        onRegistrationReply(reply);
+        break;
+    case RegistrationRefresh:
+        onRefreshReply(reply);
+        break;
+    case EndpointLookup:
+    case ResourceLookup:
+        onPageReply(pending.lookupKey, pending.page, reply);
+        break;
+    }
+    reply->deleteLater();
+}
+
+/*!
+    \internal
+
+    Emits the results of the lookup \a lookupKey, from the index.
+*/
+void QCoapResourceDirectoryPrivate::_q_reportLookup(const QString &lookupKey)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    const auto it = lookups.constFind(lookupKey);
+    if (it == lookups.cend())
+        return;
+
+    if (it->operation == EndpointLookup) {
+        QStringList names;
+        for (const Page &page : it->pages) {
+            for (const QString &name : page.endpoints) {
+                if (!isExpired(name))
+                    names.append(name);
+            }
+        }
+        emit q->endpointsFound(names);
+    } else {
+        emit q->resourcesFound(q->resources(it->resourceType, it->interface, it->endpointName));
+    }
+}
+
+/*!
+    \internal
+
+    Stores the registration resource created by the directory, from the
+    Location-Path options of \a reply.
+*/
+void QCoapResourceDirectoryPrivate::onRegistrationReply(QCoapReply *reply)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    const QCoapMessage message = reply->message();
+    QStringList segments;
+    if (reply->responseCode() == QtCoap::Created) {
+        for (const QCoapOption &option : message.options()) {
+            if (option.name() == QCoapOption::LocationPath)
+                segments.append(QString::fromUtf8(option.value()));
+        }
+    }
+
+    if (segments.isEmpty()) {
+        emit q->error(replyError(reply));
+        return;
+    }
+
+    registrationUrl = url;
+    registrationUrl.setPath(QLatin1Char('/') + segments.join(QLatin1Char('/')));
+    emit q->registered(registrationUrl);
+}
+
+/*!
+    \internal
+
+    Reports the result of a registration refresh. A registration that is
+    not found expired, and is forgotten.
+*/
+void QCoapResourceDirectoryPrivate::onRefreshReply(QCoapReply *reply)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    if (reply->responseCode() == QtCoap::Changed) {
+        emit q->registrationRefreshed();
+        return;
+    }
+
+    if (reply->responseCode() == QtCoap::NotFound)
+        registrationUrl.clear();
+    emit q->error(replyError(reply));
+}
+
+/*!
+    \internal
+
+    Starts the lookup \a operation filtered by \a resourceType,
+    \a interface and \a endpointName, or reports its results if they are
+    still fresh.
+*/
+void QCoapResourceDirectoryPrivate::startLookup(Operation operation,
+                                                const QString &resourceType,
+                                                const QString &interface,
+                                                const QString &endpointName)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    QUrlQuery query;
+    if (!resourceType.isEmpty())
+        query.addQueryItem(QStringLiteral("rt"), resourceType);
+    if (!interface.isEmpty())
+        query.addQueryItem(QStringLiteral("if"), interface);
+    if (!endpointName.isEmpty())
+        query.addQueryItem(QStringLiteral("ep"), endpointName);
+
+    const QString lookupKey = (operation == EndpointLookup ? QLatin1String("ep?")
+                                                           : QLatin1String("res?"))
+            + query.toString();
+
+    Lookup &lookup = lookups[lookupKey];
+    if (lookup.isRunning)
+        return; // Its results are reported once received
+
+    if (lookup.pages.isEmpty()) {
+        lookup.operation = operation;
+        lookup.resourceType = resourceType;
+        lookup.interface = interface;
+        lookup.endpointName = endpointName;
+        lookup.query = query.toString();
+    } else if (isFresh(lookup)) {
+        QMetaObject::invokeMethod(q, "_q_reportLookup", Qt::QueuedConnection,
+                                  Q_ARG(QString, lookupKey));
+        return;
+    }
+
+    lookup.isRunning = true;
+    requestPage(lookupKey, 0);
+}
+
+/*!
+    \internal
+
+    Requests the page \a page of the results of the lookup \a lookupKey,
+    or the first page after it that is no longer fresh. A page already
+    received is requested with its ETag, to be transferred again only if
+    it changed.
+*/
+void QCoapResourceDirectoryPrivate::requestPage(const QString &lookupKey, int page)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    Lookup &lookup = lookups[lookupKey];
+
+    const qint64 now = clock.elapsed();
+    while (page < lookup.pages.size() && lookup.pages.at(page).freshUntil > now) {
+        if (page == lookup.pages.size() - 1) {
+            finishLookup(lookupKey, page);
+            return;
+        }
+        ++page;
+    }
+
+    QUrlQuery query(lookup.query);
+    if (lookupPageSize > 0) {
+        query.addQueryItem(QStringLiteral("page"), QString::number(page));
+        query.addQueryItem(QStringLiteral("count"), QString::number(lookupPageSize));
+    }
+
+    QUrl lookupUrl = url;
+    lookupUrl.setPath(lookup.operation == EndpointLookup ? QStringLiteral("/rd-lookup/ep")
+                                                         : QStringLiteral("/rd-lookup/res"));
+    lookupUrl.setQuery(query);
+
+    QCoapRequest request(lookupUrl, QCoapMessage::Confirmable);
+    if (page < lookup.pages.size() && !lookup.pages.at(page).etag.isEmpty())
+        request.addOption(QCoapOption::Etag, lookup.pages.at(page).etag);
+
+    if (!send(lookup.operation, request, QByteArray(), lookupKey, page)) {
+        lookup.isRunning = false;
+        emit q->error(QtCoap::UnknownError);
+    }
+}
+
+/*!
+    \internal
+
+    Updates the page \a pageIndex of the lookup \a lookupKey with
+    \a reply, and requests the next page if the page is full.
+*/
+void QCoapResourceDirectoryPrivate::onPageReply(const QString &lookupKey, int pageIndex,
+                                                QCoapReply *reply)
+{
+    Q_Q(QCoapResourceDirectory);
+
+    // The lookup is dropped if the page size changed meanwhile
+    const auto it = lookups.find(lookupKey);
+    if (it == lookups.end())
+        return;
+    Lookup &lookup = *it;
+
+    const QCoapMessage message = reply->message();
+    const auto maxAge = message.findOption(QCoapOption::MaxAge);
+    const qint64 freshUntil = clock.elapsed()
+            + 1000 * (maxAge != message.options().cend() ? maxAge->valueToInt() : DefaultMaxAge);
+
+    if (reply->responseCode() == QtCoap::Valid && pageIndex < lookup.pages.size()) {
+        lookup.pages[pageIndex].freshUntil = freshUntil;
+    } else if (reply->responseCode() == QtCoap::Content) {
+        // The new page is indexed before the previous one is released, so
+        // that the resources still listed keep their entry.
+        Page page;
+        page.freshUntil = freshUntil;
+        parsePage(lookup, message, &page);
+        if (pageIndex < lookup.pages.size()) {
+            releasePage(lookup.pages.at(pageIndex));
+            lookup.pages[pageIndex] = page;
+        } else {
+            lookup.pages.append(page);
+            pageIndex = lookup.pages.size() - 1;
+        }
+    } else {
+        lookup.isRunning = false;
+        emit q->error(replyError(reply));
+        return;
+    }
+
+    if (lookupPageSize > 0 && lookup.pages.at(pageIndex).linkCount >= lookupPageSize)
+        requestPage(lookupKey, pageIndex + 1);
+    else
+        finishLookup(lookupKey, pageIndex);
+}
+
+/*!
+    \internal
+
+    Finishes the lookup \a lookupKey, whose last page is \a lastPage, and
+    reports its results. The pages after it are no longer in the results.
+*/
+void QCoapResourceDirectoryPrivate::finishLookup(const QString &lookupKey, int lastPage)
+{
+    Lookup &lookup = lookups[lookupKey];
+    while (lookup.pages.size() > lastPage + 1) {
+        releasePage(lookup.pages.last());
+        lookup.pages.removeLast();
+    }
+
+    lookup.isRunning = false;
+    _q_reportLookup(lookupKey);
+}
+
+/*!
+    \internal
+
+    Parses the links of \a message, a page of the results of \a lookup,
+    into \a page and adds them to the index.
+*/
+void QCoapResourceDirectoryPrivate::parsePage(const Lookup &lookup, const QCoapMessage &message,
+                                              Page *page)
+{
+    const auto etag = message.findOption(QCoapOption::Etag);
+    if (etag != message.options().cend())
+        page->etag = etag->value();
+
+    QVector<QStringList> values;
+    const QVector<QCoapResource> links =
+            QCoapLinkFormatParser::parse(QHostAddress(url.host()), message.payload(),
+                                         lookupParameterNames, &values);
+    page->linkCount = links.size();
+
+    const qint64 now = clock.elapsed();
+    for (int i = 0; i < links.size(); ++i) {
+        const QStringList &parameters = values.at(i);
+        const QString linkEndpoint = parameters.at(EndpointParameter);
+
+        if (lookup.operation == EndpointLookup) {
+            if (linkEndpoint.isEmpty())
+                continue;
+
+            bool ok = false;
+            int lifetime = parameters.at(LifetimeParameter).toInt(&ok);
+            if (!ok)
+                lifetime = QCoapResourceDirectory::DefaultLifetime;
+
+            const QUrl base(parameters.at(BaseParameter));
+            addEndpoint(linkEndpoint, QHostAddress(base.host()), now + 1000 * qint64(lifetime));
+            page->endpoints.append(linkEndpoint);
+            continue;
+        }
+
+        // Resource lookups return absolute links, or links relative to
+        // their anchor.
+        QCoapResource resource = links.at(i);
+        const QUrl target(resource.path());
+        const QUrl anchor(parameters.at(AnchorParameter));
+        if (!target.host().isEmpty()) {
+            resource.setHost(QHostAddress(target.host()));
+            resource.setPath(target.path());
+        } else if (!anchor.host().isEmpty()) {
+            resource.setHost(QHostAddress(anchor.host()));
+        }
+
+        QString endpointName = linkEndpoint;
+        if (endpointName.isEmpty())
+            endpointName = lookup.endpointName;
+        if (endpointName.isEmpty())
+            endpointName = endpointNames.value(resource.host());
+
+        page->entries.append(addEntry(resource, endpointName));
+    }
+}
+
+/*!
+    \internal
+
+    Releases the resources and endpoints listed by \a page.
+*/
+void QCoapResourceDirectoryPrivate::releasePage(const Page &page)
+{
+    for (int id : page.entries)
+        releaseEntry(id);
+    for (const QString &name : page.endpoints)
+        releaseEndpoint(name);
+}
+
+/*!
+    \internal
+
+    Adds \a resource of the endpoint \a endpointName to the index, or
+    updates its entry, and returns the entry.
+*/
+int QCoapResourceDirectoryPrivate::addEntry(const QCoapResource &resource,
+                                            const QString &endpointName)
+{
+    const auto key = qMakePair(resource.host(), resource.path());
+    int id = entryIds.value(key, -1);
+    if (id >= 0) {
+        unindexEntry(id);
+    } else if (!freeEntries.isEmpty()) {
+        id = freeEntries.takeLast();
+        entryIds.insert(key, id);
+    } else {
+        id = entries.size();
+        entries.append(Entry());
+        entryIds.insert(key, id);
+    }
+
+    Entry &entry = entries[id];
+    entry.resource = resource;
+    if (!endpointName.isEmpty())
+        entry.endpointName = endpointName;
+    ++entry.references;
+    indexEntry(id);
+    return id;
+}
+
+/*!
+    \internal
+
+    Releases the entry \a id, which is removed from the index once no page
+    lists it.
+*/
+void QCoapResourceDirectoryPrivate::releaseEntry(int id)
+{
+    Entry &entry = entries[id];
+    if (--entry.references > 0)
+        return;
+
+    unindexEntry(id);
+    entryIds.remove(qMakePair(entry.resource.host(), entry.resource.path()));
+    entry = Entry();
+    freeEntries.append(id);
+}
+
+/*!
+    \internal
+
+    Indexes the entry \a id by each of its resource types and interfaces,
+    its endpoint name and host.
+*/
+void QCoapResourceDirectoryPrivate::indexEntry(int id)
+{
+    const Entry &entry = entries.at(id);
+    for (const QString &resourceType : attributeValues(entry.resource.resourceType()))
+        entriesByResourceType.insert(resourceType, id);
+    for (const QString &interface : attributeValues(entry.resource.interface()))
+        entriesByInterface.insert(interface, id);
+    if (!entry.endpointName.isEmpty())
+        entriesByEndpoint.insert(entry.endpointName, id);
+    entriesByHost.insert(entry.resource.host(), id);
+}
+
+/*!
+    \internal
+
+    Removes the entry \a id from the index.
+*/
+void QCoapResourceDirectoryPrivate::unindexEntry(int id)
+{
+    const Entry &entry = entries.at(id);
+    for (const QString &resourceType : attributeValues(entry.resource.resourceType()))
+        entriesByResourceType.remove(resourceType, id);
+    for (const QString &interface : attributeValues(entry.resource.interface()))
+        entriesByInterface.remove(interface, id);
+    if (!entry.endpointName.isEmpty())
+        entriesByEndpoint.remove(entry.endpointName, id);
+    entriesByHost.remove(entry.resource.host(), id);
+}
+
+/*!
+    \internal
+
+    Adds the endpoint \a name registered from \a host, whose registration
+    expires at \a expiry.
+*/
+void QCoapResourceDirectoryPrivate::addEndpoint(const QString &name, const QHostAddress &host,
+                                                qint64 expiry)
+{
+    Endpoint &endpoint = endpoints[name];
+    if (endpoint.host != host && endpointNames.value(endpoint.host) == name)
+        endpointNames.remove(endpoint.host);
+
+    endpoint.host = host;
+    endpoint.expiry = expiry;
+    ++endpoint.references;
+    if (!host.isNull())
+        endpointNames.insert(host, name);
+}
+
+/*!
+    \internal
+
+    Releases the endpoint \a name, which is forgotten once no page lists
+    it.
+*/
+void QCoapResourceDirectoryPrivate::releaseEndpoint(const QString &name)
+{
+    const auto it = endpoints.find(name);
+    if (it == endpoints.end() || --it->references > 0)
+        return;
+
+    if (endpointNames.value(it->host) == name)
+        endpointNames.remove(it->host);
+    endpoints.erase(it);
+}
+
+/*!
+    \internal
+
+    Returns \c true if the registration of the endpoint \a endpointName,
+    found by an endpoint lookup, expired. The lifetime of the endpoints
+    that were not looked up is unknown.
+*/
+bool QCoapResourceDirectoryPrivate::isExpired(const QString &endpointName) const
+{
+    const auto it = endpoints.constFind(endpointName);
+    return it != endpoints.cend() && it->expiry <= clock.elapsed();
+}
+
+/*!
+    \internal
+
+    Returns \c true if all the pages of the results of \a lookup are still
+    fresh.
+*/
+bool QCoapResourceDirectoryPrivate::isFresh(const Lookup &lookup) const
+{
+    const qint64 now = clock.elapsed();
+    return std::all_of(lookup.pages.cbegin(), lookup.pages.cend(), [now](const Page &page) {
+        return page.freshUntil > now;
+    });
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a entry did not expire with the registration of
+    its endpoint, and matches the criteria that are not empty.
+*/
+bool QCoapResourceDirectoryPrivate::matches(const Entry &entry, const QString &resourceType,
+                                            const QString &interface,
+                                            const QString &endpointName,
+                                            const QHostAddress &host) const
+{
+    return entry.references > 0
+            && (entry.endpointName.isEmpty() || !isExpired(entry.endpointName))
+            && (resourceType.isEmpty()
+                || attributeValues(entry.resource.resourceType()).contains(resourceType))
+            && (interface.isEmpty()
+                || attributeValues(entry.resource.interface()).contains(interface))
+            && (endpointName.isEmpty() || entry.endpointName == endpointName)
+            && (host.isNull() || entry.resource.host() == host);
+}
+
+/*!
+    \internal
+
+    Returns the values of the link attribute \a attribute, which is a list
+    separated by spaces, like \c rt="temperature sensor".
+*/
+QStringList QCoapResourceDirectoryPrivate::attributeValues(const QString &attribute)
+{
+    return attribute.split(QLatin1Char(' '), QString::SkipEmptyParts);
+}
+
+/*!
+    \internal
+
+    Returns the error reported by \a reply, a failed request.
+*/
+QtCoap::Error QCoapResourceDirectoryPrivate::replyError(const QCoapReply *reply)
+{
+    if (reply->errorReceived() != QtCoap::NoError)
+        return reply->errorReceived();
+    if (QtCoap::isError(reply->responseCode()))
+        return QtCoap::responseCodeError(reply->responseCode());
+    return QtCoap::UnknownError;
+}
+
+QT_END_NAMESPACE
+
+#include "moc_qcoapresourcedirectory.cpp"
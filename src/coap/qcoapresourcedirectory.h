@@ -0,0 +1,95 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRESOURCEDIRECTORY_H
+#define QCOAPRESOURCEDIRECTORY_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapnamespace.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapClient;
+class QCoapReply;
+
+class QCoapResourceDirectoryPrivate;
+class Q_COAP_EXPORT QCoapResourceDirectory : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QCoapResourceDirectory(QCoapClient *client, const QUrl &url,
+                                    QObject *parent = nullptr);
+    ~QCoapResourceDirectory();
+
+    QUrl url() const;
+    QString endpointName() const;
+    QUrl registrationUrl() const;
+    bool isRegistered() const;
+
+    int lookupPageSize() const;
+    void setLookupPageSize(int count);
+
+    void registerEndpoint(const QString &endpointName, const QVector<QCoapResource> &resources,
+                          int lifetime = DefaultLifetime);
+    void refreshRegistration(int lifetime = -1);
+
+    void lookupEndpoints(const QString &endpointName = QString());
+    void lookupResources(const QString &resourceType = QString(),
+                         const QString &interface = QString(),
+                         const QString &endpointName = QString());
+
+    QStringList endpoints() const;
+    QVector<QCoapResource> resources(const QString &resourceType = QString(),
+                                     const QString &interface = QString(),
+                                     const QString &endpointName = QString(),
+                                     const QHostAddress &host = QHostAddress()) const;
+
+    static const int DefaultLifetime = 90000;
+
+Q_SIGNALS:
+    void registered(const QUrl &registrationUrl);
+    void registrationRefreshed();
+    void endpointsFound(const QStringList &endpointNames);
+    void resourcesFound(const QVector<QCoapResource> &resources);
+    void error(QtCoap::Error error);
+
+private:
+    Q_DECLARE_PRIVATE(QCoapResourceDirectory)
+    Q_PRIVATE_SLOT(d_func(), void _q_replyFinished(QCoapReply *))
+    Q_PRIVATE_SLOT(d_func(), void _q_reportLookup(const QString &))
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRESOURCEDIRECTORY_H
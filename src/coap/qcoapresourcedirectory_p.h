@@ -0,0 +1,166 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRESOURCEDIRECTORY_P_H
+#define QCOAPRESOURCEDIRECTORY_P_H
+
+#include <QtCoap/qcoapresourcedirectory.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvector.h>
+#include <private/qobject_p.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapResourceDirectoryPrivate : public QObjectPrivate
+{
+public:
+    QCoapResourceDirectoryPrivate(QCoapClient *client, const QUrl &url);
+
+    enum Operation {
+        Registration,
+        RegistrationRefresh,
+        EndpointLookup,
+        ResourceLookup
+    };
+
+    // A resource found by a lookup, indexed by its attributes.
+    struct Entry
+    {
+        QCoapResource resource;
+        QString endpointName;
+        int references = 0;     // pages listing the resource, free if 0
+    };
+
+    // An endpoint found by a lookup, expiring with its registration.
+    struct Endpoint
+    {
+        QHostAddress host;
+        qint64 expiry = 0;
+        int references = 0;
+    };
+
+    // A page of the results of a lookup, revalidated with its ETag.
+    struct Page
+    {
+        QByteArray etag;
+        qint64 freshUntil = 0;
+        int linkCount = 0;
+        QVector<int> entries;       // for resource lookups
+        QStringList endpoints;      // for endpoint lookups
+    };
+
+    struct Lookup
+    {
+        Operation operation = ResourceLookup;
+        QString resourceType;
+        QString interface;
+        QString endpointName;
+        QString query;
+        QVector<Page> pages;
+        bool isRunning = false;
+    };
+
+    struct PendingReply
+    {
+        Operation operation;
+        QString lookupKey;
+        int page;
+    };
+
+    void _q_replyFinished(QCoapReply *reply);
+    void _q_reportLookup(const QString &lookupKey);
+
+    bool send(Operation operation, const QCoapRequest &request,
+              const QByteArray &payload = QByteArray(), const QString &lookupKey = QString(),
+              int page = 0);
+    void startLookup(Operation operation, const QString &resourceType, const QString &interface,
+                     const QString &endpointName);
+    void requestPage(const QString &lookupKey, int page);
+    void onRegistrationReply(QCoapReply *reply);
+    void onRefreshReply(QCoapReply *reply);
+    void onPageReply(const QString &lookupKey, int pageIndex, QCoapReply *reply);
+    void finishLookup(const QString &lookupKey, int lastPage);
+    void parsePage(const Lookup &lookup, const QCoapMessage &message, Page *page);
+    void releasePage(const Page &page);
+
+    int addEntry(const QCoapResource &resource, const QString &endpointName);
+    void releaseEntry(int id);
+    void indexEntry(int id);
+    void unindexEntry(int id);
+    void addEndpoint(const QString &name, const QHostAddress &host, qint64 expiry);
+    void releaseEndpoint(const QString &name);
+    bool isExpired(const QString &endpointName) const;
+    bool isFresh(const Lookup &lookup) const;
+    bool matches(const Entry &entry, const QString &resourceType, const QString &interface,
+                 const QString &endpointName, const QHostAddress &host) const;
+
+    static QStringList attributeValues(const QString &attribute);
+    static QtCoap::Error replyError(const QCoapReply *reply);
+
+    QCoapClient *client = nullptr;
+    QUrl url;
+    QString endpointName;
+    QUrl registrationUrl;
+    int lookupPageSize = 0;
+
+    QHash<QCoapReply *, PendingReply> pendingReplies;
+    QHash<QString, Lookup> lookups;
+
+    QVector<Entry> entries;
+    QVector<int> freeEntries;
+    QHash<QPair<QHostAddress, QString>, int> entryIds;
+    QMultiHash<QString, int> entriesByResourceType;
+    QMultiHash<QString, int> entriesByInterface;
+    QMultiHash<QString, int> entriesByEndpoint;
+    QMultiHash<QHostAddress, int> entriesByHost;
+
+    QHash<QString, Endpoint> endpoints;
+    QHash<QHostAddress, QString> endpointNames;
+    QElapsedTimer clock;
+
+    Q_DECLARE_PUBLIC(QCoapResourceDirectory)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRESOURCEDIRECTORY_P_H
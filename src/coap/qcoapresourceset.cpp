@@ -0,0 +1,250 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapresourceset_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCoapResourceSet
+    \brief The QCoapResourceSet class holds discovered resources, indexed
+    by their attributes.
+
+    \reentrant
+
+    The resources are indexed as they are appended, by resource type,
+    interface, content format, host and observability. A query returns the
+    matching resources in the order they were appended, without going
+    through the other resources.
+
+    Resource types and interfaces are indexed by each of their values, so
+    that a resource with the \c rt="temperature sensor" attribute is
+    returned by resourcesWithType() for both \c temperature and \c sensor.
+
+    \sa QCoapDiscoveryReply, QCoapResource
+*/
+
+/*!
+    Constructs an empty QCoapResourceSet.
+*/
+QCoapResourceSet::QCoapResourceSet() :
+    d(new QCoapResourceSetPrivate)
+{
+}
+
+/*!
+    Constructs a QCoapResourceSet holding \a resources.
+*/
+QCoapResourceSet::QCoapResourceSet(const QVector<QCoapResource> &resources) :
+    d(new QCoapResourceSetPrivate)
+{
+    append(resources);
+}
+
+/*!
+    Copy constructs a new QCoapResourceSet.
+*/
+QCoapResourceSet::QCoapResourceSet(const QCoapResourceSet &other) :
+    d(other.d)
+{
+}
+
+/*!
+    Destroys the QCoapResourceSet.
+*/
+QCoapResourceSet::~QCoapResourceSet()
+{
+}
+
+/*!
+    Assignment operator.
+*/
+QCoapResourceSet &QCoapResourceSet::operator =(const QCoapResourceSet &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Swap function for Q_DECLARE_SHARED
+*/
+void QCoapResourceSet::swap(QCoapResourceSet &other) Q_DECL_NOTHROW
+{
+    d.swap(other.d);
+}
+
+/*!
+    Returns the number of resources in the set.
+*/
+int QCoapResourceSet::size() const
+{
+    return d->resources.size();
+}
+
+/*!
+    Returns \c true if the set holds no resource.
+*/
+bool QCoapResourceSet::isEmpty() const
+{
+    return d->resources.isEmpty();
+}
+
+/*!
+    Returns all the resources of the set, in the order they were appended.
+*/
+QVector<QCoapResource> QCoapResourceSet::resources() const
+{
+    return d->resources;
+}
+
+/*!
+    Appends \a resource to the set, and indexes it.
+*/
+void QCoapResourceSet::append(const QCoapResource &resource)
+{
+    d->resources.append(resource);
+    d->index(d->resources.size() - 1);
+}
+
+/*!
+    \overload
+
+    Appends \a resources to the set, and indexes them.
+*/
+void QCoapResourceSet::append(const QVector<QCoapResource> &resources)
+{
+    d->resources.reserve(d->resources.size() + resources.size());
+    for (const QCoapResource &resource : resources)
+        append(resource);
+}
+
+/*!
+    Removes all the resources from the set.
+*/
+void QCoapResourceSet::clear()
+{
+    d = new QCoapResourceSetPrivate;
+}
+
+/*!
+    Returns the resources having \a resourceType among the values of their
+    resource type.
+*/
+QVector<QCoapResource> QCoapResourceSet::resourcesWithType(const QString &resourceType) const
+{
+    return d->resourcesAt(d->byResourceType.value(resourceType));
+}
+
+/*!
+    Returns the resources having \a interface among the values of their
+    interface.
+*/
+QVector<QCoapResource> QCoapResourceSet::resourcesWithInterface(const QString &interface) const
+{
+    return d->resourcesAt(d->byInterface.value(interface));
+}
+
+/*!
+    Returns the resources with the content format \a contentFormat.
+*/
+QVector<QCoapResource> QCoapResourceSet::resourcesWithContentFormat(uint contentFormat) const
+{
+    return d->resourcesAt(d->byContentFormat.value(contentFormat));
+}
+
+/*!
+    Returns the resources of \a host.
+*/
+QVector<QCoapResource> QCoapResourceSet::resourcesOnHost(const QHostAddress &host) const
+{
+    return d->resourcesAt(d->byHost.value(host));
+}
+
+/*!
+    Returns the observable resources.
+*/
+QVector<QCoapResource> QCoapResourceSet::observableResources() const
+{
+    return d->resourcesAt(d->observable);
+}
+
+/*!
+    \internal
+
+    Indexes the resource at \a position by its attributes.
+*/
+void QCoapResourceSetPrivate::index(int position)
+{
+    const QCoapResource &resource = resources.at(position);
+
+    const auto resourceTypes = resource.resourceType().splitRef(QLatin1Char(' '),
+                                                                QString::SkipEmptyParts);
+    for (const QStringRef &resourceType : resourceTypes)
+        insert(&byResourceType, resourceType.toString(), position);
+
+    const auto interfaces = resource.interface().splitRef(QLatin1Char(' '),
+                                                          QString::SkipEmptyParts);
+    for (const QStringRef &interface : interfaces)
+        insert(&byInterface, interface.toString(), position);
+
+    insert(&byContentFormat, resource.contentFormat(), position);
+    insert(&byHost, resource.host(), position);
+    if (resource.observable())
+        observable.append(position);
+}
+
+/*!
+    \internal
+
+    Returns the resources at \a positions.
+*/
+QVector<QCoapResource> QCoapResourceSetPrivate::resourcesAt(const QVector<int> &positions) const
+{
+    QVector<QCoapResource> found;
+    found.reserve(positions.size());
+    for (int position : positions)
+        found.append(resources.at(position));
+    return found;
+}
+
+/*!
+    \internal
+
+    Adds \a position to the positions of \a key in \a index, once.
+*/
+template <typename Key>
+void QCoapResourceSetPrivate::insert(QHash<Key, QVector<int>> *index, const Key &key,
+                                     int position)
+{
+    QVector<int> &positions = (*index)[key];
+    if (positions.isEmpty() || positions.last() != position)
+        positions.append(position);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,77 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRESOURCESET_H
+#define QCOAPRESOURCESET_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapResourceSetPrivate;
+
+class Q_COAP_EXPORT QCoapResourceSet
+{
+public:
+    QCoapResourceSet();
+    QCoapResourceSet(const QVector<QCoapResource> &resources);
+    QCoapResourceSet(const QCoapResourceSet &other);
+    ~QCoapResourceSet();
+    QCoapResourceSet &operator =(const QCoapResourceSet &other);
+
+    void swap(QCoapResourceSet &other) Q_DECL_NOTHROW;
+
+    int size() const;
+    bool isEmpty() const;
+    QVector<QCoapResource> resources() const;
+
+    void append(const QCoapResource &resource);
+    void append(const QVector<QCoapResource> &resources);
+    void clear();
+
+    QVector<QCoapResource> resourcesWithType(const QString &resourceType) const;
+    QVector<QCoapResource> resourcesWithInterface(const QString &interface) const;
+    QVector<QCoapResource> resourcesWithContentFormat(uint contentFormat) const;
+    QVector<QCoapResource> resourcesOnHost(const QHostAddress &host) const;
+    QVector<QCoapResource> observableResources() const;
+
+private:
+    QSharedDataPointer<QCoapResourceSetPrivate> d;
+};
+
+Q_DECLARE_SHARED(QCoapResourceSet)
+Q_DECLARE_METATYPE(QCoapResourceSet)
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRESOURCESET_H
@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRESOURCESET_P_H
+#define QCOAPRESOURCESET_P_H
+
+#include <QtCoap/qcoapresourceset.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qshareddata.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapResourceSetPrivate : public QSharedData
+{
+public:
+    void index(int position);
+    QVector<QCoapResource> resourcesAt(const QVector<int> &positions) const;
+
+    template <typename Key>
+    static void insert(QHash<Key, QVector<int>> *index, const Key &key, int position);
+
+    QVector<QCoapResource> resources;
+
+    // Positions in resources, in order
+    QHash<QString, QVector<int>> byResourceType;
+    QHash<QString, QVector<int>> byInterface;
+    QHash<uint, QVector<int>> byContentFormat;
+    QHash<QHostAddress, QVector<int>> byHost;
+    QVector<int> observable;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRESOURCESET_P_H
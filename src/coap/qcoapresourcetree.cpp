@@ -0,0 +1,402 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapresourcetree_p.h"
+#include "qcoaplinkformatparser_p.h"
+
+#include <algorithm>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+int compareSegment(const QByteArray &segment, const char *other, int otherSize)
+{
+    const int size = segment.size();
+    const int result = memcmp(segment.constData(), other,
+                              static_cast<size_t>(qMin(size, otherSize)));
+    return result != 0 ? result : size - otherSize;
+}
+
+} // namespace
+
+/*!
+    \internal
+
+    \class QCoapResourceTree
+    \brief The QCoapResourceTree class routes the requests received by a
+    QCoapServer to the handlers of its resources.
+
+    Resources are stored in a trie with one node per path segment, and each
+    node has a table of handlers indexed by method. Requests are routed on
+    their Uri-Path options directly, comparing bytes without building a
+    path string, so the cost of routing depends on the depth of the path
+    and not on the number of resources.
+
+    A \c{*} segment is a wildcard matching any single segment. Literal
+    segments are preferred over the wildcard when both match.
+
+    \sa QCoapServer
+*/
+
+/*!
+    \internal
+
+    Constructs an empty tree, with the root node only.
+*/
+QCoapResourceTree::QCoapResourceTree()
+{
+    nodes.append(Node());
+}
+
+/*!
+    \internal
+
+    Returns \c true if a handler is registered on the node.
+*/
+bool QCoapResourceTree::Node::isResource() const
+{
+    return std::any_of(std::begin(handlers), std::end(handlers),
+                       [](const Handler &handler) { return bool(handler); });
+}
+
+/*!
+    \internal
+
+    Returns \c true if the node can be removed from the tree.
+*/
+bool QCoapResourceTree::Node::isEmpty() const
+{
+    return !isResource() && children.isEmpty() && wildcardChild < 0;
+}
+
+/*!
+    \internal
+
+    Registers \a handler for the \a method requests on \a path. The
+    handler of QtCoap::Invalid is used for the methods that have no handler
+    of their own.
+*/
+void QCoapResourceTree::insert(const QString &path, QtCoap::Method method,
+                               const Handler &handler)
+{
+    Q_ASSERT(method >= QtCoap::Invalid && method <= QtCoap::Delete);
+    Q_STATIC_ASSERT(QtCoap::Invalid == AnyMethod);
+
+    const int index = findOrCreateNode(path);
+    nodes[index].handlers[method] = handler;
+}
+
+/*!
+    \internal
+
+    Sets the link attributes listed in /.well-known/core for the resource
+    at the path of \a description.
+*/
+void QCoapResourceTree::setDescription(const QCoapResource &description)
+{
+    const int index = findOrCreateNode(description.path());
+    nodes[index].description = description;
+}
+
+/*!
+    \internal
+
+    Removes the handlers and the description of the resource at \a path,
+    and the nodes that are no longer needed.
+*/
+void QCoapResourceTree::remove(const QString &path)
+{
+    int index = findNode(path);
+    if (index < 0)
+        return;
+
+    std::fill(std::begin(nodes[index].handlers), std::end(nodes[index].handlers), Handler());
+    nodes[index].description = QCoapResource();
+
+    while (index != 0 && nodes.at(index).isEmpty()) {
+        const int parent = nodes.at(index).parent;
+        Node &parentNode = nodes[parent];
+        if (parentNode.wildcardChild == index)
+            parentNode.wildcardChild = -1;
+        else
+            parentNode.children.removeOne(index);
+
+        releaseNode(index);
+        index = parent;
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if a handler is registered at \a path.
+*/
+bool QCoapResourceTree::contains(const QString &path) const
+{
+    const int index = findNode(path);
+    return index >= 0 && nodes.at(index).isResource();
+}
+
+/*!
+    \internal
+
+    Returns the handler for the \a method request with the Uri-Path
+    \a options. If there is none, returns an empty handler and sets
+    \a responseCode to QtCoap::NotFound or QtCoap::MethodNotAllowed.
+    If \a observable is not null, it is set to \c true if the resource is
+    described as observable.
+
+    The handler is returned by value, so that it can safely modify the tree.
+*/
+QCoapResourceTree::Handler QCoapResourceTree::route(const QCoapOptionList &options,
+                                                    QtCoap::Method method,
+                                                    QtCoap::ResponseCode *responseCode,
+                                                    bool *observable) const
+{
+    // Options are sorted by number, Uri-Path options are contiguous
+    const auto begin = std::lower_bound(options.cbegin(), options.cend(), QCoapOption::UriPath,
+                                        [](const QCoapOption &option,
+                                           QCoapOption::OptionName name) {
+        return option.name() < name;
+    });
+    auto end = begin;
+    while (end != options.cend() && end->name() == QCoapOption::UriPath)
+        ++end;
+
+    const int index = match(0, begin, end);
+    if (index < 0) {
+        *responseCode = QtCoap::NotFound;
+        return Handler();
+    }
+
+    const Node &node = nodes.at(index);
+    if (observable)
+        *observable = node.description.observable();
+    if (method > QtCoap::Invalid && int(method) < MethodCount && node.handlers[method])
+        return node.handlers[method];
+    if (node.handlers[AnyMethod])
+        return node.handlers[AnyMethod];
+
+    *responseCode = QtCoap::MethodNotAllowed;
+    return Handler();
+}
+
+/*!
+    \internal
+
+    Returns the list of resources in the CoRE Link Format, with the link
+    attributes set by setDescription(). Paths with a wildcard are not
+    listed, and the text/plain content format, 0, is omitted. Only the
+    links matching the filter \a query, like \c rt=temperature, are listed.
+
+    See \l{https://tools.ietf.org/html/rfc6690}{RFC 6690}.
+*/
+QByteArray QCoapResourceTree::coreLinkFormat(const QString &query) const
+{
+    QByteArray path;
+    QByteArray links;
+    appendLinks(0, &path, &links, query);
+    return links;
+}
+
+/*!
+    \internal
+
+    Returns the node of \a path, or -1 if there is none.
+*/
+int QCoapResourceTree::findNode(const QString &path) const
+{
+    int index = 0;
+    for (const QByteArray &segment : segments(path)) {
+        const Node &node = nodes.at(index);
+        index = segment == "*" ? node.wildcardChild
+                               : findChild(node, segment.constData(), segment.size());
+        if (index < 0)
+            return -1;
+    }
+    return index;
+}
+
+/*!
+    \internal
+
+    Returns the node of \a path, creating it and its parents if needed.
+*/
+int QCoapResourceTree::findOrCreateNode(const QString &path)
+{
+    int index = 0;
+    for (const QByteArray &segment : segments(path)) {
+        if (segment == "*") {
+            if (nodes.at(index).wildcardChild < 0) {
+                const int child = createNode(index, segment);
+                nodes[index].wildcardChild = child;
+            }
+            index = nodes.at(index).wildcardChild;
+            continue;
+        }
+
+        int child = findChild(nodes.at(index), segment.constData(), segment.size());
+        if (child < 0) {
+            child = createNode(index, segment);
+            QVector<int> &children = nodes[index].children;
+            const auto position = std::lower_bound(children.begin(), children.end(), segment,
+                                                   [this](int node, const QByteArray &value) {
+                return compareSegment(nodes.at(node).segment,
+                                      value.constData(), value.size()) < 0;
+            });
+            children.insert(position, child);
+        }
+        index = child;
+    }
+    return index;
+}
+
+/*!
+    \internal
+
+    Returns the child of \a node with the \a segment of \a size bytes, or
+    -1 if there is none. Children are sorted, so a binary search is used.
+*/
+int QCoapResourceTree::findChild(const Node &node, const char *segment, int size) const
+{
+    const auto it = std::lower_bound(node.children.cbegin(), node.children.cend(), segment,
+                                     [this, size](int child, const char *value) {
+        return compareSegment(nodes.at(child).segment, value, size) < 0;
+    });
+
+    if (it != node.children.cend()
+            && compareSegment(nodes.at(*it).segment, segment, size) == 0) {
+        return *it;
+    }
+    return -1;
+}
+
+/*!
+    \internal
+
+    Creates a node for \a segment, child of \a parent, reusing a released
+    node if any. Returns its index.
+*/
+int QCoapResourceTree::createNode(int parent, const QByteArray &segment)
+{
+    int index;
+    if (!freeNodes.isEmpty()) {
+        index = freeNodes.takeLast();
+    } else {
+        index = nodes.size();
+        nodes.append(Node());
+    }
+
+    nodes[index].segment = segment;
+    nodes[index].parent = parent;
+    return index;
+}
+
+/*!
+    \internal
+
+    Releases the node at \a index, that is no longer linked to the tree.
+*/
+void QCoapResourceTree::releaseNode(int index)
+{
+    nodes[index] = Node();
+    freeNodes.append(index);
+}
+
+/*!
+    \internal
+
+    Returns the resource node matching the path \a segment to \a end
+    below \a node, or -1 if there is none. When a literal segment leads to
+    no resource, the wildcard is tried.
+*/
+int QCoapResourceTree::match(int node, QCoapOptionList::const_iterator segment,
+                             QCoapOptionList::const_iterator end) const
+{
+    const Node &current = nodes.at(node);
+    if (segment == end)
+        return current.isResource() ? node : -1;
+
+    const int child = findChild(current, segment->constData(), segment->length());
+    if (child >= 0) {
+        const int found = match(child, segment + 1, end);
+        if (found >= 0)
+            return found;
+    }
+
+    if (current.wildcardChild >= 0)
+        return match(current.wildcardChild, segment + 1, end);
+
+    return -1;
+}
+
+/*!
+    \internal
+
+    Appends the links of \a node and its children to \a links, \a path
+    being the path of \a node, if they match \a query.
+*/
+void QCoapResourceTree::appendLinks(int node, QByteArray *path, QByteArray *links,
+                                    const QString &query) const
+{
+    const Node &current = nodes.at(node);
+    if (current.isResource()) {
+        const QByteArray target = path->isEmpty() ? QByteArray("/") : *path;
+        if (query.isEmpty()
+                || QCoapLinkFormatParser::matchesQuery(QString::fromUtf8(target),
+                                                       current.description, query)) {
+            QCoapLinkFormatParser::appendLink(links, target, current.description);
+        }
+    }
+
+    for (int child : current.children) {
+        const int size = path->size();
+        path->append('/').append(nodes.at(child).segment);
+        appendLinks(child, path, links, query);
+        path->truncate(size);
+    }
+}
+
+/*!
+    \internal
+
+    Returns the non-empty segments of \a path, in UTF-8 like the Uri-Path
+    options.
+*/
+QVector<QByteArray> QCoapResourceTree::segments(const QString &path)
+{
+    QVector<QByteArray> result;
+    for (const QStringRef &segment : path.splitRef(QLatin1Char('/'), QString::SkipEmptyParts))
+        result.append(segment.toUtf8());
+    return result;
+}
+
+QT_END_NAMESPACE
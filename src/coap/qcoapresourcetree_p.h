@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRESOURCETREE_P_H
+#define QCOAPRESOURCETREE_P_H
+
+#include <QtCoap/qcoapserver.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCore/qvector.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapResourceTree
+{
+public:
+    typedef QCoapServer::RequestHandler Handler;
+
+    QCoapResourceTree();
+
+    void insert(const QString &path, QtCoap::Method method, const Handler &handler);
+    void setDescription(const QCoapResource &description);
+    void remove(const QString &path);
+    bool contains(const QString &path) const;
+
+    Handler route(const QCoapOptionList &options, QtCoap::Method method,
+                  QtCoap::ResponseCode *responseCode, bool *observable = nullptr) const;
+    QByteArray coreLinkFormat(const QString &query = QString()) const;
+
+private:
+    // Index 0 holds the handler for any method
+    enum { AnyMethod = 0, MethodCount = QtCoap::Delete + 1 };
+
+    struct Node
+    {
+        QByteArray segment;
+        int parent = -1;
+        QVector<int> children;  // sorted by segment, without the wildcard
+        int wildcardChild = -1;
+        Handler handlers[MethodCount];
+        QCoapResource description;
+
+        bool isResource() const;
+        bool isEmpty() const;
+    };
+
+    int findNode(const QString &path) const;
+    int findOrCreateNode(const QString &path);
+    int findChild(const Node &node, const char *segment, int size) const;
+    int createNode(int parent, const QByteArray &segment);
+    void releaseNode(int index);
+    int match(int node, QCoapOptionList::const_iterator segment,
+              QCoapOptionList::const_iterator end) const;
+    void appendLinks(int node, QByteArray *path, QByteArray *links, const QString &query) const;
+
+    static QVector<QByteArray> segments(const QString &path);
+
+    QVector<Node> nodes;
+    QVector<int> freeNodes;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRESOURCETREE_P_H
@@ -0,0 +1,1000 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapserver_p.h"
+#include "qcoapconnection_p.h"
+#include "qcoapinternalmessage_p.h"
+#include <QtCore/qurl.h>
+#include <QtNetwork/qnetworkdatagram.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// EXCHANGE_LIFETIME with the default transmission parameters, see section
+// 4.8.2 of RFC 7252. It is also used for non-confirmable requests, whose
+// NON_LIFETIME is shorter, so that expiration times are queued in order.
+const qint64 exchangeLifetime = 247000;
+
+// Bounds the memory used to detect duplicated requests under heavy load
+const int maxRecentExchanges = 0x10000;
+
+// MAX_RETRANSMIT of the default transmission parameters, see section 4.8
+// of RFC 7252
+const int maxRetransmit = 4;
+
+// Non-confirmable notifications sent to an observer before a confirmable
+// one checks that it is still interested, see section 4.5 of RFC 7641
+const int maxNonConfirmableNotifications = 16;
+
+// Response codes of the 2.xx class
+bool isSuccess(QtCoap::ResponseCode code)
+{
+    return (static_cast<int>(code) >> 5) == 2;
+}
+
+QCoapConnectionPrivate *connectionPrivate(QCoapConnection *connection)
+{
+    return static_cast<QCoapConnectionPrivate *>(QObjectPrivate::get(connection));
+}
+
+} // namespace
+
+QCoapServerPrivate::QCoapServerPrivate(QCoapConnection *connection) :
+    connection(connection)
+{
+    messageIdCounter = static_cast<QCoapMessageId>(QtCoap::randomGenerator.bounded(0x10000));
+    clock.start();
+}
+
+/*!
+    \internal
+
+    Returns \a path with a leading slash and without empty segments, as
+    observed resources are registered.
+*/
+QString QCoapServerPrivate::normalizedPath(const QString &path)
+{
+    QString normalized;
+    for (const QStringRef &segment : path.splitRef(QLatin1Char('/'), QString::SkipEmptyParts))
+        normalized.append(QLatin1Char('/')).append(segment);
+    return normalized.isEmpty() ? QStringLiteral("/") : normalized;
+}
+
+/*!
+    \internal
+
+    Returns the normalized path of \a request, from its Uri-Path options.
+*/
+QString QCoapServerPrivate::requestPath(const QCoapRequest &request)
+{
+    QString path;
+    for (const QCoapOption &option : request.options()) {
+        if (option.name() == QCoapOption::UriPath && option.length() > 0)
+            path.append(QLatin1Char('/')).append(QString::fromUtf8(option.value()));
+    }
+    return path.isEmpty() ? QStringLiteral("/") : path;
+}
+
+/*!
+    \class QCoapServer
+    \brief The QCoapServer class allows the application to serve CoAP
+    resources.
+
+    \reentrant
+
+    The application registers a handler for each resource path with
+    addResource(), then calls listen(). Each request received on a
+    registered path is passed to its handler, which fills the response
+    message and returns the response code:
+    \code
+        QCoapServer *server = new QCoapServer(this);
+        server->addResource("/temperature", [](const QCoapRequest &request,
+                                               QCoapMessage *response) {
+            if (request.method() != QtCoap::Get)
+                return QtCoap::MethodNotAllowed;
+            response->setPayload(QByteArray::number(readTemperature()));
+            return QtCoap::Content;
+        });
+        server->listen();
+    \endcode
+
+    Confirmable requests are answered with a piggybacked response in the
+    acknowledgment, and non-confirmable requests with a non-confirmable
+    response. Duplicated requests are answered with the response of the
+    original request, without calling the handler again. Requests on an
+    unknown path are answered with \l{QtCoap::NotFound}{NotFound}, and
+    requests carrying an unrecognized critical option with
+    \l{QtCoap::BadOption}{BadOption}.
+
+    Resources described as observable with setResourceDescription() can
+    be observed by the clients, as defined in
+    \l{https://tools.ietf.org/html/rfc7641}{RFC 7641}. When the state of
+    such a resource changes, notifyObservers() calls its GET handler once
+    and sends the response to each of its observers:
+    \code
+        QCoapResource description;
+        description.setPath("/temperature");
+        description.setObservable(true);
+        server->setResourceDescription(description);
+        ...
+        server->notifyObservers("/temperature");
+    \endcode
+
+    The handlers are called in the thread of the QCoapServer object.
+
+    \sa QCoapClient
+*/
+
+/*!
+    \typedef QCoapServer::RequestHandler
+
+    Synonym for \c{std::function<QtCoap::ResponseCode(const QCoapRequest &,
+    QCoapMessage *)>}. The handler receives the request, fills the payload
+    and the options of the response, and returns its response code.
+*/
+
+/*!
+    \fn void QCoapServer::error(QAbstractSocket::SocketError error)
+
+    This signal is emitted when the socket of the server reports an
+    \a error, for instance when it cannot be bound by listen().
+*/
+
+/*!
+    Constructs a QCoapServer object and sets \a parent as the parent object.
+*/
+QCoapServer::QCoapServer(QObject *parent) :
+    QCoapServer(new QCoapConnection, parent)
+{
+}
+
+/*!
+    \internal
+
+    Constructs a QCoapServer object using \a connection for the transfer of
+    frames, and sets \a parent as the parent object. The server takes
+    ownership of the \a connection.
+*/
+QCoapServer::QCoapServer(QCoapConnection *connection, QObject *parent) :
+    QObject(*new QCoapServerPrivate(connection), parent)
+{
+    connection->setParent(this);
+    connect(connection, SIGNAL(readyRead(const QNetworkDatagram &)),
+            this, SLOT(_q_onFrameReceived(const QNetworkDatagram &)));
+    connect(connection, &QCoapConnection::error, this, &QCoapServer::error);
+
+    Q_D(QCoapServer);
+    d->retransmissionTimer = new QTimer(this);
+    d->retransmissionTimer->setSingleShot(true);
+    connect(d->retransmissionTimer, SIGNAL(timeout()), this, SLOT(_q_retransmitNotifications()));
+
+    addResource(QStringLiteral("/.well-known/core"), QtCoap::Get,
+                [d](const QCoapRequest &request, QCoapMessage *response) {
+        response->addOption(QCoapOption(QCoapOption::ContentFormat, 40)); // application/link-format
+        const QString query = request.url().query(QUrl::FullyDecoded);
+        response->setPayload(d->resources.coreLinkFormat(query));
+        return QtCoap::Content;
+    });
+}
+
+/*!
+    Destroys the QCoapServer object and closes its socket.
+*/
+QCoapServer::~QCoapServer()
+{
+    close();
+}
+
+/*!
+    Starts listening for requests on \a address and \a port. Returns
+    \c true on success, otherwise emits error() and returns \c false.
+
+    Use port 0 to let the system pick a free port, and serverPort() to
+    retrieve it.
+
+    \sa close(), isListening()
+*/
+bool QCoapServer::listen(const QHostAddress &address, quint16 port)
+{
+    Q_D(QCoapServer);
+
+    if (isListening()) {
+        qWarning() << "QCoapServer::listen() called when already listening";
+        return false;
+    }
+
+    QCoapConnectionPrivate *connection = connectionPrivate(d->connection);
+    connection->bindAddress = address;
+    connection->bindPort = port;
+    connection->bindMode = QAbstractSocket::DefaultForPlatform;
+    connection->bindSocket();
+
+    return isListening();
+}
+
+/*!
+    Stops listening for requests.
+
+    \sa listen()
+*/
+void QCoapServer::close()
+{
+    Q_D(QCoapServer);
+
+    if (!isListening())
+        return;
+
+    d->connection->socket()->close();
+    connectionPrivate(d->connection)->setState(QCoapConnection::Unconnected);
+    d->recentExchanges.clear();
+    d->recentExchangesExpiry.clear();
+
+    d->observers.clear();
+    d->observersByResource.clear();
+    d->observersByEndpoint.clear();
+    d->observersByMessageId.clear();
+    d->pendingNotifications.clear();
+    d->notificationDeadlines.clear();
+    d->retransmissionTimer->stop();
+}
+
+/*!
+    Returns \c true if the server is listening for requests.
+*/
+bool QCoapServer::isListening() const
+{
+    Q_D(const QCoapServer);
+    return d->connection->state() == QCoapConnection::Bound;
+}
+
+/*!
+    Returns the address the server is listening on, or QHostAddress::Null
+    if it is not listening.
+*/
+QHostAddress QCoapServer::serverAddress() const
+{
+    Q_D(const QCoapServer);
+    return isListening() ? d->connection->socket()->localAddress() : QHostAddress();
+}
+
+/*!
+    Returns the port the server is listening on, or 0 if it is not
+    listening.
+*/
+quint16 QCoapServer::serverPort() const
+{
+    Q_D(const QCoapServer);
+    return isListening() ? d->connection->socket()->localPort() : 0;
+}
+
+/*!
+    Registers \a handler for the requests on \a path, for the methods that
+    have no handler of their own. Any handler previously registered for
+    them is replaced.
+
+    Empty segments of \a path are ignored. A \c{*} segment matches any
+    single segment, for instance \c{/sensors/*/value}. Paths without
+    wildcard are preferred when both match.
+
+    \sa removeResource()
+*/
+void QCoapServer::addResource(const QString &path, const RequestHandler &handler)
+{
+    addResource(path, QtCoap::Invalid, handler);
+}
+
+/*!
+    \overload
+
+    Registers \a handler for the \a method requests on \a path. Requests
+    with a method that has no handler on an existing path are answered
+    with \l{QtCoap::MethodNotAllowed}{MethodNotAllowed}.
+*/
+void QCoapServer::addResource(const QString &path, QtCoap::Method method,
+                              const RequestHandler &handler)
+{
+    Q_D(QCoapServer);
+
+    if (!handler) {
+        qWarning() << "QCoapServer: Cannot add resource" << path << "without handler";
+        return;
+    }
+    if (method < QtCoap::Invalid || method > QtCoap::Delete) {
+        qWarning() << "QCoapServer: Cannot add resource" << path << "for method" << method;
+        return;
+    }
+
+    d->resources.insert(path, method, handler);
+}
+
+/*!
+    Sets the link attributes listed for the resource at the path of
+    \a description in \c{/.well-known/core}: its title, resource type,
+    interface, maximum size, content format and observability.
+
+    The server answers GET requests on \c{/.well-known/core} with the
+    list of its resources, unless a handler is registered for that path.
+*/
+void QCoapServer::setResourceDescription(const QCoapResource &description)
+{
+    Q_D(QCoapServer);
+    d->resources.setDescription(description);
+}
+
+/*!
+    Removes the handlers and the description of the resource at \a path.
+    Its observers are forgotten, without being notified.
+
+    \sa addResource()
+*/
+void QCoapServer::removeResource(const QString &path)
+{
+    Q_D(QCoapServer);
+    d->resources.remove(path);
+    d->removeObservers(d->normalizedPath(path));
+}
+
+/*!
+    Returns \c true if a handler is registered for \a path.
+*/
+bool QCoapServer::hasResource(const QString &path) const
+{
+    Q_D(const QCoapServer);
+    return d->resources.contains(path);
+}
+
+/*!
+    Notifies the observers of the resource at \a path that its state
+    changed, and returns the number of observers notified.
+
+    The GET handler of the resource is called once, and its response is
+    encoded once. Only the header and the token of the frame are patched
+    for each observer. Notifications are non-confirmable, except for the
+    observers registered with a confirmable request, and regularly for the
+    others to check that they are still interested. The observers that
+    reject a notification, or do not acknowledge a confirmable one, are
+    removed.
+
+    If the handler does not return a success response code, or if the
+    resource is no longer observable, the response is sent to the
+    observers and all of them are removed. See section 4.2 of RFC 7641.
+
+    \sa observerCount(), setResourceDescription()
+*/
+int QCoapServer::notifyObservers(const QString &path)
+{
+    Q_D(QCoapServer);
+
+    const QString resourcePath = d->normalizedPath(path);
+    const auto it = d->observersByResource.constFind(resourcePath);
+    if (it == d->observersByResource.constEnd() || !isListening())
+        return 0;
+
+    QCoapRequest request;
+    request.setType(QCoapMessage::NonConfirmable);
+    request.setMethod(QtCoap::Get);
+    for (const QStringRef &segment : resourcePath.splitRef(QLatin1Char('/'),
+                                                           QString::SkipEmptyParts)) {
+        request.addOption(QCoapOption::UriPath, segment.toUtf8());
+    }
+
+    // The handler may change the observers
+    const QVector<quint32> observerIds = it.value();
+
+    QCoapMessage notification;
+    bool observable = false;
+    const QtCoap::ResponseCode responseCode =
+            d->processRequest(&request, &notification, &observable);
+    const bool succeeded = observable && isSuccess(responseCode);
+    if (succeeded)
+        notification.addOption(QCoapOption(QCoapOption::Observe, d->nextObserveSequence()));
+
+    // Encoded without token and message ID, patched for each observer
+    const QByteArray encoded = QCoapInternalMessagePrivate::encodeFrame(notification,
+                                                                        responseCode);
+    int count = 0;
+    for (quint32 observerId : observerIds) {
+        const auto observer = d->observers.find(observerId);
+        if (observer == d->observers.end())
+            continue;
+        d->sendNotification(observerId, observer.value(), encoded);
+        ++count;
+    }
+
+    if (!succeeded)
+        d->removeObservers(resourcePath);
+
+    return count;
+}
+
+/*!
+    Returns the number of observers of the resource at \a path.
+
+    \sa notifyObservers()
+*/
+int QCoapServer::observerCount(const QString &path) const
+{
+    Q_D(const QCoapServer);
+    return d->observersByResource.value(d->normalizedPath(path)).size();
+}
+
+/*!
+    \internal
+
+    Decodes the received \a frame and answers it.
+
+    Unknown versions are silently ignored. Malformed confirmable messages,
+    and confirmable messages that are not requests, are rejected with a
+    Reset message. See sections 3 and 4.2 of RFC 7252.
+*/
+void QCoapServerPrivate::_q_onFrameReceived(const QNetworkDatagram &frame)
+{
+    const QByteArray data = frame.data();
+    if (data.isEmpty() || ((static_cast<quint8>(data.at(0)) >> 6) & 0x03) != 1)
+        return;
+
+    const bool isConfirmable =
+            ((static_cast<quint8>(data.at(0)) >> 4) & 0x03) == QCoapMessage::Confirmable;
+
+    QCoapRequest request;
+    quint8 code = 0;
+    bool hasUnrecognizedCriticalOption = false;
+    if (!QCoapInternalMessagePrivate::decodeFrame(data, &request, &code,
+                                                  &hasUnrecognizedCriticalOption)) {
+        if (isConfirmable && data.size() >= 4) {
+            sendReset(frame, static_cast<QCoapMessageId>(
+                          (static_cast<quint8>(data.at(2)) << 8) | static_cast<quint8>(data.at(3))));
+        }
+        return;
+    }
+
+    // Acknowledgments and resets answer notifications
+    if (request.type() == QCoapMessage::Acknowledgment) {
+        onAcknowledgment(frame, request.messageId());
+        return;
+    }
+    if (request.type() == QCoapMessage::Reset) {
+        onReset(frame, request.messageId());
+        return;
+    }
+
+    // Empty confirmable messages are CoAP pings, and the request codes are
+    // in the 0.01 to 0.31 range.
+    if (code == QtCoap::EmptyMessage || code > 0x1F) {
+        if (isConfirmable)
+            sendReset(frame, request.messageId());
+        return;
+    }
+
+    handleRequest(frame, &request, code, hasUnrecognizedCriticalOption);
+}
+
+/*!
+    \internal
+
+    Answers the \a request decoded from \a frame, with \a code as its
+    method code.
+*/
+void QCoapServerPrivate::handleRequest(const QNetworkDatagram &frame, QCoapRequest *request,
+                                       quint8 code, bool hasUnrecognizedCriticalOption)
+{
+    const bool isConfirmable = request->type() == QCoapMessage::Confirmable;
+    const QCoapServerExchangeKey key = { frame.senderAddress(),
+                                         static_cast<quint16>(frame.senderPort()),
+                                         request->messageId() };
+
+    // Duplicated requests are answered with the original response, without
+    // processing them again. See section 4.5 of RFC 7252.
+    if (const RecentExchange *exchange = findRecentExchange(key)) {
+        if (isConfirmable && !exchange->response.isEmpty()) {
+            connectionPrivate(connection)->writeToSocket(exchange->response, key.address,
+                                                         key.port);
+        }
+        return;
+    }
+
+    request->setMethod(code <= QtCoap::Delete ? static_cast<QtCoap::Method>(code)
+                                              : QtCoap::Other);
+
+    QCoapMessage response;
+    bool observable = false;
+    const QtCoap::ResponseCode responseCode = hasUnrecognizedCriticalOption
+            ? QtCoap::BadOption : processRequest(request, &response, &observable);
+
+    if (request->method() == QtCoap::Get && request->hasOption(QCoapOption::Observe)) {
+        updateObservation(key.address, key.port, *request,
+                          observable && isSuccess(responseCode), &response);
+    }
+
+    if (isConfirmable) {
+        // Piggybacked response
+        response.setType(QCoapMessage::Acknowledgment);
+        response.setMessageId(request->messageId());
+    } else {
+        response.setType(QCoapMessage::NonConfirmable);
+        response.setMessageId(generateMessageId());
+    }
+    response.setToken(request->token());
+
+    const QByteArray responseFrame =
+            QCoapInternalMessagePrivate::encodeFrame(response, responseCode);
+
+    // Duplicates of non-confirmable requests are only ignored
+    addRecentExchange(key, isConfirmable ? responseFrame : QByteArray());
+    connectionPrivate(connection)->writeToSocket(responseFrame, key.address, key.port);
+}
+
+/*!
+    \internal
+
+    Routes \a request on its Uri-Path options, sets its URL from its Uri
+    options, and passes it to the handler of its path to fill \a response.
+    Returns the response code. If \a observable is not null, it is set to
+    \c true if the resource is described as observable.
+*/
+QtCoap::ResponseCode QCoapServerPrivate::processRequest(QCoapRequest *request,
+                                                        QCoapMessage *response,
+                                                        bool *observable)
+{
+    QtCoap::ResponseCode responseCode = QtCoap::InvalidCode;
+    const QCoapServer::RequestHandler handler =
+            resources.route(request->options(), request->method(), &responseCode, observable);
+    if (!handler)
+        return responseCode;
+
+    QString path;
+    QString query;
+    QString host;
+    int port = connection->socket()->localPort();
+    for (const QCoapOption &option : request->options()) {
+        switch (option.name()) {
+        case QCoapOption::UriHost:
+            host = QString::fromUtf8(option.value());
+            break;
+        case QCoapOption::UriPort:
+            port = static_cast<int>(option.valueToInt());
+            break;
+        case QCoapOption::UriPath:
+            if (!path.isEmpty())
+                path.append(QLatin1Char('/'));
+            path.append(QString::fromUtf8(option.value()));
+            break;
+        case QCoapOption::UriQuery:
+            if (!query.isEmpty())
+                query.append(QLatin1Char('&'));
+            query.append(QString::fromUtf8(option.value()));
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (host.isEmpty())
+        host = connection->socket()->localAddress().toString();
+
+    QUrl url;
+    url.setScheme(QStringLiteral("coap"));
+    url.setHost(host);
+    url.setPort(port);
+    url.setPath(QLatin1Char('/') + path, QUrl::DecodedMode);
+    if (!query.isEmpty())
+        url.setQuery(query, QUrl::DecodedMode);
+
+    request->setUrl(url);
+    return handler(*request, response);
+}
+
+/*!
+    \internal
+
+    Sends a Reset message with \a messageId to the sender of \a frame.
+*/
+void QCoapServerPrivate::sendReset(const QNetworkDatagram &frame, QCoapMessageId messageId)
+{
+    QCoapMessage reset;
+    reset.setType(QCoapMessage::Reset);
+    reset.setMessageId(messageId);
+
+    connectionPrivate(connection)->writeToSocket(
+                QCoapInternalMessagePrivate::encodeFrame(reset, QtCoap::EmptyMessage),
+                frame.senderAddress(), static_cast<quint16>(frame.senderPort()));
+}
+
+/*!
+    \internal
+
+    Returns the message ID of the next non-confirmable response. Message IDs
+    are generated by incrementing a counter, started at a random value.
+    See section 4.4 of RFC 7252. Like for the client, 0 is not used.
+*/
+QCoapMessageId QCoapServerPrivate::generateMessageId()
+{
+    if (++messageIdCounter == 0)
+        ++messageIdCounter;
+    return messageIdCounter;
+}
+
+/*!
+    \internal
+
+    Returns the exchange recently received with \a key, or \c nullptr if
+    there is none.
+*/
+const QCoapServerPrivate::RecentExchange *
+QCoapServerPrivate::findRecentExchange(const QCoapServerExchangeKey &key) const
+{
+    const auto it = recentExchanges.constFind(key);
+    if (it == recentExchanges.constEnd() || it->expiry <= clock.elapsed())
+        return nullptr;
+
+    return &it.value();
+}
+
+/*!
+    \internal
+
+    Remembers the \a response sent for the exchange \a key until its
+    lifetime is over, or until too many exchanges are remembered.
+*/
+void QCoapServerPrivate::addRecentExchange(const QCoapServerExchangeKey &key,
+                                           const QByteArray &response)
+{
+    const qint64 now = clock.elapsed();
+    removeExpiredExchanges(now);
+
+    const qint64 expiry = now + exchangeLifetime;
+    recentExchanges.insert(key, { response, expiry });
+    recentExchangesExpiry.enqueue(qMakePair(expiry, key));
+}
+
+/*!
+    \internal
+
+    Removes the exchanges whose lifetime is over at \a now, and the oldest
+    ones if too many exchanges are remembered. The expiration queue is
+    ordered by time, so only its head is checked.
+*/
+void QCoapServerPrivate::removeExpiredExchanges(qint64 now)
+{
+    while (!recentExchangesExpiry.isEmpty()
+           && (recentExchangesExpiry.head().first <= now
+               || recentExchangesExpiry.size() >= maxRecentExchanges)) {
+        const auto expired = recentExchangesExpiry.dequeue();
+
+        // The key may have been added again since, with a later expiry
+        const auto it = recentExchanges.find(expired.second);
+        if (it != recentExchanges.end() && it->expiry == expired.first)
+            recentExchanges.erase(it);
+    }
+}
+
+/*!
+    \internal
+
+    Registers the sender of the GET \a request, at \a address and \a port,
+    as an observer of the requested resource if its Observe option is 0 and
+    \a canObserve is \c true, and adds the Observe option to \a response.
+    Otherwise removes the registration of the sender for this resource.
+    See sections 3.6 and 4.1 of RFC 7641.
+*/
+void QCoapServerPrivate::updateObservation(const QHostAddress &address, quint16 port,
+                                           const QCoapRequest &request, bool canObserve,
+                                           QCoapMessage *response)
+{
+    const QString path = requestPath(request);
+    const bool isRegistration = request.option(QCoapOption::Observe).valueToInt() == 0;
+
+    if (isRegistration && canObserve) {
+        registerObserver(address, port, request.token(), path,
+                         request.type() == QCoapMessage::Confirmable);
+        response->addOption(QCoapOption(QCoapOption::Observe, nextObserveSequence()));
+        return;
+    }
+
+    const auto it = observersByEndpoint.constFind({ address, port, path });
+    if (it == observersByEndpoint.constEnd())
+        return;
+
+    // A deregistration only applies to the observation with the same token
+    if (isRegistration || observers.value(*it).token == request.token())
+        removeObserver(*it);
+}
+
+/*!
+    \internal
+
+    Adds the endpoint at \a address and \a port to the observers of the
+    resource at \a path, and returns its identifier. Notifications carry
+    \a token, and are confirmable if \a confirmable is \c true.
+
+    An endpoint already observing the resource is updated instead.
+*/
+quint32 QCoapServerPrivate::registerObserver(const QHostAddress &address, quint16 port,
+                                             const QCoapToken &token, const QString &path,
+                                             bool confirmable)
+{
+    const QCoapServerObserverKey key = { address, port, path };
+    const auto existing = observersByEndpoint.constFind(key);
+    if (existing != observersByEndpoint.constEnd()) {
+        QCoapServerObserver &observer = observers[*existing];
+        observer.token = token;
+        observer.confirmable = confirmable;
+        return *existing;
+    }
+
+    // Message IDs are matched with a table rather than a hash, so that
+    // notifications do not allocate
+    if (observersByMessageId.isEmpty())
+        observersByMessageId.fill(0, 0x10000);
+
+    while (nextObserverId == 0 || observers.contains(nextObserverId))
+        ++nextObserverId;
+    const quint32 observerId = nextObserverId++;
+
+    QVector<quint32> &resourceObservers = observersByResource[path];
+
+    QCoapServerObserver observer;
+    observer.address = address;
+    observer.port = port;
+    observer.token = token;
+    observer.path = path;
+    observer.confirmable = confirmable;
+    observer.position = resourceObservers.size();
+
+    resourceObservers.append(observerId);
+    observers.insert(observerId, observer);
+    observersByEndpoint.insert(key, observerId);
+    return observerId;
+}
+
+/*!
+    \internal
+
+    Removes the observer with \a observerId, and its notification waiting
+    for an acknowledgment if any.
+*/
+void QCoapServerPrivate::removeObserver(quint32 observerId)
+{
+    const auto it = observers.find(observerId);
+    if (it == observers.end())
+        return;
+
+    // Swap with the last observer of the resource, to remove in constant time
+    const auto resource = observersByResource.find(it->path);
+    if (resource != observersByResource.end()) {
+        QVector<quint32> &resourceObservers = resource.value();
+        const quint32 lastId = resourceObservers.constLast();
+        resourceObservers[it->position] = lastId;
+        observers[lastId].position = it->position;
+        resourceObservers.removeLast();
+        if (resourceObservers.isEmpty())
+            observersByResource.erase(resource);
+    }
+
+    observersByEndpoint.remove({ it->address, it->port, it->path });
+    if (observersByMessageId.at(it->lastMessageId) == observerId)
+        observersByMessageId[it->lastMessageId] = 0;
+
+    // Its entry in the deadlines is skipped when it expires
+    pendingNotifications.remove(observerId);
+    observers.erase(it);
+}
+
+/*!
+    \internal
+
+    Removes all the observers of the resource at \a path.
+*/
+void QCoapServerPrivate::removeObservers(const QString &path)
+{
+    const QVector<quint32> observerIds = observersByResource.value(path);
+    for (quint32 observerId : observerIds)
+        removeObserver(observerId);
+}
+
+/*!
+    \internal
+
+    Sends the \a notification frame, encoded without token and with a null
+    message ID, to the \a observer with \a observerId. The header and the
+    token are written in a buffer reused between observers, followed by
+    the options and the payload of \a notification.
+*/
+void QCoapServerPrivate::sendNotification(quint32 observerId, QCoapServerObserver &observer,
+                                          const QByteArray &notification)
+{
+    Q_ASSERT(notification.size() >= 4 && (notification.at(0) & 0x0F) == 0);
+
+    // A notification replacing one not acknowledged yet is confirmable as
+    // well, see section 4.5.2 of RFC 7641.
+    const bool isConfirmable = observer.confirmable
+            || observer.nonConfirmableCount >= maxNonConfirmableNotifications
+            || pendingNotifications.contains(observerId);
+    const QCoapMessageId messageId = generateMessageId();
+    const int tokenLength = observer.token.size();
+
+    notificationBuffer.resize(notification.size() + tokenLength);
+    char *data = notificationBuffer.data();
+    data[0] = static_cast<char>(0x40 | tokenLength
+                                | (isConfirmable ? QCoapMessage::Confirmable
+                                                 : QCoapMessage::NonConfirmable) << 4);
+    data[1] = notification.at(1);
+    data[2] = static_cast<char>(messageId >> 8);
+    data[3] = static_cast<char>(messageId & 0xFF);
+    memcpy(data + 4, observer.token.constData(), static_cast<size_t>(tokenLength));
+    memcpy(data + 4 + tokenLength, notification.constData() + 4,
+           static_cast<size_t>(notification.size() - 4));
+
+    // Only the last notification is matched with acknowledgments and resets
+    if (observersByMessageId.at(observer.lastMessageId) == observerId)
+        observersByMessageId[observer.lastMessageId] = 0;
+    observersByMessageId[messageId] = observerId;
+    observer.lastMessageId = messageId;
+
+    if (isConfirmable) {
+        observer.nonConfirmableCount = 0;
+        addPendingNotification(observerId, notificationBuffer);
+    } else {
+        ++observer.nonConfirmableCount;
+    }
+
+    connectionPrivate(connection)->writeToSocket(notificationBuffer, observer.address,
+                                                 observer.port);
+}
+
+/*!
+    \internal
+
+    Keeps the confirmable notification \a frame sent to the observer with
+    \a observerId, to retransmit it until it is acknowledged. A
+    notification replacing one that is still pending keeps its
+    retransmission counter and timeout.
+*/
+void QCoapServerPrivate::addPendingNotification(quint32 observerId, const QByteArray &frame)
+{
+    const auto it = pendingNotifications.find(observerId);
+    if (it != pendingNotifications.end()) {
+        it->frame = frame;
+        return;
+    }
+
+    // ACK_TIMEOUT with ACK_RANDOM_FACTOR 1.5, see section 4.2 of RFC 7252
+    const int timeout = ackTimeout + QtCoap::randomGenerator.bounded(ackTimeout / 2 + 1);
+    const qint64 deadline = clock.elapsed() + timeout;
+    pendingNotifications.insert(observerId, { frame, 0, timeout, deadline });
+    notificationDeadlines.insert(deadline, observerId);
+    scheduleRetransmission();
+}
+
+/*!
+    \internal
+
+    Starts the retransmission timer for the earliest pending notification.
+*/
+void QCoapServerPrivate::scheduleRetransmission()
+{
+    if (notificationDeadlines.isEmpty()) {
+        retransmissionTimer->stop();
+        return;
+    }
+
+    const qint64 delay = notificationDeadlines.firstKey() - clock.elapsed();
+    retransmissionTimer->start(static_cast<int>(qMax<qint64>(delay, 0)));
+}
+
+/*!
+    \internal
+
+    Retransmits the confirmable notifications whose timeout expired, doubling
+    their timeout, and removes the observers that did not acknowledge them
+    after the last retransmission.
+*/
+void QCoapServerPrivate::_q_retransmitNotifications()
+{
+    const qint64 now = clock.elapsed();
+    while (!notificationDeadlines.isEmpty() && notificationDeadlines.firstKey() <= now) {
+        const auto first = notificationDeadlines.begin();
+        const qint64 deadline = first.key();
+        const quint32 observerId = first.value();
+        notificationDeadlines.erase(first);
+
+        // Acknowledged, removed or rescheduled since
+        const auto it = pendingNotifications.find(observerId);
+        if (it == pendingNotifications.end() || it->deadline != deadline)
+            continue;
+
+        if (it->retransmissions >= maxRetransmit) {
+            removeObserver(observerId);
+            continue;
+        }
+
+        ++it->retransmissions;
+        it->timeout *= 2;
+        it->deadline = now + it->timeout;
+        notificationDeadlines.insert(it->deadline, observerId);
+
+        const QCoapServerObserver &observer = observers[observerId];
+        connectionPrivate(connection)->writeToSocket(it->frame, observer.address, observer.port);
+    }
+
+    scheduleRetransmission();
+}
+
+/*!
+    \internal
+
+    Stops the retransmission of the notification with \a messageId, if it
+    was sent to the sender of the acknowledgment \a frame.
+*/
+void QCoapServerPrivate::onAcknowledgment(const QNetworkDatagram &frame,
+                                          QCoapMessageId messageId)
+{
+    const quint32 observerId = observersByMessageId.value(messageId);
+    const auto it = observers.constFind(observerId);
+    if (it == observers.constEnd())
+        return;
+
+    if (it->port == frame.senderPort() && it->address.isEqual(frame.senderAddress()))
+        pendingNotifications.remove(observerId);
+}
+
+/*!
+    \internal
+
+    Removes the observer that rejected the notification with \a messageId
+    with the Reset \a frame. See section 3.6 of RFC 7641.
+*/
+void QCoapServerPrivate::onReset(const QNetworkDatagram &frame, QCoapMessageId messageId)
+{
+    const quint32 observerId = observersByMessageId.value(messageId);
+    const auto it = observers.constFind(observerId);
+    if (it == observers.constEnd())
+        return;
+
+    if (it->port == frame.senderPort() && it->address.isEqual(frame.senderAddress()))
+        removeObserver(observerId);
+}
+
+/*!
+    \internal
+
+    Returns the value of the Observe option of the next notification. A
+    single 24-bit sequence is shared by all the resources, so that it
+    increases for each observer. See section 4.4 of RFC 7641.
+*/
+quint32 QCoapServerPrivate::nextObserveSequence()
+{
+    observeSequence = (observeSequence + 1) & 0xFFFFFF;
+    return observeSequence;
+}
+
+QT_END_NAMESPACE
+
+#include "moc_qcoapserver.cpp"
@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPSERVER_H
+#define QCOAPSERVER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapnamespace.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCore/qobject.h>
+#include <QtNetwork/qabstractsocket.h>
+#include <QtNetwork/qhostaddress.h>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapConnection;
+class QNetworkDatagram;
+
+class QCoapServerPrivate;
+class Q_COAP_EXPORT QCoapServer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<QtCoap::ResponseCode(const QCoapRequest &request,
+                                               QCoapMessage *response)> RequestHandler;
+
+    explicit QCoapServer(QObject *parent = nullptr);
+    ~QCoapServer();
+
+    bool listen(const QHostAddress &address = QHostAddress::Any,
+                quint16 port = QtCoap::DefaultPort);
+    void close();
+    bool isListening() const;
+    QHostAddress serverAddress() const;
+    quint16 serverPort() const;
+
+    void addResource(const QString &path, const RequestHandler &handler);
+    void addResource(const QString &path, QtCoap::Method method, const RequestHandler &handler);
+    void setResourceDescription(const QCoapResource &description);
+    void removeResource(const QString &path);
+    bool hasResource(const QString &path) const;
+
+    int notifyObservers(const QString &path);
+    int observerCount(const QString &path) const;
+
+Q_SIGNALS:
+    void error(QAbstractSocket::SocketError error);
+
+protected:
+    explicit QCoapServer(QCoapConnection *connection, QObject *parent = nullptr);
+
+    Q_DECLARE_PRIVATE(QCoapServer)
+    Q_PRIVATE_SLOT(d_func(), void _q_onFrameReceived(const QNetworkDatagram &))
+    Q_PRIVATE_SLOT(d_func(), void _q_retransmitNotifications())
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPSERVER_H
@@ -0,0 +1,178 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPSERVER_P_H
+#define QCOAPSERVER_P_H
+
+#include <QtCoap/qcoapserver.h>
+#include <QtCoap/qcoapconnection.h>
+#include <private/qcoapresourcetree_p.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qvector.h>
+#include <private/qobject_p.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+struct QCoapServerExchangeKey
+{
+    QHostAddress address;
+    quint16 port;
+    QCoapMessageId messageId;
+};
+
+inline bool operator==(const QCoapServerExchangeKey &a, const QCoapServerExchangeKey &b)
+{
+    return a.messageId == b.messageId && a.port == b.port && a.address == b.address;
+}
+
+inline uint qHash(const QCoapServerExchangeKey &key, uint seed = 0)
+{
+    return qHash(key.address, seed) ^ (uint(key.port) << 16 | key.messageId);
+}
+
+struct QCoapServerObserverKey
+{
+    QHostAddress address;
+    quint16 port;
+    QString path;
+};
+
+inline bool operator==(const QCoapServerObserverKey &a, const QCoapServerObserverKey &b)
+{
+    return a.port == b.port && a.address == b.address && a.path == b.path;
+}
+
+inline uint qHash(const QCoapServerObserverKey &key, uint seed = 0)
+{
+    return qHash(key.address, seed) ^ qHash(key.path, seed) ^ key.port;
+}
+
+struct QCoapServerObserver
+{
+    QHostAddress address;
+    quint16 port = 0;
+    QCoapToken token;
+    QString path;
+    bool confirmable = false;           // registered with a confirmable request
+    int nonConfirmableCount = 0;        // notifications since the last confirmable one
+    int position = 0;                   // index in the observers of its resource
+    QCoapMessageId lastMessageId = 0;   // of the last notification sent
+};
+
+class Q_AUTOTEST_EXPORT QCoapServerPrivate : public QObjectPrivate
+{
+public:
+    explicit QCoapServerPrivate(QCoapConnection *connection);
+
+    struct RecentExchange
+    {
+        QByteArray response;
+        qint64 expiry;
+    };
+
+    struct PendingNotification
+    {
+        QByteArray frame;
+        int retransmissions;
+        int timeout;
+        qint64 deadline;
+    };
+
+    void _q_onFrameReceived(const QNetworkDatagram &frame);
+    void _q_retransmitNotifications();
+
+    void handleRequest(const QNetworkDatagram &frame, QCoapRequest *request, quint8 code,
+                       bool hasUnrecognizedCriticalOption);
+    QtCoap::ResponseCode processRequest(QCoapRequest *request, QCoapMessage *response,
+                                        bool *observable = nullptr);
+    void sendReset(const QNetworkDatagram &frame, QCoapMessageId messageId);
+    QCoapMessageId generateMessageId();
+
+    const RecentExchange *findRecentExchange(const QCoapServerExchangeKey &key) const;
+    void addRecentExchange(const QCoapServerExchangeKey &key, const QByteArray &response);
+    void removeExpiredExchanges(qint64 now);
+
+    void updateObservation(const QHostAddress &address, quint16 port, const QCoapRequest &request,
+                           bool canObserve, QCoapMessage *response);
+    quint32 registerObserver(const QHostAddress &address, quint16 port, const QCoapToken &token,
+                             const QString &path, bool confirmable);
+    void removeObserver(quint32 observerId);
+    void removeObservers(const QString &path);
+    void sendNotification(quint32 observerId, QCoapServerObserver &observer,
+                          const QByteArray &notification);
+    void addPendingNotification(quint32 observerId, const QByteArray &frame);
+    void scheduleRetransmission();
+    void onAcknowledgment(const QNetworkDatagram &frame, QCoapMessageId messageId);
+    void onReset(const QNetworkDatagram &frame, QCoapMessageId messageId);
+    quint32 nextObserveSequence();
+
+    static QString normalizedPath(const QString &path);
+    static QString requestPath(const QCoapRequest &request);
+
+    QCoapConnection *connection = nullptr;
+    QCoapResourceTree resources;
+    QCoapMessageId messageIdCounter = 0;
+
+    QHash<QCoapServerExchangeKey, RecentExchange> recentExchanges;
+    QQueue<QPair<qint64, QCoapServerExchangeKey>> recentExchangesExpiry;
+    QElapsedTimer clock;
+
+    quint32 nextObserverId = 1;
+    quint32 observeSequence = 1;
+    QHash<quint32, QCoapServerObserver> observers;
+    QHash<QString, QVector<quint32>> observersByResource;
+    QHash<QCoapServerObserverKey, quint32> observersByEndpoint;
+    QVector<quint32> observersByMessageId; // indexed by message ID, 0 if none
+    QHash<quint32, PendingNotification> pendingNotifications;
+    QMultiMap<qint64, quint32> notificationDeadlines;
+    QTimer *retransmissionTimer = nullptr;
+    QByteArray notificationBuffer;
+    int ackTimeout = 2000;
+
+    Q_DECLARE_PUBLIC(QCoapServer)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPSERVER_P_H
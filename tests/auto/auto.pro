@@ -2,12 +2,18 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     cmake \
+    qcoapcapture \
     qcoapclient \
     qcoapconnection \
     qcoapinternalreply \
     qcoapinternalrequest \
     qcoapmessage \
     qcoapoption \
+    qcoapprotocol \
+    qcoapratelimiter \
     qcoapreply \
     qcoaprequest \
-    qcoapresource
+    qcoapresource \
+    qcoapresourcedirectory \
+    qcoapresourceset \
+    qcoapserver
@@ -31,6 +31,10 @@
 #include <QtCore/qstring.h>
 #include <QtNetwork/qhostinfo.h>
 
+#if defined(COAP_TEST_SERVER_IN_PROCESS)
+#include "coaptestserver.h"
+#endif
+
 /*!
     \internal
 
@@ -45,6 +49,10 @@
 
     For more details, see
     \l{https://github.com/Pixep/coap-testserver-docker}{https://github.com/Pixep/coap-testserver-docker}.
+
+    When the COAP_TEST_SERVER_IP environment variable is not set at qmake
+    time, the tests start a QCoapTestServer in a background thread instead,
+    listening on the local host.
 */
 namespace QtCoapNetworkSettings
 {
@@ -52,6 +60,16 @@ namespace QtCoapNetworkSettings
     {
 #if defined(COAP_TEST_SERVER_IP)
         return QStringLiteral(COAP_TEST_SERVER_IP);
+#elif defined(COAP_TEST_SERVER_IN_PROCESS)
+        static QCoapTestServer *server = nullptr;
+        if (!server) {
+            server = QCoapTestServer::startInThread(QHostAddress::LocalHost, QtCoap::DefaultPort);
+            qAddPostRoutine([]() {
+                QCoapTestServer::stopInThread(server);
+                server = nullptr;
+            });
+        }
+        return QStringLiteral("127.0.0.1");
 #else
         static_assert(false, "COAP_TEST_SERVER_IP variable must be set");
 #endif
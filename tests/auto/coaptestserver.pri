@@ -1,7 +1,9 @@
 COAP_TEST_SERVER_IP = $$(COAP_TEST_SERVER_IP)
 isEmpty( COAP_TEST_SERVER_IP ) {
-    error(No IP set for CoAP plugtest server. Please set COAP_TEST_SERVER_IP environment variable to run this test.)
+    include(../shared/coaptestserver/coaptestserver.pri)
+    DEFINES += COAP_TEST_SERVER_IN_PROCESS
+    message(No IP set for CoAP plugtest server, tests use an in-process server instead.)
+} else {
+    DEFINES += COAP_TEST_SERVER_IP=\\\"$${COAP_TEST_SERVER_IP}\\\"
+    message(CoAP plugtest server IP set to $$COAP_TEST_SERVER_IP)
 }
-
-DEFINES += COAP_TEST_SERVER_IP=\\\"$${COAP_TEST_SERVER_IP}\\\"
-message(CoAP plugtest server IP set to $$COAP_TEST_SERVER_IP)
@@ -0,0 +1,4 @@
+QT = testlib network core-private core coap coap-private
+CONFIG += testcase
+
+SOURCES += tst_qcoapcapture.cpp
@@ -0,0 +1,200 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapconnection.h>
+#include <QtCoap/qcoapprotocol.h>
+#include <QtCore/qbuffer.h>
+#include <private/qcoapcapture_p.h>
+#include <private/qcoapprotocol_p.h>
+
+class tst_QCoapCapture : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void writeAndRead_data();
+    void writeAndRead();
+    void invalidLog_data();
+    void invalidLog();
+    void replay_data();
+    void replay();
+};
+
+static QCoapCaptureRecord record(QCoapCaptureRecord::Direction direction, qint64 timestamp,
+                                 const QHostAddress &address, quint16 port,
+                                 const QByteArray &frame)
+{
+    QCoapCaptureRecord record;
+    record.direction = direction;
+    record.timestamp = timestamp;
+    record.address = address;
+    record.port = port;
+    record.frame = frame;
+    return record;
+}
+
+static QByteArray captureLog(const QVector<QCoapCaptureRecord> &records)
+{
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    QCoapCaptureWriter writer(&log);
+    for (const QCoapCaptureRecord &record : records)
+        writer.write(record);
+    return log.data();
+}
+
+static QCoapProtocolPrivate *protocolPrivate(QCoapProtocol *protocol)
+{
+    return static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+}
+
+void tst_QCoapCapture::writeAndRead_data()
+{
+    QTest::addColumn<QHostAddress>("address");
+    QTest::addColumn<QByteArray>("frame");
+
+    QTest::newRow("ipv4") << QHostAddress("10.20.30.40") << QByteArray::fromHex("4401123461626364");
+    QTest::newRow("ipv6") << QHostAddress("2001:db8::1") << QByteArray::fromHex("4401123461626364");
+    QTest::newRow("empty_frame") << QHostAddress("10.20.30.40") << QByteArray();
+}
+
+void tst_QCoapCapture::writeAndRead()
+{
+    QFETCH(QHostAddress, address);
+    QFETCH(QByteArray, frame);
+
+    const QVector<QCoapCaptureRecord> records = {
+        record(QCoapCaptureRecord::Sent, 0, address, 5683, frame),
+        record(QCoapCaptureRecord::Received, Q_INT64_C(123456789012), address, 61616,
+               frame + "payload")
+    };
+
+    QByteArray data = captureLog(records);
+    QBuffer log(&data);
+    log.open(QIODevice::ReadOnly);
+
+    bool ok = false;
+    const QVector<QCoapCaptureRecord> readRecords = QCoapCaptureWriter::readAll(&log, &ok);
+    QVERIFY(ok);
+    QCOMPARE(readRecords.size(), records.size());
+    for (int i = 0; i < records.size(); ++i) {
+        QCOMPARE(readRecords.at(i).direction, records.at(i).direction);
+        QCOMPARE(readRecords.at(i).timestamp, records.at(i).timestamp);
+        QCOMPARE(readRecords.at(i).address, records.at(i).address);
+        QCOMPARE(readRecords.at(i).port, records.at(i).port);
+        QCOMPARE(readRecords.at(i).frame, records.at(i).frame);
+    }
+}
+
+void tst_QCoapCapture::invalidLog_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("recordCount");
+
+    const QByteArray frame = QByteArray::fromHex("4401123461626364");
+    const QByteArray log = captureLog({
+        record(QCoapCaptureRecord::Sent, 0, QHostAddress("10.20.30.40"), 5683, frame),
+        record(QCoapCaptureRecord::Sent, 1000, QHostAddress("10.20.30.40"), 5683, frame)
+    });
+
+    QTest::newRow("empty") << QByteArray() << 0;
+    QTest::newRow("wrong_magic") << QByteArray("QCOAPLOG\x01") << 0;
+    QTest::newRow("wrong_version") << QByteArray("QCOAPCAP\x02") << 0;
+    QTest::newRow("truncated_record_header") << log.left(log.size() - frame.size() - 3) << 1;
+    QTest::newRow("truncated_frame") << log.left(log.size() - 1) << 1;
+}
+
+void tst_QCoapCapture::invalidLog()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, recordCount);
+
+    QBuffer log(&data);
+    log.open(QIODevice::ReadOnly);
+
+    bool ok = true;
+    QCOMPARE(QCoapCaptureWriter::readAll(&log, &ok).size(), recordCount);
+    QVERIFY(!ok);
+}
+
+void tst_QCoapCapture::replay_data()
+{
+    QTest::addColumn<double>("speed");
+
+    QTest::newRow("immediate") << 0.0;
+    QTest::newRow("original_speed") << 1.0;
+    QTest::newRow("accelerated") << 4.0;
+}
+
+void tst_QCoapCapture::replay()
+{
+    QFETCH(double, speed);
+
+    // A confirmable GET, answered by a piggybacked 2.05 Content
+    const QHostAddress server("10.20.30.40");
+    const QByteArray token("abcd");
+    const QByteArray request = QByteArray::fromHex("4401123461626364");
+    const QByteArray response = QByteArray::fromHex("6445123461626364ff6869");
+    const qint64 delay = 100 * 1000 * 1000;
+
+    QCoapProtocol protocol;
+    QCoapConnection connection;
+    QCoapCaptureReplayer replayer(&protocol, &connection);
+    QSignalSpy spyFinished(&replayer, &QCoapCaptureReplayer::finished);
+    replayer.setRecords({
+        record(QCoapCaptureRecord::Sent, 0, server, 5683, request),
+        record(QCoapCaptureRecord::Received, delay, server, 5683, response)
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    replayer.start(speed);
+
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    if (speed > 0) {
+        // The request is replayed immediately, the response after the delay
+        QCOMPARE(replayer.replayedCount(), 1);
+        QVERIFY(d->isTokenRegistered(token));
+        QTRY_COMPARE(spyFinished.count(), 1);
+        QVERIFY(timer.nsecsElapsed() >= qint64(delay / speed));
+    } else {
+        QCOMPARE(spyFinished.count(), 1);
+    }
+
+    // The response finished the exchange opened by the request
+    QCOMPARE(replayer.replayedCount(), 2);
+    QVERIFY(!d->isTokenRegistered(token));
+}
+
+QTEST_MAIN(tst_QCoapCapture)
+
+#include "tst_qcoapcapture.moc"
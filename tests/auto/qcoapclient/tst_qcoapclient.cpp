@@ -34,11 +34,15 @@
 #include <QtCoap/qcoaprequest.h>
 #include <QtCoap/qcoapreply.h>
 #include <QtCoap/qcoapdiscoveryreply.h>
+#include <QtCoap/qcoapclientstatistics.h>
 #include <QtCore/qbuffer.h>
+#include <QtCore/qfuturewatcher.h>
 #include <QtNetwork/qnetworkdatagram.h>
 #include <private/qcoapclient_p.h>
 #include <private/qcoapconnection_p.h>
 
+#include <numeric>
+
 #include "../coapnetworksettings.h"
 
 using namespace QtCoapNetworkSettings;
@@ -53,6 +57,10 @@ private Q_SLOTS:
     void methods_data();
     void methods();
     void separateMethod();
+    void asyncMethods_data();
+    void asyncMethods();
+    void asyncFailures();
+    void callbackRequests();
     void socketError();
     void timeout_data();
     void timeout();
@@ -63,12 +71,15 @@ private Q_SLOTS:
     void requestWithQIODevice_data();
     void requestWithQIODevice();
     void multipleRequests();
+    void statistics();
+    void rateLimit();
     void blockwiseReply_data();
     void blockwiseReply();
     void blockwiseRequest_data();
     void blockwiseRequest();
     void discover_data();
     void discover();
+    void multicastDiscovery();
     void observe_data();
     void observe();
 };
@@ -272,6 +283,163 @@ void tst_QCoapClient::separateMethod()
     QCOMPARE(reply->responseCode(), QtCoap::Content);
 }
 
+void tst_QCoapClient::asyncMethods_data()
+{
+    QTest::addColumn<QtCoap::Method>("method");
+    QTest::addColumn<bool>("hasPayload");
+
+    QTest::newRow("get")    << QtCoap::Get << true;
+    QTest::newRow("post")   << QtCoap::Post << false;
+    QTest::newRow("put")    << QtCoap::Put << false;
+    QTest::newRow("delete") << QtCoap::Delete << false;
+}
+
+void tst_QCoapClient::asyncMethods()
+{
+    QFETCH(QtCoap::Method, method);
+    QFETCH(bool, hasPayload);
+
+    QCoapClient client;
+    QSignalSpy spyClientFinished(&client, SIGNAL(finished(QCoapReply *)));
+    const QUrl url(testServerResource());
+
+    QFuture<QCoapMessage> future;
+    switch (method) {
+    case QtCoap::Get:
+        future = client.getAsync(url);
+        break;
+    case QtCoap::Post:
+        future = client.postAsync(url);
+        break;
+    case QtCoap::Put:
+        future = client.putAsync(url);
+        break;
+    case QtCoap::Delete:
+        future = client.deleteResourceAsync(url);
+        break;
+    default:
+        QFAIL("Unexpected method");
+    }
+
+    QFutureWatcher<QCoapMessage> watcher;
+    QSignalSpy spyFinished(&watcher, &QFutureWatcher<QCoapMessage>::finished);
+    watcher.setFuture(future);
+
+    QTRY_COMPARE(spyFinished.count(), 1);
+    QVERIFY(!future.isCanceled());
+    QCOMPARE(future.resultCount(), 1);
+    QCOMPARE(!future.result().payload().isEmpty(), hasPayload);
+
+    // No QCoapReply is involved
+    QCOMPARE(spyClientFinished.count(), 0);
+    QTRY_COMPARE(client.statistics().exchangesInFlight(), 0);
+}
+
+void tst_QCoapClient::asyncFailures()
+{
+    QCoapClientForTests client;
+
+    QTest::ignoreMessage(QtWarningMsg, "QCoapClient: Failed to send request for an invalid URL.");
+    QFuture<QCoapMessage> invalid = client.getAsync(QUrl("wrong://10.20.30.40:5683/test"));
+    QVERIFY(invalid.isFinished());
+    QVERIFY(invalid.isCanceled());
+
+    client.protocol()->setAckTimeout(200);
+    client.protocol()->setAckRandomFactor(1);
+    client.protocol()->setMaxRetransmit(0);
+    const QUrl url("coap://240.0.0.0:5683/"); // Need an url that returns nothing
+
+    // Timeouts cancel the future
+    QFuture<QCoapMessage> timedOut = client.getAsync(QCoapRequest(url, QCoapMessage::Confirmable));
+    QTRY_VERIFY_WITH_TIMEOUT(timedOut.isFinished(), 5000);
+    QVERIFY(timedOut.isCanceled());
+    QCOMPARE(timedOut.resultCount(), 0);
+
+    // Canceled futures drop their exchange, without retransmissions
+    client.protocol()->setMaxRetransmit(4);
+    QFuture<QCoapMessage> canceled = client.getAsync(QCoapRequest(url, QCoapMessage::Confirmable));
+    canceled.cancel();
+    QTRY_VERIFY_WITH_TIMEOUT(canceled.isFinished(), 5000);
+    QTRY_COMPARE(client.statistics().exchangesInFlight(), 0);
+    QCOMPARE(client.statistics().retransmissions(), quint64(0));
+}
+
+void tst_QCoapClient::callbackRequests()
+{
+    QCoapClientForTests client;
+    QSignalSpy spyClientFinished(&client, SIGNAL(finished(QCoapReply *)));
+
+    int calls = 0;
+    QtCoap::ResponseCode code = QtCoap::EmptyMessage;
+    QCoapMessage message;
+    QThread *callbackThread = nullptr;
+    auto callback = [&](QtCoap::ResponseCode responseCode, const QCoapMessage &response) {
+        ++calls;
+        code = responseCode;
+        message = response;
+        callbackThread = QThread::currentThread();
+    };
+
+    QVERIFY(client.sendRequest(QCoapRequest(testServerResource()), this, callback));
+    QTRY_COMPARE(calls, 1);
+    QCOMPARE(code, QtCoap::Content);
+    QVERIFY(!message.payload().isEmpty());
+    QCOMPARE(callbackThread, thread());
+    QCOMPARE(spyClientFinished.count(), 0);
+
+    // The method of the request is kept
+    QCoapRequest request(testServerResource());
+    request.setMethod(QtCoap::Post);
+    QVERIFY(client.sendRequest(request, this, callback));
+    QTRY_COMPARE(calls, 2);
+    QCOMPARE(code, QtCoap::Created);
+
+    QTest::ignoreMessage(QtWarningMsg, "QCoapClient: Failed to send request for an invalid URL.");
+    QVERIFY(!client.sendRequest(QCoapRequest("wrong://10.20.30.40:5683/test"), this, callback));
+
+    // Failures invoke the callback without response
+    client.protocol()->setAckTimeout(200);
+    client.protocol()->setAckRandomFactor(1);
+    client.protocol()->setMaxRetransmit(0);
+    const QUrl url("coap://240.0.0.0:5683/"); // Need an url that returns nothing
+    QVERIFY(client.sendRequest(QCoapRequest(url, QCoapMessage::Confirmable), this, callback));
+    QTRY_COMPARE_WITH_TIMEOUT(calls, 3, 5000);
+    QCOMPARE(code, QtCoap::InvalidCode);
+    QVERIFY(message.payload().isEmpty());
+
+    // Nothing is invoked once the context is gone
+    QScopedPointer<QObject> context(new QObject);
+    QVERIFY(client.sendRequest(QCoapRequest(testServerResource()), context.data(), callback));
+    context.reset();
+    QTRY_COMPARE(client.statistics().exchangesInFlight(), 0);
+    QTest::qWait(100);
+    QCOMPARE(calls, 3);
+
+    // The context is checked in its own thread once the response is queued,
+    // so events are not processed until it is destroyed
+    context.reset(new QObject);
+    const quint64 requestsSent = client.statistics().requestsSent();
+    QVERIFY(client.sendRequest(QCoapRequest(testServerResource()), context.data(), callback));
+    QElapsedTimer timer;
+    timer.start();
+    while (client.statistics().requestsSent() == requestsSent && timer.elapsed() < 5000)
+        QThread::msleep(10);
+    while (client.statistics().exchangesInFlight() > 0 && timer.elapsed() < 5000)
+        QThread::msleep(10);
+    QCOMPARE(client.statistics().exchangesInFlight(), 0);
+    context.reset();
+    QCoreApplication::processEvents();
+    QCOMPARE(calls, 3);
+
+    // Contexts in other threads are rejected
+    QThread otherThread;
+    QObject otherContext;
+    otherContext.moveToThread(&otherThread);
+    QTest::ignoreMessage(QtWarningMsg,
+                         "QCoapClient: Failed to send request with a context in another thread.");
+    QVERIFY(!client.sendRequest(QCoapRequest(testServerResource()), &otherContext, callback));
+}
+
 void tst_QCoapClient::removeReply()
 {
     QCoapClient client;
@@ -402,6 +570,68 @@ void tst_QCoapClient::multipleRequests()
     QVERIFY(replyData3 != replyData4);
 }
 
+void tst_QCoapClient::statistics()
+{
+    QCoapClient client;
+    QCOMPARE(client.statistics().requestsSent(), quint64(0));
+    QCOMPARE(client.statistics().rttHistogram().size(),
+             int(QCoapClientStatistics::RttBucketCount));
+
+    QUrl url = QUrl(testServerResource());
+    QScopedPointer<QCoapReply> replyGet1(client.get(url));
+    QScopedPointer<QCoapReply> replyGet2(client.get(url));
+    QSignalSpy spyReplyGet1Finished(replyGet1.data(), SIGNAL(finished(QCoapReply *)));
+    QSignalSpy spyReplyGet2Finished(replyGet2.data(), SIGNAL(finished(QCoapReply *)));
+    QTRY_COMPARE(spyReplyGet1Finished.count(), 1);
+    QTRY_COMPARE(spyReplyGet2Finished.count(), 1);
+    QTRY_COMPARE(client.statistics().exchangesInFlight(), 0);
+
+    const QCoapClientStatistics statistics = client.statistics();
+    QCOMPARE(statistics.requestsSent(), quint64(2));
+    QCOMPARE(statistics.retransmissions(), quint64(0));
+    QCOMPARE(statistics.timeouts(), quint64(0));
+    QCOMPARE(statistics.duplicates(), quint64(0));
+    QVERIFY(statistics.bytesSent() > 0);
+    QVERIFY(statistics.bytesReceived() > 0);
+
+    // Both round-trip times are counted for the endpoint, and globally
+    QCOMPARE(statistics.endpoints(),
+             QStringList(url.host() + QLatin1Char(':') + QString::number(url.port())));
+    const QVector<quint64> histogram = statistics.rttHistogram(statistics.endpoints().first());
+    QCOMPARE(histogram.size(), int(QCoapClientStatistics::RttBucketCount));
+    QCOMPARE(std::accumulate(histogram.cbegin(), histogram.cend(), quint64(0)), quint64(2));
+    QCOMPARE(statistics.rttHistogram(), histogram);
+    QVERIFY(statistics.rttHistogram("unknown:5683").isEmpty());
+
+    QCOMPARE(QCoapClientStatistics::rttBucketUpperBound(0), qint64(128));
+    QCOMPARE(QCoapClientStatistics::rttBucketUpperBound(1), qint64(256));
+    QCOMPARE(QCoapClientStatistics::rttBucketUpperBound(QCoapClientStatistics::RttBucketCount - 1),
+             qint64(-1));
+}
+
+void tst_QCoapClient::rateLimit()
+{
+    QCoapClient client;
+    client.setRateLimit(0, 2);
+
+    // Three requests fit in the bucket, the fourth waits half a second
+    QUrl url = QUrl(testServerResource());
+    QVector<QSharedPointer<QCoapReply>> replies;
+    for (int i = 0; i < 4; ++i)
+        replies.append(QSharedPointer<QCoapReply>(client.get(url)));
+
+    for (const auto &reply : qAsConst(replies))
+        QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QTRY_COMPARE(client.statistics().exchangesInFlight(), 0);
+
+    const QCoapClientStatistics statistics = client.statistics();
+    QCOMPARE(statistics.requestsSent(), quint64(4));
+    QCOMPARE(statistics.throttledRequests(), quint64(1));
+    QVERIFY(statistics.throttledTime() >= 400000);
+    for (const auto &reply : qAsConst(replies))
+        QVERIFY(reply->isSuccessful());
+}
+
 void tst_QCoapClient::socketError()
 {
     QCoapClientForSocketErrorTests client;
@@ -468,6 +698,13 @@ void tst_QCoapClient::timeout()
     QCOMPARE(spyReplyFinished.count(), 1);
     QCOMPARE(spyReplyAborted.count(), 0);
     QCOMPARE(spyClientError.count(), 1);
+
+    const QCoapClientStatistics statistics = client.statistics();
+    QCOMPARE(statistics.requestsSent(), quint64(1));
+    QCOMPARE(statistics.retransmissions(), quint64(maxRetransmit));
+    QCOMPARE(statistics.timeouts(), quint64(1));
+    QCOMPARE(statistics.exchangesInFlight(), 0);
+    QVERIFY(statistics.endpoints().isEmpty());
 }
 
 void tst_QCoapClient::abort()
@@ -646,6 +883,60 @@ void tst_QCoapClient::discover()
     //! TODO Test discovery content too
 }
 
+void tst_QCoapClient::multicastDiscovery()
+{
+    QCoapClientForTests client;
+    client.protocol()->setLeisure(500);
+
+    QScopedPointer<QCoapDiscoveryReply> reply(client.discover());
+    QVERIFY(reply);
+    QCOMPARE(reply->request().url().host(), QString("224.0.1.187"));
+
+    QVector<QVector<QCoapResource>> discovered;
+    connect(reply.data(), &QCoapDiscoveryReply::discovered,
+            [&](QCoapDiscoveryReply *, const QVector<QCoapResource> &resources) {
+        discovered.append(resources);
+    });
+    QSignalSpy spyReplyFinished(reply.data(), SIGNAL(finished(QCoapReply *)));
+
+    QTRY_VERIFY(!reply->request().token().isEmpty());
+    const QCoapToken token = reply->request().token();
+
+    // Responses are injected as if received from several servers
+    auto receive = [&](const QString &sender, quint16 messageId, const QByteArray &links) {
+        QByteArray frame;
+        frame.append(static_cast<char>(0x50 | token.size()));
+        frame.append(static_cast<char>(QtCoap::Content));
+        frame.append(static_cast<char>(messageId >> 8));
+        frame.append(static_cast<char>(messageId & 0xFF));
+        frame.append(token);
+        frame.append(QByteArray::fromHex("c128ff")); // Content-Format 40
+        frame.append(links);
+
+        QNetworkDatagram datagram(frame);
+        datagram.setSender(QHostAddress(sender), QtCoap::DefaultPort);
+        emit client.connection()->readyRead(datagram);
+    };
+
+    receive("10.0.0.1", 1, "</temp>,</light>,</temp>");
+    receive("10.0.0.2", 1, "</temp>");
+    receive("10.0.0.1", 1, "</temp>,</light>");     // duplicate
+    receive("10.0.0.1", 2, "</other>");             // already answered
+    receive("10.0.0.3", 2, "</temp>;rt=\"temperature\"");
+
+    QTRY_COMPARE_WITH_TIMEOUT(discovered.size(), 3, 1000);
+    QCOMPARE(discovered.at(0).size(), 2);
+    QCOMPARE(discovered.at(1).size(), 1);
+    QCOMPARE(discovered.at(1).first().host(), QHostAddress("10.0.0.2"));
+    QCOMPARE(discovered.at(2).first().resourceType(), QString("temperature"));
+    QCOMPARE(reply->resources().size(), 4);
+
+    // The reply is finished without error at the end of the Leisure
+    QTRY_COMPARE_WITH_TIMEOUT(spyReplyFinished.count(), 1, 2000);
+    QCOMPARE(reply->errorReceived(), QtCoap::NoError);
+    QCOMPARE(discovered.size(), 3);
+}
+
 void tst_QCoapClient::observe_data()
 {
     QWARN("Observe tests may take some time, don't forget to raise Tests timeout in settings.");
@@ -40,8 +40,12 @@
 #include <QtCoap/qcoaprequest.h>
 #include <private/qcoapconnection_p.h>
 #include <private/qcoapinternalrequest_p.h>
+#include <private/qcoapcapture_p.h>
+#include <private/qcoapclientstatistics_p.h>
 #include "../coapnetworksettings.h"
 
+#include <numeric>
+
 using namespace QtCoapNetworkSettings;
 
 class tst_QCoapConnection : public QObject
@@ -53,6 +57,8 @@ private Q_SLOTS:
     void connectToHost();
     void sendRequest_data();
     void sendRequest();
+    void capture();
+    void priorities();
 };
 
 class QCoapConnectionForTest : public QCoapConnection
@@ -64,6 +70,10 @@ public:
     {}
 
     void bindSocketForTest() { d_func()->bindSocket(); }
+    void setStatisticsForTest(QCoapStatisticsCounters *counters)
+    {
+        d_func()->statistics = counters;
+    }
 };
 
 void tst_QCoapConnection::ctor()
@@ -171,6 +181,99 @@ void tst_QCoapConnection::sendRequest()
     QVERIFY(QString(datagram.data().toHex()).endsWith(dataHexaPayload));
 }
 
+void tst_QCoapConnection::capture()
+{
+    QCoapConnectionForTest connection;
+    QSignalSpy spyConnectionReadyRead(&connection, &QCoapConnection::readyRead);
+
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    connection.setCaptureDevice(&log);
+
+    QCoapRequest request(QUrl("coap://" + testServerHost() + "/test"));
+    request.setMessageId(24806);
+    request.setToken(QByteArray("abcd"));
+    request.setMethod(QtCoap::Get);
+    QCoapInternalRequest internalRequest(request);
+    const QByteArray frame = internalRequest.toQByteArray();
+    connection.sendRequest(frame, testServerHost(), QtCoap::DefaultPort);
+
+    QTRY_COMPARE(spyConnectionReadyRead.count(), 1);
+    connection.setCaptureDevice(nullptr);
+    const QNetworkDatagram datagram = spyConnectionReadyRead.first()
+                                          .first().value<QNetworkDatagram>();
+
+    log.close();
+    log.open(QIODevice::ReadOnly);
+    bool ok = false;
+    const QVector<QCoapCaptureRecord> records = QCoapCaptureWriter::readAll(&log, &ok);
+    QVERIFY(ok);
+    QCOMPARE(records.size(), 2);
+
+    QCOMPARE(records.at(0).direction, QCoapCaptureRecord::Sent);
+    QCOMPARE(records.at(0).frame, frame);
+    QCOMPARE(records.at(0).address, QHostAddress(testServerHost()));
+    QCOMPARE(records.at(0).port, quint16(QtCoap::DefaultPort));
+
+    QCOMPARE(records.at(1).direction, QCoapCaptureRecord::Received);
+    QCOMPARE(records.at(1).frame, datagram.data());
+    QCOMPARE(records.at(1).address, datagram.senderAddress());
+    QVERIFY(records.at(1).timestamp >= records.at(0).timestamp);
+}
+
+void tst_QCoapConnection::priorities()
+{
+    QCoapConnectionForTest connection;
+    QCoapStatisticsCounters counters;
+    connection.setStatisticsForTest(&counters);
+
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    connection.setCaptureDevice(&log);
+
+    auto frame = [](quint16 messageId) {
+        QCoapRequest request(QUrl("coap://" + testServerHost() + "/test"));
+        request.setMessageId(messageId);
+        request.setMethod(QtCoap::Get);
+        return QCoapInternalRequest(request).toQByteArray();
+    };
+    QCoapInternalRequest ack;
+    ack.initForAcknowledgment(5, QByteArray("ab"));
+
+    auto count = [&counters](QCoapRequest::Priority priority) {
+        const QVector<quint64> histogram = counters.snapshot().queueTimeHistogram(priority);
+        return std::accumulate(histogram.cbegin(), histogram.cend(), quint64(0));
+    };
+
+    // Frames queued in the same event loop pass are sent by priority
+    const QString host = testServerHost();
+    const quint16 port = QtCoap::DefaultPort;
+    connection.sendRequest(frame(1), host, port, QCoapRequest::BulkPriority);
+    connection.sendRequest(frame(2), host, port, QCoapRequest::NormalPriority);
+    connection.sendRequest(frame(3), host, port, QCoapRequest::BulkPriority);
+    connection.sendRequest(frame(4), host, port, QCoapRequest::CriticalPriority);
+    connection.sendRequest(ack.toQByteArray(), host, port, QCoapRequest::BulkPriority);
+
+    // Queue times are counted by priority, without the acknowledgment
+    QTRY_COMPARE(count(QCoapRequest::BulkPriority), quint64(2));
+    QCOMPARE(count(QCoapRequest::CriticalPriority), quint64(1));
+    QCOMPARE(count(QCoapRequest::NormalPriority), quint64(1));
+    connection.setCaptureDevice(nullptr);
+
+    log.close();
+    log.open(QIODevice::ReadOnly);
+    bool ok = false;
+    const QVector<QCoapCaptureRecord> records = QCoapCaptureWriter::readAll(&log, &ok);
+    QVERIFY(ok);
+
+    QVector<int> messageIds;
+    for (const QCoapCaptureRecord &record : records) {
+        if (record.direction == QCoapCaptureRecord::Sent)
+            messageIds.append(QCoapInternalMessagePrivate::frameMessageId(record.frame));
+    }
+    QCOMPARE(messageIds, QVector<int>({ 5, 4, 2, 1, 3 }));
+}
+
 QTEST_MAIN(tst_QCoapConnection)
 
 #include "tst_qcoapconnection.moc"
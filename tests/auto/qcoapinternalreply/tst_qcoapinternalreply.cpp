@@ -40,6 +40,13 @@ class tst_QCoapInternalReply : public QObject
 private Q_SLOTS:
     void parseReplyPdu_data();
     void parseReplyPdu();
+    void unrecognizedOptions_data();
+    void unrecognizedOptions();
+    void malformedFrames_data();
+    void malformedFrames();
+    void frameHeader_data();
+    void frameHeader();
+    void copyReply();
     void updateReply_data();
     void updateReply();
     void requestData();
@@ -64,7 +71,7 @@ void tst_QCoapInternalReply::parseReplyPdu_data()
     QList<quint8> optionsLengthsReply({0, 1});
     QList<QByteArray> optionsValuesReply({"", QByteArray::fromHex("1e")});
 
-    QList<QCoapOption::OptionName> bigOptionNameReply({QCoapOption::Size1});
+    QList<QCoapOption::OptionName> bigOptionNameReply({QCoapOption::LocationPath});
     QList<quint8> bigOptionLengthReply({26});
     QList<QByteArray> bigOptionValueReply({QByteArray("abcdefghijklmnopqrstuvwxyz")});
 
@@ -129,7 +136,7 @@ void tst_QCoapInternalReply::parseReplyPdu_data()
             << bigOptionLengthReply
             << bigOptionValueReply
             << ""
-            << "5445fbcf4647f09bdd2f0d6162636465666768696a6b6c6d6e6f707172737475"
+            << "5445fbcf4647f09b8d0d6162636465666768696a6b6c6d6e6f707172737475"
                "767778797a";
 }
 
@@ -164,6 +171,100 @@ void tst_QCoapInternalReply::parseReplyPdu()
     QCOMPARE(reply->message()->payload(), payload);
 }
 
+void tst_QCoapInternalReply::unrecognizedOptions_data()
+{
+    QTest::addColumn<QString>("pduHexa");
+    QTest::addColumn<QList<QCoapOption::OptionName>>("optionsNames");
+    QTest::addColumn<bool>("rejected");
+
+    QTest::newRow("unregistered_elective_kept")
+            << "5445fbcf4647f09bd11161"
+            << QList<QCoapOption::OptionName>({ QCoapOption::OptionName(30) })
+            << false;
+    QTest::newRow("unregistered_critical")
+            << "5445fbcf4647f09b9161"
+            << QList<QCoapOption::OptionName>({ QCoapOption::OptionName(9) })
+            << true;
+    QTest::newRow("oversized_elective_dropped")
+            << "5445fbcf4647f09bd52f6162636465"
+            << QList<QCoapOption::OptionName>()
+            << false;
+    QTest::newRow("oversized_critical")
+            << "5445fbcf4647f09b5161"
+            << QList<QCoapOption::OptionName>()
+            << true;
+    QTest::newRow("repeated_elective_dropped")
+            << "5445fbcf4647f09bc1000100"
+            << QList<QCoapOption::OptionName>({ QCoapOption::ContentFormat })
+            << false;
+    QTest::newRow("repeated_critical")
+            << "5445fbcf4647f09b717b017c"
+            << QList<QCoapOption::OptionName>({ QCoapOption::UriPort })
+            << true;
+}
+
+void tst_QCoapInternalReply::unrecognizedOptions()
+{
+    QFETCH(QString, pduHexa);
+    QFETCH(QList<QCoapOption::OptionName>, optionsNames);
+    QFETCH(bool, rejected);
+
+    QScopedPointer<QCoapInternalReply>
+            reply(QCoapInternalReply::createFromFrame(QByteArray::fromHex(pduHexa.toUtf8())));
+
+    QCOMPARE(reply->hasUnrecognizedCriticalOption(), rejected);
+    QCOMPARE(reply->message()->optionCount(), optionsNames.count());
+    for (int i = 0; i < optionsNames.count(); ++i)
+        QCOMPARE(reply->message()->option(i).name(), optionsNames.at(i));
+}
+
+void tst_QCoapInternalReply::malformedFrames_data()
+{
+    QTest::addColumn<QString>("pduHexa");
+
+    QTest::newRow("truncated_header") << "5445fb";
+    QTest::newRow("reserved_token_length") << "5945fbcf4647f09b";
+    QTest::newRow("truncated_token") << "5445fbcf4647";
+    QTest::newRow("truncated_extended_delta") << "5445fbcf4647f09bd0";
+    QTest::newRow("truncated_extended_length") << "5445fbcf4647f09bbe00";
+    QTest::newRow("truncated_option_value") << "5445fbcf4647f09bb4746573";
+    QTest::newRow("reserved_delta") << "5445fbcf4647f09bf0";
+    QTest::newRow("empty_payload_after_marker") << "5445fbcf4647f09bff";
+}
+
+void tst_QCoapInternalReply::malformedFrames()
+{
+    QFETCH(QString, pduHexa);
+
+    QScopedPointer<QCoapInternalReply>
+            reply(QCoapInternalReply::createFromFrame(QByteArray::fromHex(pduHexa.toUtf8())));
+    QVERIFY(reply.isNull());
+}
+
+void tst_QCoapInternalReply::frameHeader_data()
+{
+    QTest::addColumn<QString>("pduHexa");
+    QTest::addColumn<int>("messageId");
+    QTest::addColumn<QByteArray>("token");
+
+    QTest::newRow("token_and_payload") << "5445fbcf4647f09bff736f6d65"
+                                       << 64463 << QByteArray::fromHex("4647f09b");
+    QTest::newRow("no_token") << "6000fbcf" << 64463 << QByteArray();
+    QTest::newRow("truncated_header") << "5445fb" << -1 << QByteArray();
+    QTest::newRow("truncated_token") << "5445fbcf4647" << 64463 << QByteArray();
+}
+
+void tst_QCoapInternalReply::frameHeader()
+{
+    QFETCH(QString, pduHexa);
+    QFETCH(int, messageId);
+    QFETCH(QByteArray, token);
+
+    const QByteArray frame = QByteArray::fromHex(pduHexa.toUtf8());
+    QCOMPARE(QCoapInternalMessagePrivate::frameMessageId(frame), messageId);
+    QCOMPARE(QCoapInternalMessagePrivate::frameToken(frame), token);
+}
+
 class QCoapReplyForTests : public QCoapReply
 {
 public:
@@ -182,6 +283,37 @@ public:
     }
 };
 
+// Replies are values: copies, including the ones made by a growing vector,
+// hold their own data.
+void tst_QCoapInternalReply::copyReply()
+{
+    const QByteArray frame = QByteArray::fromHex("64451f0d4647f09bff61626364");
+    QCoapInternalReply reply;
+    QVERIFY(QCoapInternalReply::createFromFrame(frame, &reply));
+    reply.setSenderAddress(QHostAddress("10.20.30.40"));
+
+    QCoapInternalReply copy(reply);
+    copy.message()->setPayload("changed");
+    copy.setSenderAddress(QHostAddress("10.20.30.41"));
+    QCOMPARE(reply.message()->payload(), QByteArray("abcd"));
+    QCOMPARE(reply.senderAddress(), QHostAddress("10.20.30.40"));
+    QCOMPARE(copy.responseCode(), reply.responseCode());
+    QCOMPARE(copy.message()->token(), reply.message()->token());
+
+    QVector<QCoapInternalReply> replies;
+    for (int i = 0; i < 16; ++i) {
+        replies.append(reply);
+        replies.last().message()->setMessageId(static_cast<quint16>(i));
+    }
+    for (int i = 0; i < replies.size(); ++i) {
+        QCOMPARE(replies.at(i).message()->messageId(), quint16(i));
+        QCOMPARE(replies.at(i).message()->payload(), QByteArray("abcd"));
+    }
+
+    QCoapInternalReply malformed;
+    QVERIFY(!QCoapInternalReply::createFromFrame(QByteArray::fromHex("5445fb"), &malformed));
+}
+
 void tst_QCoapInternalReply::updateReply_data()
 {
     QTest::addColumn<QByteArray>("data");
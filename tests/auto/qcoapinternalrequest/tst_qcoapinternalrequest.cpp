@@ -40,8 +40,12 @@ class tst_QCoapInternalRequest : public QObject
 private Q_SLOTS:
     void requestToFrame_data();
     void requestToFrame();
+    void optionsToFrame_data();
+    void optionsToFrame();
     void parseUri_data();
     void parseUri();
+    void emptyFrame_data();
+    void emptyFrame();
 };
 
 void tst_QCoapInternalRequest::requestToFrame_data()
@@ -156,6 +160,52 @@ void tst_QCoapInternalRequest::requestToFrame()
     QCOMPARE(internalRequest.toQByteArray().toHex(), pdu);
 }
 
+void tst_QCoapInternalRequest::optionsToFrame_data()
+{
+    qRegisterMetaType<QVector<QCoapOption>>();
+    QTest::addColumn<QVector<QCoapOption>>("options");
+    QTest::addColumn<QString>("pduOptions");
+
+    QTest::newRow("two_bytes_extended_delta")
+        << QVector<QCoapOption>({ QCoapOption(QCoapOption::OptionName(300), "a") })
+        << "e1001f61";
+
+    QTest::newRow("two_bytes_extended_delta_after_option")
+        << QVector<QCoapOption>({
+            QCoapOption(QCoapOption::UriPath, "a"),
+            QCoapOption(QCoapOption::OptionName(1000)) })
+        << "b161e002d0";
+
+    QTest::newRow("two_bytes_extended_length")
+        << QVector<QCoapOption>({
+            QCoapOption(QCoapOption::ProxyUri, QByteArray(300, 'a')) })
+        << "de16001f" + QString(QByteArray(300, 'a').toHex());
+
+    QTest::newRow("unordered_repeated_options")
+        << QVector<QCoapOption>({
+            QCoapOption(QCoapOption::UriPath, "x"),
+            QCoapOption(QCoapOption::ContentFormat),
+            QCoapOption(QCoapOption::UriPath, "y") })
+        << "b178017910";
+}
+
+void tst_QCoapInternalRequest::optionsToFrame()
+{
+    QFETCH(QVector<QCoapOption>, options);
+    QFETCH(QString, pduOptions);
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/"));
+    request.setType(QCoapMessage::NonConfirmable);
+    request.setMethod(QtCoap::Get);
+    request.setMessageId(56400);
+    request.setToken(QByteArray::fromHex("4647f09b"));
+    for (const QCoapOption &option : qAsConst(options))
+        request.addOption(option);
+
+    QCoapInternalRequest internalRequest(request);
+    QCOMPARE(internalRequest.toQByteArray().toHex(), "5401dc504647f09b" + pduOptions.toLatin1());
+}
+
 void tst_QCoapInternalRequest::parseUri_data()
 {
     qRegisterMetaType<QVector<QCoapOption>>();
@@ -212,6 +262,43 @@ void tst_QCoapInternalRequest::parseUri()
     QCOMPARE(options.count(), internalRequest.message()->optionCount());
 }
 
+void tst_QCoapInternalRequest::emptyFrame_data()
+{
+    QTest::addColumn<QCoapMessage::MessageType>("type");
+    QTest::addColumn<QByteArray>("token");
+    QTest::addColumn<QString>("pdu");
+
+    QTest::newRow("acknowledgment")
+        << QCoapMessage::Acknowledgment << QByteArray::fromHex("4647f09b") << "6400dc504647f09b";
+    QTest::newRow("acknowledgment_no_token")
+        << QCoapMessage::Acknowledgment << QByteArray() << "6000dc50";
+    QTest::newRow("acknowledgment_long_token")
+        << QCoapMessage::Acknowledgment << QByteArray::fromHex("0102030405060708")
+        << "6800dc500102030405060708";
+    QTest::newRow("reset")
+        << QCoapMessage::Reset << QByteArray() << "7000dc50";
+}
+
+void tst_QCoapInternalRequest::emptyFrame()
+{
+    QFETCH(QCoapMessage::MessageType, type);
+    QFETCH(QByteArray, token);
+    QFETCH(QString, pdu);
+
+    char buffer[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const int size = QCoapInternalMessagePrivate::encodeEmptyFrame(buffer, type, 56400, token);
+    const QByteArray frame(buffer, size);
+    QCOMPARE(frame.toHex(), pdu.toLatin1());
+
+    // Same frame as the one of an internal request
+    QCoapInternalRequest internalRequest;
+    if (type == QCoapMessage::Reset)
+        internalRequest.initForReset(56400);
+    else
+        internalRequest.initForAcknowledgment(56400, token);
+    QCOMPARE(internalRequest.toQByteArray(), frame);
+}
+
 QTEST_APPLESS_MAIN(tst_QCoapInternalRequest)
 
 #include "tst_qcoapinternalrequest.moc"
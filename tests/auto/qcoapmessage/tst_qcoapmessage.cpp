@@ -92,7 +92,30 @@ void tst_QCoapMessage::setMessageType()
 
 void tst_QCoapMessage::addOption_string()
 {
-    //! TODO with one and more than one identical options
+    QCoapMessage message;
+    message.addOption(QCoapOption::UriQuery, "q=1");
+    message.addOption(QCoapOption::UriPath, "first");
+    message.addOption(QCoapOption::ContentFormat);
+    message.addOption(QCoapOption::UriPath, "second");
+    message.addOption(QCoapOption::OptionName(2048), "big");
+
+    QCOMPARE(message.optionCount(), 5);
+
+    // Options are sorted, repeated options keep their insertion order
+    QCOMPARE(message.option(0).name(), QCoapOption::UriPath);
+    QCOMPARE(message.option(0).value(), QByteArray("first"));
+    QCOMPARE(message.option(1).name(), QCoapOption::UriPath);
+    QCOMPARE(message.option(1).value(), QByteArray("second"));
+    QCOMPARE(message.option(2).name(), QCoapOption::ContentFormat);
+    QCOMPARE(message.option(3).name(), QCoapOption::UriQuery);
+    QCOMPARE(message.option(4).name(), QCoapOption::OptionName(2048));
+
+    QVERIFY(message.hasOption(QCoapOption::UriPath));
+    QVERIFY(message.hasOption(QCoapOption::OptionName(2048)));
+    QVERIFY(!message.hasOption(QCoapOption::UriHost));
+    QVERIFY(!message.hasOption(QCoapOption::OptionName(4096)));
+    QCOMPARE(message.option(QCoapOption::UriPath).value(), QByteArray("first"));
+    QVERIFY(message.findOption(QCoapOption::Block2) == message.options().cend());
 }
 
 void tst_QCoapMessage::addOption_uint_data()
@@ -119,7 +142,41 @@ void tst_QCoapMessage::addOption_uint()
 
 void tst_QCoapMessage::removeOption()
 {
-    //! TODO with one and more than one identical options
+    QCoapMessage message;
+    message.addOption(QCoapOption::UriPath, "first");
+    message.addOption(QCoapOption::UriPath, "second");
+    message.addOption(QCoapOption::UriQuery, "q=1");
+    message.addOption(QCoapOption::OptionName(2048), "big");
+
+    // Removing one of the repeated options keeps the others
+    message.removeOption(QCoapOption(QCoapOption::UriPath, "first"));
+    QCOMPARE(message.optionCount(), 3);
+    QVERIFY(message.hasOption(QCoapOption::UriPath));
+    QCOMPARE(message.option(QCoapOption::UriPath).value(), QByteArray("second"));
+
+    // Removing an option that is not present does nothing
+    message.removeOption(QCoapOption(QCoapOption::UriPath, "third"));
+    QCOMPARE(message.optionCount(), 3);
+
+    message.removeOption(QCoapOption(QCoapOption::UriPath, "second"));
+    QVERIFY(!message.hasOption(QCoapOption::UriPath));
+
+    message.addOption(QCoapOption::UriQuery, "q=2");
+    message.removeOption(QCoapOption::UriQuery);
+    QVERIFY(!message.hasOption(QCoapOption::UriQuery));
+    QCOMPARE(message.optionCount(), 1);
+
+    message.removeAllOptions();
+    QVERIFY(!message.hasOption(QCoapOption::OptionName(2048)));
+    QCOMPARE(message.optionCount(), 0);
+
+    // Copies keep the presence of options
+    message.addOption(QCoapOption::ContentFormat);
+    QCoapMessage copy(message);
+    QVERIFY(copy.hasOption(QCoapOption::ContentFormat));
+    copy.removeOption(QCoapOption::ContentFormat);
+    QVERIFY(!copy.hasOption(QCoapOption::ContentFormat));
+    QVERIFY(message.hasOption(QCoapOption::ContentFormat));
 }
 
 void tst_QCoapMessage::urlOptions()
@@ -30,6 +30,7 @@
 #include <QtTest>
 
 #include <QtCoap/qcoapoption.h>
+#include <private/qcoapoption_p.h>
 
 class tst_QCoapOption : public QObject
 {
@@ -40,7 +41,13 @@ private Q_SLOTS:
     void constructWithQStringView();
     void constructWithCString();
     void constructWithInteger();
+    void integerByteOrder_data();
+    void integerByteOrder();
     void constructWithUtf8Characters();
+    void valueSizes_data();
+    void valueSizes();
+    void copyMoveAndSwap();
+    void optionRegistry();
 };
 
 void tst_QCoapOption::constructWithQByteArray()
@@ -75,6 +82,28 @@ void tst_QCoapOption::constructWithInteger()
     QCOMPARE(option.valueToInt(), value);
 }
 
+void tst_QCoapOption::integerByteOrder_data()
+{
+    QTest::addColumn<quint32>("value");
+    QTest::addColumn<QByteArray>("encoded");
+
+    QTest::newRow("zero") << quint32(0) << QByteArray();
+    QTest::newRow("1 byte") << quint32(0x80) << QByteArray::fromHex("80");
+    QTest::newRow("2 bytes") << quint32(5683) << QByteArray::fromHex("1633");
+    QTest::newRow("3 bytes") << quint32(0x300010) << QByteArray::fromHex("300010");
+    QTest::newRow("4 bytes") << quint32(0xF0AF0010) << QByteArray::fromHex("f0af0010");
+}
+
+void tst_QCoapOption::integerByteOrder()
+{
+    QFETCH(quint32, value);
+    QFETCH(QByteArray, encoded);
+
+    QCoapOption option(QCoapOption::Size1, value);
+    QCOMPARE(option.value(), encoded);
+    QCOMPARE(option.valueToInt(), value);
+}
+
 void tst_QCoapOption::constructWithUtf8Characters()
 {
     QByteArray ba = "\xc3\xa9~\xce\xbb\xe2\x82\xb2";
@@ -83,6 +112,77 @@ void tst_QCoapOption::constructWithUtf8Characters()
     QCOMPARE(option.value(), ba);
 }
 
+void tst_QCoapOption::valueSizes_data()
+{
+    QTest::addColumn<QByteArray>("value");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short") << QByteArray("abc");
+    QTest::newRow("20 bytes") << QByteArray(20, 'a');
+    QTest::newRow("21 bytes") << QByteArray(21, 'b');
+    QTest::newRow("255 bytes") << QByteArray(255, 'c');
+}
+
+void tst_QCoapOption::valueSizes()
+{
+    QFETCH(QByteArray, value);
+
+    QCoapOption option(QCoapOption::UriPath, value);
+    QCOMPARE(option.value(), value);
+    QCOMPARE(option.length(), value.size());
+    QCOMPARE(QByteArray(option.constData(), option.length()), value);
+
+    const QByteArray copy = value;
+    QCoapOption fromCString(QCoapOption::UriPath, copy.constData());
+    QCOMPARE(fromCString, option);
+}
+
+void tst_QCoapOption::copyMoveAndSwap()
+{
+    QCoapOption shortOption(QCoapOption::Etag, QByteArray("etag"));
+    QCoapOption longOption(QCoapOption::ProxyUri, QByteArray(100, 'p'));
+
+    QCoapOption copy(shortOption);
+    QCOMPARE(copy, shortOption);
+    copy = longOption;
+    QCOMPARE(copy, longOption);
+    QVERIFY(copy != shortOption);
+
+    QCoapOption moved(std::move(copy));
+    QCOMPARE(moved, longOption);
+
+    moved.swap(shortOption);
+    QCOMPARE(moved.name(), QCoapOption::Etag);
+    QCOMPARE(moved.value(), QByteArray("etag"));
+    QCOMPARE(shortOption, longOption);
+
+    QCoapOption assigned;
+    QVERIFY(!assigned.isValid());
+    assigned = std::move(moved);
+    QCOMPARE(assigned.value(), QByteArray("etag"));
+}
+
+void tst_QCoapOption::optionRegistry()
+{
+    const QCoapOptionInfo uriPath = qCoapOptionInfo(QCoapOption::UriPath);
+    QCOMPARE(uriPath.format, QCoapOptionInfo::String);
+    QVERIFY(uriPath.repeatable);
+    QVERIFY(uriPath.acceptsLength(255));
+    QVERIFY(!uriPath.acceptsLength(256));
+
+    const QCoapOptionInfo etag = qCoapOptionInfo(QCoapOption::Etag);
+    QVERIFY(!etag.acceptsLength(0));
+    QVERIFY(etag.acceptsLength(8));
+
+    QVERIFY(!qCoapOptionInfo(QCoapOption::Observe).repeatable);
+    QVERIFY(!qCoapOptionInfo(2).isRegistered());
+    QVERIFY(!qCoapOptionInfo(2048).isRegistered());
+    QVERIFY(qCoapOptionInfo(2048).acceptsLength(2000));
+
+    QVERIFY(QCoapOptionInfo::isCritical(QCoapOption::UriHost));
+    QVERIFY(!QCoapOptionInfo::isCritical(QCoapOption::Etag));
+}
+
 QTEST_APPLESS_MAIN(tst_QCoapOption)
 
 #include "tst_qcoapoption.moc"
@@ -0,0 +1,262 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+#include <QtNetwork/qnetworkdatagram.h>
+
+#include <QtCoap/qcoapconnection.h>
+#include <QtCoap/qcoapreply.h>
+#include <private/qcoapprotocol_p.h>
+#include <private/qcoapinternalrequest_p.h>
+
+class tst_QCoapProtocol : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void separateResponse_data();
+    void separateResponse();
+    void retransmissionTimers();
+    void throttledRequestTimers();
+    void requestPool();
+};
+
+static QCoapProtocolPrivate *protocolPrivate(QCoapProtocol *protocol)
+{
+    return static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+}
+
+void tst_QCoapProtocol::initTestCase()
+{
+    qRegisterMetaType<QCoapMessage>();
+    qRegisterMetaType<QtCoap::Error>();
+    qRegisterMetaType<QtCoap::ResponseCode>();
+    qRegisterMetaType<QCoapToken>("QCoapToken");
+    qRegisterMetaType<QCoapMessageId>("QCoapMessageId");
+}
+
+void tst_QCoapProtocol::separateResponse_data()
+{
+    QTest::addColumn<bool>("responseLost");
+
+    QTest::newRow("response") << false;
+    QTest::newRow("response_lost") << true;
+}
+
+// The server acknowledges the request with an empty acknowledgment, then
+// sends the response, or never does.
+void tst_QCoapProtocol::separateResponse()
+{
+    QFETCH(bool, responseLost);
+
+    const QHostAddress server("10.20.30.40");
+    QCoapProtocol protocol;
+    protocol.setAckTimeout(100);
+    protocol.setSeparateResponseTimeout(1000);
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    QCoapConnection connection;
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/separate"), QCoapMessage::Confirmable);
+    request.setMethod(QtCoap::Get);
+    QCoapReply reply(request);
+    QSignalSpy spyReplyFinished(&reply, SIGNAL(finished(QCoapReply *)));
+    protocol.sendRequest(&reply, &connection);
+
+    QCOMPARE(d->exchangeMap.size(), 1);
+    QCoapInternalRequest *internalRequest = d->exchangeMap.first().request;
+    QCOMPARE(internalRequest->exchangeState(), QCoapInternalRequest::WaitingAcknowledgment);
+    const quint16 messageId = internalRequest->message()->messageId();
+    const QCoapToken token = internalRequest->token();
+
+    // The empty acknowledgment stops the retransmissions, and is not stored
+    char ackFrame[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const int ackSize = QCoapInternalMessagePrivate::encodeEmptyFrame(
+                ackFrame, QCoapMessage::Acknowledgment, messageId);
+    QNetworkDatagram ack(QByteArray(ackFrame, ackSize));
+    ack.setSender(server, QtCoap::DefaultPort);
+    d->onFrameReceived(ack);
+
+    QCOMPARE(internalRequest->exchangeState(), QCoapInternalRequest::WaitingSeparateResponse);
+    QCOMPARE(internalRequest->timerId(QCoapInternalRequest::RetransmissionTimer), quint64(0));
+    QVERIFY(d->exchangeMap.first().replies.isEmpty());
+
+    // A duplicate acknowledgment changes nothing
+    d->onFrameReceived(ack);
+    QCOMPARE(internalRequest->exchangeState(), QCoapInternalRequest::WaitingSeparateResponse);
+
+    QTest::qWait(500);
+    QCOMPARE(d->statistics.snapshot().retransmissions(), quint64(0));
+    QVERIFY(d->isTokenRegistered(token));
+
+    if (responseLost) {
+        QTRY_COMPARE(spyReplyFinished.count(), 1);
+        QCOMPARE(reply.errorReceived(), QtCoap::TimeOutError);
+        QCOMPARE(d->statistics.snapshot().timeouts(), quint64(1));
+    } else {
+        QCoapMessage response;
+        response.setType(QCoapMessage::Confirmable);
+        response.setMessageId(static_cast<quint16>(messageId + 1));
+        response.setToken(token);
+        response.setPayload("separate");
+        QNetworkDatagram frame(QCoapInternalMessagePrivate::encodeFrame(response,
+                                                                         QtCoap::Content));
+        frame.setSender(server, QtCoap::DefaultPort);
+        const quint64 bytesSent = d->statistics.snapshot().bytesSent();
+        d->onFrameReceived(frame);
+
+        QTRY_COMPARE(spyReplyFinished.count(), 1);
+        QCOMPARE(reply.responseCode(), QtCoap::Content);
+        QCOMPARE(reply.readAll(), QByteArray("separate"));
+
+        // The confirmable response is acknowledged
+        QCOMPARE(d->statistics.snapshot().bytesSent() - bytesSent,
+                 quint64(4 + token.size()));
+    }
+    QVERIFY(!d->isTokenRegistered(token));
+}
+
+// The request is never answered: the timers run by the protocol retransmit
+// it, then end the exchange with a timeout.
+void tst_QCoapProtocol::retransmissionTimers()
+{
+    QCoapProtocol protocol;
+    protocol.setAckTimeout(50);
+    protocol.setMaxRetransmit(2);
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    QCoapConnection connection;
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/lost"), QCoapMessage::Confirmable);
+    request.setMethod(QtCoap::Get);
+    QCoapReply reply(request);
+    QSignalSpy spyReplyFinished(&reply, SIGNAL(finished(QCoapReply *)));
+    protocol.sendRequest(&reply, &connection);
+
+    QCoapInternalRequest *internalRequest = d->exchangeMap.first().request;
+    QVERIFY(internalRequest->timerId(QCoapInternalRequest::RetransmissionTimer) != 0);
+    QVERIFY(internalRequest->timerId(QCoapInternalRequest::ExchangeTimer) != 0);
+
+    QTRY_COMPARE(spyReplyFinished.count(), 1);
+    QCOMPARE(reply.errorReceived(), QtCoap::TimeOutError);
+    QCOMPARE(d->statistics.snapshot().retransmissions(), quint64(2));
+    QCOMPARE(d->statistics.snapshot().timeouts(), quint64(1));
+    QVERIFY(d->exchangeMap.isEmpty());
+    QCOMPARE(d->requestPool.size(), 0);
+}
+
+// With the default PROBING_RATE, the second non-confirmable request to an
+// endpoint that never answered is held back. Its timers only start once
+// it is sent, so that it does not time out while it waits.
+void tst_QCoapProtocol::throttledRequestTimers()
+{
+    const QHostAddress server("10.20.30.40");
+    QCoapProtocol protocol;
+    protocol.setAckTimeout(100);
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    QCoapConnection connection;
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/silent"), QCoapMessage::NonConfirmable);
+    request.setMethod(QtCoap::Get);
+    QCoapReply firstReply(request);
+    QCoapReply secondReply(request);
+    QSignalSpy spyFirstFinished(&firstReply, SIGNAL(finished(QCoapReply *)));
+    QSignalSpy spySecondFinished(&secondReply, SIGNAL(finished(QCoapReply *)));
+    protocol.sendRequest(&firstReply, &connection);
+    protocol.sendRequest(&secondReply, &connection);
+
+    QCoapInternalRequest *heldRequest = nullptr;
+    for (const CoapExchangeData &exchange : qAsConst(d->exchangeMap)) {
+        if (exchange.userReply == &secondReply)
+            heldRequest = exchange.request;
+    }
+    QVERIFY(heldRequest);
+    QCOMPARE(d->throttledFrames.size(), 1);
+    QCOMPARE(heldRequest->exchangeState(), QCoapInternalRequest::Idle);
+    QCOMPARE(heldRequest->timerId(QCoapInternalRequest::RetransmissionTimer), quint64(0));
+    QCOMPARE(heldRequest->timerId(QCoapInternalRequest::ExchangeTimer), quint64(0));
+    QCOMPARE(d->statistics.snapshot().requestsSent(), quint64(1));
+
+    // The first request times out, the second one still waits
+    QTRY_COMPARE(spyFirstFinished.count(), 1);
+    QCOMPARE(firstReply.errorReceived(), QtCoap::TimeOutError);
+    QTest::qWait(500);
+    QCOMPARE(spySecondFinished.count(), 0);
+    QVERIFY(d->isRequestRegistered(heldRequest));
+    QCOMPARE(d->statistics.snapshot().timeouts(), quint64(1));
+
+    // Once the endpoint answered, the request is sent and its timers start
+    char resetFrame[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const int resetSize = QCoapInternalMessagePrivate::encodeEmptyFrame(
+                resetFrame, QCoapMessage::Reset, 1);
+    QNetworkDatagram answer(QByteArray(resetFrame, resetSize));
+    answer.setSender(server, QtCoap::DefaultPort);
+    d->onEndpointAnswered(answer);
+
+    QVERIFY(d->throttledFrames.isEmpty());
+    QCOMPARE(heldRequest->exchangeState(), QCoapInternalRequest::WaitingAcknowledgment);
+    QVERIFY(heldRequest->timerId(QCoapInternalRequest::ExchangeTimer) != 0);
+    QCOMPARE(d->statistics.snapshot().requestsSent(), quint64(2));
+
+    QTRY_COMPARE(spySecondFinished.count(), 1);
+    QCOMPARE(secondReply.errorReceived(), QtCoap::TimeOutError);
+    QCOMPARE(d->statistics.snapshot().retransmissions(), quint64(0));
+}
+
+// The internal requests are stored in the pool of the protocol, and the
+// slot of a finished exchange is used by the next one.
+void tst_QCoapProtocol::requestPool()
+{
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    QCoapConnection connection;
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/pool"), QCoapMessage::Confirmable);
+    request.setMethod(QtCoap::Get);
+
+    QCoapReply firstReply(request);
+    protocol.sendRequest(&firstReply, &connection);
+    QCOMPARE(d->requestPool.size(), 1);
+    QCoapInternalRequest *firstRequest = d->exchangeMap.first().request;
+    const QCoapToken firstToken = firstRequest->token();
+
+    d->onRequestAborted(firstToken);
+    QVERIFY(!d->isTokenRegistered(firstToken));
+    QCOMPARE(d->requestPool.size(), 0);
+
+    QCoapReply secondReply(request);
+    protocol.sendRequest(&secondReply, &connection);
+    QCOMPARE(d->requestPool.size(), 1);
+    QCOMPARE(d->exchangeMap.first().request, firstRequest);
+    QCOMPARE(d->requestPool.capacity(), 64);
+}
+
+QTEST_GUILESS_MAIN(tst_QCoapProtocol)
+
+#include "tst_qcoapprotocol.moc"
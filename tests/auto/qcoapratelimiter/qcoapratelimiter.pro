@@ -0,0 +1,5 @@
+QT = testlib core-private network core coap coap-private
+CONFIG += testcase
+
+SOURCES += \
+    tst_qcoapratelimiter.cpp
@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoapratelimiter_p.h>
+
+namespace {
+const qint64 second = 1000000000;
+}
+
+class tst_QCoapRateLimiter : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void noLimit();
+    void messageRate();
+    void byteRate();
+    void refillIsCapped();
+    void probingRate();
+    void endpointLimits();
+};
+
+void tst_QCoapRateLimiter::noLimit()
+{
+    QCoapRateLimiter limiter;
+    const QHostAddress host("10.20.30.40");
+
+    for (int i = 0; i < 100; ++i)
+        QCOMPARE(limiter.acquire(host, 5683, 1024, false, 0), qint64(0));
+}
+
+void tst_QCoapRateLimiter::messageRate()
+{
+    QCoapRateLimiter limiter;
+    limiter.setDefaultLimit({0, 2});
+    const QHostAddress host("10.20.30.40");
+
+    // The bucket holds one second of messages, and may go one message in debt
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(limiter.acquire(host, 5683, 10, false, 0), qint64(0));
+
+    // A refused frame takes nothing from the bucket
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, 0), second / 2);
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, second / 4), second / 4);
+
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, second / 2), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, second / 2), second / 2);
+
+    // Other endpoints have their own bucket
+    QCOMPARE(limiter.acquire(host, 5684, 10, false, 0), qint64(0));
+}
+
+void tst_QCoapRateLimiter::byteRate()
+{
+    QCoapRateLimiter limiter;
+    limiter.setDefaultLimit({100, 0});
+    const QHostAddress host("10.20.30.40");
+
+    QCOMPARE(limiter.acquire(host, 5683, 60, false, 0), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 60, false, 0), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 60, false, 0), second / 5);
+    QCOMPARE(limiter.acquire(host, 5683, 60, false, second / 5), qint64(0));
+
+    // A frame larger than the bucket is only delayed
+    QCOMPARE(limiter.acquire(host, 5683, 1000, false, 2 * second), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, 2 * second), 9 * second);
+}
+
+void tst_QCoapRateLimiter::refillIsCapped()
+{
+    QCoapRateLimiter limiter;
+    limiter.setDefaultLimit({0, 2});
+    const QHostAddress host("10.20.30.40");
+
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(limiter.acquire(host, 5683, 10, false, 0), qint64(0));
+
+    // Ten idle seconds only refill one second of messages
+    const qint64 later = 10 * second;
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(limiter.acquire(host, 5683, 10, false, later), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 10, false, later), second / 2);
+}
+
+void tst_QCoapRateLimiter::probingRate()
+{
+    QCoapRateLimiter limiter;
+    const QHostAddress host("10.20.30.40");
+    QCOMPARE(limiter.probingRate(), 1.0);
+    QVERIFY(!limiter.isAnswered(host, 5683));
+
+    // Non-confirmable frames are limited until the endpoint answers
+    QCOMPARE(limiter.acquire(host, 5683, 20, true, 0), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5683, 20, true, 0), 19 * second);
+    QCOMPARE(limiter.acquire(host, 5683, 20, false, 0), qint64(0));
+
+    QVERIFY(limiter.setAnswered(host, 5683));
+    QVERIFY(!limiter.setAnswered(host, 5683));
+    QVERIFY(limiter.isAnswered(host, 5683));
+    QCOMPARE(limiter.acquire(host, 5683, 20, true, 0), qint64(0));
+
+    limiter.setProbingRate(0);
+    QCOMPARE(limiter.probingRate(), 0.0);
+    QCOMPARE(limiter.acquire(host, 5684, 20, true, 0), qint64(0));
+    QCOMPARE(limiter.acquire(host, 5684, 20, true, 0), qint64(0));
+}
+
+void tst_QCoapRateLimiter::endpointLimits()
+{
+    QCoapRateLimiter limiter;
+    limiter.setDefaultLimit({0, 10});
+    limiter.setLimit(QHostAddress("::ffff:10.20.30.40"), 5683, {500, 1});
+
+    const QCoapRateLimiter::Limit mapped = limiter.limit(QHostAddress("10.20.30.40"), 5683);
+    QCOMPARE(mapped.bytesPerSecond, 500.0);
+    QCOMPARE(mapped.messagesPerSecond, 1.0);
+
+    const QCoapRateLimiter::Limit other = limiter.limit(QHostAddress("10.20.30.40"), 5684);
+    QCOMPARE(other.bytesPerSecond, 0.0);
+    QCOMPARE(other.messagesPerSecond, 10.0);
+
+    QCOMPARE(QCoapRateLimiter::endpointKey(QHostAddress("::ffff:10.20.30.40"), 5683),
+             QCoapRateLimiter::endpointKey(QHostAddress("10.20.30.40"), 5683));
+    QVERIFY(QCoapRateLimiter::endpointKey(QHostAddress("10.20.30.40"), 5683)
+            != QCoapRateLimiter::endpointKey(QHostAddress("10.20.30.40"), 5684));
+}
+
+QTEST_APPLESS_MAIN(tst_QCoapRateLimiter)
+
+#include "tst_qcoapratelimiter.moc"
@@ -129,6 +129,7 @@ void tst_QCoapRequest::copyAndDetach()
     a.setType(QCoapMessage::Acknowledgment);
     a.setVersion(5);
     a.setMethod(QtCoap::Delete);
+    a.setPriority(QCoapRequest::CriticalPriority);
     QUrl testUrl("coap://url:500/resource");
     a.setUrl(testUrl);
     QUrl testProxyUrl("test://proxyurl");
@@ -147,6 +148,12 @@ void tst_QCoapRequest::copyAndDetach()
     QVERIFY2(c.method() == QtCoap::Delete, "Request not copied correctly");
     QVERIFY2(c.url() == testUrl, "Request not copied correctly");
     QVERIFY2(c.proxyUrl() == testProxyUrl, "Request not copied correctly");
+    QVERIFY2(c.priority() == QCoapRequest::CriticalPriority, "Request not copied correctly");
+
+    // The method override keeps the priority
+    QCoapRequest d(a, QtCoap::Get);
+    QCOMPARE(d.priority(), QCoapRequest::CriticalPriority);
+    QCOMPARE(QCoapRequest().priority(), QCoapRequest::NormalPriority);
 
     // Detach
     c.setMessageId(9);
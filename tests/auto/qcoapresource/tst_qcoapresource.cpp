@@ -32,6 +32,8 @@
 
 #include <QtCoap/qcoapresource.h>
 #include <QtCoap/qcoapprotocol.h>
+#include <private/qcoaplinkformatparser_p.h>
+#include <private/qcoapattributepool_p.h>
 
 class tst_QCoapResource : public QObject
 {
@@ -40,6 +42,11 @@ class tst_QCoapResource : public QObject
 private Q_SLOTS:
     void parseCoreLink_data();
     void parseCoreLink();
+    void parseLinkFormatSyntax_data();
+    void parseLinkFormatSyntax();
+    void parseInBlocks_data();
+    void parseInBlocks();
+    void internedAttributes();
 };
 
 void tst_QCoapResource::parseCoreLink_data()
@@ -161,6 +168,154 @@ void tst_QCoapResource::parseCoreLink()
     }
 }
 
+void tst_QCoapResource::parseLinkFormatSyntax_data()
+{
+    QTest::addColumn<QByteArray>("coreLinkList");
+    QTest::addColumn<QStringList>("pathList");
+    QTest::addColumn<QString>("title");
+    QTest::addColumn<QString>("resourceType");
+    QTest::addColumn<uint>("contentFormat");
+    QTest::addColumn<int>("maximumSize");
+
+    QTest::newRow("quoted_delimiters")
+            << QByteArray("</a>;title=\"x, y; z\";rt=\"t\",</b>")
+            << QStringList({ "/a", "/b" }) << "x, y; z" << "t" << 0u << -1;
+    QTest::newRow("quoted_pairs")
+            << QByteArray("</a>;title=\"say \\\"hi\\\" \\\\o/\",</b>")
+            << QStringList({ "/a", "/b" }) << "say \"hi\" \\o/" << "" << 0u << -1;
+    QTest::newRow("spaces")
+            << QByteArray("  </a> ; ct = 40 ;\tsz=12 ,\r\n</b>")
+            << QStringList({ "/a", "/b" }) << "" << "" << 40u << 12;
+    QTest::newRow("content_format_list")
+            << QByteArray("</a>;ct=\"41 0\"")
+            << QStringList({ "/a" }) << "" << "" << 41u << -1;
+    QTest::newRow("unknown_parameters")
+            << QByteArray("</a>;anchor=\"/x,y\";title*=utf-8'en'z;foo;rt=bar")
+            << QStringList({ "/a" }) << "" << "bar" << 0u << -1;
+    QTest::newRow("malformed_link")
+            << QByteArray("garbage;title=\"</c>,\",</a>;title=ok,</b")
+            << QStringList({ "/a" }) << "ok" << "" << 0u << -1;
+    QTest::newRow("unterminated_quote")
+            << QByteArray("</a>;title=\"no end,</b>")
+            << QStringList({ "/a" }) << "no end,</b>" << "" << 0u << -1;
+    QTest::newRow("long_title")
+            << QByteArray("</a>;title=\"") + QByteArray(100, 'x') + QByteArray(",;\"")
+            << QStringList({ "/a" }) << QString(100, 'x') + ",;" << "" << 0u << -1;
+    QTest::newRow("empty") << QByteArray() << QStringList() << "" << "" << 0u << -1;
+}
+
+void tst_QCoapResource::parseLinkFormatSyntax()
+{
+    QFETCH(QByteArray, coreLinkList);
+    QFETCH(QStringList, pathList);
+    QFETCH(QString, title);
+    QFETCH(QString, resourceType);
+    QFETCH(uint, contentFormat);
+    QFETCH(int, maximumSize);
+
+    const QVector<QCoapResource> resourceList =
+            QCoapProtocol::resourcesFromCoreLinkList(QHostAddress::LocalHost, coreLinkList);
+
+    QCOMPARE(resourceList.size(), pathList.size());
+    for (int i = 0; i < resourceList.size(); ++i)
+        QCOMPARE(resourceList.at(i).path(), pathList.at(i));
+
+    if (resourceList.isEmpty())
+        return;
+
+    // Attributes are checked on the first link
+    const QCoapResource &resource = resourceList.first();
+    QCOMPARE(resource.title(), title);
+    QCOMPARE(resource.resourceType(), resourceType);
+    QCOMPARE(resource.contentFormat(), contentFormat);
+    QCOMPARE(resource.maximumSize(), maximumSize);
+}
+
+void tst_QCoapResource::parseInBlocks_data()
+{
+    parseLinkFormatSyntax_data();
+}
+
+void tst_QCoapResource::parseInBlocks()
+{
+    QFETCH(QByteArray, coreLinkList);
+
+    const QVector<QCoapResource> expected =
+            QCoapProtocol::resourcesFromCoreLinkList(QHostAddress::LocalHost, coreLinkList);
+
+    // Split the list at every position, including inside quoted strings
+    for (int split = 0; split <= coreLinkList.size(); ++split) {
+        QCoapLinkFormatParser parser(QHostAddress::LocalHost);
+        QVector<QCoapResource> resourceList = parser.feed(coreLinkList.left(split));
+        resourceList.append(parser.feed(coreLinkList.mid(split)));
+        resourceList.append(parser.finish());
+
+        QCOMPARE(resourceList.size(), expected.size());
+        for (int i = 0; i < resourceList.size(); ++i) {
+            QCOMPARE(resourceList.at(i).path(), expected.at(i).path());
+            QCOMPARE(resourceList.at(i).title(), expected.at(i).title());
+            QCOMPARE(resourceList.at(i).resourceType(), expected.at(i).resourceType());
+            QCOMPARE(resourceList.at(i).contentFormat(), expected.at(i).contentFormat());
+            QCOMPARE(resourceList.at(i).maximumSize(), expected.at(i).maximumSize());
+        }
+    }
+
+    // Links are reported as soon as they are complete
+    QCoapLinkFormatParser parser(QHostAddress::LocalHost);
+    QCOMPARE(parser.feed("</a>;title=\"x,").size(), 0);
+    QCOMPARE(parser.feed("y\",</b").size(), 1);
+    QCOMPARE(parser.feed(">;rt=t").size(), 0);
+    const QVector<QCoapResource> last = parser.finish();
+    QCOMPARE(last.size(), 1);
+    QCOMPARE(last.first().path(), QString("/b"));
+    QCOMPARE(last.first().resourceType(), QString("t"));
+    QCOMPARE(parser.finish().size(), 0);
+}
+
+void tst_QCoapResource::internedAttributes()
+{
+    const QByteArray coreLinkList = "</s/1>;rt=\"temperature-c\";if=\"sensor\","
+                                    "</s/2>;rt=\"temperature-c\";if=\"sensor\","
+                                    "</s/3>;rt=\"temp\\erature-c\";if=sensor";
+    const QVector<QCoapResource> resources =
+            QCoapLinkFormatParser::parse(QHostAddress::LocalHost, coreLinkList);
+    QCOMPARE(resources.size(), 3);
+
+    // Repeated values share their storage, escaped or not
+    for (const QCoapResource &resource : resources) {
+        QCOMPARE(resource.resourceType(), QString("temperature-c"));
+        QCOMPARE(resource.interface(), QString("sensor"));
+        QCOMPARE(resource.resourceType().constData(),
+                 resources.first().resourceType().constData());
+        QCOMPARE(resource.interface().constData(), resources.first().interface().constData());
+    }
+
+    // Each parser has its own pool
+    const QVector<QCoapResource> other =
+            QCoapLinkFormatParser::parse(QHostAddress::LocalHost, coreLinkList);
+    QCOMPARE(other.first().resourceType(), resources.first().resourceType());
+    QVERIFY(other.first().resourceType().constData()
+            != resources.first().resourceType().constData());
+
+    QCoapAttributePool pool;
+    const QString sensor = pool.intern("sensor", 6);
+    QCOMPARE(sensor, QString("sensor"));
+    QCOMPARE(pool.intern(QString("sen") + QString("sor")).constData(), sensor.constData());
+    QCOMPARE(pool.intern("sensor", 6).constData(), sensor.constData());
+    QCOMPARE(pool.size(), 1);
+    QVERIFY(pool.intern(QString()).isNull());
+    QCOMPARE(pool.size(), 1);
+
+    // Values beyond the maximum size are not pooled
+    for (int i = pool.size(); i < QCoapAttributePool::MaximumSize; ++i)
+        pool.intern(QString::number(i));
+    QCOMPARE(int(pool.size()), int(QCoapAttributePool::MaximumSize));
+    const QString extra = pool.intern("extra", 5);
+    QCOMPARE(extra, QString("extra"));
+    QVERIFY(pool.intern("extra", 5).constData() != extra.constData());
+    QCOMPARE(int(pool.size()), int(QCoapAttributePool::MaximumSize));
+}
+
 QTEST_APPLESS_MAIN(tst_QCoapResource)
 
 #include "tst_qcoapresource.moc"
@@ -0,0 +1,4 @@
+QT = testlib core-private network core coap coap-private
+CONFIG += testcase
+
+SOURCES += tst_qcoapresourcedirectory.cpp
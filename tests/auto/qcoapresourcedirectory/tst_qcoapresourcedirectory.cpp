@@ -0,0 +1,366 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapresourcedirectory.h>
+#include <QtCoap/qcoapserver.h>
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qurlquery.h>
+
+class tst_QCoapResourceDirectory : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void registration();
+    void refreshExpiredRegistration();
+    void lookupFromIndex();
+    void lookupRevalidation();
+    void endpointLookup();
+    void lookupError();
+
+private:
+    QUrl directoryUrl() const;
+    QByteArray link(const QString &path, const QByteArray &attributes,
+                    const QByteArray &host = "127.0.0.2") const;
+    QtCoap::ResponseCode lookupPage(const QCoapRequest &request, QCoapMessage *response);
+
+    QCoapServer *server = nullptr;
+    QCoapClient *client = nullptr;
+    QCoapResourceDirectory *directory = nullptr;
+
+    // State of the directory served by the test server
+    QString registrationQuery;
+    QByteArray registrationPayload;
+    int refreshCount = 0;
+    QVector<QByteArray> lookupLinks;
+    quint32 lookupMaxAge = 60;
+    int lookupRequests = 0;
+    int lookupTransfers = 0;
+};
+
+void tst_QCoapResourceDirectory::init()
+{
+    qRegisterMetaType<QVector<QCoapResource>>();
+
+    registrationQuery.clear();
+    registrationPayload.clear();
+    refreshCount = 0;
+    lookupLinks.clear();
+    lookupMaxAge = 60;
+    lookupRequests = 0;
+    lookupTransfers = 0;
+
+    server = new QCoapServer;
+    server->addResource("/rd", QtCoap::Post, [this](const QCoapRequest &request,
+                                                    QCoapMessage *response) {
+        registrationQuery = request.url().query();
+        registrationPayload = request.payload();
+        response->addOption(QCoapOption::LocationPath, "rd");
+        response->addOption(QCoapOption::LocationPath, "4521");
+        return QtCoap::Created;
+    });
+    server->addResource("/rd/4521", QtCoap::Post, [this](const QCoapRequest &request,
+                                                         QCoapMessage *) {
+        ++refreshCount;
+        registrationQuery = request.url().query();
+        return QtCoap::Changed;
+    });
+    server->addResource("/rd-lookup/res", QtCoap::Get, [this](const QCoapRequest &request,
+                                                              QCoapMessage *response) {
+        return lookupPage(request, response);
+    });
+    server->addResource("/rd-lookup/ep", QtCoap::Get, [this](const QCoapRequest &,
+                                                             QCoapMessage *response) {
+        response->setPayload("</rd/4521>;ep=\"node1\";base=\"coap://127.0.0.2:5683\";lt=600,"
+                             "</rd/4522>;ep=\"node2\";base=\"coap://127.0.0.3:5683\";lt=1");
+        return QtCoap::Content;
+    });
+    QVERIFY(server->listen(QHostAddress::LocalHost, 0));
+
+    client = new QCoapClient;
+    directory = new QCoapResourceDirectory(client, directoryUrl());
+}
+
+void tst_QCoapResourceDirectory::cleanup()
+{
+    delete directory;
+    directory = nullptr;
+    delete client;
+    client = nullptr;
+    delete server;
+    server = nullptr;
+}
+
+QUrl tst_QCoapResourceDirectory::directoryUrl() const
+{
+    return QUrl(QStringLiteral("coap://127.0.0.1:") + QString::number(server->serverPort()));
+}
+
+QByteArray tst_QCoapResourceDirectory::link(const QString &path, const QByteArray &attributes,
+                                            const QByteArray &host) const
+{
+    return "<coap://" + host + ":5683" + path.toUtf8() + ">;" + attributes;
+}
+
+// Serves the links matching the rt filter, a page at a time, with an ETag
+// computed from the content of the page.
+QtCoap::ResponseCode tst_QCoapResourceDirectory::lookupPage(const QCoapRequest &request,
+                                                            QCoapMessage *response)
+{
+    ++lookupRequests;
+
+    const QUrlQuery query(request.url());
+    const QByteArray resourceType = query.queryItemValue("rt").toUtf8();
+    QVector<QByteArray> links;
+    for (const QByteArray &link : qAsConst(lookupLinks)) {
+        const int start = link.indexOf("rt=\"") + 4;
+        const QByteArray types = link.mid(start, link.indexOf('"', start) - start);
+        if (resourceType.isEmpty() || types.split(' ').contains(resourceType))
+            links.append(link);
+    }
+
+    if (query.hasQueryItem("count")) {
+        const int count = query.queryItemValue("count").toInt();
+        links = links.mid(query.queryItemValue("page").toInt() * count, count);
+    }
+
+    QByteArray payload;
+    for (const QByteArray &link : qAsConst(links))
+        payload.append(payload.isEmpty() ? "" : ",").append(link);
+
+    const QByteArray etag = QCryptographicHash::hash(payload, QCryptographicHash::Md5).left(4);
+    response->addOption(QCoapOption(QCoapOption::MaxAge, lookupMaxAge));
+    response->addOption(QCoapOption::Etag, etag);
+    if (request.option(QCoapOption::Etag).value() == etag)
+        return QtCoap::Valid;
+
+    ++lookupTransfers;
+    response->setPayload(payload);
+    return QtCoap::Content;
+}
+
+void tst_QCoapResourceDirectory::registration()
+{
+    QCoapResource temperature;
+    temperature.setPath("/sensors/temp");
+    temperature.setResourceType("temperature-c");
+    temperature.setObservable(true);
+    QCoapResource light;
+    light.setPath("/sensors/light");
+    light.setInterface("sensor");
+
+    QSignalSpy spyRegistered(directory, &QCoapResourceDirectory::registered);
+    directory->registerEndpoint("node1", { temperature, light }, 600);
+    QTRY_COMPARE_WITH_TIMEOUT(spyRegistered.count(), 1, 5000);
+
+    const QUrl registrationUrl = directoryUrl().resolved(QUrl("/rd/4521"));
+    QCOMPARE(spyRegistered.first().first().toUrl(), registrationUrl);
+    QCOMPARE(directory->registrationUrl(), registrationUrl);
+    QVERIFY(directory->isRegistered());
+    QCOMPARE(directory->endpointName(), QString("node1"));
+    QCOMPARE(registrationQuery, QString("ep=node1&lt=600"));
+    QCOMPARE(registrationPayload,
+             QByteArray("</sensors/temp>;rt=\"temperature-c\";obs,</sensors/light>;if=\"sensor\""));
+
+    QSignalSpy spyRefreshed(directory, &QCoapResourceDirectory::registrationRefreshed);
+    directory->refreshRegistration(300);
+    QTRY_COMPARE_WITH_TIMEOUT(spyRefreshed.count(), 1, 5000);
+    QCOMPARE(refreshCount, 1);
+    QCOMPARE(registrationQuery, QString("lt=300"));
+
+    // The replies of the directory are deleted once processed
+    QTRY_VERIFY(client->findChildren<QCoapReply *>().isEmpty());
+}
+
+void tst_QCoapResourceDirectory::refreshExpiredRegistration()
+{
+    QTest::ignoreMessage(QtWarningMsg, "QCoapResourceDirectory: Failed to refresh the "
+                                       "registration of an unregistered endpoint.");
+    directory->refreshRegistration();
+
+    QSignalSpy spyRegistered(directory, &QCoapResourceDirectory::registered);
+    directory->registerEndpoint("node1", {});
+    QTRY_COMPARE_WITH_TIMEOUT(spyRegistered.count(), 1, 5000);
+    QCOMPARE(registrationQuery, QString("ep=node1&lt=90000"));
+
+    // The directory forgot the registration
+    server->removeResource("/rd/4521");
+
+    QSignalSpy spyError(directory, &QCoapResourceDirectory::error);
+    directory->refreshRegistration();
+    QTRY_COMPARE_WITH_TIMEOUT(spyError.count(), 1, 5000);
+    QCOMPARE(spyError.first().first().value<QtCoap::Error>(), QtCoap::NotFoundError);
+    QVERIFY(!directory->isRegistered());
+}
+
+void tst_QCoapResourceDirectory::lookupFromIndex()
+{
+    lookupLinks = {
+        link("/temp", "rt=\"temperature\";if=\"sensor\""),
+        link("/humidity", "rt=\"humidity\";if=\"sensor\""),
+        link("/heater", "rt=\"temperature actuator\""),
+    };
+
+    QSignalSpy spyFound(directory, &QCoapResourceDirectory::resourcesFound);
+    directory->lookupResources("temperature");
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 1);
+
+    auto found = spyFound.takeFirst().first().value<QVector<QCoapResource>>();
+    QCOMPARE(found.size(), 2);
+    QCOMPARE(found.at(0).path(), QString("/temp"));
+    QCOMPARE(found.at(0).host(), QHostAddress("127.0.0.2"));
+    QCOMPARE(found.at(1).path(), QString("/heater"));
+
+    // Fresh results are answered from memory
+    directory->lookupResources("temperature");
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 1);
+    QCOMPARE(spyFound.takeFirst().first().value<QVector<QCoapResource>>().size(), 2);
+
+    // The index is queried by each criterion
+    QCOMPARE(directory->resources("actuator").size(), 1);
+    QCOMPARE(directory->resources(QString(), "sensor").size(), 1);
+    QCOMPARE(directory->resources("temperature", "sensor").size(), 1);
+    QCOMPARE(directory->resources(QString(), QString(), QString(),
+                                  QHostAddress("127.0.0.2")).size(), 2);
+    QCOMPARE(directory->resources(QString(), QString(), QString(),
+                                  QHostAddress("127.0.0.3")).size(), 0);
+    QCOMPARE(directory->resources("humidity").size(), 0);
+
+    // Another filter is a different lookup
+    directory->lookupResources("humidity");
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 2);
+    QCOMPARE(directory->resources(QString(), "sensor").size(), 2);
+}
+
+void tst_QCoapResourceDirectory::lookupRevalidation()
+{
+    lookupMaxAge = 0;
+    for (int i = 0; i < 5; ++i)
+        lookupLinks.append(link("/r" + QString::number(i), "rt=\"t\""));
+    directory->setLookupPageSize(2);
+    QCOMPARE(directory->lookupPageSize(), 2);
+
+    QSignalSpy spyFound(directory, &QCoapResourceDirectory::resourcesFound);
+    directory->lookupResources();
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 3);
+    QCOMPARE(lookupTransfers, 3);
+    QCOMPARE(spyFound.takeFirst().first().value<QVector<QCoapResource>>().size(), 5);
+
+    // Stale pages are revalidated, and not transferred again
+    directory->lookupResources();
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 6);
+    QCOMPARE(lookupTransfers, 3);
+    QCOMPARE(spyFound.takeFirst().first().value<QVector<QCoapResource>>().size(), 5);
+
+    // Only the page that changed is transferred
+    lookupLinks[3] = link("/changed", "rt=\"t\"");
+    directory->lookupResources();
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(lookupRequests, 9);
+    QCOMPARE(lookupTransfers, 4);
+
+    auto found = spyFound.takeFirst().first().value<QVector<QCoapResource>>();
+    QStringList paths;
+    for (const QCoapResource &resource : qAsConst(found))
+        paths.append(resource.path());
+    paths.sort();
+    QCOMPARE(paths, QStringList({ "/changed", "/r0", "/r1", "/r2", "/r4" }));
+
+    // Removed links are dropped from the index
+    lookupLinks.removeLast();
+    lookupLinks.removeLast();
+    directory->lookupResources();
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(spyFound.takeFirst().first().value<QVector<QCoapResource>>().size(), 3);
+    QCOMPARE(directory->resources().size(), 3);
+}
+
+void tst_QCoapResourceDirectory::endpointLookup()
+{
+    QSignalSpy spyEndpoints(directory, &QCoapResourceDirectory::endpointsFound);
+    directory->lookupEndpoints();
+    QTRY_COMPARE_WITH_TIMEOUT(spyEndpoints.count(), 1, 5000);
+    QCOMPARE(spyEndpoints.first().first().toStringList(), QStringList({ "node1", "node2" }));
+    QCOMPARE(directory->endpoints(), QStringList({ "node1", "node2" }));
+
+    // Resources are indexed by the endpoint registered from their host
+    lookupLinks = {
+        link("/temp", "rt=\"temperature\""),
+        link("/light", "rt=\"light\"", "127.0.0.3"),
+        link("/other", "rt=\"light\"", "127.0.0.4"),
+    };
+    QSignalSpy spyFound(directory, &QCoapResourceDirectory::resourcesFound);
+    directory->lookupResources();
+    QTRY_COMPARE_WITH_TIMEOUT(spyFound.count(), 1, 5000);
+    QCOMPARE(spyFound.first().first().value<QVector<QCoapResource>>().size(), 3);
+
+    QVector<QCoapResource> found = directory->resources(QString(), QString(), "node1");
+    QCOMPARE(found.size(), 1);
+    QCOMPARE(found.first().path(), QString("/temp"));
+    found = directory->resources("light", QString(), "node2");
+    QCOMPARE(found.size(), 1);
+    QCOMPARE(found.first().host(), QHostAddress("127.0.0.3"));
+
+    // and expire with its registration, resources of unknown endpoints do not
+    QTRY_COMPARE_WITH_TIMEOUT(directory->resources("light").size(), 1, 5000);
+    QCOMPARE(directory->resources("light").first().path(), QString("/other"));
+    QCOMPARE(directory->endpoints(), QStringList({ "node1" }));
+    QCOMPARE(directory->resources().size(), 2);
+}
+
+void tst_QCoapResourceDirectory::lookupError()
+{
+    server->removeResource("/rd-lookup/res");
+
+    QSignalSpy spyError(directory, &QCoapResourceDirectory::error);
+    QSignalSpy spyFound(directory, &QCoapResourceDirectory::resourcesFound);
+    directory->lookupResources("temperature");
+    QTRY_COMPARE_WITH_TIMEOUT(spyError.count(), 1, 5000);
+    QCOMPARE(spyError.first().first().value<QtCoap::Error>(), QtCoap::NotFoundError);
+    QCOMPARE(spyFound.count(), 0);
+    QCOMPARE(directory->resources().size(), 0);
+}
+
+QTEST_MAIN(tst_QCoapResourceDirectory)
+
+#include "tst_qcoapresourcedirectory.moc"
@@ -0,0 +1,155 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapresourceset.h>
+#include <private/qcoaplinkformatparser_p.h>
+
+class tst_QCoapResourceSet : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void queries();
+    void sharedCopies();
+    void matchesQuery_data();
+    void matchesQuery();
+
+private:
+    static QCoapResource resource(const QString &path, const QString &resourceType,
+                                  const QString &interface = QString(), uint contentFormat = 0,
+                                  bool observable = false,
+                                  const QHostAddress &host = QHostAddress::LocalHost);
+    static QStringList paths(const QVector<QCoapResource> &resources);
+};
+
+QCoapResource tst_QCoapResourceSet::resource(const QString &path, const QString &resourceType,
+                                             const QString &interface, uint contentFormat,
+                                             bool observable, const QHostAddress &host)
+{
+    QCoapResource resource;
+    resource.setPath(path);
+    resource.setResourceType(resourceType);
+    resource.setInterface(interface);
+    resource.setContentFormat(contentFormat);
+    resource.setObservable(observable);
+    resource.setHost(host);
+    return resource;
+}
+
+QStringList tst_QCoapResourceSet::paths(const QVector<QCoapResource> &resources)
+{
+    QStringList list;
+    for (const QCoapResource &resource : resources)
+        list.append(resource.path());
+    return list;
+}
+
+void tst_QCoapResourceSet::queries()
+{
+    const QHostAddress otherHost("10.0.0.2");
+    QCoapResourceSet set({
+        resource("/temp", "temperature sensor", "core.s", 50, true),
+        resource("/light", "light sensor", "core.s", 0),
+        resource("/heater", "temperature", "core.a", 50, false, otherHost),
+    });
+    set.append(resource("/duplicated", "sensor sensor", "core.s core.s"));
+
+    QCOMPARE(set.size(), 4);
+    QVERIFY(!set.isEmpty());
+    QCOMPARE(paths(set.resources()),
+             QStringList({ "/temp", "/light", "/heater", "/duplicated" }));
+
+    QCOMPARE(paths(set.resourcesWithType("temperature")), QStringList({ "/temp", "/heater" }));
+    QCOMPARE(paths(set.resourcesWithType("sensor")),
+             QStringList({ "/temp", "/light", "/duplicated" }));
+    QCOMPARE(paths(set.resourcesWithType("temp")), QStringList());
+    QCOMPARE(paths(set.resourcesWithInterface("core.a")), QStringList({ "/heater" }));
+    QCOMPARE(paths(set.resourcesWithInterface("core.s")),
+             QStringList({ "/temp", "/light", "/duplicated" }));
+    QCOMPARE(paths(set.resourcesWithContentFormat(50)), QStringList({ "/temp", "/heater" }));
+    QCOMPARE(paths(set.resourcesWithContentFormat(0)), QStringList({ "/light", "/duplicated" }));
+    QCOMPARE(paths(set.resourcesOnHost(otherHost)), QStringList({ "/heater" }));
+    QCOMPARE(paths(set.observableResources()), QStringList({ "/temp" }));
+
+    set.clear();
+    QVERIFY(set.isEmpty());
+    QVERIFY(set.resourcesWithType("sensor").isEmpty());
+}
+
+void tst_QCoapResourceSet::sharedCopies()
+{
+    QCoapResourceSet set({ resource("/temp", "temperature") });
+    QCoapResourceSet copy = set;
+    copy.append(resource("/heater", "temperature"));
+
+    QCOMPARE(set.resourcesWithType("temperature").size(), 1);
+    QCOMPARE(copy.resourcesWithType("temperature").size(), 2);
+}
+
+void tst_QCoapResourceSet::matchesQuery_data()
+{
+    QTest::addColumn<QString>("query");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("empty") << "" << true;
+    QTest::newRow("rt") << "rt=sensor" << true;
+    QTest::newRow("rt_other_value") << "rt=temperature" << true;
+    QTest::newRow("rt_no_match") << "rt=light" << false;
+    QTest::newRow("rt_prefix") << "rt=temp*" << true;
+    QTest::newRow("rt_partial") << "rt=temp" << false;
+    QTest::newRow("if") << "if=core.s" << true;
+    QTest::newRow("href") << "href=/sensors/temp" << true;
+    QTest::newRow("href_prefix") << "href=/sensors/*" << true;
+    QTest::newRow("href_no_match") << "href=/actuators/*" << false;
+    QTest::newRow("ct") << "ct=50" << true;
+    QTest::newRow("ct_no_match") << "ct=0" << false;
+    QTest::newRow("obs") << "obs" << true;
+    QTest::newRow("all_filters") << "rt=sensor&ct=50" << true;
+    QTest::newRow("one_filter_fails") << "rt=sensor&ct=40" << false;
+    QTest::newRow("unknown_parameter") << "anchor=x" << true;
+}
+
+void tst_QCoapResourceSet::matchesQuery()
+{
+    QFETCH(QString, query);
+    QFETCH(bool, matches);
+
+    const QCoapResource temperature = resource("/sensors/temp", "temperature sensor", "core.s",
+                                               50, true);
+    QCOMPARE(QCoapLinkFormatParser::matchesQuery(temperature.path(), temperature, query),
+             matches);
+}
+
+QTEST_APPLESS_MAIN(tst_QCoapResourceSet)
+
+#include "tst_qcoapresourceset.moc"
@@ -0,0 +1,700 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoapdiscoveryreply.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapserver.h>
+#include <private/qcoapserver_p.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <QtNetwork/qudpsocket.h>
+
+class tst_QCoapServer : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void listen();
+    void resources();
+    void methods_data();
+    void methods();
+    void notFound();
+    void requestUrl();
+    void routing_data();
+    void routing();
+    void wellKnownCore();
+    void rawExchanges_data();
+    void rawExchanges();
+    void duplicatedRequest();
+    void multipleRequests();
+    void observe();
+    void observeRegistration();
+    void observeReset();
+    void observeAcknowledgment();
+    void observeTimeout();
+    void observeError();
+
+private:
+    QUrl serverUrl(const QString &path) const;
+    QCoapReply *sendRequest(QCoapClient *client, QtCoap::Method method, const QString &path,
+                            const QByteArray &payload = QByteArray());
+    QByteArray sendRawFrame(const QByteArray &frame, bool expectResponse = true);
+    QByteArray registerObserver(QUdpSocket *socket, bool confirmable);
+
+    QCoapServer *server = nullptr;
+    int handlerCalls = 0;
+    int observedValue = 0;
+};
+
+void tst_QCoapServer::init()
+{
+    handlerCalls = 0;
+    server = new QCoapServer;
+    server->addResource("/test", [this](const QCoapRequest &request, QCoapMessage *response) {
+        ++handlerCalls;
+        response->setPayload(request.payload().isEmpty()
+                             ? QByteArray("Method: ") + QByteArray::number(request.method())
+                             : request.payload());
+        switch (request.method()) {
+        case QtCoap::Get:
+            return QtCoap::Content;
+        case QtCoap::Post:
+            response->addOption(QCoapOption::LocationPath, "created");
+            return QtCoap::Created;
+        case QtCoap::Put:
+            return QtCoap::Changed;
+        case QtCoap::Delete:
+            return QtCoap::Deleted;
+        default:
+            return QtCoap::MethodNotAllowed;
+        }
+    });
+    observedValue = 0;
+    server->addResource("/observed", QtCoap::Get, [this](const QCoapRequest &,
+                                                         QCoapMessage *response) {
+        if (observedValue < 0)
+            return QtCoap::ServiceUnavailable;
+        response->setPayload(QByteArray::number(observedValue));
+        return QtCoap::Content;
+    });
+    QCoapResource description;
+    description.setPath("/observed");
+    description.setObservable(true);
+    server->setResourceDescription(description);
+
+    QVERIFY(server->listen(QHostAddress::LocalHost, 0));
+}
+
+void tst_QCoapServer::cleanup()
+{
+    delete server;
+    server = nullptr;
+}
+
+QUrl tst_QCoapServer::serverUrl(const QString &path) const
+{
+    return QUrl(QStringLiteral("coap://127.0.0.1:") + QString::number(server->serverPort())
+                + path);
+}
+
+QCoapReply *tst_QCoapServer::sendRequest(QCoapClient *client, QtCoap::Method method,
+                                         const QString &path, const QByteArray &payload)
+{
+    QCoapRequest request(serverUrl(path), QCoapMessage::Confirmable);
+    switch (method) {
+    case QtCoap::Get:
+        return client->get(request);
+    case QtCoap::Post:
+        return client->post(request, payload);
+    case QtCoap::Put:
+        return client->put(request, payload);
+    case QtCoap::Delete:
+        return client->deleteResource(request);
+    default:
+        return nullptr;
+    }
+}
+
+QByteArray tst_QCoapServer::sendRawFrame(const QByteArray &frame, bool expectResponse)
+{
+    QUdpSocket socket;
+    socket.bind(QHostAddress::LocalHost, 0);
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    socket.writeDatagram(frame, QHostAddress::LocalHost, server->serverPort());
+
+    // The server runs in this thread, so the event loop must run
+    if (!spyReadyRead.wait(expectResponse ? 1000 : 200))
+        return QByteArray();
+    return socket.receiveDatagram().data();
+}
+
+/*!
+    Registers \a socket as an observer of \c{/observed}, with the token
+    \c{ab}, and returns the response of the server.
+*/
+QByteArray tst_QCoapServer::registerObserver(QUdpSocket *socket, bool confirmable)
+{
+    QSignalSpy spyReadyRead(socket, &QUdpSocket::readyRead);
+
+    // GET /observed with Observe 0
+    const QByteArray frame = QByteArray::fromHex(confirmable ? "41011234ab6058" : "51011234ab6058")
+            + QByteArray("observed");
+    socket->writeDatagram(frame, QHostAddress::LocalHost, server->serverPort());
+    if (!spyReadyRead.wait(1000))
+        return QByteArray();
+    return socket->receiveDatagram().data();
+}
+
+void tst_QCoapServer::listen()
+{
+    QVERIFY(server->isListening());
+    QVERIFY(server->serverPort() != 0);
+    QCOMPARE(server->serverAddress(), QHostAddress(QHostAddress::LocalHost));
+
+    QTest::ignoreMessage(QtWarningMsg, "QCoapServer::listen() called when already listening");
+    QVERIFY(!server->listen(QHostAddress::LocalHost, 0));
+
+    server->close();
+    QVERIFY(!server->isListening());
+    QCOMPARE(server->serverPort(), quint16(0));
+
+    QVERIFY(server->listen(QHostAddress::LocalHost, 0));
+    QVERIFY(server->isListening());
+}
+
+void tst_QCoapServer::resources()
+{
+    QVERIFY(server->hasResource("test"));
+    QVERIFY(server->hasResource("/test/"));
+    QVERIFY(!server->hasResource("other"));
+
+    server->addResource("a/b/", [](const QCoapRequest &, QCoapMessage *) {
+        return QtCoap::Content;
+    });
+    QVERIFY(server->hasResource("/a/b"));
+
+    server->removeResource("/a/b");
+    QVERIFY(!server->hasResource("a/b"));
+}
+
+void tst_QCoapServer::methods_data()
+{
+    QTest::addColumn<QtCoap::Method>("method");
+    QTest::addColumn<QCoapMessage::MessageType>("type");
+    QTest::addColumn<QByteArray>("payload");
+    QTest::addColumn<QtCoap::ResponseCode>("responseCode");
+    QTest::addColumn<QByteArray>("replyPayload");
+
+    QTest::newRow("get_con") << QtCoap::Get << QCoapMessage::Confirmable << QByteArray()
+                             << QtCoap::Content << QByteArray("Method: 1");
+    QTest::newRow("get_non") << QtCoap::Get << QCoapMessage::NonConfirmable << QByteArray()
+                             << QtCoap::Content << QByteArray("Method: 1");
+    QTest::newRow("post") << QtCoap::Post << QCoapMessage::Confirmable << QByteArray("posted")
+                          << QtCoap::Created << QByteArray("posted");
+    QTest::newRow("put") << QtCoap::Put << QCoapMessage::NonConfirmable << QByteArray("put")
+                         << QtCoap::Changed << QByteArray("put");
+    QTest::newRow("delete") << QtCoap::Delete << QCoapMessage::Confirmable << QByteArray()
+                            << QtCoap::Deleted << QByteArray("Method: 4");
+}
+
+void tst_QCoapServer::methods()
+{
+    QFETCH(QtCoap::Method, method);
+    QFETCH(QCoapMessage::MessageType, type);
+    QFETCH(QByteArray, payload);
+    QFETCH(QtCoap::ResponseCode, responseCode);
+    QFETCH(QByteArray, replyPayload);
+
+    QCoapClient client;
+    QCoapRequest request(serverUrl("/test"), type);
+
+    QScopedPointer<QCoapReply> reply;
+    switch (method) {
+    case QtCoap::Get:
+        reply.reset(client.get(request));
+        break;
+    case QtCoap::Post:
+        reply.reset(client.post(request, payload));
+        break;
+    case QtCoap::Put:
+        reply.reset(client.put(request, payload));
+        break;
+    case QtCoap::Delete:
+        reply.reset(client.deleteResource(request));
+        break;
+    default:
+        QFAIL("Unexpected method");
+    }
+
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+    QCOMPARE(reply->responseCode(), responseCode);
+    QCOMPARE(reply->readAll(), replyPayload);
+    QCOMPARE(handlerCalls, 1);
+
+    if (method == QtCoap::Post)
+        QCOMPARE(reply->message().option(QCoapOption::LocationPath).value(), QByteArray("created"));
+}
+
+void tst_QCoapServer::notFound()
+{
+    QCoapClient client;
+    QScopedPointer<QCoapReply> reply(client.get(QCoapRequest(serverUrl("/missing"),
+                                                             QCoapMessage::Confirmable)));
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+    QCOMPARE(reply->responseCode(), QtCoap::NotFound);
+    QCOMPARE(handlerCalls, 0);
+}
+
+void tst_QCoapServer::requestUrl()
+{
+    QUrl receivedUrl;
+    server->addResource("/path/to/resource", [&](const QCoapRequest &request, QCoapMessage *) {
+        receivedUrl = request.url();
+        return QtCoap::Content;
+    });
+
+    QCoapClient client;
+    QScopedPointer<QCoapReply> reply(client.get(serverUrl("/path/to/resource?a=1&b=2")));
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+    QCOMPARE(reply->responseCode(), QtCoap::Content);
+    QCOMPARE(receivedUrl.path(), QStringLiteral("/path/to/resource"));
+    QCOMPARE(receivedUrl.query(), QStringLiteral("a=1&b=2"));
+    QCOMPARE(receivedUrl.port(), int(server->serverPort()));
+}
+
+void tst_QCoapServer::routing_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QtCoap::Method>("method");
+    QTest::addColumn<QtCoap::ResponseCode>("responseCode");
+    QTest::addColumn<QByteArray>("handlerName");
+
+    QTest::newRow("literal_get") << "/sensors/main/value" << QtCoap::Get
+                                 << QtCoap::Content << QByteArray("literal");
+    QTest::newRow("literal_put") << "/sensors/main/value" << QtCoap::Put
+                                 << QtCoap::Changed << QByteArray("literal-put");
+    QTest::newRow("literal_method_not_allowed") << "/sensors/main/value" << QtCoap::Post
+                                                << QtCoap::MethodNotAllowed << QByteArray();
+    QTest::newRow("wildcard") << "/sensors/other/value" << QtCoap::Get
+                              << QtCoap::Content << QByteArray("wildcard");
+    QTest::newRow("wildcard_after_literal") << "/sensors/main/other" << QtCoap::Get
+                                            << QtCoap::Content << QByteArray("wildcard-other");
+    QTest::newRow("too_deep") << "/sensors/main/value/more" << QtCoap::Get
+                              << QtCoap::NotFound << QByteArray();
+    QTest::newRow("not_a_resource") << "/sensors" << QtCoap::Get
+                                    << QtCoap::NotFound << QByteArray();
+    QTest::newRow("any_method") << "/actuator" << QtCoap::Post
+                                << QtCoap::Content << QByteArray("any");
+    QTest::newRow("method_table") << "/actuator" << QtCoap::Delete
+                                  << QtCoap::Deleted << QByteArray("delete");
+}
+
+void tst_QCoapServer::routing()
+{
+    QFETCH(QString, path);
+    QFETCH(QtCoap::Method, method);
+    QFETCH(QtCoap::ResponseCode, responseCode);
+    QFETCH(QByteArray, handlerName);
+
+    auto handler = [](const QByteArray &name, QtCoap::ResponseCode code) {
+        return [name, code](const QCoapRequest &, QCoapMessage *response) {
+            response->setPayload(name);
+            return code;
+        };
+    };
+    server->addResource("/sensors/main/value", QtCoap::Get,
+                        handler("literal", QtCoap::Content));
+    server->addResource("/sensors/main/value", QtCoap::Put,
+                        handler("literal-put", QtCoap::Changed));
+    server->addResource("/sensors/*/value", handler("wildcard", QtCoap::Content));
+    server->addResource("/sensors/*/other", handler("wildcard-other", QtCoap::Content));
+    server->addResource("/actuator", handler("any", QtCoap::Content));
+    server->addResource("/actuator", QtCoap::Delete, handler("delete", QtCoap::Deleted));
+
+    QCoapClient client;
+    QScopedPointer<QCoapReply> reply(sendRequest(&client, method, path));
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+    QCOMPARE(reply->responseCode(), responseCode);
+    QCOMPARE(reply->readAll(), handlerName);
+}
+
+void tst_QCoapServer::wellKnownCore()
+{
+    auto handler = [](const QCoapRequest &, QCoapMessage *) { return QtCoap::Content; };
+    server->addResource("/sensors/temp", handler);
+    server->addResource("/sensors/*/value", handler);
+    server->addResource("/sensors/light", handler);
+
+    QCoapResource description;
+    description.setPath("/sensors/temp");
+    description.setTitle("Temperature \"main\"");
+    description.setResourceType("temperature-c");
+    description.setContentFormat(50);
+    description.setObservable(true);
+    server->setResourceDescription(description);
+
+    const QByteArray expected = "</.well-known/core>,</observed>;obs,</sensors/light>,"
+                                "</sensors/temp>;rt=\"temperature-c\";ct=50;obs;"
+                                "title=\"Temperature \\\"main\\\"\",</test>";
+
+    QCoapClient client;
+    QScopedPointer<QCoapReply> reply(client.get(serverUrl("/.well-known/core")));
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+    QCOMPARE(reply->responseCode(), QtCoap::Content);
+    QCOMPARE(reply->message().option(QCoapOption::ContentFormat).valueToInt(), 40u);
+    QCOMPARE(reply->readAll(), expected);
+
+    // Resources are filtered by the query
+    const QVector<QPair<QString, QByteArray>> filters = {
+        { "rt=temperature-c", "</sensors/temp>" },
+        { "rt=temp*", "</sensors/temp>" },
+        { "href=/sensors/*", "</sensors/light>,</sensors/temp>" },
+        { "obs", "</observed>,</sensors/temp>" },
+        { "ct=50", "</sensors/temp>" },
+        { "rt=humidity", "" },
+    };
+    for (const auto &filter : filters) {
+        reply.reset(client.get(serverUrl("/.well-known/core?" + filter.first)));
+        QSignalSpy spyFiltered(reply.data(), &QCoapReply::finished);
+        QTRY_COMPARE_WITH_TIMEOUT(spyFiltered.count(), 1, 5000);
+
+        QByteArrayList targets;
+        for (const QByteArray &link : reply->readAll().split(',')) {
+            if (!link.isEmpty())
+                targets.append(link.left(link.indexOf('>') + 1));
+        }
+        QCOMPARE(targets.join(','), filter.second);
+    }
+
+    // The filter of a discovery is sent to the server
+    QScopedPointer<QCoapDiscoveryReply> discovery(
+                client.discover(serverUrl(""), "/.well-known/core?rt=temp*"));
+    QSignalSpy spyDiscovered(discovery.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyDiscovered.count(), 1, 5000);
+    QCOMPARE(discovery->resources().size(), 1);
+    QCOMPARE(discovery->resourceSet().resourcesWithType("temperature-c").size(), 1);
+    QCOMPARE(discovery->resourceSet().observableResources().size(), 1);
+
+    // The filters of the URL are kept along those of the discovery path
+    QUrl filteredUrl = serverUrl("");
+    filteredUrl.setQuery("rt=temp*");
+    discovery.reset(client.discover(filteredUrl, "/.well-known/core?href=/sensors/*"));
+    QSignalSpy spyFilteredDiscovery(discovery.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFilteredDiscovery.count(), 1, 5000);
+    QCOMPARE(discovery->request().url().query(), QString("rt=temp*&href=/sensors/*"));
+    QCOMPARE(discovery->resources().size(), 1);
+
+    // Removed resources are no longer listed
+    server->removeResource("/sensors/temp");
+    server->removeResource("/sensors/light");
+    QVERIFY(!server->hasResource("/sensors/temp"));
+    QVERIFY(server->hasResource("/sensors/*/value"));
+
+    reply.reset(client.get(serverUrl("/.well-known/core")));
+    QSignalSpy spyFinishedAfterRemoval(reply.data(), &QCoapReply::finished);
+    QTRY_COMPARE_WITH_TIMEOUT(spyFinishedAfterRemoval.count(), 1, 5000);
+    QCOMPARE(reply->readAll(), QByteArray("</.well-known/core>,</observed>;obs,</test>"));
+}
+
+void tst_QCoapServer::rawExchanges_data()
+{
+    QTest::addColumn<QString>("requestHexa");
+    QTest::addColumn<QString>("responseHexa");
+
+    QTest::newRow("ping")
+            << "40001234"
+            << "70001234";
+    QTest::newRow("piggybacked_response")
+            << "410112350ab474657374"
+            << "614512350aff4d6574686f643a2031";
+    QTest::newRow("unrecognized_critical_option")
+            << "400112369161"
+            << "60821236";
+    QTest::newRow("malformed_confirmable")
+            << "4201123701"
+            << "70001237";
+    QTest::newRow("confirmable_response")
+            << "40451238"
+            << "70001238";
+    QTest::newRow("acknowledgment_ignored")
+            << "60001239"
+            << "";
+    QTest::newRow("malformed_non_confirmable_ignored")
+            << "5201123a01"
+            << "";
+    QTest::newRow("unknown_version_ignored")
+            << "8001123b"
+            << "";
+}
+
+void tst_QCoapServer::rawExchanges()
+{
+    QFETCH(QString, requestHexa);
+    QFETCH(QString, responseHexa);
+
+    const QByteArray response = sendRawFrame(QByteArray::fromHex(requestHexa.toLatin1()),
+                                             !responseHexa.isEmpty());
+    QCOMPARE(response.toHex(), responseHexa.toLatin1());
+}
+
+void tst_QCoapServer::duplicatedRequest()
+{
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+
+    // Confirmable and non-confirmable GET /test with the same message ID
+    const QByteArray confirmable = QByteArray::fromHex("410112400ab474657374");
+    const QByteArray nonConfirmable = QByteArray::fromHex("510112410bb474657374");
+
+    socket.writeDatagram(confirmable, QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray response = socket.receiveDatagram().data();
+    QCOMPARE(handlerCalls, 1);
+
+    // The duplicate gets the same response, without calling the handler
+    socket.writeDatagram(confirmable, QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    QCOMPARE(socket.receiveDatagram().data(), response);
+    QCOMPARE(handlerCalls, 1);
+
+    // Non-confirmable responses have their own message ID
+    socket.writeDatagram(nonConfirmable, QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray nonResponse = socket.receiveDatagram().data();
+    QCOMPARE(handlerCalls, 2);
+    QCOMPARE(quint8(nonResponse.at(0)), quint8(0x51));
+    QCOMPARE(quint8(nonResponse.at(1)), quint8(QtCoap::Content));
+    QCOMPARE(nonResponse.at(4), '\x0b');
+
+    // Duplicated non-confirmable requests are ignored
+    socket.writeDatagram(nonConfirmable, QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(!spyReadyRead.wait(200));
+    QCOMPARE(handlerCalls, 2);
+}
+
+void tst_QCoapServer::multipleRequests()
+{
+    const int requestCount = 100;
+
+    QCoapClient client;
+    QVector<QCoapReply *> replies;
+    for (int i = 0; i < requestCount; ++i) {
+        QCoapRequest request(serverUrl("/test"), QCoapMessage::Confirmable);
+        replies.append(client.post(request, QByteArray::number(i)));
+    }
+
+    for (int i = 0; i < requestCount; ++i) {
+        QCoapReply *reply = replies.at(i);
+        QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+        QCOMPARE(reply->responseCode(), QtCoap::Created);
+        QCOMPARE(reply->readAll(), QByteArray::number(i));
+    }
+    QCOMPARE(handlerCalls, requestCount);
+
+    qDeleteAll(replies);
+}
+
+void tst_QCoapServer::observe()
+{
+    QCoapClient client;
+    QCoapRequest request(serverUrl("/observed"));
+    QScopedPointer<QCoapReply> reply(client.observe(request));
+    QSignalSpy spyReplyNotified(reply.data(), &QCoapReply::notified);
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyReplyNotified.count(), 1, 5000);
+    QCOMPARE(server->observerCount("/observed"), 1);
+    QCOMPARE(server->observerCount("observed/"), 1);
+
+    for (observedValue = 1; observedValue <= 3; ++observedValue) {
+        QCOMPARE(server->notifyObservers("/observed"), 1);
+        QTRY_COMPARE_WITH_TIMEOUT(spyReplyNotified.count(), observedValue + 1, 5000);
+    }
+
+    for (int i = 0; i < spyReplyNotified.count(); ++i) {
+        const QCoapMessage message = spyReplyNotified.at(i).at(1).value<QCoapMessage>();
+        QCOMPARE(message.payload(), QByteArray::number(i));
+    }
+
+    // The client resets the next notification
+    client.cancelObserve(reply.data());
+    QCOMPARE(server->notifyObservers("/observed"), 1);
+    QTRY_COMPARE_WITH_TIMEOUT(server->observerCount("/observed"), 0, 5000);
+    QCOMPARE(server->notifyObservers("/observed"), 0);
+}
+
+void tst_QCoapServer::observeRegistration()
+{
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+
+    // The piggybacked response carries the Observe option
+    const QByteArray response = registerObserver(&socket, true);
+    QCOMPARE(response.left(5), QByteArray::fromHex("61451234ab"));
+    QCOMPARE(quint8(response.at(5)) & 0xF0, 0x60);
+    QCOMPARE(server->observerCount("/observed"), 1);
+
+    // Registering again replaces the observation
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    socket.writeDatagram(QByteArray::fromHex("41011235cd6058") + QByteArray("observed"),
+                         QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    socket.receiveDatagram();
+    QCOMPARE(server->observerCount("/observed"), 1);
+
+    // Deregistering needs the same token
+    socket.writeDatagram(QByteArray::fromHex("41011236ab610158") + QByteArray("observed"),
+                         QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    socket.receiveDatagram();
+    QCOMPARE(server->observerCount("/observed"), 1);
+
+    socket.writeDatagram(QByteArray::fromHex("41011237cd610158") + QByteArray("observed"),
+                         QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray deregistration = socket.receiveDatagram().data();
+    QCOMPARE(deregistration.left(5), QByteArray::fromHex("61451237cd"));
+    QCOMPARE(deregistration.at(5), '\xff');
+    QCOMPARE(server->observerCount("/observed"), 0);
+
+    // Resources not described as observable cannot be observed
+    socket.writeDatagram(QByteArray::fromHex("41011238ab6054") + QByteArray("test"),
+                         QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(spyReadyRead.wait(1000));
+    socket.receiveDatagram();
+    QCOMPARE(server->observerCount("/test"), 0);
+}
+
+void tst_QCoapServer::observeReset()
+{
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    QVERIFY(!registerObserver(&socket, false).isEmpty());
+    QCOMPARE(server->observerCount("/observed"), 1);
+
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    observedValue = 42;
+    QCOMPARE(server->notifyObservers("/observed"), 1);
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray notification = socket.receiveDatagram().data();
+    QCOMPARE(quint8(notification.at(0)), quint8(0x51));
+    QCOMPARE(quint8(notification.at(1)), quint8(QtCoap::Content));
+    QCOMPARE(notification.mid(4, 1), QByteArray::fromHex("ab"));
+    QVERIFY(notification.endsWith("\xff" "42"));
+
+    // A reset with another message ID is ignored
+    const QByteArray messageId = notification.mid(2, 2);
+    QByteArray otherMessageId = messageId;
+    otherMessageId[1] = static_cast<char>(otherMessageId.at(1) + 1);
+    socket.writeDatagram(QByteArray::fromHex("7000") + otherMessageId, QHostAddress::LocalHost,
+                         server->serverPort());
+    QVERIFY(!spyReadyRead.wait(200));
+    QCOMPARE(server->observerCount("/observed"), 1);
+
+    socket.writeDatagram(QByteArray::fromHex("7000") + messageId, QHostAddress::LocalHost,
+                         server->serverPort());
+    QTRY_COMPARE_WITH_TIMEOUT(server->observerCount("/observed"), 0, 1000);
+}
+
+void tst_QCoapServer::observeAcknowledgment()
+{
+    static_cast<QCoapServerPrivate *>(QObjectPrivate::get(server))->ackTimeout = 100;
+
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    QVERIFY(!registerObserver(&socket, true).isEmpty());
+
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    QCOMPARE(server->notifyObservers("/observed"), 1);
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray notification = socket.receiveDatagram().data();
+    QCOMPARE(quint8(notification.at(0)), quint8(0x41));
+
+    // Once acknowledged, the notification is not retransmitted
+    socket.writeDatagram(QByteArray::fromHex("6000") + notification.mid(2, 2),
+                         QHostAddress::LocalHost, server->serverPort());
+    QVERIFY(!spyReadyRead.wait(500));
+    QCOMPARE(server->observerCount("/observed"), 1);
+}
+
+void tst_QCoapServer::observeTimeout()
+{
+    static_cast<QCoapServerPrivate *>(QObjectPrivate::get(server))->ackTimeout = 20;
+
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    QVERIFY(!registerObserver(&socket, true).isEmpty());
+
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    QCOMPARE(server->notifyObservers("/observed"), 1);
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray notification = socket.receiveDatagram().data();
+
+    // Retransmitted 4 times, then the observer is removed
+    QTRY_COMPARE_WITH_TIMEOUT(server->observerCount("/observed"), 0, 5000);
+    int retransmissions = 0;
+    while (socket.hasPendingDatagrams()) {
+        QCOMPARE(socket.receiveDatagram().data(), notification);
+        ++retransmissions;
+    }
+    QCOMPARE(retransmissions, 4);
+}
+
+void tst_QCoapServer::observeError()
+{
+    QUdpSocket socket;
+    QVERIFY(socket.bind(QHostAddress::LocalHost, 0));
+    QVERIFY(!registerObserver(&socket, false).isEmpty());
+
+    // An error response ends the observation
+    QSignalSpy spyReadyRead(&socket, &QUdpSocket::readyRead);
+    observedValue = -1;
+    QCOMPARE(server->notifyObservers("/observed"), 1);
+    QVERIFY(spyReadyRead.wait(1000));
+    const QByteArray notification = socket.receiveDatagram().data();
+    QCOMPARE(quint8(notification.at(1)), quint8(QtCoap::ServiceUnavailable));
+    QCOMPARE(notification.size(), 5);
+    QCOMPARE(server->observerCount("/observed"), 0);
+}
+
+QTEST_MAIN(tst_QCoapServer)
+
+#include "tst_qcoapserver.moc"
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    qcoapclient \
+    qcoapinternalreply \
+    qcoapinternalrequest \
+    qcoapprotocol \
+    qcoapresource \
+    qcoapserver
@@ -0,0 +1,7 @@
+TARGET = tst_bench_qcoapclient
+QT = testlib network core coap
+CONFIG += benchmark
+
+include(../../shared/coaptestserver/coaptestserver.pri)
+
+SOURCES += tst_bench_qcoapclient.cpp
@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoapreply.h>
+
+#include "coaptestserver.h"
+
+class tst_QCoapClient : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void roundTrip_data();
+    void roundTrip();
+    void bulkPolling_data();
+    void bulkPolling();
+
+private:
+    QCoapTestServer *server = nullptr;
+};
+
+void tst_QCoapClient::initTestCase()
+{
+    // Port 0 lets the system pick a free port, so that the benchmark does
+    // not conflict with a plugtest server running on the default port
+    server = QCoapTestServer::startInThread(QHostAddress::LocalHost, 0);
+    QVERIFY(server);
+}
+
+void tst_QCoapClient::cleanupTestCase()
+{
+    QCoapTestServer::stopInThread(server);
+    server = nullptr;
+}
+
+void tst_QCoapClient::roundTrip_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("latency");
+
+    QTest::newRow("test") << "/test" << 0;
+    QTest::newRow("test_latency_5ms") << "/test" << 5;
+    QTest::newRow("large") << "/large" << 0;
+    QTest::newRow("well-known_core") << "/.well-known/core" << 0;
+}
+
+void tst_QCoapClient::roundTrip()
+{
+    QFETCH(QString, path);
+    QFETCH(int, latency);
+
+    server->setLatency(latency);
+    const QUrl url(QStringLiteral("coap://127.0.0.1:") + QString::number(server->serverPort())
+                   + path);
+
+    QCoapClient client;
+    QBENCHMARK {
+        QScopedPointer<QCoapReply> reply(client.get(url));
+        QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+        QVERIFY(spyFinished.wait(5000));
+        QVERIFY(!reply->readAll().isEmpty());
+    }
+    server->setLatency(0);
+}
+
+void tst_QCoapClient::bulkPolling_data()
+{
+    QTest::addColumn<bool>("useCallback");
+    QTest::addColumn<int>("requestCount");
+
+    QTest::newRow("reply_1k") << false << 1000;
+    QTest::newRow("callback_1k") << true << 1000;
+}
+
+void tst_QCoapClient::bulkPolling()
+{
+    QFETCH(bool, useCallback);
+    QFETCH(int, requestCount);
+
+    const QUrl url(QStringLiteral("coap://127.0.0.1:") + QString::number(server->serverPort())
+                   + QStringLiteral("/test"));
+    const QCoapRequest request(url);
+
+    QCoapClient client;
+    QBENCHMARK {
+        int pending = requestCount;
+        QEventLoop loop;
+        auto done = [&] {
+            if (--pending == 0)
+                loop.quit();
+        };
+
+        QVector<QCoapReply *> replies;
+        if (useCallback) {
+            for (int i = 0; i < requestCount; ++i) {
+                client.sendRequest(request, &loop, [&](QtCoap::ResponseCode, const QCoapMessage &) {
+                    done();
+                });
+            }
+        } else {
+            replies.reserve(requestCount);
+            for (int i = 0; i < requestCount; ++i) {
+                QCoapReply *reply = client.get(request);
+                connect(reply, &QCoapReply::finished, &loop, done);
+                replies.append(reply);
+            }
+        }
+
+        QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+        loop.exec();
+        QCOMPARE(pending, 0);
+        qDeleteAll(replies);
+    }
+}
+
+QTEST_MAIN(tst_QCoapClient)
+
+#include "tst_bench_qcoapclient.moc"
@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <private/qcoapinternalreply_p.h>
+
+#include "allocationcounter.h"
+
+class tst_QCoapInternalReply : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void createFromFrame_data();
+    void createFromFrame();
+    void createFromFrameAllocations_data();
+    void createFromFrameAllocations();
+};
+
+static QByteArray makeFrame(const QCoapMessage &message)
+{
+    return QCoapInternalMessagePrivate::encodeFrame(message, QtCoap::Content);
+}
+
+static void addFrameRows()
+{
+    QTest::addColumn<QByteArray>("frame");
+
+    QCoapMessage message;
+    message.setType(QCoapMessage::Acknowledgment);
+    message.setMessageId(64463);
+    message.setToken(QByteArray::fromHex("4647f09b"));
+    QTest::newRow("reply_only") << makeFrame(message);
+
+    message.addOption(QCoapOption(QCoapOption::ContentFormat, quint32(0)));
+    message.addOption(QCoapOption(QCoapOption::MaxAge, quint32(30)));
+    message.setPayload("Type: 1 (NON)\nCode: 1 (GET)\nMID: 56400\nToken: 4647f09b");
+    QTest::newRow("options_and_payload") << makeFrame(message);
+
+    message.addOption(QCoapOption(QCoapOption::Observe, quint32(0x1234)));
+    message.addOption(QCoapOption::Etag, QByteArray::fromHex("0102030405060708"));
+    message.addOption(QCoapOption::LocationPath, QByteArray("location-with-a-long-segment"));
+    QTest::newRow("notification") << makeFrame(message);
+
+    message.removeAllOptions();
+    message.addOption(QCoapOption(QCoapOption::Block2, quint32((3 << 4) | 0x08 | 6)));
+    message.addOption(QCoapOption(QCoapOption::Size2, quint32(8192)));
+    message.setPayload(QByteArray(1024, 'b'));
+    QTest::newRow("block2") << makeFrame(message);
+}
+
+void tst_QCoapInternalReply::createFromFrame_data()
+{
+    addFrameRows();
+}
+
+void tst_QCoapInternalReply::createFromFrame()
+{
+    QFETCH(QByteArray, frame);
+
+    QBENCHMARK {
+        QScopedPointer<QCoapInternalReply> reply(QCoapInternalReply::createFromFrame(frame));
+        Q_UNUSED(reply);
+    }
+}
+
+void tst_QCoapInternalReply::createFromFrameAllocations_data()
+{
+    addFrameRows();
+}
+
+void tst_QCoapInternalReply::createFromFrameAllocations()
+{
+    QFETCH(QByteArray, frame);
+
+    const AllocationCounter counter;
+    QScopedPointer<QCoapInternalReply> reply(QCoapInternalReply::createFromFrame(frame));
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QCOMPARE(reply->responseCode(), QtCoap::Content);
+}
+
+QTEST_APPLESS_MAIN(tst_QCoapInternalReply)
+
+#include "tst_bench_qcoapinternalreply.moc"
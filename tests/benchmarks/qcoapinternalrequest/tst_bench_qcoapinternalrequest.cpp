@@ -0,0 +1,171 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <QtCoap/qcoaprequest.h>
+#include <private/qcoapinternalrequest_p.h>
+#include <private/qcoapobjectpool_p.h>
+
+#include "allocationcounter.h"
+
+class tst_QCoapInternalRequest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void toQByteArray_data();
+    void toQByteArray();
+    void toQByteArrayAllocations_data();
+    void toQByteArrayAllocations();
+    void buildOptions_data();
+    void buildOptions();
+    void createAllocations_data();
+    void createAllocations();
+};
+
+static QCoapRequest makeRequest(const QUrl &url, const QByteArray &payload)
+{
+    QCoapRequest request(url);
+    request.setType(QCoapMessage::Confirmable);
+    request.setMethod(QtCoap::Post);
+    request.setMessageId(56400);
+    request.setToken(QByteArray::fromHex("4647f09b"));
+    request.addOption(QCoapOption(QCoapOption::ContentFormat, quint32(40)));
+    request.addOption(QCoapOption::Etag, QByteArray::fromHex("a1b2c3d4"));
+    request.setPayload(payload);
+    return request;
+}
+
+static void addRequestRows()
+{
+    QTest::addColumn<QUrl>("url");
+    QTest::addColumn<QByteArray>("payload");
+
+    QTest::newRow("no_path") << QUrl("coap://10.20.30.40/") << QByteArray();
+    QTest::newRow("short_path") << QUrl("coap://10.20.30.40/test") << QByteArray("payload");
+    QTest::newRow("long_path_query")
+            << QUrl("coap://10.20.30.40:5684/sensors/building-a/floor-3/room-312/temperature"
+                    "?unit=celsius&precision=2&history=false")
+            << QByteArray(64, 'p');
+    QTest::newRow("block_payload") << QUrl("coap://10.20.30.40/large-post")
+                                   << QByteArray(1024, 'b');
+}
+
+void tst_QCoapInternalRequest::toQByteArray_data()
+{
+    addRequestRows();
+}
+
+void tst_QCoapInternalRequest::toQByteArray()
+{
+    QFETCH(QUrl, url);
+    QFETCH(QByteArray, payload);
+
+    QCoapInternalRequest internalRequest(makeRequest(url, payload));
+
+    QByteArray frame;
+    QBENCHMARK {
+        frame = internalRequest.toQByteArray();
+    }
+    QVERIFY(!frame.isEmpty());
+}
+
+void tst_QCoapInternalRequest::toQByteArrayAllocations_data()
+{
+    addRequestRows();
+}
+
+void tst_QCoapInternalRequest::toQByteArrayAllocations()
+{
+    QFETCH(QUrl, url);
+    QFETCH(QByteArray, payload);
+
+    QCoapInternalRequest internalRequest(makeRequest(url, payload));
+
+    const AllocationCounter counter;
+    const QByteArray frame = internalRequest.toQByteArray();
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QVERIFY(!frame.isEmpty());
+}
+
+void tst_QCoapInternalRequest::buildOptions_data()
+{
+    addRequestRows();
+}
+
+// Measures the creation of the internal request, which converts the URL
+// into options and copies the message.
+void tst_QCoapInternalRequest::buildOptions()
+{
+    QFETCH(QUrl, url);
+    QFETCH(QByteArray, payload);
+
+    const QCoapRequest request = makeRequest(url, payload);
+
+    QBENCHMARK {
+        QCoapInternalRequest internalRequest(request);
+        Q_UNUSED(internalRequest);
+    }
+}
+
+void tst_QCoapInternalRequest::createAllocations_data()
+{
+    QTest::addColumn<bool>("pooled");
+
+    QTest::newRow("heap") << false;
+    QTest::newRow("pool") << true;
+}
+
+// Counts the allocations made to create and destroy an internal request,
+// either on the heap or in a pool which already holds a free slot.
+void tst_QCoapInternalRequest::createAllocations()
+{
+    QFETCH(bool, pooled);
+
+    QCoapObjectPool<QCoapInternalRequest> pool;
+    pool.destroy(pool.create());
+
+    const AllocationCounter counter;
+    if (pooled) {
+        QCoapInternalRequest *request = pool.create();
+        request->setToken(QByteArray::fromHex("4647f09b"));
+        pool.destroy(request);
+    } else {
+        QCoapInternalRequest *request = new QCoapInternalRequest;
+        request->setToken(QByteArray::fromHex("4647f09b"));
+        delete request;
+    }
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QCOMPARE(pool.size(), 0);
+}
+
+QTEST_APPLESS_MAIN(tst_QCoapInternalRequest)
+
+#include "tst_bench_qcoapinternalrequest.moc"
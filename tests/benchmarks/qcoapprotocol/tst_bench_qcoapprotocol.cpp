@@ -0,0 +1,448 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QtNetwork/qnetworkdatagram.h>
+
+#include <QtCoap/qcoapconnection.h>
+#include <QtCoap/qcoapreply.h>
+#include <private/qcoapprotocol_p.h>
+#include <private/qcoapinternalrequest_p.h>
+#include <private/qcoapinternalreply_p.h>
+#include <private/qcoapcapture_p.h>
+
+#include "allocationcounter.h"
+
+class tst_QCoapProtocol : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void resourcesFromCoreLinkList_data();
+    void resourcesFromCoreLinkList();
+    void resourcesFromCoreLinkListAllocations_data();
+    void resourcesFromCoreLinkListAllocations();
+    void registerExchange_data();
+    void registerExchange();
+    void lookupExchange_data();
+    void lookupExchange();
+    void block2Reassembly_data();
+    void block2Reassembly();
+    void replayCapture_data();
+    void replayCapture();
+    void encodeAcknowledgment_data();
+    void encodeAcknowledgment();
+    void encodeAcknowledgmentAllocations_data();
+    void encodeAcknowledgmentAllocations();
+    void emptyAcknowledgmentAllocations();
+};
+
+static QCoapProtocolPrivate *protocolPrivate(QCoapProtocol *protocol)
+{
+    return static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(protocol));
+}
+
+static QCoapToken tokenForIndex(int index)
+{
+    QCoapToken token(4, Qt::Uninitialized);
+    qToBigEndian(static_cast<quint32>(index), token.data());
+    return token;
+}
+
+// Message IDs only use half of the range, so that unused ones can still
+// be found with large exchange counts.
+static quint16 messageIdForIndex(int index)
+{
+    return static_cast<quint16>(1 + index % 0x7FFF);
+}
+
+// Registers \a count exchanges, with tokens and message IDs derived from
+// their index.
+static void fillExchanges(QCoapProtocolPrivate *d, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        QCoapInternalRequest *request = d->requestPool.create();
+        request->setToken(tokenForIndex(i));
+        request->setMessageId(messageIdForIndex(i));
+        d->registerExchange(request->token(), nullptr, request);
+    }
+}
+
+void tst_QCoapProtocol::initTestCase()
+{
+    qRegisterMetaType<QCoapMessage>();
+    qRegisterMetaType<QtCoap::Error>();
+    qRegisterMetaType<QtCoap::ResponseCode>();
+}
+
+void tst_QCoapProtocol::resourcesFromCoreLinkList_data()
+{
+    QTest::addColumn<QByteArray>("coreLinks");
+
+    // Resources of the Californium plugtest server
+    const QByteArray plugtestLinks =
+            "</obs>;obs;rt=\"observe\";title=\"Observable resource which changes every"
+            " 5 seconds\",</separate>;title=\"Resource which cannot be served immediately"
+            " and which cannot be acknowledged in a piggy-backed way\",</seg1>;title=\""
+            "Long path resource\",</seg1/seg2>;title=\"Long path resource\","
+            "</large-separate>;rt=\"block\";sz=1280;title=\"Large resource\","
+            "</.well-known/core>,</multi-format>;ct=\"0 41\";title=\"Resource that exists"
+            " in different content formats (text/plain utf8 and application/xml)\","
+            "</path>;ct=40;title=\"Hierarchical link description entry\",</path/sub1>;"
+            "title=\"Hierarchical link description sub-resource\",</link1>;if=\"If1\";"
+            "rt=\"Type1 Type2\";title=\"Link test resource\",</validate>;title=\"Resource"
+            " which varies\",</test>;title=\"Default test resource\",</query>;"
+            "title=\"Resource accepting query parameters\",</large-post>;rt=\"block\";"
+            "title=\"Handle PostOperation with two-way blockwise transfer\",</obs-non>;"
+            "obs;rt=\"observe\";title=\"Observable resource which changes every 5 "
+            "seconds\",</shutdown>";
+
+    QByteArray largeLinks;
+    for (int i = 0; i < 1000; ++i) {
+        if (i)
+            largeLinks.append(',');
+        largeLinks.append("</sensors/" + QByteArray::number(i)
+                          + ">;rt=\"temperature-c\";if=\"sensor\";ct=0;obs");
+    }
+
+    // Resource directory entries, with long quoted values holding delimiters
+    QByteArray directoryLinks;
+    for (int i = 0; i < 1000; ++i) {
+        if (i)
+            directoryLinks.append(',');
+        directoryLinks.append("</rd/" + QByteArray::number(i) + "/sensors/temperature>;"
+                              "anchor=\"coap://[2001:db8::" + QByteArray::number(i, 16) + "]\";"
+                              "rt=\"oic.r.temperature\";title=\"Temperature, room "
+                              + QByteArray::number(i) + "; ground floor, building A\";ct=\"0 50\"");
+    }
+
+    QTest::newRow("plugtest") << plugtestLinks;
+    QTest::newRow("1000_links") << largeLinks;
+    QTest::newRow("1000_directory_links") << directoryLinks;
+}
+
+void tst_QCoapProtocol::resourcesFromCoreLinkList()
+{
+    QFETCH(QByteArray, coreLinks);
+    const QHostAddress sender(QHostAddress::LocalHost);
+
+    QVector<QCoapResource> resources;
+    QBENCHMARK {
+        resources = QCoapProtocol::resourcesFromCoreLinkList(sender, coreLinks);
+    }
+    QVERIFY(!resources.isEmpty());
+}
+
+void tst_QCoapProtocol::resourcesFromCoreLinkListAllocations_data()
+{
+    resourcesFromCoreLinkList_data();
+}
+
+void tst_QCoapProtocol::resourcesFromCoreLinkListAllocations()
+{
+    QFETCH(QByteArray, coreLinks);
+    const QHostAddress sender(QHostAddress::LocalHost);
+
+    const AllocationCounter counter;
+    const QVector<QCoapResource> resources =
+            QCoapProtocol::resourcesFromCoreLinkList(sender, coreLinks);
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QVERIFY(!resources.isEmpty());
+}
+
+static void addExchangeCountRows()
+{
+    QTest::addColumn<int>("exchangeCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("100k") << 100000;
+}
+
+void tst_QCoapProtocol::registerExchange_data()
+{
+    addExchangeCountRows();
+}
+
+// Measures adding and removing one exchange, including the generation of
+// a unique token and message ID and the pool slot of its request, while
+// \c exchangeCount are running.
+void tst_QCoapProtocol::registerExchange()
+{
+    QFETCH(int, exchangeCount);
+
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    fillExchanges(d, exchangeCount);
+
+    QBENCHMARK {
+        QCoapInternalRequest *request = d->requestPool.create();
+        request->setToken(d->generateUniqueToken());
+        request->setMessageId(d->generateUniqueMessageId());
+        d->registerExchange(request->token(), nullptr, request);
+        d->forgetExchange(request->token());
+    }
+    QCOMPARE(d->exchangeMap.size(), exchangeCount);
+}
+
+void tst_QCoapProtocol::lookupExchange_data()
+{
+    addExchangeCountRows();
+}
+
+// Measures finding an exchange from a received reply, by token and by
+// message ID.
+void tst_QCoapProtocol::lookupExchange()
+{
+    QFETCH(int, exchangeCount);
+
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    fillExchanges(d, exchangeCount);
+
+    const int index = exchangeCount / 2;
+    const QCoapToken token = tokenForIndex(index);
+    const quint16 messageId = messageIdForIndex(index);
+
+    QCoapInternalRequest *byToken = nullptr;
+    QCoapInternalRequest *byMessageId = nullptr;
+    QBENCHMARK {
+        byToken = d->requestForToken(token);
+        byMessageId = d->findRequestByMessageId(messageId);
+    }
+    QVERIFY(byToken);
+    QVERIFY(byMessageId);
+}
+
+void tst_QCoapProtocol::block2Reassembly_data()
+{
+    QTest::addColumn<int>("blockCount");
+    QTest::addColumn<int>("blockSize");
+
+    QTest::newRow("4x64") << 4 << 64;
+    QTest::newRow("16x1024") << 16 << 1024;
+    QTest::newRow("256x1024") << 256 << 1024;
+}
+
+// Measures decoding the Block2 replies of a transfer and merging their
+// payloads once the last block is received.
+void tst_QCoapProtocol::block2Reassembly()
+{
+    QFETCH(int, blockCount);
+    QFETCH(int, blockSize);
+
+    const QCoapToken token = QByteArray::fromHex("4647f09b");
+    const quint32 sizeExponent = static_cast<quint32>(qCountTrailingZeroBits(
+                                                          static_cast<quint32>(blockSize)) - 4);
+
+    QVector<QByteArray> frames;
+    for (int block = 0; block < blockCount; ++block) {
+        QCoapMessage message;
+        message.setType(QCoapMessage::Acknowledgment);
+        message.setMessageId(static_cast<quint16>(block));
+        message.setToken(token);
+        const bool more = block < blockCount - 1;
+        message.addOption(QCoapOption(QCoapOption::Block2,
+                                      (static_cast<quint32>(block) << 4)
+                                      | (more ? 0x08u : 0u) | sizeExponent));
+        message.setPayload(QByteArray(blockSize, static_cast<char>('a' + block % 26)));
+        frames.append(QCoapInternalMessagePrivate::encodeFrame(message, QtCoap::Content));
+    }
+
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+    QCoapReply userReply(QCoapRequest(QUrl("coap://127.0.0.1/large")));
+
+    QBENCHMARK {
+        QCoapInternalRequest *request = d->requestPool.create();
+        request->setToken(token);
+        d->registerExchange(token, &userReply, request);
+        for (const QByteArray &frame : qAsConst(frames)) {
+            QCoapInternalReply reply;
+            QCoapInternalReply::createFromFrame(frame, &reply);
+            d->addReply(token, reply);
+        }
+        d->onLastMessageReceived(request);
+
+        // Drop the results queued to the user reply
+        QCoreApplication::removePostedEvents(&userReply);
+    }
+    QVERIFY(!d->isTokenRegistered(token));
+}
+
+void tst_QCoapProtocol::replayCapture_data()
+{
+    QTest::addColumn<int>("exchangeCount");
+
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+}
+
+// Measures replaying the capture of a busy gateway as fast as the
+// protocol handles it: each exchange is a confirmable GET, answered by a
+// piggybacked response, and several exchanges overlap.
+void tst_QCoapProtocol::replayCapture()
+{
+    QFETCH(int, exchangeCount);
+
+    const QHostAddress server("10.20.30.40");
+    const int overlap = 32;
+    QVector<QCoapCaptureRecord> records;
+    records.reserve(exchangeCount * 2);
+    auto addRecord = [&](QCoapCaptureRecord::Direction direction, int index,
+                         QCoapMessage::MessageType type, quint8 code) {
+        QCoapMessage message;
+        message.setType(type);
+        message.setMessageId(messageIdForIndex(index));
+        message.setToken(tokenForIndex(index));
+        if (direction == QCoapCaptureRecord::Received)
+            message.setPayload("22.5 C");
+        QCoapCaptureRecord record;
+        record.direction = direction;
+        record.timestamp = qint64(records.size()) * 100000;
+        record.address = server;
+        record.port = QtCoap::DefaultPort;
+        record.frame = QCoapInternalMessagePrivate::encodeFrame(message, code);
+        records.append(record);
+    };
+    for (int i = 0; i < exchangeCount + overlap; ++i) {
+        if (i < exchangeCount)
+            addRecord(QCoapCaptureRecord::Sent, i, QCoapMessage::Confirmable, QtCoap::Get);
+        if (i >= overlap) {
+            addRecord(QCoapCaptureRecord::Received, i - overlap, QCoapMessage::Acknowledgment,
+                      QtCoap::Content);
+        }
+    }
+
+    QCoapProtocol protocol;
+    QCoapConnection connection;
+    QCoapCaptureReplayer replayer(&protocol, &connection);
+    QBENCHMARK {
+        replayer.setRecords(records);
+        replayer.start(0);
+    }
+    QCOMPARE(replayer.replayedCount(), records.size());
+    QVERIFY(protocolPrivate(&protocol)->exchangeMap.isEmpty());
+}
+
+void tst_QCoapProtocol::encodeAcknowledgment_data()
+{
+    QTest::addColumn<bool>("internalRequest");
+
+    QTest::newRow("internal_request") << true;
+    QTest::newRow("empty_frame") << false;
+}
+
+// Builds the acknowledgment of a confirmable notification, either with an
+// internal request, as it used to be, or with the empty frame written on
+// the stack by the protocol.
+static int encodeAcknowledgment(bool internalRequest, QCoapConnection *connection,
+                                const QUrl &target, const QCoapToken &token, char *buffer)
+{
+    if (!internalRequest) {
+        return QCoapInternalMessagePrivate::encodeEmptyFrame(buffer, QCoapMessage::Acknowledgment,
+                                                             56400, token);
+    }
+
+    QCoapInternalRequest ackRequest;
+    ackRequest.setTargetUri(target);
+    ackRequest.initForAcknowledgment(56400, token);
+    ackRequest.setConnection(connection);
+    return ackRequest.toQByteArray().size();
+}
+
+void tst_QCoapProtocol::encodeAcknowledgment()
+{
+    QFETCH(bool, internalRequest);
+
+    QCoapConnection connection;
+    const QUrl target("coap://10.20.30.40:5683/sensor");
+    const QCoapToken token = tokenForIndex(42);
+
+    char buffer[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    int size = 0;
+    QBENCHMARK {
+        size = encodeAcknowledgment(internalRequest, &connection, target, token, buffer);
+    }
+    QCOMPARE(size, 4 + token.size());
+}
+
+void tst_QCoapProtocol::encodeAcknowledgmentAllocations_data()
+{
+    encodeAcknowledgment_data();
+}
+
+void tst_QCoapProtocol::encodeAcknowledgmentAllocations()
+{
+    QFETCH(bool, internalRequest);
+
+    QCoapConnection connection;
+    const QUrl target("coap://10.20.30.40:5683/sensor");
+    const QCoapToken token = tokenForIndex(42);
+
+    char buffer[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const AllocationCounter counter;
+    const int size = encodeAcknowledgment(internalRequest, &connection, target, token, buffer);
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QCOMPARE(size, 4 + token.size());
+}
+
+// Counts the allocations made to handle the empty acknowledgment of a
+// request answered with a separate response. The endpoint is already known.
+void tst_QCoapProtocol::emptyAcknowledgmentAllocations()
+{
+    const QHostAddress server("10.20.30.40");
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = protocolPrivate(&protocol);
+
+    QCoapInternalRequest *request = d->requestPool.create();
+    request->setTargetUri(QUrl("coap://10.20.30.40:5683/separate"));
+    request->setToken(tokenForIndex(1));
+    request->setMessageId(messageIdForIndex(1));
+    d->registerExchange(request->token(), nullptr, request);
+    d->restartTransmission(request);
+    d->rateLimiter.setAnswered(server, QtCoap::DefaultPort);
+    d->statistics.addRttSample(server.toString(), QtCoap::DefaultPort, 0);
+
+    char frame[QCoapInternalMessagePrivate::MaxEmptyFrameSize];
+    const int size = QCoapInternalMessagePrivate::encodeEmptyFrame(
+                frame, QCoapMessage::Acknowledgment, messageIdForIndex(1));
+    QNetworkDatagram ack(QByteArray(frame, size));
+    ack.setSender(server, QtCoap::DefaultPort);
+
+    const AllocationCounter counter;
+    d->onFrameReceived(ack);
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QCOMPARE(request->exchangeState(), QCoapInternalRequest::WaitingSeparateResponse);
+}
+
+QTEST_GUILESS_MAIN(tst_QCoapProtocol)
+
+#include "tst_bench_qcoapprotocol.moc"
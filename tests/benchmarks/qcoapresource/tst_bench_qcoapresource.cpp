@@ -0,0 +1,197 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <QtCoap/qcoapresource.h>
+#include <private/qcoapresource_p.h>
+#include <private/qcoaplinkformatparser_p.h>
+
+#include "allocationcounter.h"
+
+class tst_QCoapResource : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void catalogueMemory_data();
+    void catalogueMemory();
+    void parseCatalogue();
+    void repeatedAttributeAllocations();
+};
+
+// QCoapResourcePrivate as it was declared before the attribute values
+// were interned and its fields reordered.
+class BaselineResourcePrivate : public QSharedData
+{
+public:
+    BaselineResourcePrivate() {}
+    BaselineResourcePrivate(const BaselineResourcePrivate &other)
+      : QSharedData(other), maximumSize(other.maximumSize), contentFormat(other.contentFormat)
+      , resourceType(other.resourceType), interface(other.interface), host(other.host)
+      , path(other.path), title(other.title), observable(other.observable) {}
+    ~BaselineResourcePrivate() {}
+
+    int maximumSize = -1;    // sz field
+    uint contentFormat = 0;  // ct field
+    QString resourceType;    // rt field
+    QString interface;       // if field
+    QHostAddress host;
+    QString path;
+    QString title;
+    bool observable = false; // obs field
+};
+
+static const int catalogueSize = 200000;
+
+// A catalogue of resources whose 'rt' and 'if' values come from a small
+// vocabulary, as returned by a resource directory.
+static QByteArray catalogueLinks()
+{
+    static const char *const resourceTypes[] = {
+        "temperature-c", "temperature-f", "humidity", "pressure", "luminosity",
+        "oic.r.temperature", "oic.r.humidity", "oic.r.switch.binary", "oic.r.light.dimming",
+        "oic.r.energy.consumption", "core.rd", "core.rd-lookup-res", "core.rd-lookup-ep",
+        "ipso:3303", "ipso:3304", "ipso:3311", "ipso:3312", "ipso:3323", "firmware", "battery"
+    };
+    static const char *const interfaces[] = { "sensor", "core.s", "core.a", "core.p" };
+
+    QByteArray links;
+    links.reserve(catalogueSize * 64);
+    for (int i = 0; i < catalogueSize; ++i) {
+        if (i)
+            links.append(',');
+        links.append("</dev/" + QByteArray::number(i / 20) + "/" + QByteArray::number(i % 20)
+                     + ">;rt=\"" + resourceTypes[i % 20] + "\";if=\"" + interfaces[i % 4]
+                     + "\";ct=" + QByteArray::number(i % 3 ? 0 : 50));
+        if (i % 5 == 0)
+            links.append(";obs");
+    }
+    return links;
+}
+
+// Returns the heap size of the string data referenced by \a string,
+// counting each block once across \a seen.
+static qint64 stringBytes(const QString &string, QSet<const void *> *seen)
+{
+    if (string.isNull() || seen->contains(string.constData()))
+        return 0;
+    seen->insert(string.constData());
+    return qint64(sizeof(QString::Data)) + (string.capacity() + 1) * qint64(sizeof(QChar));
+}
+
+void tst_QCoapResource::catalogueMemory_data()
+{
+    QTest::addColumn<bool>("baseline");
+
+    QTest::newRow("baseline") << true;
+    QTest::newRow("packed_interned") << false;
+}
+
+// Reports the bytes held by a 200k-resource catalogue, for the records
+// and the string data they reference.
+void tst_QCoapResource::catalogueMemory()
+{
+    QFETCH(bool, baseline);
+
+    const QVector<QCoapResource> resources =
+            QCoapLinkFormatParser::parse(QHostAddress::LocalHost, catalogueLinks());
+    QCOMPARE(resources.size(), catalogueSize);
+
+    QSet<const void *> seen;
+    qint64 bytes = 0;
+    if (baseline) {
+        // Every resource owned the values decoded from its own link
+        QVector<QSharedDataPointer<BaselineResourcePrivate>> records(resources.size());
+        for (int i = 0; i < resources.size(); ++i) {
+            const QCoapResource &resource = resources.at(i);
+            BaselineResourcePrivate *record = new BaselineResourcePrivate;
+            records[i] = record;
+            record->maximumSize = resource.maximumSize();
+            record->contentFormat = resource.contentFormat();
+            record->resourceType = QString::fromUtf8(resource.resourceType().toUtf8());
+            record->interface = QString::fromUtf8(resource.interface().toUtf8());
+            record->host = resource.host();
+            record->path = resource.path();
+            record->title = resource.title();
+            record->observable = resource.observable();
+            bytes += qint64(sizeof(BaselineResourcePrivate))
+                    + stringBytes(record->resourceType, &seen)
+                    + stringBytes(record->interface, &seen)
+                    + stringBytes(record->path, &seen)
+                    + stringBytes(record->title, &seen);
+        }
+    } else {
+        for (const QCoapResource &resource : resources) {
+            bytes += qint64(sizeof(QCoapResourcePrivate))
+                    + stringBytes(resource.resourceType(), &seen)
+                    + stringBytes(resource.interface(), &seen)
+                    + stringBytes(resource.path(), &seen)
+                    + stringBytes(resource.title(), &seen);
+        }
+    }
+    QTest::setBenchmarkResult(bytes, QTest::BytesAllocated);
+}
+
+void tst_QCoapResource::parseCatalogue()
+{
+    const QByteArray links = catalogueLinks();
+
+    QVector<QCoapResource> resources;
+    QBENCHMARK {
+        resources = QCoapLinkFormatParser::parse(QHostAddress::LocalHost, links);
+    }
+    QCOMPARE(resources.size(), catalogueSize);
+}
+
+// Counts the allocations made by parsing links whose attribute values
+// were already seen by the parser.
+void tst_QCoapResource::repeatedAttributeAllocations()
+{
+    const QByteArray link = "</s>;rt=\"temperature-c\";if=\"sensor\",";
+    QCoapLinkFormatParser parser(QHostAddress::LocalHost);
+    const QVector<QCoapResource> first = parser.feed(link);
+    QCOMPARE(first.size(), 1);
+
+    QVector<QCoapResource> resources;
+    resources.reserve(1000);
+    const AllocationCounter counter;
+    for (int i = 0; i < 1000; ++i)
+        resources += parser.feed(link);
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+
+    QCOMPARE(resources.size(), 1000);
+    QCOMPARE(resources.last().resourceType().constData(),
+             first.first().resourceType().constData());
+    QCOMPARE(resources.last().interface().constData(), first.first().interface().constData());
+}
+
+QTEST_APPLESS_MAIN(tst_QCoapResource)
+
+#include "tst_bench_qcoapresource.moc"
@@ -0,0 +1,7 @@
+TARGET = tst_bench_qcoapserver
+QT = testlib core-private network core coap coap-private
+CONFIG += benchmark
+
+include(../shared/allocationcounter.pri)
+
+SOURCES += tst_bench_qcoapserver.cpp
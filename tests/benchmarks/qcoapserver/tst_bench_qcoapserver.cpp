@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <QtCoap/qcoapresource.h>
+#include <QtCoap/qcoapserver.h>
+#include <private/qcoapserver_p.h>
+#include <QtNetwork/qudpsocket.h>
+
+#include "allocationcounter.h"
+
+class tst_QCoapServer : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void notifyObservers_data();
+    void notifyObservers();
+    void notifyObserversAllocations_data();
+    void notifyObserversAllocations();
+
+private:
+    void addObservers(int count, bool confirmable);
+
+    QCoapServer *server = nullptr;
+    QUdpSocket *sink = nullptr;
+};
+
+void tst_QCoapServer::init()
+{
+    server = new QCoapServer;
+    server->addResource("/observed", QtCoap::Get, [](const QCoapRequest &,
+                                                     QCoapMessage *response) {
+        response->addOption(QCoapOption(QCoapOption::ContentFormat, quint32(0)));
+        response->setPayload(QByteArray(32, 'v'));
+        return QtCoap::Content;
+    });
+    QCoapResource description;
+    description.setPath("/observed");
+    description.setObservable(true);
+    server->setResourceDescription(description);
+    QVERIFY(server->listen(QHostAddress::LocalHost, 0));
+
+    // Notifications are sent to this socket, which never reads them
+    sink = new QUdpSocket;
+    QVERIFY(sink->bind(QHostAddress::AnyIPv4, 0));
+}
+
+void tst_QCoapServer::cleanup()
+{
+    delete server;
+    server = nullptr;
+    delete sink;
+    sink = nullptr;
+}
+
+// Observers are told apart by their address in 127.0.0.0/8, which all
+// reach the sink socket.
+void tst_QCoapServer::addObservers(int count, bool confirmable)
+{
+    QCoapServerPrivate *d = static_cast<QCoapServerPrivate *>(QObjectPrivate::get(server));
+    for (int i = 0; i < count; ++i) {
+        d->registerObserver(QHostAddress(quint32(0x7F000001 + i)), sink->localPort(),
+                            QByteArray::number(i), QStringLiteral("/observed"), confirmable);
+    }
+    QCOMPARE(server->observerCount("/observed"), count);
+}
+
+static void addObserverRows()
+{
+    QTest::addColumn<int>("observers");
+    QTest::addColumn<bool>("confirmable");
+
+    QTest::newRow("non_100") << 100 << false;
+    QTest::newRow("non_1000") << 1000 << false;
+    QTest::newRow("non_10000") << 10000 << false;
+    QTest::newRow("con_10000") << 10000 << true;
+}
+
+void tst_QCoapServer::notifyObservers_data()
+{
+    addObserverRows();
+}
+
+void tst_QCoapServer::notifyObservers()
+{
+    QFETCH(int, observers);
+    QFETCH(bool, confirmable);
+
+    addObservers(observers, confirmable);
+
+    QBENCHMARK {
+        QCOMPARE(server->notifyObservers("/observed"), observers);
+    }
+}
+
+void tst_QCoapServer::notifyObserversAllocations_data()
+{
+    addObserverRows();
+}
+
+// Non-confirmable notifications reuse a single buffer, so that the count
+// should not depend on the number of observers.
+void tst_QCoapServer::notifyObserversAllocations()
+{
+    QFETCH(int, observers);
+    QFETCH(bool, confirmable);
+
+    addObservers(observers, confirmable);
+    server->notifyObservers("/observed");
+
+    const AllocationCounter counter;
+    const int notified = server->notifyObservers("/observed");
+    QTest::setBenchmarkResult(counter.count(), QTest::Events);
+    QCOMPARE(notified, observers);
+}
+
+QTEST_MAIN(tst_QCoapServer)
+
+#include "tst_bench_qcoapserver.moc"
@@ -0,0 +1,7 @@
+INCLUDEPATH += $$PWD
+
+HEADERS += $$PWD/allocationcounter.h
+SOURCES += $$PWD/allocationcounter.cpp
+
+# operator new may throw when not counting with glibc
+CONFIG += exceptions
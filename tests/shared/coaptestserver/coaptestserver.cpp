@@ -0,0 +1,929 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "coaptestserver.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <QtNetwork/qudpsocket.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+enum : quint8 {
+    Get = 1, Post = 2, Put = 3, Delete = 4,
+    Created = 0x41, Deleted = 0x42, Changed = 0x44, Content = 0x45, Continue = 0x5F,
+    BadRequest = 0x80, BadOption = 0x82, NotFound = 0x84, MethodNotAllowed = 0x85,
+    RequestEntityIncomplete = 0x88
+};
+
+enum : quint16 {
+    Observe = 6, LocationPath = 8, UriPath = 11, ContentFormat = 12, MaxAge = 14,
+    UriQuery = 15, Block2 = 23, Block1 = 27, Size2 = 28
+};
+
+const int maxRetransmissions = 4;
+const int ackTimeout = 2000;
+const int recentResponseCount = 1024;
+
+struct BlockValue
+{
+    explicit BlockValue(quint32 value) :
+        number(value >> 4), more(value & 0x08), sizeExponent(qMin<quint32>(value & 0x07, 6))
+    {}
+
+    int size() const { return 16 << sizeExponent; }
+
+    quint32 number;
+    bool more;
+    quint32 sizeExponent;
+};
+
+quint32 blockValue(quint32 number, bool more, quint32 sizeExponent)
+{
+    return (number << 4) | (more ? 0x08 : 0) | sizeExponent;
+}
+
+const char *typeName(QCoapTestServer::Message::Type type)
+{
+    static const char *names[] = { "CON", "NON", "ACK", "RST" };
+    return names[type];
+}
+
+const char *methodName(quint8 code)
+{
+    static const char *names[] = { "EMPTY", "GET", "POST", "PUT", "DELETE" };
+    return code <= Delete ? names[code] : "UNKNOWN";
+}
+
+bool isObservable(const QString &path)
+{
+    return path == QLatin1String("obs") || path == QLatin1String("obs-non")
+            || path == QLatin1String("obs-large") || path == QLatin1String("obs-pumping");
+}
+
+} // namespace
+
+QByteArray QCoapTestServer::Message::option(quint16 number) const
+{
+    for (const auto &option : optionList) {
+        if (option.first == number)
+            return option.second;
+    }
+    return QByteArray();
+}
+
+QVector<QByteArray> QCoapTestServer::Message::options(quint16 number) const
+{
+    QVector<QByteArray> values;
+    for (const auto &option : optionList) {
+        if (option.first == number)
+            values.append(option.second);
+    }
+    return values;
+}
+
+bool QCoapTestServer::Message::hasOption(quint16 number) const
+{
+    return std::any_of(optionList.cbegin(), optionList.cend(),
+                       [number](const QPair<quint16, QByteArray> &option) {
+        return option.first == number;
+    });
+}
+
+void QCoapTestServer::Message::addOption(quint16 number, const QByteArray &value)
+{
+    optionList.append(qMakePair(number, value));
+}
+
+void QCoapTestServer::Message::addUIntOption(quint16 number, quint32 value)
+{
+    addOption(number, encodeUInt(value));
+}
+
+QCoapTestServer::QCoapTestServer(QObject *parent) :
+    QObject(parent),
+    socket(new QUdpSocket(this)),
+    notificationTimer(new QTimer(this))
+{
+    messageIdCounter = static_cast<quint16>(QRandomGenerator::global()->bounded(0x10000));
+    largeUpdateContent = largeContent();
+
+    connect(socket, &QUdpSocket::readyRead, this, &QCoapTestServer::onReadyRead);
+    connect(notificationTimer, &QTimer::timeout, this, &QCoapTestServer::sendNotifications);
+}
+
+QCoapTestServer::~QCoapTestServer()
+{
+    close();
+}
+
+/*!
+    Starts listening on \a address and \a port. Returns \c true on success.
+*/
+bool QCoapTestServer::listen(const QHostAddress &address, quint16 port)
+{
+    if (!socket->bind(address, port)) {
+        qWarning() << "QCoapTestServer: cannot bind to" << address << port
+                   << socket->errorString();
+        return false;
+    }
+
+    notificationTimer->start(notificationIntervalMs.load());
+    return true;
+}
+
+void QCoapTestServer::close()
+{
+    notificationTimer->stop();
+    socket->close();
+    for (const auto &pending : qAsConst(pendingConfirmables))
+        delete pending.timer;
+    pendingConfirmables.clear();
+    observers.clear();
+}
+
+QHostAddress QCoapTestServer::serverAddress() const
+{
+    return socket->localAddress();
+}
+
+quint16 QCoapTestServer::serverPort() const
+{
+    return socket->localPort();
+}
+
+/*!
+    Delays every datagram sent by the server by \a milliseconds.
+*/
+void QCoapTestServer::setLatency(int milliseconds)
+{
+    latencyMs.store(milliseconds);
+}
+
+int QCoapTestServer::latency() const
+{
+    return latencyMs.load();
+}
+
+/*!
+    Drops incoming and outgoing datagrams with the probability \a rate,
+    between 0 and 1.
+*/
+void QCoapTestServer::setLossRate(double rate)
+{
+    lossPerMillion.store(qBound(0, qRound(rate * 1000000), 1000000));
+}
+
+double QCoapTestServer::lossRate() const
+{
+    return lossPerMillion.load() / 1000000.0;
+}
+
+/*!
+    Sets the interval between two notifications of observed resources.
+    Takes effect the next time the server starts listening.
+*/
+void QCoapTestServer::setNotificationInterval(int milliseconds)
+{
+    notificationIntervalMs.store(milliseconds);
+}
+
+void QCoapTestServer::setSeparateResponseDelay(int milliseconds)
+{
+    separateDelayMs.store(milliseconds);
+}
+
+/*!
+    Creates a server listening on \a address and \a port, running in its
+    own thread. Returns \c nullptr if the server could not listen.
+
+    \sa stopInThread()
+*/
+QCoapTestServer *QCoapTestServer::startInThread(const QHostAddress &address, quint16 port)
+{
+    QThread *thread = new QThread;
+    thread->setObjectName(QStringLiteral("QCoapTestServer"));
+    QCoapTestServer *server = new QCoapTestServer;
+    server->moveToThread(thread);
+    connect(thread, &QThread::finished, server, &QObject::deleteLater);
+    thread->start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(server, [&]() { listening = server->listen(address, port); },
+                              Qt::BlockingQueuedConnection);
+    if (!listening) {
+        stopInThread(server);
+        return nullptr;
+    }
+    return server;
+}
+
+/*!
+    Stops a \a server created with startInThread() and its thread.
+*/
+void QCoapTestServer::stopInThread(QCoapTestServer *server)
+{
+    if (!server)
+        return;
+
+    QThread *thread = server->thread();
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+/*!
+    Decodes the CoAP \a frame into \a message. Returns \c false if the frame
+    is malformed.
+*/
+bool QCoapTestServer::decode(const QByteArray &frame, Message *message)
+{
+    const quint8 *data = reinterpret_cast<const quint8 *>(frame.constData());
+    const int size = frame.size();
+    if (size < 4 || (data[0] >> 6) != 1)
+        return false;
+
+    const int tokenLength = data[0] & 0x0F;
+    if (tokenLength > 8 || 4 + tokenLength > size)
+        return false;
+
+    message->type = static_cast<Message::Type>((data[0] >> 4) & 0x03);
+    message->code = data[1];
+    message->messageId = static_cast<quint16>((data[2] << 8) | data[3]);
+    message->token = frame.mid(4, tokenLength);
+    message->optionList.clear();
+    message->payload.clear();
+
+    int i = 4 + tokenLength;
+    quint32 optionNumber = 0;
+    while (i < size && data[i] != 0xFF) {
+        quint32 delta = data[i] >> 4;
+        quint32 length = data[i] & 0x0F;
+        ++i;
+
+        for (quint32 *field : { &delta, &length }) {
+            if (*field == 13) {
+                if (i + 1 > size)
+                    return false;
+                *field = 13u + data[i];
+                i += 1;
+            } else if (*field == 14) {
+                if (i + 2 > size)
+                    return false;
+                *field = 269u + ((data[i] << 8) | data[i + 1]);
+                i += 2;
+            } else if (*field == 15) {
+                return false;
+            }
+        }
+
+        optionNumber += delta;
+        if (optionNumber > 0xFFFF || i + static_cast<int>(length) > size)
+            return false;
+
+        message->addOption(static_cast<quint16>(optionNumber),
+                           frame.mid(i, static_cast<int>(length)));
+        i += static_cast<int>(length);
+    }
+
+    if (i < size) {
+        // Payload marker followed by an empty payload is a format error
+        if (i + 1 == size)
+            return false;
+        message->payload = frame.mid(i + 1);
+    }
+
+    return true;
+}
+
+/*!
+    Encodes \a message into a CoAP frame.
+*/
+QByteArray QCoapTestServer::encode(const Message &message)
+{
+    QByteArray frame;
+    frame.append(static_cast<char>(0x40 | (message.type << 4) | message.token.size()));
+    frame.append(static_cast<char>(message.code));
+    frame.append(static_cast<char>(message.messageId >> 8));
+    frame.append(static_cast<char>(message.messageId & 0xFF));
+    frame.append(message.token);
+
+    auto options = message.optionList;
+    std::stable_sort(options.begin(), options.end(),
+                     [](const QPair<quint16, QByteArray> &a, const QPair<quint16, QByteArray> &b) {
+        return a.first < b.first;
+    });
+
+    auto nibble = [](quint32 value) -> quint8 {
+        return value < 13 ? static_cast<quint8>(value) : (value < 269 ? 13 : 14);
+    };
+    auto extended = [&frame](quint8 nibble, quint32 value) {
+        if (nibble == 13) {
+            frame.append(static_cast<char>(value - 13));
+        } else if (nibble == 14) {
+            frame.append(static_cast<char>((value - 269) >> 8));
+            frame.append(static_cast<char>((value - 269) & 0xFF));
+        }
+    };
+
+    quint32 lastNumber = 0;
+    for (const auto &option : qAsConst(options)) {
+        const quint32 delta = option.first - lastNumber;
+        const quint32 length = static_cast<quint32>(option.second.size());
+        frame.append(static_cast<char>((nibble(delta) << 4) | nibble(length)));
+        extended(nibble(delta), delta);
+        extended(nibble(length), length);
+        frame.append(option.second);
+        lastNumber = option.first;
+    }
+
+    if (!message.payload.isEmpty()) {
+        frame.append(static_cast<char>(0xFF));
+        frame.append(message.payload);
+    }
+
+    return frame;
+}
+
+/*!
+    Encodes \a value as a CoAP unsigned integer option value.
+*/
+QByteArray QCoapTestServer::encodeUInt(quint32 value)
+{
+    QByteArray encoded;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        if (!encoded.isEmpty() || (value >> shift) != 0)
+            encoded.append(static_cast<char>((value >> shift) & 0xFF));
+    }
+    return encoded;
+}
+
+quint32 QCoapTestServer::decodeUInt(const QByteArray &value)
+{
+    quint32 decoded = 0;
+    for (char byte : value)
+        decoded = (decoded << 8) | static_cast<quint8>(byte);
+    return decoded;
+}
+
+void QCoapTestServer::onReadyRead()
+{
+    while (socket->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = socket->receiveDatagram();
+        if (isLost())
+            continue;
+
+        Message message;
+        if (!decode(datagram.data(), &message))
+            continue;
+
+        const Peer peer = { datagram.senderAddress(), static_cast<quint16>(datagram.senderPort()) };
+        handleMessage(peer, message);
+    }
+}
+
+void QCoapTestServer::handleMessage(const Peer &peer, const Message &message)
+{
+    switch (message.type) {
+    case Message::Acknowledgment:
+    case Message::Reset: {
+        auto it = pendingConfirmables.find(message.messageId);
+        if (it != pendingConfirmables.end()) {
+            delete it->timer;
+            pendingConfirmables.erase(it);
+        }
+
+        // A Reset answering a notification cancels the observation
+        if (message.type == Message::Reset) {
+            observers.erase(std::remove_if(observers.begin(), observers.end(),
+                                           [&](const Observer &observer) {
+                return observer.peer.address.isEqual(peer.address)
+                        && observer.peer.port == peer.port
+                        && observer.recentMessageIds.contains(message.messageId);
+            }), observers.end());
+        }
+        break;
+    }
+    case Message::Confirmable:
+    case Message::NonConfirmable:
+        if (message.code == 0) {
+            // CoAP ping
+            if (message.type == Message::Confirmable) {
+                Message reset;
+                reset.type = Message::Reset;
+                reset.messageId = message.messageId;
+                send(peer, reset);
+            }
+        } else if (message.code <= Delete) {
+            handleRequest(peer, message);
+        }
+        break;
+    }
+}
+
+void QCoapTestServer::handleRequest(const Peer &peer, const Message &request)
+{
+    // Duplicated requests get the same response, see section 4.5 of RFC 7252
+    const QString key = peerKey(peer) + QLatin1Char('#') + QString::number(request.messageId);
+    const auto recent = recentResponses.constFind(key);
+    if (recent != recentResponses.constEnd()) {
+        if (request.type == Message::Confirmable && !recent->isEmpty())
+            sendFrame(peer, *recent);
+        return;
+    }
+
+    QStringList segments;
+    for (const QByteArray &segment : request.options(UriPath))
+        segments.append(QString::fromUtf8(segment));
+    const QString path = segments.join(QLatin1Char('/'));
+
+    const bool separate = (path == QLatin1String("separate")
+                           || path == QLatin1String("large-separate"))
+            && !(request.hasOption(Block2) && BlockValue(decodeUInt(request.option(Block2))).number > 0);
+    if (separate) {
+        QByteArray ackFrame;
+        if (request.type == Message::Confirmable) {
+            Message ack;
+            ack.type = Message::Acknowledgment;
+            ack.messageId = request.messageId;
+            ackFrame = encode(ack);
+            sendFrame(peer, ackFrame);
+        }
+        rememberResponse(key, ackFrame);
+        sendSeparateResponse(peer, request, path);
+        return;
+    }
+
+    Message response;
+    response.token = request.token;
+    if (request.type == Message::Confirmable) {
+        response.type = Message::Acknowledgment;
+        response.messageId = request.messageId;
+    } else {
+        response.type = Message::NonConfirmable;
+        response.messageId = nextMessageId();
+    }
+
+    processRequest(peer, request, path, &response);
+    const QByteArray frame = encode(response);
+    rememberResponse(key, frame);
+    sendFrame(peer, frame);
+}
+
+/*!
+    Fills \a response for \a request on the resource at \a path.
+*/
+void QCoapTestServer::processRequest(const Peer &peer, const Message &request,
+                                     const QString &path, Message *response)
+{
+    // Follow-up Block2 requests are served from the stored representation
+    const QString bodyKey = peerKey(peer) + QLatin1Char('/') + path;
+    if (request.hasOption(Block2) && BlockValue(decodeUInt(request.option(Block2))).number > 0
+            && blockBodies.contains(bodyKey)) {
+        response->code = Content;
+        serveBlock2(peer, request, path, blockBodies.value(bodyKey), response);
+        return;
+    }
+
+    if (path == QLatin1String("test")) {
+        switch (request.code) {
+        case Get:
+            response->code = Content;
+            response->addUIntOption(ContentFormat, 0);
+            response->addUIntOption(MaxAge, 30);
+            response->payload = resourceContent(path);
+            response->payload.replace("%TYPE%", QByteArray::number(request.type) + " ("
+                                      + typeName(request.type) + ")");
+            response->payload.replace("%CODE%", QByteArray::number(request.code) + " ("
+                                      + methodName(request.code) + ")");
+            response->payload.replace("%MID%", QByteArray::number(request.messageId));
+            response->payload.replace("%TOKEN%", request.token.toHex());
+            break;
+        case Post:
+            response->code = Created;
+            response->addOption(LocationPath, "location1");
+            response->addOption(LocationPath, "location2");
+            response->addOption(LocationPath, "location3");
+            break;
+        case Put:
+            response->code = Changed;
+            break;
+        case Delete:
+            response->code = Deleted;
+            break;
+        }
+        return;
+    }
+
+    if (path == QLatin1String("separate")) {
+        response->code = Content;
+        response->addUIntOption(ContentFormat, 0);
+        response->payload = resourceContent(path);
+        return;
+    }
+
+    if (path == QLatin1String("large") || path == QLatin1String("large-separate")
+            || path == QLatin1String(".well-known/core")) {
+        if (request.code != Get) {
+            response->code = MethodNotAllowed;
+            return;
+        }
+        response->code = Content;
+        response->addUIntOption(ContentFormat, path.startsWith(QLatin1Char('.')) ? 40 : 0);
+        serveBlock2(peer, request, path, resourceContent(path), response);
+        return;
+    }
+
+    if (path == QLatin1String("large-post") || path == QLatin1String("large-update")) {
+        const bool update = path == QLatin1String("large-update");
+        if (update && request.code == Get) {
+            response->code = Content;
+            serveBlock2(peer, request, path, largeUpdateContent, response);
+            return;
+        }
+        if (request.code != (update ? Put : Post)) {
+            response->code = MethodNotAllowed;
+            return;
+        }
+
+        QByteArray body;
+        if (!receiveBlock1(peer, request, path, response, &body))
+            return;
+
+        response->code = Changed;
+        if (update)
+            largeUpdateContent = body;
+        else
+            serveBlock2(peer, request, path, body.toUpper(), response);
+        return;
+    }
+
+    if (path == QLatin1String("query")) {
+        if (request.code != Get) {
+            response->code = MethodNotAllowed;
+            return;
+        }
+        response->code = Content;
+        QByteArrayList queries;
+        for (const QByteArray &query : request.options(UriQuery))
+            queries.append(query);
+        response->payload = "Query: " + queries.join('&');
+        return;
+    }
+
+    if (isObservable(path)) {
+        if (request.code != Get) {
+            response->code = MethodNotAllowed;
+            return;
+        }
+
+        response->code = Content;
+        response->addUIntOption(ContentFormat, 0);
+        if (request.hasOption(Observe)) {
+            if (decodeUInt(request.option(Observe)) == 0) {
+                registerObserver(peer, request, path);
+                response->addUIntOption(Observe, 1);
+            } else {
+                removeObserver(peer, request.token);
+            }
+        }
+        serveBlock2(peer, request, path, resourceContent(path), response);
+        return;
+    }
+
+    response->code = NotFound;
+}
+
+/*!
+    Accumulates the Block1 transfer of \a request. Returns \c true with the
+    complete \a body once the last block is received, otherwise fills
+    \a response and returns \c false.
+*/
+bool QCoapTestServer::receiveBlock1(const Peer &peer, const Message &request,
+                                    const QString &path, Message *response, QByteArray *body)
+{
+    if (!request.hasOption(Block1)) {
+        *body = request.payload;
+        return true;
+    }
+
+    const quint32 value = decodeUInt(request.option(Block1));
+    const BlockValue block(value);
+    const QString key = peerKey(peer) + QLatin1Char('/') + path;
+    QByteArray &upload = uploads[key];
+    if (block.number == 0)
+        upload.clear();
+
+    if (upload.size() != static_cast<int>(block.number) * block.size()) {
+        uploads.remove(key);
+        response->code = RequestEntityIncomplete;
+        return false;
+    }
+
+    upload.append(request.payload);
+    if (block.more) {
+        response->code = Continue;
+        response->addUIntOption(Block1, value);
+        return false;
+    }
+
+    *body = uploads.take(key);
+    response->addUIntOption(Block1, value);
+    return true;
+}
+
+/*!
+    Puts the block of \a body requested by \a request in \a response.
+    Without a Block2 option, bodies larger than 1024 bytes are split.
+*/
+void QCoapTestServer::serveBlock2(const Peer &peer, const Message &request, const QString &path,
+                                  const QByteArray &body, Message *response)
+{
+    const QString key = peerKey(peer) + QLatin1Char('/') + path;
+    const bool requested = request.hasOption(Block2);
+    const BlockValue block(requested ? decodeUInt(request.option(Block2)) : 6);
+    if (!requested && body.size() <= block.size()) {
+        response->payload = body;
+        return;
+    }
+
+    const int offset = static_cast<int>(block.number) * block.size();
+    if (offset > 0 && offset >= body.size()) {
+        response->code = BadOption;
+        return;
+    }
+
+    const bool more = offset + block.size() < body.size();
+    response->addUIntOption(Block2, blockValue(block.number, more, block.sizeExponent));
+    if (block.number == 0)
+        response->addUIntOption(Size2, static_cast<quint32>(body.size()));
+    response->payload = body.mid(offset, block.size());
+
+    if (more)
+        blockBodies.insert(key, body);
+    else
+        blockBodies.remove(key);
+}
+
+void QCoapTestServer::sendSeparateResponse(const Peer &peer, const Message &request,
+                                           const QString &path)
+{
+    QTimer::singleShot(separateDelayMs.load(), this, [this, peer, request, path]() {
+        Message response;
+        response.type = request.type;
+        response.messageId = nextMessageId();
+        response.token = request.token;
+        processRequest(peer, request, path, &response);
+        send(peer, response);
+    });
+}
+
+void QCoapTestServer::registerObserver(const Peer &peer, const Message &request,
+                                       const QString &path)
+{
+    removeObserver(peer, request.token);
+
+    Observer observer;
+    observer.peer = peer;
+    observer.token = request.token;
+    observer.path = path;
+    observer.type = (path == QLatin1String("obs-non") || path == QLatin1String("obs-pumping"))
+            ? Message::NonConfirmable : Message::Confirmable;
+    observer.sequence = 1;
+    observers.append(observer);
+}
+
+void QCoapTestServer::removeObserver(const Peer &peer, const QByteArray &token)
+{
+    observers.erase(std::remove_if(observers.begin(), observers.end(),
+                                   [&](const Observer &observer) {
+        return observer.token == token && observer.peer.address.isEqual(peer.address)
+                && observer.peer.port == peer.port;
+    }), observers.end());
+}
+
+void QCoapTestServer::sendNotifications()
+{
+    for (Observer &observer : observers) {
+        // obs-pumping notifies twice per interval
+        const int count = observer.path == QLatin1String("obs-pumping") ? 2 : 1;
+        for (int i = 0; i < count; ++i) {
+            Message notification;
+            notification.type = observer.type;
+            notification.code = Content;
+            notification.messageId = nextMessageId();
+            notification.token = observer.token;
+            notification.addUIntOption(Observe, ++observer.sequence & 0xFFFFFF);
+            notification.addUIntOption(ContentFormat, 0);
+
+            // Large notifications start a new Block2 transfer
+            Message request;
+            request.code = Get;
+            serveBlock2(observer.peer, request, observer.path,
+                        resourceContent(observer.path), &notification);
+
+            // Remember a few message IDs, a Reset may answer any of them
+            observer.recentMessageIds.append(notification.messageId);
+            if (observer.recentMessageIds.size() > 8)
+                observer.recentMessageIds.removeFirst();
+            send(observer.peer, notification);
+        }
+    }
+}
+
+void QCoapTestServer::send(const Peer &peer, const Message &message)
+{
+    const QByteArray frame = encode(message);
+    if (message.type == Message::Confirmable) {
+        QTimer *timer = new QTimer(this);
+        timer->setSingleShot(true);
+        const quint16 messageId = message.messageId;
+        connect(timer, &QTimer::timeout, this, [this, messageId]() {
+            onRetransmissionTimeout(messageId);
+        });
+        timer->start(ackTimeout);
+        pendingConfirmables.insert(messageId, { peer, frame, 0, timer });
+    }
+    sendFrame(peer, frame);
+}
+
+void QCoapTestServer::sendFrame(const Peer &peer, const QByteArray &frame)
+{
+    if (isLost())
+        return;
+
+    const int delay = latencyMs.load();
+    if (delay <= 0) {
+        socket->writeDatagram(frame, peer.address, peer.port);
+        return;
+    }
+
+    QTimer::singleShot(delay, this, [this, peer, frame]() {
+        socket->writeDatagram(frame, peer.address, peer.port);
+    });
+}
+
+void QCoapTestServer::onRetransmissionTimeout(quint16 messageId)
+{
+    auto it = pendingConfirmables.find(messageId);
+    if (it == pendingConfirmables.end())
+        return;
+
+    if (it->retransmissions >= maxRetransmissions) {
+        delete it->timer;
+        pendingConfirmables.erase(it);
+
+        // An unacknowledged notification ends the observation, see
+        // section 4.5 of RFC 7641
+        observers.erase(std::remove_if(observers.begin(), observers.end(),
+                                       [messageId](const Observer &observer) {
+            return observer.recentMessageIds.contains(messageId);
+        }), observers.end());
+        return;
+    }
+
+    ++it->retransmissions;
+    it->timer->start(ackTimeout << it->retransmissions);
+    sendFrame(it->peer, it->frame);
+}
+
+void QCoapTestServer::rememberResponse(const QString &key, const QByteArray &frame)
+{
+    recentResponses.insert(key, frame);
+    recentResponseKeys.enqueue(key);
+    while (recentResponseKeys.size() > recentResponseCount)
+        recentResponses.remove(recentResponseKeys.dequeue());
+}
+
+quint16 QCoapTestServer::nextMessageId()
+{
+    return ++messageIdCounter;
+}
+
+bool QCoapTestServer::isLost() const
+{
+    const int loss = lossPerMillion.load();
+    return loss > 0 && static_cast<int>(QRandomGenerator::global()->bounded(1000000)) < loss;
+}
+
+QByteArray QCoapTestServer::resourceContent(const QString &path) const
+{
+    if (path == QLatin1String("test"))
+        return "Type: %TYPE%\nCode: %CODE%\nMID: %MID%\nToken: %TOKEN%";
+    if (path == QLatin1String("separate"))
+        return "Type: 0 (CON)\nCode: 1 (GET)\nSeparate response";
+    if (path == QLatin1String("large") || path == QLatin1String("large-separate"))
+        return largeContent();
+    if (path == QLatin1String(".well-known/core"))
+        return coreLinkFormat();
+
+    if (isObservable(path)) {
+        QByteArray content = QTime::currentTime().toString(QStringLiteral("HH:mm:ss")).toLatin1();
+        if (path == QLatin1String("obs-large"))
+            content.append(QByteArray(1400, '.'));
+        return content;
+    }
+
+    return QByteArray();
+}
+
+/*!
+    Returns the resources of the Californium plugtest server, in the
+    CoRE link format.
+*/
+QByteArray QCoapTestServer::coreLinkFormat()
+{
+    static const char *const links[] = {
+        "</obs>;obs;rt=\"observe\";title=\"Observable resource which changes every 5 seconds\"",
+        "</obs-pumping>;obs;rt=\"observe\";title=\"Observable resource which changes every 5 seconds\"",
+        "</separate>;title=\"Resource which cannot be served immediately\"",
+        "</large-create>;rt=\"block\";title=\"Large resource that can be created using POST method\"",
+        "</seg1>;title=\"Long path resource\"",
+        "</seg1/seg2>;title=\"Long path resource\"",
+        "</seg1/seg2/seg3>;title=\"Long path resource\"",
+        "</large-separate>;rt=\"block\";sz=1280;title=\"Large resource\"",
+        "</obs-reset>",
+        "</.well-known/core>",
+        "</multi-format>;ct=\"0 41\";title=\"Resource that exists in different content formats\"",
+        "</path>;ct=40;title=\"Hierarchical link description entry\"",
+        "</path/sub1>;title=\"Hierarchical link description sub-resource\"",
+        "</path/sub2>;title=\"Hierarchical link description sub-resource\"",
+        "</path/sub3>;title=\"Hierarchical link description sub-resource\"",
+        "</link1>;if=\"If1\";rt=\"Type1 Type2\";title=\"Link test resource\"",
+        "</link3>;if=\"foo\";rt=\"Type1 Type3\";title=\"Link test resource\"",
+        "</link2>;if=\"If2\";rt=\"Type2 Type3\";title=\"Link test resource\"",
+        "</obs-large>;obs;rt=\"observe\";title=\"Large Observable resource\"",
+        "</validate>;ct=0;sz=17;title=\"Resource which varies\"",
+        "</test>;title=\"Default test resource\"",
+        "</large>;rt=\"block\";sz=1280;title=\"Large resource\"",
+        "</obs-pumping-non>;obs;rt=\"observe\";title=\"Observable resource which changes every 5 seconds\"",
+        "</query>;title=\"Resource accepting query parameters\"",
+        "</large-post>;rt=\"block\";title=\"Handle POST with two-way blockwise transfer\"",
+        "</location-query>;title=\"Perform POST transaction with responses containing several Location-Query options (CON mode)\"",
+        "</obs-non>;obs;rt=\"observe\";title=\"Observable resource which changes every 5 seconds\"",
+        "</large-update>;rt=\"block\";sz=1280;title=\"Large resource that can be updated using PUT method\"",
+        "</shutdown>"
+    };
+
+    QByteArrayList list;
+    for (const char *link : links)
+        list.append(link);
+    return list.join(',');
+}
+
+/*!
+    Returns the content of the /large resource: five blocks of 256 bytes.
+*/
+QByteArray QCoapTestServer::largeContent()
+{
+    QByteArray content;
+    for (int block = 1; block <= 5; ++block) {
+        content.append("/-------------------------------------------------------------\\\n");
+        content.append("|                 RESOURCE BLOCK NO. " + QByteArray::number(block)
+                       + " OF 5                   |\n");
+        content.append("|               [each line contains 64 bytes]                 |\n");
+        content.append("\\-------------------------------------------------------------/\n");
+    }
+    return content;
+}
+
+QString QCoapTestServer::peerKey(const Peer &peer)
+{
+    return peer.address.toString() + QLatin1Char(':') + QString::number(peer.port);
+}
+
+QT_END_NAMESPACE
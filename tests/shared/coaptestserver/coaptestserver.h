@@ -0,0 +1,177 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 Witekio.
+** Contact: https://witekio.com/contact/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef COAPTESTSERVER_H
+#define COAPTESTSERVER_H
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qvector.h>
+#include <QtNetwork/qhostaddress.h>
+
+QT_BEGIN_NAMESPACE
+
+class QUdpSocket;
+class QTimer;
+
+/*!
+    \internal
+
+    A CoAP server implementing the plugtest resources used by the QtCoap
+    tests and benchmarks, so that they do not need a Californium server.
+
+    The server has its own minimal codec, independent from QtCoap, so that
+    encoding bugs in the module are not hidden by the server sharing them.
+    It answers confirmable requests with piggybacked or separate responses,
+    handles Block1 and Block2 transfers and Observe registrations. Latency
+    and datagram loss can be configured to exercise retransmissions.
+*/
+class QCoapTestServer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Message
+    {
+        enum Type { Confirmable, NonConfirmable, Acknowledgment, Reset };
+
+        QByteArray option(quint16 number) const;
+        QVector<QByteArray> options(quint16 number) const;
+        bool hasOption(quint16 number) const;
+        void addOption(quint16 number, const QByteArray &value = QByteArray());
+        void addUIntOption(quint16 number, quint32 value);
+
+        Type type = NonConfirmable;
+        quint8 code = 0;
+        quint16 messageId = 0;
+        QByteArray token;
+        QVector<QPair<quint16, QByteArray>> optionList;
+        QByteArray payload;
+    };
+
+    explicit QCoapTestServer(QObject *parent = nullptr);
+    ~QCoapTestServer();
+
+    bool listen(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 5683);
+    void close();
+    QHostAddress serverAddress() const;
+    quint16 serverPort() const;
+
+    // These settings can be changed from any thread
+    void setLatency(int milliseconds);
+    int latency() const;
+    void setLossRate(double rate);
+    double lossRate() const;
+    void setNotificationInterval(int milliseconds);
+    void setSeparateResponseDelay(int milliseconds);
+
+    static QCoapTestServer *startInThread(const QHostAddress &address, quint16 port);
+    static void stopInThread(QCoapTestServer *server);
+
+    static bool decode(const QByteArray &frame, Message *message);
+    static QByteArray encode(const Message &message);
+    static QByteArray encodeUInt(quint32 value);
+    static quint32 decodeUInt(const QByteArray &value);
+
+private Q_SLOTS:
+    void onReadyRead();
+    void sendNotifications();
+
+private:
+    struct Peer
+    {
+        QHostAddress address;
+        quint16 port;
+    };
+
+    struct Observer
+    {
+        Peer peer;
+        QByteArray token;
+        QString path;
+        Message::Type type;
+        quint32 sequence;
+        QVector<quint16> recentMessageIds;
+    };
+
+    struct PendingConfirmable
+    {
+        Peer peer;
+        QByteArray frame;
+        int retransmissions;
+        QTimer *timer;
+    };
+
+    void handleMessage(const Peer &peer, const Message &message);
+    void handleRequest(const Peer &peer, const Message &request);
+    void processRequest(const Peer &peer, const Message &request, const QString &path,
+                        Message *response);
+    bool receiveBlock1(const Peer &peer, const Message &request, const QString &path,
+                       Message *response, QByteArray *body);
+    void serveBlock2(const Peer &peer, const Message &request, const QString &path,
+                     const QByteArray &body, Message *response);
+    void sendSeparateResponse(const Peer &peer, const Message &request, const QString &path);
+    void registerObserver(const Peer &peer, const Message &request, const QString &path);
+    void removeObserver(const Peer &peer, const QByteArray &token);
+
+    void send(const Peer &peer, const Message &message);
+    void sendFrame(const Peer &peer, const QByteArray &frame);
+    void onRetransmissionTimeout(quint16 messageId);
+    void rememberResponse(const QString &key, const QByteArray &frame);
+    quint16 nextMessageId();
+    bool isLost() const;
+
+    QByteArray resourceContent(const QString &path) const;
+    static QByteArray coreLinkFormat();
+    static QByteArray largeContent();
+    static QString peerKey(const Peer &peer);
+
+    QUdpSocket *socket = nullptr;
+    QTimer *notificationTimer = nullptr;
+    quint16 messageIdCounter = 0;
+
+    QAtomicInt latencyMs = 0;
+    QAtomicInt lossPerMillion = 0;
+    QAtomicInt notificationIntervalMs = 1000;
+    QAtomicInt separateDelayMs = 500;
+
+    QVector<Observer> observers;
+    QHash<quint16, PendingConfirmable> pendingConfirmables;
+    QHash<QString, QByteArray> uploads;          // Block1 bodies being received
+    QHash<QString, QByteArray> blockBodies;      // Block2 bodies being served
+    QHash<QString, QByteArray> recentResponses;  // deduplication of requests
+    QQueue<QString> recentResponseKeys;
+    QByteArray largeUpdateContent;
+};
+
+QT_END_NAMESPACE
+
+#endif // COAPTESTSERVER_H
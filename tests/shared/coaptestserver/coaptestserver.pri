@@ -0,0 +1,9 @@
+QT += network
+
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/coaptestserver.h
+
+SOURCES += \
+    $$PWD/coaptestserver.cpp